@@ -0,0 +1,259 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <cassert>
+
+#include "Benchmark.h"
+#include "Game/GameSetup.h"
+#include "Game/GameVersion.h"
+#include "Game/GlobalUnsynced.h"
+#include "Net/GameServer.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "Sim/Misc/GlobalSynced.h"
+#include "System/EventHandler.h"
+#include "System/FileSystem/FileSystem.h"
+#include "System/Log/ILog.h"
+#include "System/SafeUtil.h"
+#include "System/StringUtil.h"
+#include "System/TimeProfiler.h"
+
+#include "System/Misc/TracyDefs.h"
+
+CBenchmark* CBenchmark::instance = nullptr;
+
+// how long the sim has to stand still after the demo was fully sent
+static constexpr float DEMO_END_IDLE_TIME = 2.0f; // secs
+
+
+CBenchmark::CBenchmark()
+: CEventClient("[CBenchmark]", 199992, false)
+{
+	eventHandler.AddClient(this);
+
+	frameSamples.reserve(GAME_SPEED * 60 * 30);
+
+	startTime = spring_gettime();
+	lastSampleTime = startTime;
+	lastFrameChangeTime = startTime;
+}
+
+void CBenchmark::Create()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	assert(instance == nullptr);
+
+	// all timers only accumulate while the profiler is enabled
+	CTimeProfiler& profiler = CTimeProfiler::GetInstance();
+	profiler.ResetState();
+	profiler.SetEnabled(true);
+
+	instance = new CBenchmark();
+
+	LOG("[Benchmark::%s] recording timers, report will be written to \"%s\"", __func__, reportFileName.c_str());
+}
+
+void CBenchmark::Destroy()
+{
+	spring::SafeDelete(instance);
+}
+
+
+void CBenchmark::GameFrame(int gameFrame)
+{
+	// GameFrame is called from inside Sim::GameFrame, so at this point the
+	// profiler holds everything of the previous frame but nothing of this one
+	SampleTimers(gameFrame - 1);
+}
+
+void CBenchmark::GameOver(const std::vector<unsigned char>& winningAllyTeams)
+{
+	Finish();
+}
+
+void CBenchmark::Update()
+{
+	if (finished)
+		return;
+	if (gameServer == nullptr || !gameServer->HasStarted())
+		return;
+
+	const spring_time now = spring_gettime();
+
+	if (gs->frameNum != lastFrameNum || gameServer->GetDemoReader() != nullptr) {
+		lastFrameNum = gs->frameNum;
+		lastFrameChangeTime = now;
+		return;
+	}
+
+	// the server has sent the whole demo; wait until we simulated all of it
+	if ((now - lastFrameChangeTime).toSecsf() < DEMO_END_IDLE_TIME)
+		return;
+
+	Finish();
+}
+
+
+unsigned int CBenchmark::GetColumn(unsigned int nameHash)
+{
+	const auto iter = timerColumns.find(nameHash);
+
+	if (iter != timerColumns.end())
+		return iter->second;
+
+	timerColumns.emplace(nameHash, columnTimers.size());
+	columnTimers.push_back(nameHash);
+	return (columnTimers.size() - 1);
+}
+
+void CBenchmark::SampleTimers(int frameNum)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	const spring_time now = spring_gettime();
+
+	curTotals.clear();
+	CTimeProfiler::GetInstance().GetTotalTimes(curTotals);
+
+	// loading and pre-game time ends up in frame -1, which is not reported
+	FrameSample* sample = nullptr;
+
+	if (frameNum >= 0) {
+		sample = &frameSamples.emplace_back();
+		sample->frameNum = frameNum;
+		sample->wallTime = (now - lastSampleTime).toMilliSecsf();
+	}
+
+	for (const auto& [nameHash, total]: curTotals) {
+		spring_time& lastTotal = lastTotals[nameHash];
+		const spring_time delta = total - lastTotal;
+
+		lastTotal = total;
+
+		if (sample == nullptr || delta <= spring_notime)
+			continue;
+
+		sample->times.emplace_back(GetColumn(nameHash), delta.toMilliSecsf());
+	}
+
+	lastSampleTime = now;
+}
+
+
+void CBenchmark::Finish()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (finished)
+		return;
+
+	finished = true;
+
+	LOG("[Benchmark::%s] %u frames in %.2fs", __func__, static_cast<unsigned int>(frameSamples.size()), (spring_gettime() - startTime).toSecsf());
+
+	if (WriteReport()) {
+		LOG("[Benchmark::%s] wrote report to \"%s\"", __func__, reportFileName.c_str());
+	} else {
+		LOG_L(L_ERROR, "[Benchmark::%s] could not write report to \"%s\"", __func__, reportFileName.c_str());
+	}
+
+	gu->globalQuit = true;
+}
+
+bool CBenchmark::WriteReport() const
+{
+	FILE* out = fopen(reportFileName.c_str(), "wt");
+
+	if (out == nullptr)
+		return false;
+
+	if (StringToLower(FileSystem::GetExtension(reportFileName)) == "csv") {
+		WriteCSV(out);
+	} else {
+		WriteJSON(out);
+	}
+
+	const bool success = (ferror(out) == 0);
+
+	fclose(out);
+	return success;
+}
+
+void CBenchmark::WriteCSV(FILE* out) const
+{
+	std::vector<float> row(columnTimers.size(), 0.0f);
+
+	fprintf(out, "frame,wall");
+
+	for (const unsigned int nameHash: columnTimers) {
+		fprintf(out, ",%s", CTimeProfiler::GetTimerName(nameHash).c_str());
+	}
+
+	fprintf(out, "\n");
+
+	for (const FrameSample& sample: frameSamples) {
+		std::fill(row.begin(), row.end(), 0.0f);
+
+		for (const auto& [column, time]: sample.times) {
+			row[column] = time;
+		}
+
+		fprintf(out, "%d,%.4f", sample.frameNum, sample.wallTime);
+
+		for (const float time: row) {
+			fprintf(out, ",%.4f", time);
+		}
+
+		fprintf(out, "\n");
+	}
+}
+
+void CBenchmark::WriteJSON(FILE* out) const
+{
+	// per-timer series, column-major so a timer can be plotted directly
+	std::vector< std::vector<float> > series(columnTimers.size(), std::vector<float>(frameSamples.size(), 0.0f));
+
+	for (size_t i = 0; i < frameSamples.size(); i++) {
+		for (const auto& [column, time]: frameSamples[i].times) {
+			series[column][i] = time;
+		}
+	}
+
+	const auto writeSeries = [out](const std::vector<float>& values) {
+		float total = 0.0f;
+		float peak = 0.0f;
+
+		for (const float value: values) {
+			total += value;
+			peak = std::max(peak, value);
+		}
+
+		fprintf(out, "{\"totalMs\": %.4f, \"maxMs\": %.4f, \"frames\": [", total, peak);
+
+		for (size_t i = 0; i < values.size(); i++) {
+			fprintf(out, (i == 0)? "%.4f": ", %.4f", values[i]);
+		}
+
+		fprintf(out, "]}");
+	};
+
+	std::vector<float> wallTimes;
+	wallTimes.reserve(frameSamples.size());
+
+	for (const FrameSample& sample: frameSamples) {
+		wallTimes.push_back(sample.wallTime);
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "\t\"engine\": %s,\n", Quote(SpringVersion::GetFull()).c_str());
+	fprintf(out, "\t\"demo\": %s,\n", Quote((gameSetup != nullptr)? gameSetup->demoName: "").c_str());
+	fprintf(out, "\t\"firstFrame\": %d,\n", frameSamples.empty()? 0: frameSamples.front().frameNum);
+	fprintf(out, "\t\"numFrames\": %u,\n", static_cast<unsigned int>(frameSamples.size()));
+	fprintf(out, "\t\"wall\": ");
+	writeSeries(wallTimes);
+	fprintf(out, ",\n\t\"timers\": {");
+
+	for (size_t column = 0; column < columnTimers.size(); column++) {
+		fprintf(out, "%s\n\t\t%s: ", (column == 0)? "": ",", Quote(CTimeProfiler::GetTimerName(columnTimers[column])).c_str());
+		writeSeries(series[column]);
+	}
+
+	fprintf(out, "\n\t}\n}\n");
+}
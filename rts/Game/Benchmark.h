@@ -0,0 +1,87 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "System/EventClient.h"
+#include "System/Misc/SpringTime.h"
+#include "System/UnorderedMap.hpp"
+
+/**
+ * Benchmark mode (--benchmark-report): while a demo is replayed as fast as
+ * the client can simulate it, records how much time every profiler timer
+ * (SCOPED_TIMER and friends) took in each sim-frame. When the demo is over
+ * the samples are written to the report file, as CSV if its name ends in
+ * ".csv" and as JSON otherwise, and the engine quits.
+ */
+class CBenchmark : public CEventClient
+{
+public:
+	// CEventClient interface
+	bool WantsEvent(const std::string& eventName) override {
+		return (eventName == "GameFrame" || eventName == "GameOver" || eventName == "Update");
+	}
+	bool GetFullRead() const override { return true; }
+	int  GetReadAllyTeam() const override { return AllAccessTeam; }
+
+	void GameFrame(int gameFrame) override;
+	void GameOver(const std::vector<unsigned char>& winningAllyTeams) override;
+	void Update() override;
+
+public:
+	static void Create();
+	static void Destroy();
+
+	static bool IsEnabled() { return (!reportFileName.empty()); }
+	static bool IsRunning() { return (instance != nullptr); }
+
+	inline static std::string reportFileName;
+
+private:
+	CBenchmark();
+
+	struct FrameSample {
+		int frameNum = 0;
+		float wallTime = 0.0f; // ms since the previous sample
+
+		// (column, ms); timers that were not hit in a frame are left out
+		std::vector< std::pair<unsigned int, float> > times;
+	};
+
+	void SampleTimers(int frameNum);
+	void Finish();
+
+	bool WriteReport() const;
+	void WriteCSV(FILE* out) const;
+	void WriteJSON(FILE* out) const;
+
+	unsigned int GetColumn(unsigned int nameHash);
+
+private:
+	std::vector<FrameSample> frameSamples;
+
+	// timer name-hash -> column, and the reverse
+	spring::unordered_map<unsigned int, unsigned int> timerColumns;
+	std::vector<unsigned int> columnTimers;
+
+	// accumulated time per timer as of the previous sample
+	spring::unordered_map<unsigned int, spring_time> lastTotals;
+	std::vector< std::pair<unsigned int, spring_time> > curTotals;
+
+	spring_time lastSampleTime;
+	spring_time startTime;
+	spring_time lastFrameChangeTime;
+
+	int lastFrameNum = -1;
+
+	bool finished = false;
+
+	static CBenchmark* instance;
+};
+
+#endif // BENCHMARK_H
@@ -19,7 +19,8 @@ CONFIG(std::string, HostIPDefault).defaultValue("localhost").dedicatedValue("").
 CONFIG(int, HostPortDefault).defaultValue(8452).minimumValue(0).maximumValue(65535).description("Default Port to use for hosting if not specified in script.txt");
 
 ClientSetup::ClientSetup()
-	: hostIP(configHandler->GetString("HostIPDefault"))
+	: demoSkipFrame(-1)
+	, hostIP(configHandler->GetString("HostIPDefault"))
 	, hostPort(configHandler->GetInt("HostPortDefault"))
 	, isHost(false)
 {
@@ -77,4 +78,5 @@ void ClientSetup::LoadFromStartScript(const std::string& setup)
 
 	file.GetDef(saveFile, "", "GAME\\SaveFile");
 	file.GetDef(demoFile, "", "GAME\\DemoFile");
+	file.GetDef(demoSkipFrame, "-1", "GAME\\DemoSkipFrame");
 }
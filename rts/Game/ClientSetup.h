@@ -19,6 +19,9 @@ public:
 	std::string saveFile;
 	std::string demoFile;
 
+	//! if saveFile is a demo snapshot, the frame to skip to after loading it
+	int demoSkipFrame;
+
 	//! if this client is not the server player, the IP address we connect to
 	//! if this client is the server player, the IP address that other players connect to
 	std::string hostIP;
@@ -4,10 +4,13 @@
 
 #include <Rml/Backends/RmlUi_Backend.h>
 #include <RmlUi/Core.h>
+#include <sstream>
 #include "Game.h"
+#include "Benchmark.h"
 #include "Camera.h"
 #include "CameraHandler.h"
 #include "ChatMessage.h"
+#include "ClientSetup.h"
 #include "CommandMessage.h"
 #include "ConsoleHistory.h"
 #include "GameHelper.h"
@@ -121,6 +124,8 @@
 #include "System/SpringMath.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/LoadSave/LoadSaveHandler.h"
+#include "System/LoadSave/CregLoadSaveHandler.h"
+#include "System/LoadSave/DemoIndex.h"
 #include "System/LoadSave/DemoRecorder.h"
 #include "System/Log/ILog.h"
 #include "System/Platform/Misc.h"
@@ -147,6 +152,7 @@ CONFIG(int, ShowPlayerInfo).defaultValue(1).headlessValue(0);
 CONFIG(float, GuiOpacity).defaultValue(0.8f).minimumValue(0.0f).maximumValue(1.0f).description("Sets the opacity of the built-in Spring UI. Generally has no effect on LuaUI widgets. Can be set in-game using shift+, to decrease and shift+. to increase.");
 CONFIG(std::string, InputTextGeo).defaultValue("");
 
+CONFIG(int, AutoSaveInterval).defaultValue(0).minimumValue(0).description("Seconds of game time between automatic saves to Saves/autosave.ssf (0 disables). These are incremental: only changed objects are written, against a full save in Saves/autosave.base.ssf that is rewritten once too much has changed. Only serializing the game state stalls the simulation, the files are written in the background.");
 CONFIG(int, SmoothTimeOffset).defaultValue(0).headlessValue(0).description("Enables frametimeoffset smoothing, 0 = off (old version), -1 = forced 0.5,  1-20 smooth, recommended = 2-3");
 
 CGame* game = nullptr;
@@ -216,6 +222,10 @@ CR_REG_METADATA(CGame, (
 	CR_IGNORED(curScanCodeChain),
 	CR_IGNORED(worldDrawer),
 	CR_IGNORED(saveFileHandler),
+	CR_IGNORED(autoSaveInterval),
+	CR_IGNORED(autoSaveDelta),
+	CR_IGNORED(autoSaveJob),
+	CR_IGNORED(simFrameGraph),
 
 	// Post Load
 	CR_POSTLOAD(PostLoad)
@@ -249,6 +259,7 @@ CGame::CGame(const std::string& mapFileName, const std::string& modFileName, ILo
 	showSpeed = configHandler->GetBool("ShowSpeed");
 
 	speedControl = configHandler->GetInt("SpeedControl");
+	autoSaveInterval = configHandler->GetInt("AutoSaveInterval") * GAME_SPEED;
 
 	playerRoster.SetSortTypeByCode((PlayerRoster::SortType)configHandler->GetInt("ShowPlayerInfo"));
 
@@ -283,6 +294,8 @@ CGame::CGame(const std::string& mapFileName, const std::string& modFileName, ILo
 
 	CResourceHandler::CreateInstance();
 	CCategoryHandler::CreateInstance();
+
+	InitSimFrameGraph();
 }
 
 CGame::~CGame()
@@ -980,6 +993,7 @@ void CGame::KillMisc()
 	RECOIL_DETAILED_TRACY_ZONE;
 	LOG("[Game::%s][1]", __func__);
 	CEndGameBox::Destroy();
+	CBenchmark::Destroy();
 	IVideoCapturing::FreeInstance();
 
 	LOG("[Game::%s][2]", __func__);
@@ -1245,6 +1259,15 @@ bool CGame::Update()
 
 	LEAVE_SYNCED_CODE();
 
+	{
+		int snapshotFrame = -1;
+		int skipFrame = -1;
+
+		// server found a demo snapshot closer to a /skip target than we are
+		if (gameServer != nullptr && gameServer->PopDemoSnapshotRequest(snapshotFrame, skipFrame))
+			LoadDemoSnapshot(snapshotFrame, skipFrame);
+	}
+
 	{
 		SLuaAllocError error = {};
 
@@ -1730,10 +1753,100 @@ void CGame::StartPlaying()
 
 	teamHandler.SetDefaultStartPositions(gameSetup);
 
+	if (CBenchmark::IsEnabled())
+		CBenchmark::Create();
+
 	if (saveFileHandler == nullptr)
 		eventHandler.GameStart();
 }
 
+// what the SimFrame stages read and write; any stage that can reach Lua,
+// unit scripts or the event handler can touch everything (SIM_RES_ALL)
+// and so keeps its place relative to every other stage
+enum SimFrameResource: CTaskGraph::ResourceMask {
+	SIM_RES_UNITS                = 1 << 0,
+	SIM_RES_FEATURES             = 1 << 1,
+	SIM_RES_PROJECTILES          = 1 << 2,
+	SIM_RES_UNSYNCED_PROJECTILES = 1 << 3,
+	SIM_RES_LOS                  = 1 << 4,
+	SIM_RES_PATH                 = 1 << 5,
+	SIM_RES_MAP                  = 1 << 6,
+	SIM_RES_ENVIRONMENT          = 1 << 7,
+	SIM_RES_GHOSTS               = 1 << 8,
+	SIM_RES_ALL                  = CTaskGraph::RES_ALL,
+};
+
+void CGame::InitSimFrameGraph()
+{
+	auto& g = simFrameGraph;
+
+	g.AddStage("Sim::Stage::GameFrame", SIM_RES_ALL, SIM_RES_ALL, true, [this]() {
+		SCOPED_TIMER("Sim::GameFrame");
+
+		// keep garbage-collection rate tied to sim-speed
+		// (fixed 30Hz gc is not enough while catching up)
+		if (luaGCControl == 0)
+			eventHandler.CollectGarbage(false);
+
+		eventHandler.GameFrame(gs->frameNum);
+	});
+	g.AddStage("Sim::Stage::Helper", SIM_RES_ALL, SIM_RES_ALL, true, []() { helper->Update(); });
+	g.AddStage("Sim::Stage::Map", SIM_RES_ALL, SIM_RES_ALL, true, []() {
+		readMap->Update();
+		smoothGround.UpdateSmoothMesh();
+		mapDamage->Update();
+	});
+	g.AddStage("Sim::Stage::Units", SIM_RES_ALL, SIM_RES_ALL, true, []() { unitHandler.Update(); });
+	g.AddStage("Sim::Stage::Path", SIM_RES_UNITS | SIM_RES_MAP | SIM_RES_PATH, SIM_RES_PATH, true, []() { pathManager->Update(); });
+	g.AddStage("Sim::Stage::Projectiles", SIM_RES_ALL, SIM_RES_ALL, true, []() { projectileHandler.Update(); });
+	g.AddStage("Sim::Stage::Features", SIM_RES_ALL, SIM_RES_ALL, true, []() { featureHandler.Update(); });
+	g.AddStage("Sim::Stage::Script", SIM_RES_ALL, SIM_RES_ALL, true, []() {
+		/* The default GAME_SPEED is 30, which doesn't divide 1000 well,
+		 * so scripts will perceive 990ms per second. But this is fine,
+		 * since doing "29th February" style of extra counting would be
+		 * disruptive to sleeps that assume a constant tick length while
+		 * not being otherwise perceptible since most animations don't
+		 * run that long. */
+		static constexpr int tickMs = 1000 / GAME_SPEED;
+
+		SCOPED_TIMER("Sim::Script");
+		unitScriptEngine->Tick(tickMs);
+	});
+	// wind changes are passed on to the generators' scripts
+	g.AddStage("Sim::Stage::Environment", SIM_RES_ALL, SIM_RES_ALL, true, []() { envResHandler.Update(); });
+
+	// unsynced projectiles only read sim state and los only writes its own
+	// maps; both run on workers, beside each other and the ghost update
+	g.AddStage(
+		"Sim::Stage::UnsyncedProjectiles",
+		SIM_RES_UNITS | SIM_RES_FEATURES | SIM_RES_PROJECTILES | SIM_RES_MAP | SIM_RES_ENVIRONMENT | SIM_RES_UNSYNCED_PROJECTILES,
+		SIM_RES_UNSYNCED_PROJECTILES,
+		false,
+		[]() { projectileHandler.UpdateUnsyncedProjectiles(); }
+	);
+	g.AddStage("Sim::Stage::Los", SIM_RES_UNITS | SIM_RES_MAP | SIM_RES_LOS, SIM_RES_LOS, false, []() { losHandler->Update(); });
+	// dead ghosts have to be updated in sim, after los,
+	// to make sure they represent the current knowledge correctly.
+	// should probably be split from drawer
+	g.AddStage("Sim::Stage::Ghosts", SIM_RES_LOS | SIM_RES_GHOSTS, SIM_RES_GHOSTS, true, []() { CUnitDrawer::UpdateGhostedBuildings(); });
+
+	g.AddStage("Sim::Stage::Intercept", SIM_RES_ALL, SIM_RES_ALL, true, []() { interceptHandler.Update(false); });
+	g.AddStage("Sim::Stage::Teams", SIM_RES_ALL, SIM_RES_ALL, true, []() {
+		teamHandler.GameFrame(gs->frameNum);
+		playerHandler.GameFrame(gs->frameNum);
+	});
+	g.AddStage("Sim::Stage::GameFramePost", SIM_RES_ALL, SIM_RES_ALL, true, []() { eventHandler.GameFramePost(gs->frameNum); });
+	// everything synced Lua sent to unsynced during this frame, for handles that batch it
+	g.AddStage("Sim::Stage::RecvFromSyncedBatch", SIM_RES_ALL, SIM_RES_ALL, true, []() {
+		CSplitLuaHandle* handles[] = {luaRules, luaGaia};
+
+		for (CSplitLuaHandle* h: handles) {
+			if (h != nullptr)
+				h->RecvFromSyncedBatch();
+		}
+	});
+}
+
 static const char* const tracingSimFrameName = "SimFrame";
 
 void CGame::SimFrame() {
@@ -1800,49 +1913,8 @@ void CGame::SimFrame() {
 	// everything from here is simulation
 	{
 		SCOPED_SPECIAL_TIMER("Sim");
-
-		{
-			SCOPED_TIMER("Sim::GameFrame");
-
-			// keep garbage-collection rate tied to sim-speed
-			// (fixed 30Hz gc is not enough while catching up)
-			if (luaGCControl == 0)
-				eventHandler.CollectGarbage(false);
-
-			eventHandler.GameFrame(gs->frameNum);
-		}
-
-		helper->Update();
-		readMap->Update();
-		smoothGround.UpdateSmoothMesh();
-		mapDamage->Update();
-		unitHandler.Update();
-		pathManager->Update();
-		projectileHandler.Update();
-		featureHandler.Update();
-		{
-			/* The default GAME_SPEED is 30, which doesn't divide 1000 well,
-			 * so scripts will perceive 990ms per second. But this is fine,
-			 * since doing "29th February" style of extra counting would be
-			 * disruptive to sleeps that assume a constant tick length while
-			 * not being otherwise perceptible since most animations don't
-			 * run that long. */
-			static constexpr int tickMs = 1000 / GAME_SPEED;
-
-			SCOPED_TIMER("Sim::Script");
-			unitScriptEngine->Tick(tickMs);
-		}
-		envResHandler.Update();
-		losHandler->Update();
-		// dead ghosts have to be updated in sim, after los,
-		// to make sure they represent the current knowledge correctly.
-		// should probably be split from drawer
-		CUnitDrawer::UpdateGhostedBuildings();
-		interceptHandler.Update(false);
-
-		teamHandler.GameFrame(gs->frameNum);
-		playerHandler.GameFrame(gs->frameNum);
-		eventHandler.GameFramePost(gs->frameNum);
+		// see InitSimFrameGraph for the stages and their order
+		simFrameGraph.Run();
 	}
 
 	lastSimFrameTime = spring_gettime();
@@ -1860,7 +1932,8 @@ void CGame::SimFrame() {
 		// multiply by 0.5 to give unsynced code some execution time (50% of our sleep-budget)
 		const float msecSleepTime = (msecMaxSimFrameTime - msecDifSimFrameTime) * 0.5f;
 
-		if (msecSleepTime > 0.0f) {
+		// benchmarks replay as fast as possible
+		if (msecSleepTime > 0.0f && !CBenchmark::IsRunning()) {
 			spring_sleep(spring_msecs(msecSleepTime));
 		}
 	}
@@ -2180,6 +2253,68 @@ void CGame::Save(std::string&& fileName, std::string&& saveArgs)
 	globalSaveFileData.args = std::move(saveArgs);
 }
 
+void CGame::SaveDemoSnapshot()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	CDemoIndex* demoIndex = gameServer->GetDemoIndex();
+
+	if (demoIndex == nullptr || !demoIndex->WantSnapshot(gs->frameNum))
+		return;
+
+	// must happen right after SimFrame, the index entry points at the demo
+	// data following this frame; nothing of that can be processed yet
+	CCregLoadSaveHandler saveHandler;
+	saveHandler.SaveInfo(gameSetup->mapName, gameSetup->modName);
+	saveHandler.SaveGame(demoIndex->GetSnapshotFileName(gs->frameNum));
+
+	demoIndex->AddSnapshot(gs->frameNum);
+}
+
+void CGame::AutoSave()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+
+	if (autoSaveInterval <= 0 || gs->frameNum <= 0 || (gs->frameNum % autoSaveInterval) != 0)
+		return;
+
+	if (!FileSystem::CreateDirectory("Saves"))
+		return;
+
+	if (autoSaveJob.valid()) {
+		// never wait for the disk; skipping one autosave is harmless
+		if (autoSaveJob.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) {
+			LOG_L(L_WARNING, "[Game::%s] previous autosave still being written, skipping frame %d", __func__, gs->frameNum);
+			return;
+		}
+
+		autoSaveDelta = autoSaveJob.get();
+	}
+
+	// every delta replaces the previous one, only the latest matters for recovery
+	CCregLoadSaveHandler saveHandler;
+	saveHandler.SaveInfo(gameSetup->mapName, gameSetup->modName);
+	autoSaveJob = saveHandler.SaveGameDelta("Saves/autosave.ssf", "Saves/autosave.base.ssf", std::move(autoSaveDelta));
+}
+
+void CGame::LoadDemoSnapshot(int snapshotFrame, int skipFrame)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	const CDemoIndex* demoIndex = gameServer->GetDemoIndex();
+
+	std::ostringstream script;
+	script << "[GAME]\n{\n";
+	script << "\tSaveFile=" << demoIndex->GetSnapshotFileName(snapshotFrame) << ";\n";
+	script << "\tDemoSkipFrame=" << skipFrame << ";\n";
+	script << "\tMyPlayerName=" << gameServer->GetClientSetup()->myPlayerName << ";\n";
+	script << "\tIsHost=1;\n";
+	script << "}\n";
+
+	LOG("[Game::%s] reloading into snapshot of frame %d, then skipping to frame %d", __func__, snapshotFrame, skipFrame);
+
+	gameSetup->reloadScript = script.str();
+	gu->globalReload = true;
+}
+
 
 
 
@@ -4,6 +4,7 @@
 #define _GAME_H
 
 #include <atomic>
+#include <future>
 #include <string>
 #include <vector>
 
@@ -15,6 +16,8 @@
 #include "System/UnorderedMap.hpp"
 #include "System/creg/creg_cond.h"
 #include "System/Misc/SpringTime.h"
+#include "System/LoadSave/SaveDelta.h"
+#include "System/Threading/TaskGraph.h"
 
 class LuaParser;
 class ILoadSaveHandler;
@@ -100,6 +103,11 @@ public:
 	void ParseInputTextGeometry(const std::string& geo);
 
 	void Save(std::string&& fileName, std::string&& saveArgs);
+	/// writes a demo-index snapshot if the frame just simulated needs one
+	void SaveDemoSnapshot();
+	/// writes an incremental autosave if one is due after the frame just simulated
+	void AutoSave();
+	void LoadDemoSnapshot(int snapshotFrame, int skipFrame);
 
 	void ResizeEvent() override;
 
@@ -141,6 +149,7 @@ private:
 	void ClientReadNet();
 	void UpdateNumQueuedSimFrames();
 	void UpdateNetMessageProcessingTimeLeft();
+	void InitSimFrameGraph();
 	void SimFrame();
 	void StartPlaying();
 
@@ -224,6 +233,16 @@ private:
 	/// for reloading the savefile
 	ILoadSaveHandler* saveFileHandler;
 
+	/// frames between autosaves, 0 if disabled
+	int autoSaveInterval = 0;
+	/// base the autosave deltas are written against
+	CSaveDelta autoSaveDelta;
+	/// the autosave being written, owns autoSaveDelta until it is done
+	std::future<CSaveDelta> autoSaveJob;
+
+	/// the stages of SimFrame and what each of them touches
+	CTaskGraph simFrameGraph{"Sim::CriticalPath"};
+
 	std::atomic<bool> loadDone = {false};
 	std::atomic<bool> gameOver = {false};
 };
@@ -655,10 +655,34 @@ namespace {
 
 
 
-size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets)
+// [0] := default, [1,2,3,4,5,6] := target is {avoidee, in bad category, crashing, last attacker, paralyzed, outside unboosted range}
+static constexpr float tgtPriorityMults[] = {1.0f, 10.0f, 100.0f, 1000.0f, 0.5f, 4.0f, 100000.0f};
+
+static const CUnit* GetWeaponLastAttacker(const CWeapon* weapon)
+{
+	const CUnit* weaponOwner = weapon->owner;
+	return (((weaponOwner->lastAttackFrame + 200) <= gs->frameNum) ? weaponOwner->lastAttacker : nullptr);
+}
+
+static float ApplyPrevLosPriority(const CWeapon* weapon, const CUnit* targetUnit, const CUnit* lastAttacker, float targetPriority)
+{
+	if ((targetUnit->losStatus[weapon->owner->allyteam] & LOS_PREVLOS) == 0)
+		return targetPriority;
+
+	const float damageMul = std::max(0.0001f, weapon->damages->Get(targetUnit->armorType) * targetUnit->curArmorMultiple);
+
+	targetPriority /= (damageMul * targetUnit->power);
+	targetPriority *= tgtPriorityMults[((targetUnit->category & weapon->badTargetCategory) != 0) * 2];
+	targetPriority *= tgtPriorityMults[(targetUnit->IsCrashing()) * 3];
+	targetPriority *= tgtPriorityMults[(targetUnit == lastAttacker) * 4];
+	return targetPriority;
+}
+
+void CGameHelper::GatherWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, int thread, std::vector<SWeaponTargetCandidate>& candidates)
 {
+	RECOIL_DETAILED_TRACY_ZONE;
 	const CUnit*  weaponOwner = weapon->owner;
-	const CUnit* lastAttacker = ((weaponOwner->lastAttackFrame + 200) <= gs->frameNum) ? weaponOwner->lastAttacker : nullptr;
+	const CUnit* lastAttacker = GetWeaponLastAttacker(weapon);
 
 	const      WeaponDef* weaponDef = weapon->weaponDef;
 	const DynDamageArray* weaponDmg = weapon->damages;
@@ -682,19 +706,16 @@ size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* av
 	// const float scanRadius = weapon->GetRange2D(rangeBoost, (minMapHeight - aimPosHeight) * heightMod);
 	const float scanRadius = baseRange + rangeBoost + (aimPosHeight - minMapHeight) * heightMod;
 
-	// [0] := default, [1,2,3,4,5,6] := target is {avoidee, in bad category, crashing, last attacker, paralyzed, outside unboosted range}
-	constexpr float tgtPriorityMults[] = {1.0f, 10.0f, 100.0f, 1000.0f, 0.5f, 4.0f, 100000.0f};
-
 	const bool paralyzer = (weaponDmg->paralyzeDamageTime != 0);
 
-	// copy on purpose since the below calls lua
 	QuadFieldQuery qfQuery;
+	qfQuery.threadOwner = thread;
 	quadField.GetQuads(qfQuery, ownerPos, scanRadius);
 
-	targets.clear();
-	targets.reserve(32);
+	candidates.clear();
+	candidates.reserve(32);
 
-	const int tempNum = gs->GetTempNum();
+	const int tempNum = gs->GetMtTempNum(thread);
 
 	for (int t = 0; t < teamHandler.ActiveAllyTeams(); ++t) {
 		if (teamHandler.Ally(weaponOwner->allyteam, t))
@@ -704,10 +725,10 @@ size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* av
 			const std::vector<CUnit*>& allyTeamUnits = quadField.GetQuad(qi).teamUnits[t];
 
 			for (CUnit* targetUnit: allyTeamUnits) {
-				if (targetUnit->tempNum == tempNum)
+				if (targetUnit->mtTempNum[thread] == tempNum)
 					continue;
 
-				targetUnit->tempNum = tempNum;
+				targetUnit->mtTempNum[thread] = tempNum;
 
 				if (!weapon->TestTarget(testPos, SWeaponTarget(targetUnit)))
 					continue;
@@ -743,43 +764,56 @@ size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* av
 
 				const float dist2D = math::sqrt(sqDist2D);
 				const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
-				const float damageMul = std::max(0.0001f, weaponDmg->Get(targetUnit->armorType) * targetUnit->curArmorMultiple);
 
 				targetPriority *= angleMul;
 				targetPriority *= rangeMul;
 				targetPriority *= tgtPriorityMults[(dist2D > baseRange) * 6];
 
+				// TargetWeight calls into the unit script, leave it (and
+				// everything that follows it) to CommitWeaponTargets
+				const bool needsTargetWeight = ((targetLOSState & LOS_INLOS) != 0 && weapon->hasTargetWeight);
+
 				if (targetLOSState & LOS_INLOS) {
 					targetPriority *= (secDamage + targetUnit->health);
 
 					if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health))
 						targetPriority *= tgtPriorityMults[5];
-
-					if (weapon->hasTargetWeight)
-						targetPriority *= weapon->TargetWeight(targetUnit);
-
 				} else {
 					targetPriority *= (secDamage + 10000.0f);
 				}
 
-				if (targetLOSState & LOS_PREVLOS) {
-					targetPriority /= (damageMul * targetUnit->power);
-					targetPriority *= tgtPriorityMults[((targetUnit->category & weapon->badTargetCategory) != 0) * 2];
-					targetPriority *= tgtPriorityMults[(targetUnit->IsCrashing()) * 3];
-					targetPriority *= tgtPriorityMults[(targetUnit == lastAttacker) * 4];
-				}
+				if (!needsTargetWeight)
+					targetPriority = ApplyPrevLosPriority(weapon, targetUnit, lastAttacker, targetPriority);
 
-				const bool allowTarget = eventHandler.AllowWeaponTarget(weaponOwner->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority);
+				candidates.push_back({targetUnit, targetPriority, needsTargetWeight});
+			}
+		}
+	}
+}
 
-				// Lua call may have changed tempNum, so needs to be set again
-				targetUnit->tempNum = tempNum;
+size_t CGameHelper::CommitWeaponTargets(const CWeapon* weapon, const std::vector<SWeaponTargetCandidate>& candidates, std::vector<std::pair<float, CUnit*>>& targets)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	const CUnit*  weaponOwner = weapon->owner;
+	const CUnit* lastAttacker = GetWeaponLastAttacker(weapon);
+	const WeaponDef* weaponDef = weapon->weaponDef;
 
-				if (!allowTarget)
-					continue;
+	targets.clear();
+	targets.reserve(candidates.size());
 
-				targets.emplace_back(targetPriority, targetUnit);
-			}
+	for (const SWeaponTargetCandidate& candidate: candidates) {
+		CUnit* targetUnit = candidate.unit;
+		float targetPriority = candidate.priority;
+
+		if (candidate.needsTargetWeight) {
+			targetPriority *= weapon->TargetWeight(targetUnit);
+			targetPriority = ApplyPrevLosPriority(weapon, targetUnit, lastAttacker, targetPriority);
 		}
+
+		if (!eventHandler.AllowWeaponTarget(weaponOwner->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority))
+			continue;
+
+		targets.emplace_back(targetPriority, targetUnit);
 	}
 
 	std::stable_sort(targets.begin(), targets.end(), [](const std::pair<float, CUnit*>& a, const std::pair<float, CUnit*>& b) { return (a.first < b.first); });
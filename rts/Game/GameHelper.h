@@ -6,6 +6,7 @@
 #include "Sim/Projectiles/ExplosionListener.h"
 #include "Sim/Units/CommandAI/Command.h"
 #include "Sim/Misc/GlobalConstants.h"
+#include "Sim/Weapons/WeaponTarget.h"
 #include "System/EventClient.h"
 #include "System/float3.h"
 #include "System/float4.h"
@@ -148,7 +149,15 @@ public:
 		bool synced = false
 	);
 
-	static size_t GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets);
+	/**
+	 * Weapon auto-targeting in two halves. Gather does the QuadField search and
+	 * priority scoring without calling into Lua or unit scripts, so it may run
+	 * concurrently for different weapons (each with its own thread slot);
+	 * Commit applies TargetWeight and AllowWeaponTarget in candidate order and
+	 * sorts by INCREASING priority, and must run on the main thread.
+	 */
+	static void GatherWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, int thread, std::vector<SWeaponTargetCandidate>& candidates);
+	static size_t CommitWeaponTargets(const CWeapon* weapon, const std::vector<SWeaponTargetCandidate>& candidates, std::vector<std::pair<float, CUnit*>>& targets);
 
 	void Init();
 	void Kill();
@@ -207,7 +216,7 @@ private:
 
 public:
 	std::vector<int> targetUnitIDs; // GetEnemyUnits{NoLosTest}
-	std::vector<std::pair<float, CUnit*>> targetPairs; // GenerateWeaponTargets
+	std::vector<std::pair<float, CUnit*>> targetPairs; // CommitWeaponTargets
 };
 
 extern CGameHelper* helper;
\ No newline at end of file
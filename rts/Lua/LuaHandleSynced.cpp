@@ -84,6 +84,8 @@ bool CUnsyncedLuaHandle::Init(std::string code, const std::string& file)
 	if (!IsValid())
 		return false;
 
+	syncedBatch.Reset();
+
 	// load the standard libraries
 	LUA_OPEN_LIB(L, luaopen_base);
 	LUA_OPEN_LIB(L, luaopen_math);
@@ -175,6 +177,8 @@ bool CUnsyncedLuaHandle::Init(std::string code, const std::string& file)
  *********************/
 
 /*** Receives data sent via `SendToUnsynced` callout.
+ *
+ * Not called if `RecvFromSyncedBatch` is defined.
  *
  * @function UnsyncedCallins:RecvFromSynced
  * @param ... any
@@ -188,6 +192,15 @@ void CUnsyncedLuaHandle::RecvFromSynced(lua_State* srcState, int args)
 	LUA_CALL_IN_CHECK(L);
 	luaL_checkstack(L, 2 + args, __func__);
 
+	static const LuaHashString batchStr("RecvFromSyncedBatch");
+	if (batchStr.GetGlobalFunc(L)) {
+		lua_pop(L, 1);
+
+		LuaUtils::CopyData(L, srcState, args);
+		syncedBatch.Push(L, args);
+		return;
+	}
+
 	static const LuaHashString cmdStr(__func__);
 	if (!cmdStr.GetGlobalFunc(L))
 		return; // the call is not defined
@@ -198,6 +211,38 @@ void CUnsyncedLuaHandle::RecvFromSynced(lua_State* srcState, int args)
 	RunCallIn(L, cmdStr, args, 0);
 }
 
+/*** Receives all data sent via `SendToUnsynced` during one sim frame.
+ *
+ * If defined, replaces `RecvFromSynced`: the arguments of every `SendToUnsynced`
+ * are queued and delivered together at the end of the sim frame, which saves a
+ * call-in per message. Messages sent between frames (e.g. by `RecvLuaMsg` while
+ * the game is paused) are delivered at the end of the next frame.
+ *
+ * @function UnsyncedCallins:RecvFromSyncedBatch
+ * @param messages table[] the argument lists in the order they were sent, each with its argument count in `n`
+ */
+void CUnsyncedLuaHandle::RecvFromSyncedBatch()
+{
+	if (syncedBatch.Empty() || !IsValid())
+		return;
+
+	LUA_CALL_IN_CHECK(L);
+	luaL_checkstack(L, 3, __func__);
+
+	syncedBatch.Pop(L);
+
+	static const LuaHashString cmdStr(__func__);
+	if (!cmdStr.GetGlobalFunc(L)) {
+		lua_pop(L, 1);
+		return; // undefined since the messages were queued
+	}
+
+	lua_insert(L, -2);
+
+	// call the routine
+	RunCallIn(L, cmdStr, 1, 0);
+}
+
 /*** Custom Object Rendering
  *
  * For the following calls drawMode can be one of the following, notDrawing = 0, normalDraw = 1, shadowDraw = 2, reflectionDraw = 3, refractionDraw = 4, and finally gameDeferredDraw = 5 which was added in 102.0.
@@ -7,6 +7,7 @@
 
 #include "LuaHandle.h"
 #include "LuaRulesParams.h"
+#include "LuaSyncedBatch.h"
 #include "System/UnorderedMap.hpp"
 
 struct lua_State;
@@ -28,6 +29,7 @@ class CUnsyncedLuaHandle : public CLuaHandle
 
 	public: // all non-eventhandler callins
 		void RecvFromSynced(lua_State* srcState, int args); // not an engine call-in
+		void RecvFromSyncedBatch(); // not an engine call-in
 
 	protected:
 		CUnsyncedLuaHandle(CSplitLuaHandle* base, const std::string& name, int order);
@@ -42,6 +44,9 @@ class CUnsyncedLuaHandle : public CLuaHandle
 
 	protected:
 		CSplitLuaHandle& base;
+
+		// argument lists RecvFromSynced queued for RecvFromSyncedBatch
+		LuaSyncedBatch syncedBatch;
 };
 
 
@@ -183,6 +188,10 @@ class CSplitLuaHandle
 			return syncedLuaHandle.RecvLuaMsg(msg, playerID);
 		}
 
+		void RecvFromSyncedBatch() {
+			unsyncedLuaHandle.RecvFromSyncedBatch();
+		}
+
 	public:
 		void CheckStack() {
 			syncedLuaHandle.CheckStack();
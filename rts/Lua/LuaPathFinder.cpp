@@ -159,6 +159,30 @@ static int path_nodes(lua_State* L)
 	return (LuaPathFinder::PushPathNodes(L, pathID));
 }
 
+static int path_stats(lua_State* L)
+{
+	const int* idPtr = (int*)luaL_checkudata(L, 1, "Path");
+	const int pathID = *idPtr;
+
+	if (pathID == 0)
+		return 0;
+
+	unsigned int numNodesSearched = 0;
+	float searchTimeMs = 0.0f;
+
+	if (!pathManager->GetPathSearchStats(pathID, numNodesSearched, searchTimeMs))
+		return 0;
+
+	lua_pushnumber(L, numNodesSearched);
+
+	// wall-clock time differs between clients, synced code only gets the node count
+	if (CLuaHandle::GetHandleSynced(L))
+		return 1;
+
+	lua_pushnumber(L, searchTimeMs);
+	return 2;
+}
+
 static int path_index(lua_State* L)
 {
 	const int* idPtr = (int*)luaL_checkudata(L, 1, "Path");
@@ -176,6 +200,10 @@ static int path_index(lua_State* L)
 		lua_pushcfunction(L, path_nodes);
 		return 1;
 	}
+	if (key == "GetSearchStats") {
+		lua_pushcfunction(L, path_stats);
+		return 1;
+	}
 	return 0;
 }
 
@@ -0,0 +1,66 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef LUA_SYNCED_BATCH_H
+#define LUA_SYNCED_BATCH_H
+
+#include "LuaInclude.h"
+
+
+/**
+ * The argument lists of the SendToUnsynced calls that are waiting for
+ * RecvFromSyncedBatch, kept in a registry table of the receiving state.
+ */
+class LuaSyncedBatch {
+	public:
+		// references into a previous state are gone
+		void Reset() {
+			ref = LUA_NOREF;
+			size = 0;
+		}
+
+		bool Empty() const { return (size == 0); }
+		int Size() const { return size; }
+
+		// moves the top <args> values of L into a new list {..., n = args}
+		// at the end of the batch; needs two free stack slots
+		void Push(lua_State* L, int args) {
+			lua_createtable(L, args, 1);
+			lua_insert(L, -(args + 1));
+
+			// pop the arguments into the list, last one first
+			for (int i = args; i > 0; i--) {
+				lua_rawseti(L, -(i + 1), i);
+			}
+
+			lua_pushnumber(L, args);
+			lua_setfield(L, -2, "n");
+
+			if (ref == LUA_NOREF) {
+				lua_createtable(L, 16, 0);
+				ref = luaL_ref(L, LUA_REGISTRYINDEX);
+			}
+
+			lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+			lua_insert(L, -2);
+			lua_rawseti(L, -2, ++size);
+			lua_pop(L, 1);
+		}
+
+		// pushes the lists in the order they were queued and starts a new batch;
+		// pushes nothing if the batch is empty
+		bool Pop(lua_State* L) {
+			if (Empty())
+				return false;
+
+			lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+			luaL_unref(L, LUA_REGISTRYINDEX, ref);
+			Reset();
+			return true;
+		}
+
+	private:
+		int ref = LUA_NOREF;
+		int size = 0;
+};
+
+#endif /* LUA_SYNCED_BATCH_H */
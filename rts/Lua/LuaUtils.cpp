@@ -42,8 +42,22 @@ Json::Value LuaUtils::LuaStackDumper::root  = {};
 /******************************************************************************/
 
 
-static bool CopyPushData(lua_State* dst, lua_State* src, int index, int depth, spring::unsynced_map<const void*, int>& alreadyCopied);
-static bool CopyPushTable(lua_State* dst, lua_State* src, int index, int depth, spring::unsynced_map<const void*, int>& alreadyCopied);
+// strings shorter than this are cheaper to intern again than to look up in the cache
+static constexpr size_t MIN_CACHED_STRING_LEN = 256;
+
+struct CopyCache {
+	// copied tables (needed for recursive tables, i.e. "local t = {}; t[t] = t")
+	// and long strings by their address in src, mapped to their index in a
+	// scratch table at <stackIdx> in dst; the order of traversal does not
+	// matter so we can use an unsynced map
+	spring::unsynced_map<const void*, int> indices;
+
+	int baseIdx = 0;  // dst stack-top before copying
+	int stackIdx = 0; // scratch table, 0 until something was cached
+};
+
+static bool CopyPushData(lua_State* dst, lua_State* src, int index, int depth, CopyCache& cache);
+static bool CopyPushTable(lua_State* dst, lua_State* src, int index, int depth, CopyCache& cache);
 
 
 static inline int PosAbsLuaIndex(lua_State* src, int index)
@@ -55,7 +69,36 @@ static inline int PosAbsLuaIndex(lua_State* src, int index)
 }
 
 
-static bool CopyPushData(lua_State* dst, lua_State* src, int index, int depth, spring::unsynced_map<const void*, int>& alreadyCopied)
+static bool PushCached(lua_State* dst, const CopyCache& cache, const void* p)
+{
+	const auto it = cache.indices.find(p);
+
+	if (it == cache.indices.end())
+		return false;
+
+	lua_rawgeti(dst, cache.stackIdx, it->second);
+	return true;
+}
+
+// caches the value on top of dst
+static void AddCached(lua_State* dst, CopyCache& cache, const void* p)
+{
+	if (cache.stackIdx == 0) {
+		// below everything copied so far; values are only ever addressed relative to the top
+		lua_createtable(dst, 16, 0);
+		lua_insert(dst, cache.baseIdx + 1);
+		cache.stackIdx = cache.baseIdx + 1;
+	}
+
+	const int idx = cache.indices.size() + 1;
+
+	lua_pushvalue(dst, -1);
+	lua_rawseti(dst, cache.stackIdx, idx);
+	cache.indices[p] = idx;
+}
+
+
+static bool CopyPushData(lua_State* dst, lua_State* src, int index, int depth, CopyCache& cache)
 {
 	switch (lua_type(src, index)) {
 		case LUA_TBOOLEAN: {
@@ -67,28 +110,29 @@ static bool CopyPushData(lua_State* dst, lua_State* src, int index, int depth, s
 		} break;
 
 		case LUA_TSTRING: {
-			// get string (pointer)
+			// get string (pointer), both states hash strings the same way
 			size_t len;
-			const char* data = lua_tolstring(src, index, &len);
+			lua_Hash hash;
+			const char* data = lua_tohstring(src, index, &len, &hash);
 
-			// check cache
-			auto it = alreadyCopied.find(data);
-			if (it != alreadyCopied.end()) {
-				lua_rawgeti(dst, LUA_REGISTRYINDEX, it->second);
+			if (len < MIN_CACHED_STRING_LEN) {
+				lua_pushhstring(dst, hash, data, len);
 				break;
 			}
 
+			// check cache
+			if (PushCached(dst, cache, data))
+				break;
+
 			// copy string
-			lua_pushlstring(dst, data, len);
+			lua_pushhstring(dst, hash, data, len);
 
 			// cache it
-			lua_pushvalue(dst, -1);
-			const int dstRef = luaL_ref(dst, LUA_REGISTRYINDEX);
-			alreadyCopied[data] = dstRef;
+			AddCached(dst, cache, data);
 		} break;
 
 		case LUA_TTABLE: {
-			CopyPushTable(dst, src, index, depth, alreadyCopied);
+			CopyPushTable(dst, src, index, depth, cache);
 		} break;
 
 		default: {
@@ -101,17 +145,14 @@ static bool CopyPushData(lua_State* dst, lua_State* src, int index, int depth, s
 }
 
 
-static bool CopyPushTable(lua_State* dst, lua_State* src, int index, int depth, spring::unsynced_map<const void*, int>& alreadyCopied)
+static bool CopyPushTable(lua_State* dst, lua_State* src, int index, int depth, CopyCache& cache)
 {
 	const int table = PosAbsLuaIndex(src, index);
 
 	// check cache
 	const void* p = lua_topointer(src, table);
-	auto it = alreadyCopied.find(p);
-	if (it != alreadyCopied.end()) {
-		lua_rawgeti(dst, LUA_REGISTRYINDEX, it->second);
+	if (PushCached(dst, cache, p))
 		return true;
-	}
 
 	// check table depth
 	if (depth++ > maxDepth) {
@@ -120,19 +161,19 @@ static bool CopyPushTable(lua_State* dst, lua_State* src, int index, int depth,
 		return false;
 	}
 
-	// create new table
-	const auto array_len = lua_objlen(src, table);
-	lua_createtable(dst, array_len, 5);
+	// create new table with the same shape, so filling it never rehashes
+	int arraySize = 0;
+	int hashSize = 0;
+	lua_tablesize(src, table, &arraySize, &hashSize);
+	lua_createtable(dst, arraySize, hashSize);
 
 	// cache it
-	lua_pushvalue(dst, -1);
-	const int dstRef = luaL_ref(dst, LUA_REGISTRYINDEX);
-	alreadyCopied[p] = dstRef;
+	AddCached(dst, cache, p);
 
 	// copy table entries
 	for (lua_pushnil(src); lua_next(src, table) != 0; lua_pop(src, 1)) {
-		CopyPushData(dst, src, -2, depth, alreadyCopied); // copy the key
-		CopyPushData(dst, src, -1, depth, alreadyCopied); // copy the value
+		CopyPushData(dst, src, -2, depth, cache); // copy the key
+		CopyPushData(dst, src, -1, depth, cache); // copy the value
 		lua_rawset(dst, -3);
 	}
 
@@ -150,24 +191,21 @@ int LuaUtils::CopyData(lua_State* dst, lua_State* src, int count)
 		LOG_L(L_ERROR, "LuaUtils::CopyData: tried to copy more data than there is");
 		return 0;
 	}
-	lua_checkstack(dst, count + 3); // +3 needed for table copying
+	lua_checkstack(dst, count + 4); // +3 needed for table copying, +1 for the cache
 	lua_lock(src); // we need to be sure tables aren't changed while we iterate them
 
-	// hold a map of all already copied tables in the lua's registry table
-	// needed for recursive tables, i.e. "local t = {}; t[t] = t"
-	// the order of traversal doesn't matter so we can use an unsynced map
-	spring::unsynced_map<const void*, int> alreadyCopied;
+	CopyCache cache;
+	cache.baseIdx = dstTop;
 
 	const int startIndex = (srcTop - count + 1);
 	const int endIndex   = srcTop;
 	for (int i = startIndex; i <= endIndex; i++) {
-		CopyPushData(dst, src, i, 0, alreadyCopied);
+		CopyPushData(dst, src, i, 0, cache);
 	}
 
-	// clear map
-	for (auto& pair: alreadyCopied) {
-		luaL_unref(dst, LUA_REGISTRYINDEX, pair.second);
-	}
+	// the scratch table is garbage once it is off the stack
+	if (cache.stackIdx != 0)
+		lua_remove(dst, cache.stackIdx);
 
 	const int curSrcTop = lua_gettop(src);
 	assert(srcTop == curSrcTop);
@@ -124,6 +124,7 @@ std::vector<float3> CReadMap::centerNormalsUnsynced;
 
 std::vector<float> CReadMap::slopeMap;
 std::vector<uint8_t> CReadMap::typeMap;
+std::vector<uint8_t> CReadMap::originalTypeMap;
 std::vector<float3> CReadMap::centerNormals2D;
 
 std::vector<uint8_t> CReadMap::  syncedHeightMapDigests;
@@ -227,21 +228,36 @@ void CReadMap::SerializeMapChanges(creg::ISerializer* s, const float* refHeightM
 	}
 }
 
-void CReadMap::SerializeTypeMap(creg::ISerializer* s)
+void CReadMap::ReadOriginalTypeMap()
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	// LuaSynced can also touch the typemap, serialize it (manually)
 	MapBitmapInfo tbi;
 
-	uint8_t*  itm = typeMap.data();
 	uint8_t* iotm = GetInfoMap("type", &tbi);
 
+	originalTypeMap.clear();
+
+	if (iotm == nullptr)
+		return;
+
 	assert(!typeMap.empty());
 	assert(typeMap.size() == (tbi.width * tbi.height));
 
-	if (iotm == nullptr)
+	originalTypeMap.assign(iotm, iotm + typeMap.size());
+
+	FreeInfoMap("type", iotm);
+}
+
+void CReadMap::SerializeTypeMap(creg::ISerializer* s)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	// LuaSynced can also touch the typemap, serialize it (manually)
+	if (originalTypeMap.empty())
 		return;
 
+	      uint8_t*  itm = typeMap.data();
+	const uint8_t* iotm = originalTypeMap.data();
+
 	uint8_t type;
 
 	if (s->IsWriting()) {
@@ -255,8 +271,6 @@ void CReadMap::SerializeTypeMap(creg::ISerializer* s)
 			itm[i] = type ^ iotm[i];
 		}
 	}
-
-	FreeInfoMap("type", iotm);
 }
 
 
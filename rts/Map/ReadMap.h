@@ -86,6 +86,15 @@ public:
 	/// creg serialize callback
 	void Serialize(creg::ISerializer* s);
 
+	/// reads the map file's typemap, which SerializeTypeMap stores the changes
+	/// against; has to be called before a game is saved or loaded since the map
+	/// can be serialized on a worker thread, which must not touch the VFS
+	void ReadOriginalTypeMap();
+	void FreeOriginalTypeMap() {
+		originalTypeMap.clear();
+		originalTypeMap.shrink_to_fit();
+	}
+
 private:
 	void SerializeMapChangesBeforeMatch(creg::ISerializer* s);
 	void SerializeMapChangesDuringMatch(creg::ISerializer* s);
@@ -277,6 +286,8 @@ protected:
 
 	static std::vector<float> slopeMap;               //< size: (mapx/2)    * (mapy/2)  , same as 1.0 - interpolate(centernomal[i]).y [SYNCED]
 	static std::vector<uint8_t> typeMap;
+	/// only held while a game is saved or loaded, empty if the map has no typemap
+	static std::vector<uint8_t> originalTypeMap;
 	static std::vector<float3> centerNormals2D;
 
 
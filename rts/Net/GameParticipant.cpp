@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "GameParticipant.h"
+#include "SpectatorRelay.h"
 
 #include "Net/Protocol/BaseNetProtocol.h"
 #include "Sim/Misc/GlobalConstants.h"
@@ -22,8 +23,15 @@ GameParticipant::~GameParticipant()
 
 void GameParticipant::SendData(std::shared_ptr<const netcode::RawPacket> packet)
 {
-	if (clientLink != nullptr && myState != GameParticipant::State::DISCONNECTING)
+	if (clientLink == nullptr || myState == GameParticipant::State::DISCONNECTING)
+		return;
+
+	// keep the order of everything the relay still has queued for this link
+	if (CSpectatorRelay* r = GetRelay(); r != nullptr) {
+		lastRelayJob = r->SendData(clientLink, packet);
+	} else {
 		clientLink->SendData(packet);
+	}
 }
 
 void GameParticipant::Connected(std::shared_ptr<netcode::CConnection> _link, bool local)
@@ -42,9 +50,11 @@ void GameParticipant::Kill(const std::string& reason, const bool flush)
 {
 	bool disconnected = true;
 
+	SetRelay(nullptr);
+
 	if (clientLink != nullptr) {
 		if (myState != GameParticipant::State::DISCONNECTING) {
-			clientLink->SendData(CBaseNetProtocol::Get().SendQuit(reason));
+			SendData(CBaseNetProtocol::Get().SendQuit(reason));
 
 			if (flush) {
 				/* delay to make sure the Flush() performed by Close()
@@ -77,10 +87,52 @@ void GameParticipant::CheckForExpiredConnection() {
 	}
 }
 
+void GameParticipant::SetRelay(CSpectatorRelay* newRelay)
+{
+	if (newRelay == (relayAttached? relay: nullptr))
+		return;
+
+	// does not wait for the relay; sends keep going through it until it is
+	// done with the link, see GetRelay
+	if (relayAttached && clientLink != nullptr)
+		lastRelayJob = relay->RemoveLink(clientLink);
+
+	relayAttached = false;
+
+	if (newRelay == nullptr) {
+		GetRelay();
+		return;
+	}
+
+	relay = newRelay;
+	relayAttached = true;
+
+	if (clientLink != nullptr)
+		lastRelayJob = relay->AddLink(clientLink);
+}
+
+CSpectatorRelay* GameParticipant::GetRelay()
+{
+	if (relay != nullptr && !relayAttached && relay->IsDone(lastRelayJob))
+		relay = nullptr;
+
+	return relay;
+}
+
 void GameParticipant::CloseConnection(bool flush) {
+	SetRelay(nullptr);
+
 	if (clientLink != nullptr) {
 		LOG("%s: client connection closed", __func__);
-		clientLink->Close(flush);
+
+		if (CSpectatorRelay* r = GetRelay(); r != nullptr) {
+			r->CloseLink(clientLink, flush);
+		} else {
+			clientLink->Close(flush);
+		}
+
 		clientLink.reset();
 	}
+
+	relay = nullptr;
 }
@@ -3,6 +3,7 @@
 #ifndef _GAME_PARTICIPANT_H
 #define _GAME_PARTICIPANT_H
 
+#include <cstdint>
 #include <memory>
 
 #include "Game/Players/PlayerBase.h"
@@ -17,6 +18,8 @@ namespace netcode
 	class RawPacket;
 }
 
+class CSpectatorRelay;
+
 class GameParticipant : public PlayerBase
 {
 public:
@@ -29,6 +32,10 @@ public:
 
 	void CheckForExpiredConnection();
 
+	/// hands clientLink to <relay> (or takes it back if null); sends then go through the relay's queue
+	void SetRelay(CSpectatorRelay* relay);
+	bool IsRelayed() const { return relayAttached; }
+
 	GameParticipant& operator=(const PlayerBase& base) { PlayerBase::operator=(base); return *this; };
 
 public:
@@ -73,6 +80,16 @@ public:
 
 private:
 	void CloseConnection(bool flush);
+
+	/// the relay while it is attached or still has jobs for clientLink, else null
+	CSpectatorRelay* GetRelay();
+
+private:
+	CSpectatorRelay* relay = nullptr;
+
+	std::uint64_t lastRelayJob = 0;
+
+	bool relayAttached = false;
 };
 
 #endif // _GAME_PARTICIPANT_H
@@ -13,6 +13,7 @@
 
 #include "GameParticipant.h"
 #include "GameSkirmishAI.h"
+#include "SpectatorRelay.h"
 #include "AutohostInterface.h"
 
 #include "Game/ClientSetup.h"
@@ -50,6 +51,7 @@
 #include "System/Net/Connection.h"
 #include "System/Net/LocalConnection.h"
 #include "System/Net/UnpackPacket.h"
+#include "System/LoadSave/DemoIndex.h"
 #include "System/LoadSave/DemoRecorder.h"
 #include "System/LoadSave/DemoReader.h"
 #include "System/Log/ILog.h"
@@ -73,6 +75,9 @@ CONFIG(int, SpeedControl).defaultValue(1).minimumValue(1).maximumValue(2)
 CONFIG(bool, AllowSpectatorJoin).defaultValue(true).dedicatedValue(false).description("allow any unauthenticated clients to join as spectator with any name, name will be prefixed with ~");
 CONFIG(bool, WhiteListAdditionalPlayers).defaultValue(true);
 CONFIG(bool, ServerRecordDemos).defaultValue(false).dedicatedValue(true);
+CONFIG(bool, ServerSpectatorRelay).defaultValue(false).dedicatedValue(true).description("Send to remote spectators from a separate thread, so that large audiences do not delay the players.");
+CONFIG(int, ServerNetworkCompressionLevel).defaultValue(0).minimumValue(0).maximumValue(9).description("Deflate level for data sent to remote clients, capped by their own NetworkCompressionLevel. 0 disables compression, 1 is cheapest.");
+CONFIG(int, DemoIndexInterval).defaultValue(0).minimumValue(0).description("While replaying a demo, save a snapshot every this many frames into the demo's seek index (0 disables). Seeking with /skip loads the nearest snapshot instead of simulating every frame before it.");
 CONFIG(bool, ServerLogInfoMessages).defaultValue(false);
 CONFIG(bool, ServerLogDebugMessages).defaultValue(false);
 CONFIG(std::string, AutohostIP).defaultValue("127.0.0.1");
@@ -110,6 +115,9 @@ static constexpr unsigned gameProgressFrameInterval = GAME_SPEED * 5;
 
 static constexpr unsigned syncResponseEchoInterval = GAME_SPEED * 2;
 
+/// loading a demo snapshot takes a few seconds, only worth it when skipping further than this
+static constexpr int minDemoSnapshotSkipFrames = GAME_SPEED * 60;
+
 
 //FIXME remodularize server commands, so they get registered in word completion etc.
 decltype(CGameServer::commandBlacklist) CGameServer::commandBlacklist{
@@ -150,6 +158,8 @@ CGameServer::~CGameServer()
 	thread.join();
 	LOG_L(L_INFO, "[%s][2]", __func__);
 
+	StopSpectatorRelay();
+
 	// after this, demoRecorder goes out of scope and its dtor is called
 	WriteDemoData();
 }
@@ -185,6 +195,8 @@ void CGameServer::Initialize()
 	if (myGameSetup->hostDemo) {
 		Message(spring::format(PlayingDemo, myGameSetup->demoName.c_str()));
 		demoReader.reset(new CDemoReader(myGameSetup->demoName, modGameTime + 0.1f));
+		demoIndex.reset(new CDemoIndex(myGameSetup->demoName, demoReader->GetFileHeader(), configHandler->GetInt("DemoIndexInterval")));
+		demoIndex->Load();
 	}
 
 	// initialize players, teams & ais
@@ -257,6 +269,9 @@ void CGameServer::Initialize()
 	loopSleepTime = configHandler->GetInt("ServerSleepTime");
 	linkMinPacketSize = globalConfig.linkIncomingMaxPacketRate > 0 ? (globalConfig.linkIncomingSustainedBandwidth / globalConfig.linkIncomingMaxPacketRate) : 1;
 
+	if (udpListener != nullptr && configHandler->GetBool("ServerSpectatorRelay"))
+		specRelay.reset(new CSpectatorRelay(loopSleepTime));
+
 	lastNewFrameTick = spring_gettime();
 	lastBandwidthUpdate = spring_gettime();
 
@@ -291,6 +306,30 @@ void CGameServer::PostLoad(int newServerFrameNum)
 	for (GameParticipant& p: players) {
 		p.lastFrameResponse = newServerFrameNum;
 	}
+
+	if (demoReader == nullptr)
+		return;
+
+	// a demo snapshot was loaded, continue reading the demo right after its frame
+	CDemoIndex::Entry entry;
+
+	if (!demoIndex->GetEntry(newServerFrameNum, entry) || !demoReader->SeekToChunk(entry.chunkPos, modGameTime + 0.1f)) {
+		Message(spring::format(DemoSnapshotMissing, newServerFrameNum));
+		demoReader.reset();
+		return;
+	}
+
+	Message(spring::format(DemoSnapshotResume, newServerFrameNum));
+	demoSkipFrame = myClientSetup->demoSkipFrame;
+}
+
+bool CGameServer::PopDemoSnapshotRequest(int& snapshotFrame, int& skipFrame)
+{
+	if ((snapshotFrame = demoSnapshotFrame.exchange(-1)) < 0)
+		return false;
+
+	skipFrame = demoSnapshotSkipFrame;
+	return true;
 }
 
 
@@ -408,9 +447,22 @@ void CGameServer::SkipTo(int targetFrameNum)
 	if (serverFrameNum >= targetFrameNum) { return; }
 	if (demoReader == nullptr) { return; }
 
+	{
+		CDemoIndex::Entry entry;
+
+		// let the client reload into the closest snapshot and skip the rest from there
+		if (demoIndex->FindEntry(targetFrameNum, entry) && (entry.frameNum - serverFrameNum) >= minDemoSnapshotSkipFrames && demoIndex->HasSnapshot(entry.frameNum)) {
+			Message(spring::format(DemoSnapshotSeek, targetFrameNum, entry.frameNum));
+
+			demoSnapshotSkipFrame = targetFrameNum;
+			demoSnapshotFrame = entry.frameNum;
+			return;
+		}
+	}
+
 	CommandMessage startMsg(spring::format("skip start %d", targetFrameNum), SERVER_PLAYER);
 	CommandMessage endMsg("skip end", SERVER_PLAYER);
-	Broadcast(std::shared_ptr<const netcode::RawPacket>(startMsg.Pack()));
+	Broadcast(netcode::SharePacket(startMsg.Pack()));
 
 	// fast-read and send demo data
 	//
@@ -427,7 +479,7 @@ void CGameServer::SkipTo(int targetFrameNum)
 		udpListener->Update();
 	}
 
-	Broadcast(std::shared_ptr<const netcode::RawPacket>(endMsg.Pack()));
+	Broadcast(netcode::SharePacket(endMsg.Pack()));
 
 	if (udpListener != nullptr)
 		udpListener->Update();
@@ -459,7 +511,7 @@ bool CGameServer::SendDemoData(int targetFrameNum)
 
 	// get all packets from the stream up to <modGameTime>
 	while ((buf = demoReader->GetData(modGameTime))) {
-		std::shared_ptr<const RawPacket> rpkt(buf);
+		std::shared_ptr<const RawPacket> rpkt = netcode::SharePacket(buf);
 
 		if (buf->length <= 0) {
 			Message("Warning: Discarding zero size packet in demo");
@@ -475,6 +527,9 @@ bool CGameServer::SendDemoData(int targetFrameNum)
 				lastNewFrameTick = spring_gettime();
 				serverFrameNum++;
 
+				if (!demoReader->ReachedEnd())
+					demoIndex->AddFramePos(serverFrameNum, demoReader->GetNextChunkPos(), demoReader->GetModGameTime());
+
 #ifdef SYNCCHECK
 				if (targetFrameNum == -1) {
 					// not skipping
@@ -550,9 +605,14 @@ bool CGameServer::SendDemoData(int targetFrameNum)
 void CGameServer::Broadcast(std::shared_ptr<const netcode::RawPacket> packet)
 {
 	for (GameParticipant& p: players) {
-		p.SendData(packet);
+		if (!p.IsRelayed())
+			p.SendData(packet);
 	}
 
+	// relayed spectators get a single queue entry, fanned out on the relay's thread
+	if (specRelay != nullptr)
+		specRelay->Broadcast(packet);
+
 	if (canReconnect || allowSpecJoin || !gameHasStarted)
 		packetCache.push_back(packet);
 
@@ -804,8 +864,14 @@ void CGameServer::Update()
 		// if we are not playing a demo, or have no local client, or the
 		// local client is less than <GAME_SPEED> frames behind, advance
 		// <modGameTime>
-		if (demoReader == nullptr || !HasLocalClient() || (serverFrameNum - players[localClientNumber].lastFrameResponse) < GAME_SPEED)
+		if (demoReader == nullptr || !HasLocalClient() || (serverFrameNum - players[localClientNumber].lastFrameResponse) < GAME_SPEED) {
 			modGameTime += (tdif * internalSpeed);
+
+			// in fast playback the client is the only limit, queue another second
+			// of demo data whenever it has caught up to within <GAME_SPEED> frames
+			if (demoReader != nullptr && HasLocalClient() && fastDemoPlayback)
+				modGameTime += 1.0f;
+		}
 	}
 
 	if (lastPlayerInfo < (spring_gettime() - playerInfoTime)) {
@@ -844,6 +910,10 @@ void CGameServer::Update()
 	else if (!PreSimFrame() || demoReader != nullptr)
 		CreateNewFrame(true, false);
 
+	// remainder of a skip that was shortened by loading a demo snapshot
+	if (gameHasStarted && demoSkipFrame > serverFrameNum)
+		SkipTo(demoSkipFrame.exchange(-1));
+
 	if (hostif != nullptr) {
 		const std::string msg = hostif->GetChatMessage();
 
@@ -1893,6 +1963,7 @@ void CGameServer::HandleConnectionAttempts()
 			std::string platform;
 			uint8_t reconnect;
 			uint8_t netloss;
+			uint8_t compressLevel = 0;
 			uint16_t netversion;
 			msg >> netversion;
 			msg >> name;
@@ -1902,10 +1973,14 @@ void CGameServer::HandleConnectionAttempts()
 			msg >> reconnect;
 			msg >> netloss;
 
+			// not sent by clients without NETMSG_ZSTREAM support
+			if (msg.GetBytesLeft() >= sizeof(compressLevel))
+				msg >> compressLevel;
+
 			if (netversion != NETWORK_VERSION)
 				throw netcode::UnpackPacketException(spring::format("Wrong network version: received %d, required %d", (int)netversion, (int)NETWORK_VERSION));
 
-			BindConnection(udpListener->AcceptConnection(), name, passwd, version, platform, false, reconnect, netloss);
+			BindConnection(udpListener->AcceptConnection(), name, passwd, version, platform, false, reconnect, netloss, compressLevel);
 		} catch (const netcode::UnpackPacketException& ex) {
 			const asio::ip::udp::endpoint endp = prev->GetEndpoint();
 			const asio::ip::address addr = endp.address();
@@ -2414,13 +2489,13 @@ void CGameServer::PushAction(const Action& action, bool fromAutoHost)
 			InverseOrSetBool(noHelperAIs, action.extra);
 			// sent it because clients have to do stuff when this changes
 			CommandMessage msg(action, SERVER_PLAYER);
-			Broadcast(std::shared_ptr<const RawPacket>(msg.Pack()));
+			Broadcast(netcode::SharePacket(msg.Pack()));
 		} break;
 		case hashString("nospecdraw"): {
 			InverseOrSetBool(allowSpecDraw, action.extra, true);
 			// sent it because clients have to do stuff when this changes
 			CommandMessage msg(action, SERVER_PLAYER);
-			Broadcast(std::shared_ptr<const RawPacket>(msg.Pack()));
+			Broadcast(netcode::SharePacket(msg.Pack()));
 		} break;
 
 		case hashString("setmaxspeed"): {
@@ -2477,7 +2552,7 @@ void CGameServer::PushAction(const Action& action, bool fromAutoHost)
 		case hashString("cheat"): {
 			InverseOrSetBool(cheating, action.extra);
 			CommandMessage msg(action, SERVER_PLAYER);
-			Broadcast(std::shared_ptr<const RawPacket>(msg.Pack()));
+			Broadcast(netcode::SharePacket(msg.Pack()));
 		} break;
 
 		case hashString("singlestep"): {
@@ -2565,7 +2640,7 @@ void CGameServer::PushAction(const Action& action, bool fromAutoHost)
 		default: {
 			// only forward to players (send over network)
 			CommandMessage msg(action, SERVER_PLAYER);
-			Broadcast(std::shared_ptr<const RawPacket>(msg.Pack()));
+			Broadcast(netcode::SharePacket(msg.Pack()));
 		} break;
 	}
 }
@@ -2725,6 +2800,7 @@ void CGameServer::UpdateLoop()
 
 			std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
 			ServerReadNet();
+			UpdateSpectatorRelay();
 			Update();
 		}
 
@@ -2740,6 +2816,9 @@ void CGameServer::UpdateLoop()
 		if (!reloadingServer && !myGameSetup->onlyLocal)
 			spring_sleep(spring_msecs(500));
 
+		// relay hands out its remaining queue (including the quit message) first
+		StopSpectatorRelay();
+
 		// flush the quit messages to reduce ugly network error messages on the client side
 		for (GameParticipant& p: players) {
 			if (p.clientLink != nullptr)
@@ -2754,6 +2833,39 @@ void CGameServer::UpdateLoop()
 }
 
 
+void CGameServer::UpdateSpectatorRelay()
+{
+	if (specRelay == nullptr)
+		return;
+
+	for (GameParticipant& p: players) {
+		bool relayed = true;
+
+		relayed &= (p.spectator && !p.isLocal && !p.isFromDemo);
+		relayed &= (p.clientLink != nullptr);
+		relayed &= (p.myState == GameParticipant::CONNECTED || p.myState == GameParticipant::INGAME);
+
+		p.SetRelay(relayed? specRelay.get(): nullptr);
+	}
+
+	// the relay thread only prepares datagrams, the socket is ours
+	specRelay->FlushSends();
+}
+
+void CGameServer::StopSpectatorRelay()
+{
+	if (specRelay == nullptr)
+		return;
+
+	// queue is drained first, so the links are handed back right away
+	specRelay->Stop();
+
+	for (GameParticipant& p: players) {
+		p.SetRelay(nullptr);
+	}
+}
+
+
 void CGameServer::KickPlayer(int playerNum)
 {
 	// only kick connected players
@@ -2879,7 +2991,8 @@ unsigned CGameServer::BindConnection(
 	const std::string& clientPlatform,
 	bool isLocal,
 	bool reconnect,
-	int netloss
+	int netloss,
+	int compressLevel
 ) {
 	Message(spring::format("%s attempt from %s", (reconnect ? "Reconnection" : "Connection"), clientName.c_str()));
 	Message(spring::format(" -> Version: %s [%s]", clientVersion.c_str(), clientPlatform.c_str()));
@@ -3017,12 +3130,13 @@ unsigned CGameServer::BindConnection(
 
 		Message(spring::format(" -> Connection reestablished (id %i)", newPlayerNumber));
 		newPlayer.clientLink->SetLossFactor(netloss);
+		newPlayer.clientLink->SetCompressionLevel(std::min(compressLevel, configHandler->GetInt("ServerNetworkCompressionLevel")));
 		newPlayer.clientLink->Flush(!gameHasStarted);
 		return newPlayerNumber;
 	}
 
 	newPlayer.Connected(clientLink, isLocal);
-	newPlayer.SendData(std::shared_ptr<const RawPacket>(myGameData->Pack()));
+	newPlayer.SendData(netcode::SharePacket(myGameData->Pack()));
 	newPlayer.SendData(CBaseNetProtocol::Get().SendSetPlayerNum((unsigned char)newPlayerNumber));
 
 	// after gamedata and playerNum, the player can start loading
@@ -3048,6 +3162,7 @@ unsigned CGameServer::BindConnection(
 	// new connection established
 	Message(spring::format(" -> Connection established (given id %i)", newPlayerNumber));
 	clientLink->SetLossFactor(netloss);
+	clientLink->SetCompressionLevel(std::min(compressLevel, configHandler->GetInt("ServerNetworkCompressionLevel")));
 	clientLink->Flush(!gameHasStarted);
 	return newPlayerNumber;
 }
@@ -3059,7 +3174,7 @@ void CGameServer::GotChatMessage(const ChatMessage& msg)
 	if (msg.msg.empty())
 		return;
 
-	Broadcast(std::shared_ptr<const RawPacket>(msg.Pack()));
+	Broadcast(netcode::SharePacket(msg.Pack()));
 
 	if (hostif == nullptr)
 		return;
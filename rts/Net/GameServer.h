@@ -34,8 +34,10 @@ namespace netcode
 	class UDPListener;
 }
 class CDemoReader;
+class CDemoIndex;
 class Action;
 class CDemoRecorder;
+class CSpectatorRelay;
 class AutohostInterface;
 class ClientSetup;
 class CGameSetup;
@@ -117,6 +119,21 @@ public:
 	const std::unique_ptr<CDemoReader>& GetDemoReader() const { return demoReader; }
 	const std::unique_ptr<CDemoRecorder>& GetDemoRecorder() const { return demoRecorder; }
 
+	/// only exists while playing back a demo
+	CDemoIndex* GetDemoIndex() const { return demoIndex.get(); }
+
+	/**
+	 * @brief take a pending request to seek by loading a demo snapshot
+	 *
+	 * Set by SkipTo when the demo index has a snapshot that is closer to the
+	 * target than the current frame; the local client is expected to reload
+	 * into <snapshotFrame> and skip the remaining frames up to <skipFrame>.
+	 */
+	bool PopDemoSnapshotRequest(int& snapshotFrame, int& skipFrame);
+
+	/// demos are fed to the local client as fast as it can simulate them (benchmark mode)
+	inline static bool fastDemoPlayback = false;
+
 private:
 	/**
 	 * @brief relay chat messages to players / autohost
@@ -152,7 +169,8 @@ private:
 		const std::string& clientPlatform,
 		bool isLocal,
 		bool reconnect = false,
-		int netloss = 0
+		int netloss = 0,
+		int compressLevel = 0
 	);
 
 	void CheckForGameStart(bool forced = false);
@@ -164,6 +182,10 @@ private:
 	void HandleConnectionAttempts();
 	void ServerReadNet();
 
+	/// (de)attaches remote spectators to specRelay as their state changes, sends what it prepared
+	void UpdateSpectatorRelay();
+	void StopSpectatorRelay();
+
 	void LagProtection();
 
 	/** @brief Generate a unique game identifier and send it to all clients. */
@@ -287,8 +309,10 @@ private:
 
 	std::unique_ptr<netcode::UDPListener> udpListener;
 	std::unique_ptr<CDemoReader> demoReader;
+	std::unique_ptr<CDemoIndex> demoIndex;
 	std::unique_ptr<CDemoRecorder> demoRecorder;
 	std::unique_ptr<AutohostInterface> hostif;
+	std::unique_ptr<CSpectatorRelay> specRelay;
 
 	CGlobalUnsyncedRNG rng;
 	spring::thread thread;
@@ -300,6 +324,11 @@ private:
 	std::atomic<bool> reloadingServer{false};
 	std::atomic<bool> quitServer{false};
 
+	// see PopDemoSnapshotRequest; demoSkipFrame is the remainder after a snapshot was loaded
+	std::atomic<int> demoSnapshotFrame{-1};
+	std::atomic<int> demoSnapshotSkipFrame{-1};
+	std::atomic<int> demoSkipFrame{-1};
+
 	union {
 		unsigned char charArray[16];
 		unsigned int intArray[4];
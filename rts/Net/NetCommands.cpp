@@ -616,6 +616,11 @@ void CGame::ClientReadNet()
 
 				SimFrame();
 
+				if (haveServerDemo)
+					SaveDemoSnapshot();
+
+				AutoSave();
+
 #ifdef SYNCCHECK
 				// both NETMSG_SYNCRESPONSE and NETMSG_NEWFRAME are used for ping calculation by server
 				ASSERT_SYNCED(gs->frameNum);
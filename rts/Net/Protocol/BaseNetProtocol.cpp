@@ -22,12 +22,12 @@ PacketType CBaseNetProtocol::SendKeyFrame(int32_t frameNum)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(frameNum), NETMSG_KEYFRAME);
 	*packet << frameNum;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendNewFrame()
 {
-	return PacketType(new PackPacket(sizeof(uint8_t), NETMSG_NEWFRAME));
+	return netcode::SharePacket(new PackPacket(sizeof(uint8_t), NETMSG_NEWFRAME));
 }
 
 
@@ -43,21 +43,21 @@ PacketType CBaseNetProtocol::SendQuit(const std::string& reason)
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_QUIT);
 	*packet << static_cast<uint16_t>(packetSize) << reason;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendStartPlaying(uint32_t countdown)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(countdown), NETMSG_STARTPLAYING);
 	*packet << countdown;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendSetPlayerNum(uint8_t playerNum)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum), NETMSG_SETPLAYERNUM);
 	*packet << playerNum;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendPlayerName(uint8_t playerNum, const std::string& playerName)
@@ -68,14 +68,14 @@ PacketType CBaseNetProtocol::SendPlayerName(uint8_t playerNum, const std::string
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_PLAYERNAME);
 	*packet << static_cast<uint8_t>(packetSize) << playerNum << playerName;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendRandSeed(uint32_t randSeed)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(randSeed), NETMSG_RANDSEED);
 	*packet << randSeed;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 // NETMSG_GAMEID = 9, char gameID[16];
@@ -83,7 +83,7 @@ PacketType CBaseNetProtocol::SendGameID(const uint8_t* buf)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + 16, NETMSG_GAMEID);
 	memcpy(packet->GetWritingPos(), buf, 16);
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendPathCheckSum(uint8_t playerNum, uint32_t checksum)
@@ -91,7 +91,7 @@ PacketType CBaseNetProtocol::SendPathCheckSum(uint8_t playerNum, uint32_t checks
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(uint32_t), NETMSG_PATH_CHECKSUM);
 	*packet << playerNum;
 	*packet << checksum;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -103,7 +103,7 @@ PacketType CBaseNetProtocol::SendSelect(uint8_t playerNum, const std::vector<int
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_SELECT);
 	*packet << static_cast<uint16_t>(packetSize) << playerNum << selectedUnitIDs;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -111,7 +111,7 @@ PacketType CBaseNetProtocol::SendPause(uint8_t playerNum, uint8_t bPaused)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(bPaused), NETMSG_PAUSE);
 	*packet << playerNum << bPaused;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -134,7 +134,7 @@ PacketType CBaseNetProtocol::SendCommand(
 		*packet << params[i];
 	}
 
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendAICommand(
@@ -173,7 +173,7 @@ PacketType CBaseNetProtocol::SendAICommand(
 		*packet << params[i];
 	}
 
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendAIShare(
@@ -194,7 +194,7 @@ PacketType CBaseNetProtocol::SendAIShare(
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_AISHARE);
 	*packet << static_cast<uint16_t>(packetSize) << playerNum << aiID << sourceTeam << destTeam << metal << energy << unitIDs;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -202,35 +202,35 @@ PacketType CBaseNetProtocol::SendUserSpeed(uint8_t playerNum, float userSpeed)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(userSpeed), NETMSG_USER_SPEED);
 	*packet << playerNum << userSpeed;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendInternalSpeed(float internalSpeed)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(internalSpeed), NETMSG_INTERNAL_SPEED);
 	*packet << internalSpeed;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendCPUUsage(float cpuUsage)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(cpuUsage), NETMSG_CPU_USAGE);
 	*packet << cpuUsage;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendDirectControl(uint8_t playerNum)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum), NETMSG_DIRECT_CONTROL);
 	*packet << playerNum;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendDirectControlUpdate(uint8_t playerNum, uint8_t status, int16_t heading, int16_t pitch)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(status) + sizeof(heading) + sizeof(pitch), NETMSG_DC_UPDATE);
 	*packet << playerNum << status << heading << pitch;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -240,11 +240,13 @@ PacketType CBaseNetProtocol::SendAttemptConnect(
 	const std::string& version,
 	const std::string& platform,
 	int32_t netloss,
+	int32_t compressLevel,
 	bool reconnect
 ) {
 	const uint32_t payloadSize =
 		sizeof(NETWORK_VERSION) +
 		sizeof(static_cast<uint8_t>(netloss)) +
+		sizeof(static_cast<uint8_t>(compressLevel)) +
 		sizeof(static_cast<uint8_t>(reconnect)) +
 		(name.size() + 1) +
 		(passwd.size() + 1) +
@@ -262,8 +264,9 @@ PacketType CBaseNetProtocol::SendAttemptConnect(
 	*packet << platform;
 	*packet << uint8_t(reconnect);
 	*packet << uint8_t(netloss);
+	*packet << uint8_t(compressLevel);
 
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -275,7 +278,7 @@ PacketType CBaseNetProtocol::SendRejectConnect(const std::string& reason)
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_REJECT_CONNECT);
 	*packet << static_cast<uint16_t>(packetSize) << reason;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -283,14 +286,14 @@ PacketType CBaseNetProtocol::SendShare(uint8_t playerNum, uint8_t shareTeam, uin
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(shareTeam) + sizeof(bShareUnits) + (sizeof(shareMetal) * 2), NETMSG_SHARE);
 	*packet << playerNum << shareTeam << bShareUnits << shareMetal << shareEnergy;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendSetShare(uint8_t playerNum, uint8_t myTeam, float metalShareFraction, float energyShareFraction)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(myTeam) + (sizeof(metalShareFraction) * 2), NETMSG_SETSHARE);
 	*packet << playerNum << myTeam << metalShareFraction << energyShareFraction;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -298,14 +301,14 @@ PacketType CBaseNetProtocol::SendPlayerStat(uint8_t playerNum, const PlayerStati
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(PlayerStatistics), NETMSG_PLAYERSTAT);
 	*packet << playerNum << currentStats;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendTeamStat(uint8_t teamNum, const TeamStatistics& currentStats)
 {
 	PackPacket* packet = new netcode::PackPacket(sizeof(uint8_t) + sizeof(teamNum) + sizeof(TeamStatistics), NETMSG_TEAMSTAT);
 	*packet << teamNum << currentStats;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -318,7 +321,7 @@ PacketType CBaseNetProtocol::SendGameOver(uint8_t playerNum, const std::vector<u
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_GAMEOVER);
 	*packet << static_cast<uint8_t>(packetSize) << playerNum << winningAllyTeams;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -332,7 +335,7 @@ PacketType CBaseNetProtocol::SendMapErase(uint8_t playerNum, uint32_t x, uint32_
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_MAPDRAW);
 	*packet << static_cast<uint8_t>(packetSize) << playerNum << drawType << x << z;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -353,7 +356,7 @@ PacketType CBaseNetProtocol::SendMapDrawPoint(uint8_t playerNum, uint32_t x, uin
 		z <<
 		static_cast<uint8_t>(fromLua) <<
 		label;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendMapDrawLine(uint8_t playerNum, uint32_t x1, uint32_t z1, uint32_t x2, uint32_t z2, bool fromLua)
@@ -372,7 +375,7 @@ PacketType CBaseNetProtocol::SendMapDrawLine(uint8_t playerNum, uint32_t x1, uin
 		x1 << z1 <<
 		x2 << z2 <<
 		static_cast<uint8_t>(fromLua);
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -380,7 +383,7 @@ PacketType CBaseNetProtocol::SendSyncResponse(uint8_t playerNum, int32_t frameNu
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(frameNum) + sizeof(checksum), NETMSG_SYNCRESPONSE);
 	*packet << playerNum << frameNum << checksum;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendSystemMessage(uint8_t playerNum, std::string message)
@@ -396,28 +399,28 @@ PacketType CBaseNetProtocol::SendSystemMessage(uint8_t playerNum, std::string me
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_SYSTEMMSG);
 	*packet << static_cast<uint16_t>(packetSize) << playerNum << message;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendStartPos(uint8_t playerNum, uint8_t teamNum, uint8_t readyState, float x, float y, float z)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(teamNum) + sizeof(readyState) + (3 * sizeof(x)), NETMSG_STARTPOS);
 	*packet << playerNum << teamNum << readyState << x << y << z;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendPlayerInfo(uint8_t playerNum, float cpuUsage, int32_t ping)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(cpuUsage) + sizeof(ping), NETMSG_PLAYERINFO);
 	*packet << playerNum << cpuUsage << static_cast<uint32_t>(ping);
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendPlayerLeft(uint8_t playerNum, uint8_t bIntended)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(bIntended), NETMSG_PLAYERLEFT);
 	*packet << playerNum << bIntended;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -432,7 +435,7 @@ PacketType CBaseNetProtocol::SendLogMsg(uint8_t playerNum, uint8_t logMsgLvl, co
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_LOGMSG);
 	*packet << static_cast<uint16_t>(packetSize) << playerNum << logMsgLvl << strData;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendLuaMsg(uint8_t playerNum, uint16_t script, uint8_t mode, const std::vector<uint8_t>& rawData)
@@ -446,7 +449,7 @@ PacketType CBaseNetProtocol::SendLuaMsg(uint8_t playerNum, uint16_t script, uint
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_LUAMSG);
 	*packet << static_cast<uint16_t>(packetSize) << playerNum << script << mode << rawData;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -454,28 +457,28 @@ PacketType CBaseNetProtocol::SendGiveAwayEverything(uint8_t playerNum, uint8_t g
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + 1 + sizeof(giveToTeam) + sizeof(takeFromTeam), NETMSG_TEAM);
 	*packet << playerNum << static_cast<uint8_t>(TEAMMSG_GIVEAWAY) << giveToTeam << takeFromTeam;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendResign(uint8_t playerNum)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + 1 + 1 + 1, NETMSG_TEAM);
 	*packet << playerNum << static_cast<uint8_t>(TEAMMSG_RESIGN) << static_cast<uint8_t>(0) << static_cast<uint8_t>(0);
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendJoinTeam(uint8_t playerNum, uint8_t wantedTeamNum)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + 1 + sizeof(wantedTeamNum) + 1, NETMSG_TEAM);
 	*packet << playerNum << static_cast<uint8_t>(TEAMMSG_JOIN_TEAM) << wantedTeamNum << static_cast<uint8_t>(0);
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendTeamDied(uint8_t playerNum, uint8_t whichTeam)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + 1 + sizeof(whichTeam) + 1, NETMSG_TEAM);
 	*packet << playerNum << static_cast<uint8_t>(TEAMMSG_TEAM_DIED) << whichTeam << static_cast<uint8_t>(0);
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendAICreated(uint8_t playerNum, uint8_t whichSkirmishAI, uint8_t team, const std::string& name)
@@ -492,7 +495,7 @@ PacketType CBaseNetProtocol::SendAICreated(uint8_t playerNum, uint8_t whichSkirm
 		<< whichSkirmishAI
 		<< team
 		<< name;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendAIStateChanged(uint8_t playerNum, uint8_t whichSkirmishAI, uint8_t newState)
@@ -500,14 +503,14 @@ PacketType CBaseNetProtocol::SendAIStateChanged(uint8_t playerNum, uint8_t which
 	// do not hand optimize this math; the compiler will do that
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(whichSkirmishAI) + sizeof(newState), NETMSG_AI_STATE_CHANGED);
 	*packet << playerNum << whichSkirmishAI << newState;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendSetAllied(uint8_t playerNum, uint8_t whichAllyTeam, uint8_t state)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(playerNum) + sizeof(whichAllyTeam) + sizeof(state), NETMSG_ALLIANCE);
 	*packet << playerNum << whichAllyTeam << state;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -519,7 +522,7 @@ PacketType CBaseNetProtocol::SendCreateNewPlayer(uint8_t playerNum, bool spectat
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_CREATE_NEWPLAYER);
 	*packet << static_cast<uint16_t>(packetSize) << playerNum << (uint8_t)spectator << teamNum << playerName;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 
 }
 
@@ -527,7 +530,7 @@ PacketType CBaseNetProtocol::SendCurrentFrameProgress(int32_t frameNum)
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(frameNum), NETMSG_GAME_FRAME_PROGRESS);
 	*packet << frameNum;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendPing(uint8_t playerNum, uint8_t pingTag, float localTime)
@@ -540,7 +543,7 @@ PacketType CBaseNetProtocol::SendPing(uint8_t playerNum, uint8_t pingTag, float
 	*packet << playerNum;
 	*packet << pingTag;
 	*packet << localTime;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -555,7 +558,7 @@ PacketType CBaseNetProtocol::SendClientData(uint8_t playerNum, const std::vector
 	*packet << playerNum;
 	*packet << data;
 
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 
@@ -565,7 +568,7 @@ PacketType CBaseNetProtocol::SendSdCheckrequest(int32_t frameNum)
 {
 	PackPacket* packet = new PackPacket(5, NETMSG_SD_CHKREQUEST);
 	*packet << frameNum;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendSdCheckresponse(uint8_t playerNum, uint64_t flop, std::vector<uint32_t> checksums)
@@ -576,12 +579,12 @@ PacketType CBaseNetProtocol::SendSdCheckresponse(uint8_t playerNum, uint64_t flo
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_SD_CHKRESPONSE);
 	*packet << static_cast<uint16_t>(packetSize) << playerNum << flop << checksums;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 PacketType CBaseNetProtocol::SendSdReset()
 {
-	return PacketType(new PackPacket(sizeof(uint8_t), NETMSG_SD_RESET));
+	return netcode::SharePacket(new PackPacket(sizeof(uint8_t), NETMSG_SD_RESET));
 }
 
 
@@ -589,7 +592,7 @@ PacketType CBaseNetProtocol::SendSdBlockrequest(uint16_t begin, uint16_t length,
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(begin) + sizeof(length) + sizeof(requestSize), NETMSG_SD_BLKREQUEST);
 	*packet << begin << length << requestSize;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 
 }
 
@@ -601,14 +604,14 @@ PacketType CBaseNetProtocol::SendSdBlockresponse(uint8_t playerNum, std::vector<
 
 	PackPacket* packet = new PackPacket(packetSize, NETMSG_SD_BLKRESPONSE);
 	*packet << static_cast<uint16_t>(packetSize) << playerNum << checksums;
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 #endif // SYNCDEBUG
 
 PacketType CBaseNetProtocol::SendGameStateDump()
 {
 	PackPacket* packet = new PackPacket(sizeof(uint8_t), NETMSG_GAMESTATE_DUMP);
-	return PacketType(packet);
+	return netcode::SharePacket(packet);
 }
 
 CBaseNetProtocol::CBaseNetProtocol()
@@ -671,6 +674,7 @@ CBaseNetProtocol::CBaseNetProtocol()
 	proto->AddType(NETMSG_AI_STATE_CHANGED, 4);
 	proto->AddType(NETMSG_GAME_FRAME_PROGRESS, 5);
 	proto->AddType(NETMSG_PING, 1 + (1 + 1 + 4));
+	proto->AddType(NETMSG_ZSTREAM, -2);
 
 #ifdef SYNCDEBUG
 	proto->AddType(NETMSG_SD_CHKREQUEST, 5);
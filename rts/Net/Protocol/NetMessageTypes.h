@@ -95,6 +95,8 @@ enum NETMSG {
 
 	NETMSG_PING = 78, // uint8_t playerNum, uint8_t pingTag, float localTime
 
+	NETMSG_ZSTREAM = 79, // uint16_t msgsize, std::vector<uint8_t> deflatedMessages # internal to UDPConnection, never reaches the game #
+
 	NETMSG_LAST //max types of netmessages, internal only
 };
 
@@ -0,0 +1,219 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "SpectatorRelay.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+#include "System/ConcurrentQueue.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Misc/TracyDefs.h"
+#include "System/Net/Connection.h"
+#include "System/Net/UDPBatch.h"
+#include "System/Platform/Threading.h"
+
+
+struct CSpectatorRelay::JobQueue: public moodycamel::ConcurrentQueue<Job> {
+	JobQueue(): token(*this) {}
+
+	// jobs are only dequeued in order if they all come through one producer
+	moodycamel::ProducerToken token;
+};
+
+
+CSpectatorRelay::CSpectatorRelay(int _sleepTime)
+	: jobQueue(std::make_unique<JobQueue>())
+	, pendingSends(std::make_unique<netcode::UDPSendBatch>(false))
+	, sleepTime(std::max(_sleepTime, 1))
+{
+	jobs.resize(256);
+
+	running = true;
+	thread = spring::thread(std::bind(&CSpectatorRelay::UpdateLoop, this));
+}
+
+CSpectatorRelay::~CSpectatorRelay()
+{
+	Stop();
+
+	for (const auto& link: links) {
+		link->SetRelayed(false);
+	}
+}
+
+
+CSpectatorRelay::JobNum CSpectatorRelay::QueueJob(Job&& job)
+{
+	numJobsQueued += 1;
+
+	if (running) {
+		while (!jobQueue->enqueue(jobQueue->token, std::move(job)));
+	} else {
+		ProcessJob(job);
+		numJobsDone.fetch_add(1, std::memory_order_release);
+	}
+
+	return numJobsQueued;
+}
+
+CSpectatorRelay::JobNum CSpectatorRelay::AddLink(std::shared_ptr<netcode::CConnection> link)
+{
+	// from here on UDPListener leaves updating the link to us
+	link->SetRelayed(true);
+
+	Job job;
+	job.type = Job::JOB_ADD_LINK;
+	job.link = std::move(link);
+
+	return (QueueJob(std::move(job)));
+}
+
+CSpectatorRelay::JobNum CSpectatorRelay::RemoveLink(std::shared_ptr<netcode::CConnection> link)
+{
+	Job job;
+	job.type = Job::JOB_DEL_LINK;
+	job.link = std::move(link);
+
+	return (QueueJob(std::move(job)));
+}
+
+
+CSpectatorRelay::JobNum CSpectatorRelay::SendData(std::shared_ptr<netcode::CConnection> link, std::shared_ptr<const netcode::RawPacket> packet)
+{
+	Job job;
+	job.type = Job::JOB_SEND;
+	job.link = std::move(link);
+	job.packet = std::move(packet);
+
+	return (QueueJob(std::move(job)));
+}
+
+CSpectatorRelay::JobNum CSpectatorRelay::Broadcast(std::shared_ptr<const netcode::RawPacket> packet)
+{
+	Job job;
+	job.type = Job::JOB_BROADCAST;
+	job.packet = std::move(packet);
+
+	return (QueueJob(std::move(job)));
+}
+
+CSpectatorRelay::JobNum CSpectatorRelay::CloseLink(std::shared_ptr<netcode::CConnection> link, bool flush)
+{
+	Job job;
+	job.type = Job::JOB_CLOSE_LINK;
+	job.flush = flush;
+	job.link = std::move(link);
+
+	return (QueueJob(std::move(job)));
+}
+
+
+void CSpectatorRelay::FlushSends()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+
+	netcode::UDPSendBatch sendBatch(false);
+
+	{
+		std::lock_guard<spring::mutex> lock(pendingSendsMutex);
+		sendBatch.Append(*pendingSends);
+	}
+
+	sendBatch.Flush();
+}
+
+void CSpectatorRelay::Stop()
+{
+	if (!running)
+		return;
+
+	running = false;
+	thread.join();
+
+	// anything queued while the thread was exiting; we own the sockets here
+	ProcessJobs();
+	FlushSends();
+}
+
+
+void CSpectatorRelay::UpdateLoop()
+{
+	Threading::SetThreadName("netrelay");
+
+	while (running) {
+		spring_msecs(sleepTime).sleep(true);
+
+		// collects what the links send, for FlushSends
+		netcode::UDPSendBatch sendBatch;
+
+		ProcessJobs();
+
+		{
+			RECOIL_DETAILED_TRACY_ZONE;
+
+			for (const auto& link: links) {
+				link->Update();
+			}
+		}
+
+		if (sendBatch.GetNumQueued() == 0)
+			continue;
+
+		std::lock_guard<spring::mutex> lock(pendingSendsMutex);
+		pendingSends->Append(sendBatch);
+	}
+}
+
+void CSpectatorRelay::ProcessJobs()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+
+	size_t numJobs = 0;
+
+	while ((numJobs = jobQueue->try_dequeue_bulk(jobs.begin(), jobs.size())) > 0) {
+		for (size_t i = 0; i < numJobs; i++) {
+			ProcessJob(jobs[i]);
+
+			jobs[i] = {};
+			numJobsDone.fetch_add(1, std::memory_order_release);
+		}
+	}
+}
+
+void CSpectatorRelay::ProcessJob(Job& job)
+{
+	switch (job.type) {
+		case Job::JOB_ADD_LINK: {
+			// the link may have been removed and added again before we got here
+			job.link->SetRelayed(true);
+
+			if (std::find(links.begin(), links.end(), job.link) == links.end())
+				links.push_back(job.link);
+		} break;
+		case Job::JOB_DEL_LINK: {
+			const auto iter = std::find(links.begin(), links.end(), job.link);
+
+			if (iter != links.end()) {
+				*iter = std::move(links.back());
+				links.pop_back();
+			}
+
+			job.link->SetRelayed(false);
+		} break;
+		case Job::JOB_SEND: {
+			job.link->SendData(job.packet);
+		} break;
+		case Job::JOB_BROADCAST: {
+			for (const auto& link: links) {
+				link->SendData(job.packet);
+			}
+		} break;
+		case Job::JOB_CLOSE_LINK: {
+			job.link->Close(job.flush);
+		} break;
+		default: {
+			assert(false);
+		} break;
+	}
+}
@@ -0,0 +1,124 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _SPECTATOR_RELAY_H
+#define _SPECTATOR_RELAY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "System/Threading/SpringThreading.h"
+
+namespace netcode
+{
+	class CConnection;
+	class RawPacket;
+	class UDPSendBatch;
+}
+
+/**
+ * @brief Feeds spectator connections from a dedicated thread
+ *
+ * Sending a frame to a UDP client means chunking, checksumming and a
+ * sendto() per connection, which with a few hundred spectators dominates
+ * the server loop and delays the players. The server instead pushes every
+ * packet once into a lock-free queue and this thread fans it out to all
+ * attached links and keeps updating them (resends, acks).
+ *
+ * Packets sent to one link are queued as well, so a link sees the same
+ * order as if the server had written to it directly. Links still receive
+ * on the server thread; UDPConnection locks itself, and UDPListener skips
+ * updating links that are marked as relayed.
+ *
+ * The relay thread never touches a socket: the datagrams its links produce
+ * are collected, and FlushSends hands them to the socket from the thread
+ * that owns it.
+ *
+ * Every call returns the number of the job it queued; jobs run in order,
+ * and IsDone tells when the relay is finished with one. All calls have to
+ * come from one thread at a time (the server's).
+ */
+class CSpectatorRelay
+{
+public:
+	CSpectatorRelay(int sleepTime);
+	~CSpectatorRelay();
+
+	CSpectatorRelay(const CSpectatorRelay&) = delete;
+	CSpectatorRelay& operator = (const CSpectatorRelay&) = delete;
+
+	using JobNum = std::uint64_t;
+
+	JobNum AddLink(std::shared_ptr<netcode::CConnection> link);
+	/**
+	 * Does not wait: jobs queued before (and sends queued after) still go
+	 * to <link>, which is returned to its listener once they are done.
+	 */
+	JobNum RemoveLink(std::shared_ptr<netcode::CConnection> link);
+
+	JobNum SendData(std::shared_ptr<netcode::CConnection> link, std::shared_ptr<const netcode::RawPacket> packet);
+	JobNum Broadcast(std::shared_ptr<const netcode::RawPacket> packet);
+	/// closes <link> after the jobs queued before
+	JobNum CloseLink(std::shared_ptr<netcode::CConnection> link, bool flush);
+
+	bool IsDone(JobNum jobNum) const { return (numJobsDone.load(std::memory_order_acquire) >= jobNum); }
+
+	/// sends the datagrams prepared by the relay thread; call from the thread owning the sockets
+	void FlushSends();
+
+	/// hands out whatever is still queued and joins the thread; links stay attached
+	void Stop();
+
+	bool IsRunning() const { return running; }
+
+private:
+	struct Job {
+		enum {
+			JOB_ADD_LINK,
+			JOB_DEL_LINK,
+			JOB_SEND,
+			JOB_BROADCAST,
+			JOB_CLOSE_LINK,
+		};
+
+		int type = JOB_BROADCAST;
+
+		bool flush = false;
+
+		std::shared_ptr<netcode::CConnection> link;
+		std::shared_ptr<const netcode::RawPacket> packet;
+	};
+
+	// wraps moodycamel::ConcurrentQueue, which does not mix with BranchPrediction.h
+	struct JobQueue;
+
+	JobNum QueueJob(Job&& job);
+
+	void UpdateLoop();
+	void ProcessJobs();
+	void ProcessJob(Job& job);
+
+private:
+	std::unique_ptr<JobQueue> jobQueue;
+
+	/// datagrams of the relayed links, waiting for FlushSends
+	std::unique_ptr<netcode::UDPSendBatch> pendingSends;
+	spring::mutex pendingSendsMutex;
+
+	/// only touched by the relay thread while it runs
+	std::vector< std::shared_ptr<netcode::CConnection> > links;
+	std::vector<Job> jobs;
+
+	spring::thread thread;
+
+	int sleepTime = 0;
+
+	/// only touched by the queueing thread
+	JobNum numJobsQueued = 0;
+	std::atomic<JobNum> numJobsDone{0};
+
+	std::atomic<bool> running{false};
+};
+
+#endif // _SPECTATOR_RELAY_H
@@ -64,6 +64,7 @@ inline void SLosInstance::Init(int radius, int allyteam, int2 basePos, float bas
 	this->isCached = false;
 	this->isQueuedForUpdate = false;
 	this->isQueuedForTerraform = false;
+	this->dirtyRect = {};
 }
 
 
@@ -126,6 +127,7 @@ void ILosType::Kill()
 	losAdd.clear();
 	losDeleted.clear();
 	losRecalc.clear();
+	losMapStrips.clear();
 
 	// mark as invalid
 	size = {0, 0};
@@ -304,6 +306,73 @@ inline void ILosType::LosRemove(SLosInstance* li)
 }
 
 
+void ILosType::UpdateLosMaps(const std::vector<SLosInstance*>& lis, int amount)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	// not worth spawning tasks for the usual handful of moved units
+	if (lis.size() < MT_MIN_LOSMAP_UPDATES) {
+		for (SLosInstance* li: lis) {
+			assert(amount < 0 || li->refCount > 0);
+
+			if (amount > 0) {
+				LosAdd(li);
+			} else {
+				LosRemove(li);
+			}
+		}
+
+		return;
+	}
+
+	// each losmap is split into strips of rows which are updated in parallel;
+	// every strip applies all instances of its map in the same order as the
+	// serial loop above, so each square still gets the same sequence of +/-
+	// amounts and the result is identical
+	losMapStrips.clear();
+
+	for (int i = 0, n = losMaps.size(); i < n; i++) {
+		const auto pred = [&](const SLosInstance* li) { return (li->allyteam == i); };
+
+		if (std::find_if(lis.begin(), lis.end(), pred) == lis.end())
+			continue;
+
+		for (int y = 0; y < size.y; y += LOSMAP_STRIP_ROWS) {
+			losMapStrips.push_back({i, y, std::min(y + LOSMAP_STRIP_ROWS, size.y)});
+		}
+	}
+
+	if (enteredSquares.size() < losMapStrips.size())
+		enteredSquares.resize(losMapStrips.size());
+
+	for_mt(0, losMapStrips.size(), [&](const int idx) {
+		const LosMapStrip& strip = losMapStrips[idx];
+
+		CLosMap& losMap = losMaps[strip.losMap];
+		std::vector<int>& entered = enteredSquares[idx];
+
+		entered.clear();
+
+		for (const SLosInstance* li: lis) {
+			if (li->allyteam != strip.losMap)
+				continue;
+			if ((li->basePos.y + li->radius) < strip.rowBeg || (li->basePos.y - li->radius) >= strip.rowEnd)
+				continue;
+
+			if (algoType == LOS_ALGO_RAYCAST) {
+				losMap.AddRaycast(li, amount, strip.rowBeg, strip.rowEnd, entered);
+			} else {
+				losMap.AddCircle(li, amount, strip.rowBeg, strip.rowEnd);
+			}
+		}
+	});
+
+	// the ReadMap must only be informed from here
+	for (size_t i = 0; i < losMapStrips.size(); i++) {
+		losMaps[losMapStrips[i].losMap].SendEnteredSquares(enteredSquares[i]);
+	}
+}
+
+
 inline void ILosType::RefInstance(SLosInstance* li)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
@@ -569,26 +638,28 @@ void ILosType::Update()
 	}
 
 	// remove sight
-	//FIXME multithread?
-	for (SLosInstance* li: losRemove) {
-		LosRemove(li);
-	}
+	UpdateLosMaps(losRemove, -1);
 
 	// raycast terrain
 	if (algoType == LOS_ALGO_RAYCAST)  {
 		for_mt(0, losRecalc.size(), [&](const int idx) {
 			auto li = losRecalc[idx];
 			assert(li->refCount > 0);
-			li->squares.clear();
-			losMaps[li->allyteam].PrepareRaycast(li);
+
+			// old squares were removed above, safe to update them in-place
+			if (li->dirtyRect.GetArea() > 0 && !li->squares.empty()) {
+				losMaps[li->allyteam].UpdateRaycast(li);
+			} else {
+				li->squares.clear();
+				losMaps[li->allyteam].PrepareRaycast(li);
+			}
+
+			li->dirtyRect = {};
 		});
 	}
 
 	// add sight
-	for (SLosInstance* li: losAdd) {
-		assert(li->refCount > 0);
-		LosAdd(li);
-	}
+	UpdateLosMaps(losAdd, 1);
 
 	// delete / move to cache unused instances
 	if (algoType == LOS_ALGO_RAYCAST) {
@@ -652,9 +723,34 @@ void ILosType::UpdateHeightMapSynced(SRectangle rect)
 		DeleteInstance(li);
 	}
 
+	// the LOS squares whose mip-heights can have changed; padded by one
+	// since corner heights also feed the centers of neighboring squares
+	const SRectangle losRect(
+		std::max((rect.x1 >> mipLevel) - 1, 0),
+		std::max((rect.y1 >> mipLevel) - 1, 0),
+		std::min((rect.x2 >> mipLevel) + 2, size.x),
+		std::min((rect.y2 >> mipLevel) + 2, size.y)
+	);
+
 	// relos used instances
 	for (auto& p: instanceHashes) {
 		for (SLosInstance* li: p.second) {
+			const SRectangle losBox(li->basePos.x - li->radius, li->basePos.y - li->radius, li->basePos.x + li->radius + 1, li->basePos.y + li->radius + 1);
+
+			// track every change within sight range, including the ones that
+			// happen while a RECALC is already pending or that CheckOverlap
+			// considers irrelevant, UpdateRaycast relies on it being complete
+			if (losBox.CheckOverlap(losRect)) {
+				if (li->dirtyRect.GetArea() > 0) {
+					li->dirtyRect.x1 = std::min(li->dirtyRect.x1, losRect.x1);
+					li->dirtyRect.y1 = std::min(li->dirtyRect.y1, losRect.y1);
+					li->dirtyRect.x2 = std::max(li->dirtyRect.x2, losRect.x2);
+					li->dirtyRect.y2 = std::max(li->dirtyRect.y2, losRect.y2);
+				} else {
+					li->dirtyRect = losRect;
+				}
+			}
+
 			if (li->status & SLosInstance::TLosStatus::RECALC)
 				continue;
 			if (!CheckOverlap(li, rect))
@@ -7,6 +7,7 @@
 #include <deque>
 
 #include "Map/Ground.h"
+#include "Sim/Misc/LosInstance.h"
 #include "Sim/Misc/LosMap.h"
 #include "Sim/Objects/WorldObject.h"
 #include "Sim/Units/Unit.h"
@@ -16,74 +17,6 @@
 #include "System/UnorderedMap.hpp"
 
 
-/**
- * LoS Instance
- *
- * The main goal of this object is to store the squares on the LOS map that
- * have been incremented (CLosHandler::LosAdd) when the unit last moved.
- * (CLosHandler::MoveUnit)
- *
- * These squares must be remembered because 1) ray-casting against the terrain
- * is not particularly fast and more importantly 2) the terrain may have changed
- * between the LosAdd and the moment we want to undo the LosAdd.
- *
- * LosInstances may be shared between multiple units. Reference counting is
- * used to track how many units currently use one instance.
- *
- * An instance will be shared iff the other unit is in the same square
- * (basePos, baseSquare) on the LOS map, has the same radius, is in the
- * same ally-team and has the same height.
- */
-struct SLosInstance
-{
-	SLosInstance(int id)
-		: id(id)
-		, allyteam(-1)
-		, radius(-1)
-		, basePos()
-		, baseHeight(-1)
-		, refCount(0)
-		, hashNum(-1)
-		, status(NONE)
-		, isCached(false)
-		, isQueuedForUpdate(false)
-		, isQueuedForTerraform(false)
-	{}
-	void Init(int radius, int allyteam, int2 basePos, float baseHeight, int hashNum);
-
-public:
-	// hash properties
-	int id;
-	int allyteam;
-	int radius;
-	int2 basePos;
-	float baseHeight;
-
-	// working data
-	int refCount;
-	struct RLE { int start; unsigned length; };
-	static constexpr RLE EMPTY_RLE = RLE{0,0};
-	std::vector<RLE> squares;
-
-	// helpers
-	int hashNum;
-	enum TLosStatus {
-		NONE       =  0,
-		NEW        =  1,
-		REACTIVATE =  2,
-		RECALC     =  4,
-		REMOVE     =  8,
-	};
-	int status;
-
-	bool isCached;
-	bool isQueuedForUpdate;
-	bool isQueuedForTerraform;
-};
-
-
-
-
 /**
  * All different types of LOS are implemented using ILosType, which is a
  * 2d array essentially containing a reference count. That is to say, each
@@ -138,6 +71,7 @@ private:
 
 	void LosAdd(SLosInstance* instance);
 	void LosRemove(SLosInstance* instance);
+	void UpdateLosMaps(const std::vector<SLosInstance*>& lis, int amount);
 
 	void RefInstance(SLosInstance* instance);
 	void UnrefInstance(SLosInstance* instance);
@@ -192,7 +126,19 @@ private:
 	std::vector<SLosInstance*> losDeleted;
 	std::vector<SLosInstance*> losRecalc;
 
+	struct LosMapStrip {
+		int losMap;
+		int rowBeg;
+		int rowEnd;
+	};
+
+	std::vector<LosMapStrip> losMapStrips;
+	std::vector<std::vector<int>> enteredSquares; // per strip
+
 	static constexpr int CACHE_SIZE = 4096;
+
+	static constexpr int LOSMAP_STRIP_ROWS = 16;
+	static constexpr size_t MT_MIN_LOSMAP_UPDATES = 32;
 };
 
 
@@ -4,21 +4,26 @@
 #include <array>
 
 #include "LosMap.h"
-#include "LosHandler.h"
+#include "LosInstance.h"
+#include "LosMapSIMD.h"
 #include "Map/ReadMap.h"
 #include "System/SpringMath.h"
 #include "System/float3.h"
 #include "System/Log/ILog.h"
+#include "System/Misc/TracyDefs.h"
 #include "System/StringUtil.h"
 #include "System/Threading/ThreadPool.h"
 #include "Game/GlobalUnsynced.h" // for myAllyTeam
 
-constexpr float LOS_BONUS_HEIGHT = 5.0f;
+using LosMapSIMD::LOS_BONUS_HEIGHT;
+using LosMapSIMD::ToAngleMapIdx;
 
 static std::array<std::vector<float>, ThreadPool::MAX_THREADS> RADIUS_ISQRT_TABLES;
 
 static std::array<std::vector<float>, ThreadPool::MAX_THREADS> RAYCAST_ANGLE_TABLES;
 static std::array<std::vector< char>, ThreadPool::MAX_THREADS> LOSRAY_SQUARE_TABLES; // visible squares per instance
+static std::array<std::vector< char>, ThreadPool::MAX_THREADS> LOSRAY_UPDATE_TABLES; // UpdateRaycast square flags
+static std::array<std::vector<  int>, ThreadPool::MAX_THREADS> CIRCLE_WIDTH_TABLES; // half-width per circle row
 
 
 static float isqrtTableLookup(unsigned r, int threadNum)
@@ -120,6 +125,10 @@ public:
 	// only generates table if not in cache
 	void GenerateForLosSize(size_t losSize);
 
+	const LosLine& GetLosTableRay(size_t losSize, size_t rayIndex) {
+		return losTables[losSize][rayIndex];
+	}
+
 	const int2 GetLosTableRaySquare(size_t losSize, size_t rayIndex, size_t squareIdx) {
 		return losTables[losSize][rayIndex][squareIdx];
 	}
@@ -409,13 +418,15 @@ void CLosTableHelper::Debug(const LosTable& losRays, const std::vector<int2>& po
 //////////////////////////////////////////////////////////////////////
 /// CLosMap implementation
 
-void CLosMap::AddCircle(SLosInstance* instance, int amount)
+void CLosMap::AddCircle(const SLosInstance* instance, int amount, int rowBeg, int rowEnd)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
+	assert(rowBeg >= 0 && rowEnd <= size.y);
+
 	MidpointCircleAlgoPerLine(instance->radius, [&](int width, int y) {
-		const unsigned y_ = instance->basePos.y + y;
+		const int y_ = instance->basePos.y + y;
 
-		if (y_ < size.y) {
+		if (y_ >= rowBeg && y_ < rowEnd) {
 			const unsigned sx = std::clamp(instance->basePos.x - width,     0, size.x);
 			const unsigned ex = std::clamp(instance->basePos.x + width + 1, 0, size.x);
 
@@ -448,12 +459,7 @@ void CLosMap::AddRaycast(SLosInstance* instance, int amount)
 				if (losmap[idx] != amount)
 					continue;
 
-				const int2 lm = IdxToCoord(idx, size.x);
-				const int2 p1 = (lm             ) * LOS2HEIGHT;
-				const int2 p2 = (lm + int2(1, 1)) * LOS2HEIGHT;
-				const int2 p3 = {std::min(p2.x, mapDims.mapxm1), std::min(p2.y, mapDims.mapym1)};
-
-				readMap->UpdateLOS(SRectangle(p1.x, p1.y,  p3.x, p3.y));
+				SendEnteredSquare(idx);
 			}
 		}
 
@@ -468,6 +474,59 @@ void CLosMap::AddRaycast(SLosInstance* instance, int amount)
 }
 
 
+void CLosMap::AddRaycast(const SLosInstance* instance, int amount, int rowBeg, int rowEnd, std::vector<int>& enteredSquares)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	assert(rowBeg >= 0 && rowEnd <= size.y);
+
+	const auto& losSquares = instance->squares;
+
+	if (losSquares.empty() || losSquares[0].length == SLosInstance::EMPTY_RLE.length)
+		return;
+
+	const bool visibleInstanceSquares = (instance->allyteam >= 0 && (instance->allyteam == gu->myAllyTeam || gu->spectatingFullView));
+	const bool updateUnsyncedHeightMap = sendReadmapEvents && visibleInstanceSquares;
+	const bool collectEnteredSquares = (amount > 0) && updateUnsyncedHeightMap;
+
+	// RLEs are sorted and never cross a row (see AddSquaresToInstance)
+	const int idxBeg = rowBeg * size.x;
+	const int idxEnd = rowEnd * size.x;
+
+	const auto pred = [](const SLosInstance::RLE& rle, int idx) { return (rle.start < idx); };
+
+	for (auto it = std::lower_bound(losSquares.begin(), losSquares.end(), idxBeg, pred); it != losSquares.end() && it->start < idxEnd; ++it) {
+		for (int idx = it->start, len = it->length; len > 0; --len, ++idx) {
+			losmap[idx] += amount;
+
+			if (!collectEnteredSquares || losmap[idx] != amount)
+				continue;
+
+			enteredSquares.push_back(idx);
+		}
+	}
+}
+
+
+void CLosMap::SendEnteredSquares(const std::vector<int>& enteredSquares) const
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	for (const int idx: enteredSquares) {
+		SendEnteredSquare(idx);
+	}
+}
+
+
+void CLosMap::SendEnteredSquare(int idx) const
+{
+	const int2 lm = IdxToCoord(idx, size.x);
+	const int2 p1 = (lm             ) * LOS2HEIGHT;
+	const int2 p2 = (lm + int2(1, 1)) * LOS2HEIGHT;
+	const int2 p3 = {std::min(p2.x, mapDims.mapxm1), std::min(p2.y, mapDims.mapym1)};
+
+	readMap->UpdateLOS(SRectangle(p1.x, p1.y,  p3.x, p3.y));
+}
+
+
 void CLosMap::PrepareRaycast(SLosInstance* instance) const
 {
 	RECOIL_DETAILED_TRACY_ZONE;
@@ -515,13 +574,6 @@ void CLosMap::LosAdd(SLosInstance* li) const
 }
 
 
-inline static constexpr size_t ToAngleMapIdx(const int2 p, const int radius)
-{
-	// [-radius, +radius]^2 -> [0, +2*radius]^2 -> idx
-	return (p.y + radius) * (2 * radius + 1) + (p.x + radius);
-}
-
-
 inline void CastLos(
 	float* prvAngle,
 	float* maxAngle,
@@ -533,24 +585,25 @@ inline void CastLos(
 ) {
 	RECOIL_DETAILED_TRACY_ZONE;
 	const size_t oidx = ToAngleMapIdx(off, losRadius);
+	const float invR = isqrtTableLookup(off.x * off.x + off.y * off.y, threadNum);
 
-	// angle to square is smaller than current max-angle, so not visible
-	if (raycastAngles[oidx] < *maxAngle) {
-		losRaySquares[oidx] = false;
+	if (LosMapSIMD::CastLos(prvAngle, maxAngle, raycastAngles[oidx], invR))
 		return;
-	}
 
-	if (raycastAngles[oidx] < *prvAngle) {
-		const float invR = isqrtTableLookup(off.x * off.x + off.y * off.y, threadNum);
-		const float angle = *prvAngle - LOS_BONUS_HEIGHT * invR;
+	losRaySquares[oidx] = false;
+}
 
-		if (raycastAngles[oidx] < (*maxAngle = angle)) {
-			losRaySquares[oidx] = false;
-			return;
-		}
-	}
 
-	*prvAngle = raycastAngles[oidx];
+inline static void CastRays(
+	CLosTableHelper& helper,
+	const LosMapSIMD::CastParams& castParams
+) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	for (size_t i = 0, numRays = helper.GetLosTableSize(castParams.radius); i < numRays; ++i) {
+		const auto& ray = helper.GetLosTableRay(castParams.radius, i);
+
+		LosMapSIMD::CastRay(castParams, ray.data(), ray.size());
+	}
 }
 
 
@@ -659,23 +712,15 @@ void CLosMap::UnsafeLosAdd(SLosInstance* li) const
 	// cast the rays
 	losRaySquares[ToAngleMapIdx(int2(0, 0), radius)] = true;
 
-	const size_t numRays = helper.GetLosTableSize(radius);
-
-	for (size_t i = 0; i < numRays; ++i) {
-		float maxAngles[4] = {-1e7, -1e7, -1e7, -1e7};
-		float prvAngles[4] = {-1e7, -1e7, -1e7, -1e7};
-
-		const size_t numSquares = helper.GetLosTableRaySize(radius, i);
-
-		for (size_t n = 0; n < numSquares; n++) {
-			const int2 square = helper.GetLosTableRaySquare(radius, i, n);
-
-			CastLos(&prvAngles[0], &maxAngles[0],       square              , losRaySquares, raycastAngles, radius, threadNum);
-			CastLos(&prvAngles[1], &maxAngles[1],      -square              , losRaySquares, raycastAngles, radius, threadNum);
-			CastLos(&prvAngles[2], &maxAngles[2], int2( square.y, -square.x), losRaySquares, raycastAngles, radius, threadNum);
-			CastLos(&prvAngles[3], &maxAngles[3], int2(-square.y,  square.x), losRaySquares, raycastAngles, radius, threadNum);
-		}
-	}
+	CastRays(helper, {
+		raycastAngles.data(),
+		losRaySquares.data(),
+		RADIUS_ISQRT_TABLES[threadNum].data(),
+		pos,
+		size,
+		radius,
+		LosMapSIMD::CAST_UNBOUNDED
+	});
 
 	// translate visible square indices to map square idx + RLE
 	AddSquaresToInstance(li, losRaySquares);
@@ -748,76 +793,187 @@ void CLosMap::SafeLosAdd(SLosInstance* li) const
 
 
 	// Cast the Rays
-	const size_t numRays = helper.GetLosTableSize(radius);
-
-	if (safeRect.Inside(pos)) {
+	if (safeRect.Inside(pos))
 		losRaySquares[ToAngleMapIdx(int2(0, 0), radius)] = true;
 
-		for (size_t i = 0; i < numRays; ++i) {
-			float maxAngles[4] = {-1e7, -1e7, -1e7, -1e7};
-			float prvAngles[4] = {-1e7, -1e7, -1e7, -1e7};
+	CastRays(helper, {
+		raycastAngles.data(),
+		losRaySquares.data(),
+		RADIUS_ISQRT_TABLES[threadNum].data(),
+		pos,
+		size,
+		radius,
+		// emit position outside the map skips squares outside the map instead of stopping
+		safeRect.Inside(pos)? LosMapSIMD::CAST_STOP_AT_EDGE: LosMapSIMD::CAST_SKIP_OUTSIDE
+	});
 
-			const size_t numSquares = helper.GetLosTableRaySize(radius, i);
+	// translate visible square indices to map square idx + RLE
+	AddSquaresToInstance(li, losRaySquares);
+}
 
-			for (size_t n = 0; n < numSquares; n++) {
-				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
 
-				if (!safeRect.Inside(pos + square))
-					break;
+void CLosMap::UpdateRaycast(SLosInstance* li) const
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	// A square's visibility is the AND of what every ray passing through
+	// it decides, and a ray's decision for a square only depends on the
+	// angles of the squares up to it. So after terrain changed within the
+	// dirty rectangle, only squares that come after a dirty one on some ray
+	// can flip; those are reset and every ray visiting any of them is cast
+	// again, which yields exactly what a full recast would.
+	const int2 pos   = li->basePos;
+	const int radius = li->radius;
+	const float losHeight = li->baseHeight;
 
-				CastLos(&prvAngles[0], &maxAngles[0],  square,                   losRaySquares, raycastAngles, radius, threadNum);
-			}
-			for (size_t n = 0; n < numSquares; n++) {
-				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
+	const SRectangle& dirtyRect = li->dirtyRect;
+	const SRectangle fullRect(0, 0, size.x, size.y);
+	const SRectangle safeRect(radius, radius, size.x - radius, size.y - radius);
+	const SRectangle sightRect(pos.x - radius, pos.y - radius, pos.x + radius + 1, pos.y + radius + 1);
+
+	// the base square decides whether LosAdd casts anything at all, and an
+	// instance that did not see anything has no squares to start from
+	if (li->squares.empty() || li->squares[0].length == SLosInstance::EMPTY_RLE.length || dirtyRect.Inside(pos)) {
+		li->squares.clear();
+		PrepareRaycast(li);
+		return;
+	}
 
-				if (!safeRect.Inside(pos - square))
-					break;
+	if (!dirtyRect.CheckOverlap(sightRect))
+		return;
 
-				CastLos(&prvAngles[1], &maxAngles[1], -square,                   losRaySquares, raycastAngles, radius, threadNum);
-			}
-			for (size_t n = 0; n < numSquares; n++) {
-				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
+	constexpr char SQUARE_AFFECTED  = 1;
+	constexpr char SQUARE_HAS_ANGLE = 2;
 
-				if (!safeRect.Inside(pos + int2(square.y, -square.x)))
-					break;
+	const int threadNum = ThreadPool::GetThreadNum();
 
-				CastLos(&prvAngles[2], &maxAngles[2], int2(square.y, -square.x), losRaySquares, raycastAngles, radius, threadNum);
-			}
-			for (size_t n = 0; n < numSquares; n++) {
-				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
+	CLosTableHelper& helper = losTableHelpers[threadNum];
+
+	std::vector< char>& losRaySquares = LOSRAY_SQUARE_TABLES[threadNum];
+	std::vector<float>& raycastAngles = RAYCAST_ANGLE_TABLES[threadNum];
+	std::vector< char>& squareFlags = LOSRAY_UPDATE_TABLES[threadNum];
+	std::vector<  int>& circleWidths = CIRCLE_WIDTH_TABLES[threadNum];
+
+	helper.GenerateForLosSize(radius);
+
+	losRaySquares.clear();
+	losRaySquares.resize(Square((2 * radius) + 1), false);
+	raycastAngles.clear();
+	raycastAngles.resize(Square((2 * radius) + 1), -1e8);
+	squareFlags.clear();
+	squareFlags.resize(Square((2 * radius) + 1), 0);
+	circleWidths.clear();
+	circleWidths.resize((2 * radius) + 1, -1);
+
+	isqrtTableExpand((radius + 1) * (radius + 1), threadNum);
+
+	MidpointCircleAlgoPerLine(radius, [&](int width, int y) {
+		circleWidths[y + radius] = std::max(circleWidths[y + radius], width);
+	});
 
-				if (!safeRect.Inside(pos + int2(-square.y, square.x)))
+	const size_t numRays = helper.GetLosTableSize(radius);
+
+	const bool unsafeCast = safeRect.Inside(pos);
+	const bool baseInMap = fullRect.Inside(pos);
+
+	// visits the same squares in the same order as {Unsafe,Safe}LosAdd
+	const auto WalkRay = [&](size_t i, int orientation, const auto& func) {
+		for (size_t n = 0, numSquares = helper.GetLosTableRaySize(radius, i); n < numSquares; n++) {
+			const int2 off = LosMapSIMD::OrientRaySquare(helper.GetLosTableRaySquare(radius, i, n), orientation);
+
+			if (!unsafeCast && !fullRect.Inside(pos + off)) {
+				if (baseInMap)
 					break;
 
-				CastLos(&prvAngles[3], &maxAngles[3], int2(-square.y, square.x), losRaySquares, raycastAngles, radius, threadNum);
+				continue;
 			}
+
+			func(off, ToAngleMapIdx(off, radius));
 		}
-	} else {
-		// emit position outside the map
-		for (size_t i = 0; i < numRays; ++i) {
-			float maxAngles[4] = {-1e7, -1e7, -1e7, -1e7};
-			float prvAngles[4] = {-1e7, -1e7, -1e7, -1e7};
+	};
 
-			const size_t numSquares = helper.GetLosTableRaySize(radius, i);
+	// same value as the precalculation in {Unsafe,Safe}LosAdd, but only
+	// for the squares that are actually cast again
+	const auto UpdateAngle = [&](const int2 off, size_t oidx) {
+		if (squareFlags[oidx] & SQUARE_HAS_ANGLE)
+			return;
 
-			for (size_t n = 0; n < numSquares; n++) {
-				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
+		squareFlags[oidx] |= SQUARE_HAS_ANGLE;
 
-				if (safeRect.Inside(pos + square))
-					CastLos(&prvAngles[0], &maxAngles[0],  square,                   losRaySquares, raycastAngles, radius, threadNum);
+		if (std::abs(off.x) > circleWidths[off.y + radius])
+			return;
 
-				if (safeRect.Inside(pos - square))
-					CastLos(&prvAngles[1], &maxAngles[1], -square,                   losRaySquares, raycastAngles, radius, threadNum);
+		const float invR = isqrtTableLookup(off.x*off.x + off.y*off.y, threadNum);
+		const float dh = std::max(0.0f, mipHeightMap[MAP_SQUARE(pos + off)]) - losHeight;
 
-				if (safeRect.Inside(pos + int2(square.y, -square.x)))
-					CastLos(&prvAngles[2], &maxAngles[2], int2(square.y, -square.x), losRaySquares, raycastAngles, radius, threadNum);
+		raycastAngles[oidx] = (dh + LOS_BONUS_HEIGHT) * invR;
+	};
 
-				if (safeRect.Inside(pos + int2(-square.y, square.x)))
-					CastLos(&prvAngles[3], &maxAngles[3], int2(-square.y, square.x), losRaySquares, raycastAngles, radius, threadNum);
-			}
+
+	// decode the current result
+	for (const SLosInstance::RLE rle: li->squares) {
+		const int2 off = IdxToCoord(rle.start, size.x) - pos;
+		std::fill_n(losRaySquares.begin() + ToAngleMapIdx(off, radius), rle.length, true);
+	}
+
+	// find the squares behind dirty ones
+	bool anyAffected = false;
+
+	for (size_t i = 0; i < numRays; ++i) {
+		for (int k = 0; k < 4; ++k) {
+			bool behindDirty = false;
+
+			WalkRay(i, k, [&](const int2 off, size_t oidx) {
+				behindDirty |= dirtyRect.Inside(pos + off);
+				squareFlags[oidx] |= (SQUARE_AFFECTED * behindDirty);
+			});
+
+			anyAffected |= behindDirty;
 		}
 	}
 
-	// translate visible square indices to map square idx + RLE
+	if (!anyAffected)
+		return;
+
+	for (int y = -radius; y <= radius; ++y) {
+		for (int x = -radius; x <= radius; ++x) {
+			const size_t oidx = ToAngleMapIdx(int2(x, y), radius);
+
+			if ((squareFlags[oidx] & SQUARE_AFFECTED) == 0)
+				continue;
+
+			// WalkRay only visits in-map squares, which the precalc makes visible
+			losRaySquares[oidx] = (std::abs(x) <= circleWidths[y + radius]);
+		}
+	}
+
+	// cast the rays
+	for (size_t i = 0; i < numRays; ++i) {
+		for (int k = 0; k < 4; ++k) {
+			bool castRay = false;
+
+			WalkRay(i, k, [&](const int2 off, size_t oidx) {
+				castRay |= ((squareFlags[oidx] & SQUARE_AFFECTED) != 0);
+			});
+
+			if (!castRay)
+				continue;
+
+			float maxAngle = -1e7;
+			float prvAngle = -1e7;
+
+			WalkRay(i, k, [&](const int2 off, size_t oidx) {
+				UpdateAngle(off, oidx);
+				CastLos(&prvAngle, &maxAngle, off, losRaySquares, raycastAngles, radius, threadNum);
+			});
+		}
+	}
+
+	li->squares.clear();
+
 	AddSquaresToInstance(li, losRaySquares);
+
+	if (!li->squares.empty())
+		return;
+
+	li->squares.push_back(SLosInstance::EMPTY_RLE);
 }
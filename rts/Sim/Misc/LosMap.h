@@ -35,14 +35,31 @@ public:
 
 public:
 	/// circular area, for airLosMap, circular radar maps, jammer maps, ...
-	void AddCircle(SLosInstance* instance, int amount);
+	void AddCircle(SLosInstance* instance, int amount) { AddCircle(instance, amount, 0, size.y); }
 
 	/// arbitrary area, for losMap, non-circular radar maps, ...
 	void AddRaycast(SLosInstance* instance, int amount);
 
+	/**
+	 * Same as the above, but only touches losmap rows [rowBeg, rowEnd), so
+	 * may run concurrently for disjoint row ranges. AddRaycast appends the
+	 * squares that entered LOS to <enteredSquares> instead of informing the
+	 * ReadMap, which SendEnteredSquares must then do from the main thread.
+	 */
+	void AddCircle(const SLosInstance* instance, int amount, int rowBeg, int rowEnd);
+	void AddRaycast(const SLosInstance* instance, int amount, int rowBeg, int rowEnd, std::vector<int>& enteredSquares);
+	void SendEnteredSquares(const std::vector<int>& enteredSquares) const;
+
 	/// arbitrary area, for losMap, non-circular radar maps, ...
 	void PrepareRaycast(SLosInstance* instance) const;
 
+	/**
+	 * Re-casts only the rays of <instance> that cross its dirtyRect, using
+	 * its current squares for everything else; gives the same squares as
+	 * clearing them and calling PrepareRaycast.
+	 */
+	void UpdateRaycast(SLosInstance* instance) const;
+
 public:
 	int At(int2 p) const {
 		p.x = std::clamp(p.x, 0, size.x - 1);
@@ -59,6 +76,7 @@ private:
 	void SafeLosAdd(SLosInstance* instance) const;
 
 	void AddSquaresToInstance(SLosInstance* li, const std::vector<char>& losRaySquares) const;
+	void SendEnteredSquare(int idx) const;
 
 protected:
 	int2 size;
@@ -0,0 +1,124 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <bit>
+
+#include "LosMapSIMD.h"
+#include "xsimd/xsimd.hpp"
+
+namespace LosMapSIMD {
+	static inline bool InsideMap(const CastParams& cp, const int2 off) {
+		const int2 pos = cp.basePos + off;
+		return (pos.x >= 0 && pos.y >= 0 && pos.x < cp.mapSize.x && pos.y < cp.mapSize.y);
+	}
+
+
+	void CastRayScalar(const CastParams& cp, const int2* ray, size_t numSquares)
+	{
+		for (int k = 0; k < 4; ++k) {
+			float maxAngle = -1e7;
+			float prvAngle = -1e7;
+
+			for (size_t n = 0; n < numSquares; n++) {
+				const int2 off = OrientRaySquare(ray[n], k);
+
+				if (cp.mode != CAST_UNBOUNDED && !InsideMap(cp, off)) {
+					if (cp.mode == CAST_STOP_AT_EDGE)
+						break;
+
+					continue;
+				}
+
+				const size_t oidx = ToAngleMapIdx(off, cp.radius);
+				const float invR = cp.isqrtTable[off.x * off.x + off.y * off.y];
+
+				if (CastLos(&prvAngle, &maxAngle, cp.raycastAngles[oidx], invR))
+					continue;
+
+				cp.losRaySquares[oidx] = false;
+			}
+		}
+	}
+
+
+#if defined(XSIMD_X86_INSTR_SET) && (XSIMD_X86_INSTR_SET >= XSIMD_X86_SSE2_VERSION)
+	void CastRaySSE(const CastParams& cp, const int2* ray, size_t numSquares)
+	{
+		typedef xsimd::batch<float, 4> batch_t;
+		typedef xsimd::batch_bool<float, 4> batch_bool_t;
+
+		// lane k follows orientation k; a lane is inactive for squares the
+		// scalar loop would skip, and stays so once it would have stopped
+		batch_t maxAngles(-1e7f);
+		batch_t prvAngles(-1e7f);
+
+		alignas(16) float squareAngles[4];
+		size_t squareIndices[4];
+
+		unsigned stoppedLanes = 0;
+
+		for (size_t n = 0; n < numSquares; n++) {
+			const int2 square = ray[n];
+			const int2 offsets[4] = {
+				OrientRaySquare(square, 0),
+				OrientRaySquare(square, 1),
+				OrientRaySquare(square, 2),
+				OrientRaySquare(square, 3),
+			};
+
+			unsigned activeLanes = 0xF;
+
+			if (cp.mode != CAST_UNBOUNDED) {
+				for (int k = 0; k < 4; ++k) {
+					activeLanes &= ~(unsigned(!InsideMap(cp, offsets[k])) << k);
+				}
+
+				if (cp.mode == CAST_STOP_AT_EDGE) {
+					if ((stoppedLanes |= (~activeLanes & 0xF)) == 0xF)
+						break;
+
+					activeLanes &= ~stoppedLanes;
+				}
+
+				if (activeLanes == 0)
+					continue;
+			}
+
+			// offsets outside the map are still within the angle table
+			for (int k = 0; k < 4; ++k) {
+				squareAngles[k] = cp.raycastAngles[squareIndices[k] = ToAngleMapIdx(offsets[k], cp.radius)];
+			}
+
+			// all four orientations are at the same distance from the base
+			const float invR = cp.isqrtTable[square.x * square.x + square.y * square.y];
+
+			const batch_t squareAngle(&squareAngles[0], xsimd::aligned_mode());
+			const batch_t hillAngles = prvAngles - batch_t(LOS_BONUS_HEIGHT * invR);
+
+			const batch_bool_t active((activeLanes & 1) != 0, (activeLanes & 2) != 0, (activeLanes & 4) != 0, (activeLanes & 8) != 0);
+			const batch_bool_t belowMax = (squareAngle < maxAngles);
+			const batch_bool_t belowPrv = (~belowMax) & (squareAngle < prvAngles) & active;
+
+			maxAngles = xsimd::select(belowPrv, hillAngles, maxAngles);
+
+			const batch_bool_t hidden = belowMax | (belowPrv & (squareAngle < maxAngles));
+
+			prvAngles = xsimd::select(hidden | (~active), prvAngles, squareAngle);
+
+			for (unsigned hiddenLanes = (_mm_movemask_ps(hidden) & activeLanes); hiddenLanes != 0; hiddenLanes &= (hiddenLanes - 1)) {
+				cp.losRaySquares[squareIndices[std::countr_zero(hiddenLanes)]] = false;
+			}
+		}
+	}
+
+	CastRayFunc CastRay = CastRaySSE;
+	const char* GetImplName() { return "SSE"; }
+#else
+	void CastRaySSE(const CastParams& cp, const int2* ray, size_t numSquares)
+	{
+		CastRayScalar(cp, ray, numSquares);
+	}
+
+	CastRayFunc CastRay = CastRayScalar;
+	const char* GetImplName() { return "Scalar"; }
+#endif
+}
@@ -0,0 +1,84 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef LOS_MAP_SIMD_H
+#define LOS_MAP_SIMD_H
+
+#include <cstddef>
+
+#include "System/type2.h"
+
+
+/**
+ * Ray casting kernels for CLosMap. Every LOS table ray is cast in its four
+ * mirrored orientations, which have the same length and are independent of
+ * each other; the SIMD kernel runs them in lockstep, one per lane. All
+ * implementations evaluate the same IEEE operations as the scalar reference
+ * (no FMA contraction, see CMake), so the visible squares are bit-identical.
+ */
+namespace LosMapSIMD {
+	static constexpr float LOS_BONUS_HEIGHT = 5.0f;
+
+	enum CastMode {
+		CAST_UNBOUNDED    = 0, // whole circle is inside the map
+		CAST_STOP_AT_EDGE = 1, // base inside the map, rays end at the first square outside
+		CAST_SKIP_OUTSIDE = 2, // base outside the map, rays skip squares outside
+	};
+
+	struct CastParams {
+		// per-instance tables of (2 * radius + 1)^2 entries, see ToAngleMapIdx
+		const float* raycastAngles;
+		char* losRaySquares;
+
+		// isqrtTable[i] = 1 / sqrt(max(i, 1))
+		const float* isqrtTable;
+
+		int2 basePos;
+		int2 mapSize;
+		int radius;
+		CastMode mode;
+	};
+
+	typedef void (*CastRayFunc)(const CastParams& cp, const int2* ray, size_t numSquares);
+
+	inline static constexpr size_t ToAngleMapIdx(const int2 p, const int radius) {
+		// [-radius, +radius]^2 -> [0, +2*radius]^2 -> idx
+		return (p.y + radius) * (2 * radius + 1) + (p.x + radius);
+	}
+
+	inline static int2 OrientRaySquare(const int2 square, int orientation) {
+		// ray tables only hold one quadrant, the others are mirrored
+		switch (orientation) {
+			case  0: return  square;
+			case  1: return -square;
+			case  2: return int2( square.y, -square.x);
+			default: return int2(-square.y,  square.x);
+		}
+	}
+
+	/// scalar reference: advances one ray by one square, returns false if the square is hidden
+	inline static bool CastLos(float* prvAngle, float* maxAngle, float squareAngle, float invR) {
+		// angle to square is smaller than current max-angle, so not visible
+		if (squareAngle < *maxAngle)
+			return false;
+
+		if (squareAngle < *prvAngle) {
+			const float angle = *prvAngle - LOS_BONUS_HEIGHT * invR;
+
+			if (squareAngle < (*maxAngle = angle))
+				return false;
+		}
+
+		*prvAngle = squareAngle;
+		return true;
+	}
+
+	/// clears losRaySquares for every square hidden along the four orientations of <ray>
+	void CastRayScalar(const CastParams& cp, const int2* ray, size_t numSquares);
+	void CastRaySSE(const CastParams& cp, const int2* ray, size_t numSquares);
+
+	/// widest implementation compiled in (SSE2 is part of the x86-64 baseline)
+	extern CastRayFunc CastRay;
+	const char* GetImplName();
+}
+
+#endif
@@ -119,6 +119,7 @@ void CModInfo::ResetState()
 		qtRefreshPathMinDist = 512.f;
 		qtMaxNodesSearchedRelativeToMapOpenNodes = 0.25;
 		qtLowerQualityPaths = false;
+		qtAbstractGraphMinDist = 0.f;
 
 		enableSmoothMesh = true;
 		smoothMeshResDivider = 2;
@@ -178,6 +179,7 @@ void CModInfo::Init(const std::string& modFileName)
 		qtRefreshPathMinDist = system.GetFloat("qtRefreshPathMinDist", qtRefreshPathMinDist);
 		qtMaxNodesSearchedRelativeToMapOpenNodes = system.GetFloat("qtMaxNodesSearchedRelativeToMapOpenNodes", qtMaxNodesSearchedRelativeToMapOpenNodes);
 		qtLowerQualityPaths = system.GetBool("qtLowerQualityPaths", qtLowerQualityPaths);
+		qtAbstractGraphMinDist = system.GetFloat("qtAbstractGraphMinDist", qtAbstractGraphMinDist);
 
 		enableSmoothMesh = system.GetBool("enableSmoothMesh", enableSmoothMesh);
 		smoothMeshResDivider = system.GetInt("smoothMeshResDivider", smoothMeshResDivider);
@@ -359,6 +361,7 @@ void CModInfo::Init(const std::string& modFileName)
 	pfRawMoveSpeedThreshold                  = std::max  (pfRawMoveSpeedThreshold                 ,    0.0f       );
 	pfRepathDelayInFrames                    = std::clamp(pfRepathDelayInFrames                   ,    0    ,  300);
 	pfRepathMaxRateInFrames                  = std::clamp(pfRepathMaxRateInFrames                 ,    0    , 3600);
+	qtAbstractGraphMinDist                   = std::max  (qtAbstractGraphMinDist                  ,    0.0f       );
 	qtMaxNodesSearched                       = std::max  (qtMaxNodesSearched                      , 1024          );
 	qtMaxNodesSearchedRelativeToMapOpenNodes = std::max  (qtMaxNodesSearchedRelativeToMapOpenNodes,    0.0f       );
 	qtRefreshPathMinDist                     = std::max  (qtRefreshPathMinDist                    ,    0.0f       );
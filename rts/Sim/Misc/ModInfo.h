@@ -217,6 +217,12 @@ public:
 	/// Enable to reduce CPU usage, but also reduce quality of resultant paths.
 	bool qtLowerQualityPaths;
 
+	/// Minimum distance, in elmos, between start and goal for a QTPFS search to be planned
+	/// on a coarse graph of map regions first and then only searched in detail along that
+	/// route. Reduces the nodes searched for long paths, at the cost of keeping the coarse
+	/// graph up to date. 0 disables the coarse graph.
+	float qtAbstractGraphMinDist;
+
 	float pfRawDistMult;
 	float pfUpdateRateScale;
 
@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include <algorithm>
+#include <bit>
 
 #include "QuadField.h"
 #include "Map/ReadMap.h"
@@ -33,12 +34,21 @@ CR_REG_METADATA(CQuadField, (
 	CR_IGNORED(tempFeatures),
 	CR_IGNORED(tempProjectiles),
 	CR_IGNORED(tempSolids),
-	CR_IGNORED(tempQuads)
+	CR_IGNORED(tempQuads),
+	CR_IGNORED(tempMasks),
+
+	CR_IGNORED(batchQuads),
+	CR_IGNORED(batchChanged),
+	CR_IGNORED(moveBatch),
+	CR_IGNORED(solidsVersion),
+
+	CR_POSTLOAD(PostLoad)
 ))
 
 CR_BIND(CQuadField::Quad, )
 CR_REG_METADATA_SUB(CQuadField, Quad, (
 	CR_MEMBER(units),
+	CR_IGNORED(unitSpheres),
 	CR_IGNORED(teamUnits),
 	CR_MEMBER(features),
 	CR_MEMBER(projectiles),
@@ -51,6 +61,18 @@ CR_REG_METADATA_SUB(CQuadField, Quad, (
 CQuadField quadField;
 
 
+// calls f(i) for every set bit i of the QuadFieldSIMD output, in ascending order
+template<typename F>
+static void ForEachMaskBit(const uint64_t* masks, size_t numElems, F&& f)
+{
+	for (size_t w = 0, n = QuadFieldSIMD::NumMaskWords(numElems); w < n; ++w) {
+		for (uint64_t bits = masks[w]; bits != 0; bits &= (bits - 1)) {
+			f((w << 6) + std::countr_zero(bits));
+		}
+	}
+}
+
+
 #ifndef UNIT_TEST
 /*
 void CQuadField::Resize(int quad_size)
@@ -104,12 +126,83 @@ void CQuadField::Quad::PostLoad()
 #ifndef UNIT_TEST
 	Resize(teamHandler.ActiveAllyTeams());
 
+	unitSpheres.clear();
+
 	for (CUnit* unit: units) {
 		spring::VectorInsertUnique(teamUnits[unit->allyteam], unit, false);
+		unitSpheres.push_back(unit->pos, unit->radius);
 	}
 #endif
 }
 
+#ifndef UNIT_TEST
+int CQuadField::Quad::AddUnit(CUnit* unit)
+{
+	spring::VectorInsertUnique(units, unit, false);
+	spring::VectorInsertUnique(teamUnits[unit->allyteam], unit, false);
+	unitSpheres.push_back(unit->pos, unit->radius);
+	return (units.size() - 1);
+}
+
+CUnit* CQuadField::Quad::EraseUnit(CUnit* unit, int slot)
+{
+	assert(units[slot] == unit);
+
+	// same resulting order as spring::VectorErase(units, unit)
+	CUnit* last = units.back();
+
+	units[slot] = last;
+	units.pop_back();
+
+	const float4 lastSphere = unitSpheres.get(units.size());
+
+	unitSpheres.set(slot, lastSphere, lastSphere.w);
+	unitSpheres.pop_back();
+
+	spring::VectorErase(teamUnits[unit->allyteam], unit);
+	return ((last != unit)? last: nullptr);
+}
+#endif
+
+
+void CQuadField::MoveBatch::AddMove(int unit, const std::vector<int>& oldQuads, const std::vector<int>& newQuads)
+{
+	for (const int qi: oldQuads) {
+		ops.push_back({qi, unit, false});
+	}
+	for (const int qi: newQuads) {
+		ops.push_back({qi, unit, true});
+	}
+}
+
+void CQuadField::MoveBatch::Group(size_t numQuads)
+{
+	quadEnds.assign(numQuads + 1, 0);
+	quadsTouched.clear();
+	groupedOps.resize(ops.size());
+
+	// count into quadEnds[q + 1], then the prefix sums are the begin offsets
+	for (const Op& op: ops) {
+		if ((quadEnds[op.quad + 1]++) == 0)
+			quadsTouched.push_back(op.quad);
+	}
+	for (size_t qi = 1; qi <= numQuads; ++qi) {
+		quadEnds[qi] += quadEnds[qi - 1];
+	}
+	// placing the ops advances every begin offset to its quad's end
+	for (const Op& op: ops) {
+		groupedOps[quadEnds[op.quad]++] = op;
+	}
+}
+
+std::span<const CQuadField::MoveBatch::Op> CQuadField::MoveBatch::GetQuadOps(int quad) const
+{
+	const int beg = (quad > 0)? quadEnds[quad - 1]: 0;
+	const int end = quadEnds[quad];
+
+	return {groupedOps.data() + beg, groupedOps.data() + end};
+}
+
 void CQuadField::Init(int2 mapDims, int quadSize)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
@@ -134,6 +227,7 @@ void CQuadField::Init(int2 mapDims, int quadSize)
 		tempQuads[i].ReleaseAll();
 	}
 
+	QuadFieldSIMD::Init();
 
 #ifndef UNIT_TEST
 	for (Quad& quad: baseQuads) {
@@ -166,6 +260,27 @@ void CQuadField::Kill()
 		cache.ReleaseAll();
 }
 
+void CQuadField::PostLoad()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+#ifndef UNIT_TEST
+	// the quads' unit lists are saved, the slots pointing into them are not
+	for (int qi = 0, nq = baseQuads.size(); qi < nq; ++qi) {
+		const Quad& quad = baseQuads[qi];
+
+		for (size_t slot = 0, n = quad.units.size(); slot < n; ++slot) {
+			CUnit* unit = quad.units[slot];
+
+			const auto it = std::find(unit->quads.begin(), unit->quads.end(), qi);
+
+			assert(it != unit->quads.end());
+			unit->quadSlots.resize(unit->quads.size());
+			unit->quadSlots[it - unit->quads.begin()] = slot;
+		}
+	}
+#endif
+}
+
 
 int2 CQuadField::WorldPosToQuadField(const float3 p) const
 {
@@ -438,8 +553,8 @@ bool CQuadField::InsertUnitIf(CUnit* unit, const float3& wpos)
 	if (!spring::VectorInsertUnique(unit->quads, wposQuadIdx, true))
 		return false;
 
-	spring::VectorInsertUnique(baseQuads[wposQuadIdx].units, unit, false);
-	spring::VectorInsertUnique(baseQuads[wposQuadIdx].teamUnits[unit->allyteam], unit, false);
+	solidsVersion++;
+	unit->quadSlots.push_back(baseQuads[wposQuadIdx].AddUnit(unit));
 	return true;
 }
 
@@ -466,11 +581,21 @@ bool CQuadField::RemoveUnitIf(CUnit* unit, const float3& wpos)
 		return false;
 	}
 
-	if (!spring::VectorErase(unit->quads, wposQuadIdx))
+	const auto it = std::find(unit->quads.begin(), unit->quads.end(), wposQuadIdx);
+
+	if (it == unit->quads.end())
 		return false;
 
-	spring::VectorErase(baseQuads[wposQuadIdx].units, unit);
-	spring::VectorErase(baseQuads[wposQuadIdx].teamUnits[unit->allyteam], unit);
+	const size_t i = it - unit->quads.begin();
+
+	solidsVersion++;
+	EraseUnitFromQuad(unit, i);
+
+	// same as spring::VectorErase, for both lists
+	unit->quads[i] = unit->quads.back();
+	unit->quads.pop_back();
+	unit->quadSlots[i] = unit->quadSlots.back();
+	unit->quadSlots.pop_back();
 	return true;
 }
 #endif
@@ -490,28 +615,132 @@ void CQuadField::MovedUnit(CUnit* unit)
 			return;
 	}
 
-	for (const int qi: unit->quads) {
-		spring::VectorErase(baseQuads[qi].units, unit);
-		spring::VectorErase(baseQuads[qi].teamUnits[unit->allyteam], unit);
+	solidsVersion++;
+
+	for (size_t i = 0; i < unit->quads.size(); ++i) {
+		EraseUnitFromQuad(unit, i);
 	}
 
+	unit->quadSlots.clear();
+
 	for (const int qi: *qfQuery.quads) {
-		spring::VectorInsertUnique(baseQuads[qi].units, unit, false);
-		spring::VectorInsertUnique(baseQuads[qi].teamUnits[unit->allyteam], unit, false);
+		unit->quadSlots.push_back(baseQuads[qi].AddUnit(unit));
 	}
 
 	unit->quads = std::move(*qfQuery.quads);
 }
 
+void CQuadField::EraseUnitFromQuad(CUnit* unit, size_t i)
+{
+	const int qi = unit->quads[i];
+	const int slot = unit->quadSlots[i];
+
+	CUnit* movedUnit = baseQuads[qi].EraseUnit(unit, slot);
+
+	if (movedUnit == nullptr)
+		return;
+
+	const auto it = std::find(movedUnit->quads.begin(), movedUnit->quads.end(), qi);
+
+	assert(it != movedUnit->quads.end());
+	movedUnit->quadSlots[it - movedUnit->quads.begin()] = slot;
+}
+
+void CQuadField::UpdateUnitSphere(const CUnit* unit)
+{
+	// called for every Move, so every unit only writes its own slots
+	for (size_t i = 0, n = unit->quads.size(); i < n; ++i) {
+		baseQuads[unit->quads[i]].unitSpheres.set(unit->quadSlots[i], unit->pos, unit->radius);
+	}
+}
+
+void CQuadField::MovedUnitsBatch(std::span<CUnit* const> units)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (units.empty())
+		return;
+
+	solidsVersion++;
+	batchQuads.resize(std::max(batchQuads.size(), units.size()));
+	batchChanged.resize(units.size());
+
+	// 1) compute the new memberships; read-only w.r.t. the quads
+	for_mt_chunk(0, units.size(), [&](const int i) {
+		const CUnit* unit = units[i];
+
+		QuadFieldQuery qfQuery;
+		qfQuery.threadOwner = ThreadPool::GetThreadNum();
+		GetQuads(qfQuery, unit->pos, unit->radius);
+
+		batchQuads[i].assign(qfQuery.quads->begin(), qfQuery.quads->end());
+		batchChanged[i] = !std::equal(batchQuads[i].begin(), batchQuads[i].end(), unit->quads.begin(), unit->quads.end());
+	});
+
+	// 2) group the changes by quad
+	moveBatch.Clear();
+
+	for (size_t i = 0; i < units.size(); ++i) {
+		if (!batchChanged[i])
+			continue;
+
+		moveBatch.AddMove(i, units[i]->quads, batchQuads[i]);
+	}
+
+	moveBatch.Group(baseQuads.size());
+
+	// 3) apply; each quad is only touched by one thread
+	const std::vector<int>& touchedQuads = moveBatch.GetTouchedQuads();
+
+	for_mt(0, touchedQuads.size(), [&](const int i) {
+		Quad& quad = baseQuads[touchedQuads[i]];
+
+		// unit slots are shared between quads, they are fixed up below
+		for (const MoveBatch::Op& op: moveBatch.GetQuadOps(touchedQuads[i])) {
+			CUnit* unit = units[op.unit];
+
+			if (op.insert) {
+				quad.AddUnit(unit);
+			} else {
+				quad.EraseUnit(unit, std::find(quad.units.begin(), quad.units.end(), unit) - quad.units.begin());
+			}
+		}
+	});
+
+	for_mt_chunk(0, units.size(), [&](const int i) {
+		if (!batchChanged[i])
+			return;
+
+		units[i]->quads.swap(batchQuads[i]);
+		units[i]->quadSlots.resize(units[i]->quads.size());
+	});
+
+	// 4) every unit in a touched quad may have a new slot there
+	for_mt(0, touchedQuads.size(), [&](const int i) {
+		const int qi = touchedQuads[i];
+		const Quad& quad = baseQuads[qi];
+
+		for (size_t slot = 0, n = quad.units.size(); slot < n; ++slot) {
+			CUnit* unit = quad.units[slot];
+
+			const auto it = std::find(unit->quads.begin(), unit->quads.end(), qi);
+
+			assert(it != unit->quads.end());
+			unit->quadSlots[it - unit->quads.begin()] = slot;
+		}
+	});
+}
+
 void CQuadField::RemoveUnit(CUnit* unit)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	for (const int qi: unit->quads) {
-		spring::VectorErase(baseQuads[qi].units, unit);
-		spring::VectorErase(baseQuads[qi].teamUnits[unit->allyteam], unit);
+	solidsVersion++;
+
+	for (size_t i = 0; i < unit->quads.size(); ++i) {
+		EraseUnitFromQuad(unit, i);
 	}
 
 	unit->quads.clear();
+	unit->quadSlots.clear();
 
 	#ifdef DEBUG_QUADFIELD
 	for (const Quad& q: baseQuads) {
@@ -539,6 +768,8 @@ void CQuadField::MovedRepulser(CPlasmaRepulser* repulser)
 			return;
 	}
 
+	solidsVersion++;
+
 	for (const int qi: repulserQuads) {
 		spring::VectorErase(baseQuads[qi].repulsers, repulser);
 	}
@@ -553,6 +784,8 @@ void CQuadField::MovedRepulser(CPlasmaRepulser* repulser)
 void CQuadField::RemoveRepulser(CPlasmaRepulser* repulser)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
+	solidsVersion++;
+
 	for (const int qi: repulser->GetQuads()) {
 		spring::VectorErase(baseQuads[qi].repulsers, repulser);
 	}
@@ -572,6 +805,8 @@ void CQuadField::RemoveRepulser(CPlasmaRepulser* repulser)
 void CQuadField::AddFeature(CFeature* feature)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
+	solidsVersion++;
+
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, feature->pos, feature->radius);
 
@@ -583,6 +818,8 @@ void CQuadField::AddFeature(CFeature* feature)
 void CQuadField::RemoveFeature(CFeature* feature)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
+	solidsVersion++;
+
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, feature->pos, feature->radius);
 
@@ -689,23 +926,24 @@ void CQuadField::GetUnitsExact(QuadFieldQuery& qfq, const float3& pos, float rad
 	qfq.units = tempUnits[curThread].ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
-		for (CUnit* u: baseQuads[qi].units) {
-			if (u->mtTempNum[curThread] == tempNum)
-				continue;
+		const Quad& quad = baseQuads[qi];
 
-			u->mtTempNum[curThread] = tempNum;
+		uint64_t* masks = ReserveMasks(curThread, quad.units.size());
 
-			const float totRad       = radius + u->radius;
-			const float totRadSq     = totRad * totRad;
-			const float posUnitDstSq = spherical?
-				pos.SqDistance(u->pos):
-				pos.SqDistance2D(u->pos);
+		// units that fail the test are not marked, unlike before; they
+		// fail it in every other quad too, so the result is unchanged
+		QuadFieldSIMD::SphereMask(quad.unitSpheres, pos, radius, spherical, masks);
 
-			if (posUnitDstSq >= totRadSq)
-				continue;
+		ForEachMaskBit(masks, quad.units.size(), [&](size_t i) {
+			CUnit* u = quad.units[i];
+
+			if (u->mtTempNum[curThread] == tempNum)
+				return;
+
+			u->mtTempNum[curThread] = tempNum;
 
 			qfq.units->push_back(u);
-		}
+		});
 	}
 
 	return;
@@ -722,21 +960,22 @@ void CQuadField::GetUnitsExact(QuadFieldQuery& qfq, const float3& mins, const fl
 	qfq.units = tempUnits[curThread].ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
-		for (CUnit* unit: baseQuads[qi].units) {
+		const Quad& quad = baseQuads[qi];
+
+		uint64_t* masks = ReserveMasks(curThread, quad.units.size());
+
+		QuadFieldSIMD::RectMask(quad.unitSpheres, mins, maxs, masks);
+
+		ForEachMaskBit(masks, quad.units.size(), [&](size_t i) {
+			CUnit* unit = quad.units[i];
 
 			if (unit->mtTempNum[curThread] == tempNum)
-				continue;
+				return;
 
 			unit->mtTempNum[curThread] = tempNum;
 
-			const float3& pos = unit->pos;
-			if (pos.x < mins.x || pos.x > maxs.x)
-				continue;
-			if (pos.z < mins.z || pos.z > maxs.z)
-				continue;
-
 			qfq.units->push_back(unit);
-		}
+		});
 	}
 
 	return;
@@ -880,21 +1119,28 @@ void CQuadField::GetSolidsExact(
 	
 
 	for (const int qi: *qfQuery.quads) {
-		for (CUnit* u: baseQuads[qi].units) {
+		const Quad& quad = baseQuads[qi];
+
+		uint64_t* masks = ReserveMasks(curThread, quad.units.size());
+
+		// same arithmetic as (pos - u->pos).SqLength() >= Square(radius + u->radius)
+		QuadFieldSIMD::SphereMask(quad.unitSpheres, pos, radius, true, masks);
+
+		ForEachMaskBit(masks, quad.units.size(), [&](size_t i) {
+			CUnit* u = quad.units[i];
+
 			if (u->mtTempNum[curThread] == tempNum)
-				continue;
+				return;
 
 			u->mtTempNum[curThread] = tempNum;
 
 			if (!u->HasPhysicalStateBit(physicalStateBits))
-				continue;
+				return;
 			if (!u->HasCollidableStateBit(collisionStateBits))
-				continue;
-			if ((pos - u->pos).SqLength() >= Square(radius + u->radius))
-				continue;
+				return;
 
 			qfq.solids->push_back(u);
-		}
+		});
 
 		for (CFeature* f: baseQuads[qi].features) {
 			if (f->mtTempNum[curThread] == tempNum)
@@ -927,22 +1173,31 @@ bool CQuadField::NoSolidsExact(
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
 	const int tempNum = gs->GetTempNum();
+	const int curThread = ThreadPool::GetThreadNum();
 
 	for (const int qi: *qfQuery.quads) {
-		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
-				continue;
+		const Quad& quad = baseQuads[qi];
 
-			u->tempNum = tempNum;
+		uint64_t* masks = ReserveMasks(curThread, quad.units.size());
 
-			if (!u->HasPhysicalStateBit(physicalStateBits))
-				continue;
-			if (!u->HasCollidableStateBit(collisionStateBits))
-				continue;
-			if ((pos - u->pos).SqLength() >= Square(radius + u->radius))
-				continue;
+		QuadFieldSIMD::SphereMask(quad.unitSpheres, pos, radius, true, masks);
 
-			return false;
+		for (size_t w = 0, nw = QuadFieldSIMD::NumMaskWords(quad.units.size()); w < nw; ++w) {
+			for (uint64_t bits = masks[w]; bits != 0; bits &= (bits - 1)) {
+				CUnit* u = quad.units[(w << 6) + std::countr_zero(bits)];
+
+				if (u->tempNum == tempNum)
+					continue;
+
+				u->tempNum = tempNum;
+
+				if (!u->HasPhysicalStateBit(physicalStateBits))
+					continue;
+				if (!u->HasCollidableStateBit(collisionStateBits))
+					continue;
+
+				return false;
+			}
 		}
 
 		for (CFeature* f: baseQuads[qi].features) {
@@ -966,6 +1221,22 @@ bool CQuadField::NoSolidsExact(
 }
 
 
+static inline bool InColVolRange(const CSolidObject* o, const float3& pos, const float radius)
+{
+	const auto* colvol = &o->collisionVolume;
+	const float totRad = radius + colvol->GetBoundingRadius();
+
+	return (pos.SqDistance(colvol->GetWorldSpacePos(o)) < (totRad * totRad));
+}
+
+static inline bool InColVolRange(const CPlasmaRepulser* r, const float3& pos, const float radius)
+{
+	const auto* colvol = &r->collisionVolume;
+	const float totRad = radius + colvol->GetBoundingRadius();
+
+	return (pos.SqDistance(r->weaponMuzzlePos) < (totRad * totRad));
+}
+
 // optimization specifically for projectile collisions
 void CQuadField::GetUnitsAndFeaturesColVol(
 	const float3& pos,
@@ -991,10 +1262,7 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 
 			u->tempNum = tempNum;
 
-			const auto* colvol = &u->collisionVolume;
-			const float totRad = radius + colvol->GetBoundingRadius();
-
-			if (pos.SqDistance(colvol->GetWorldSpacePos(u)) >= (totRad * totRad))
+			if (!InColVolRange(u, pos, radius))
 				continue;
 
 			units.push_back(u);
@@ -1007,10 +1275,7 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 
 			f->tempNum = tempNum;
 
-			const auto* colvol = &f->collisionVolume;
-			const float totRad = radius + colvol->GetBoundingRadius();
-
-			if (pos.SqDistance(colvol->GetWorldSpacePos(f)) >= (totRad * totRad))
+			if (!InColVolRange(f, pos, radius))
 				continue;
 
 			features.push_back(f);
@@ -1023,10 +1288,7 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 
 				r->tempNum = tempNum;
 
-				const auto* colvol = &r->collisionVolume;
-				const float totRad = radius + colvol->GetBoundingRadius();
-
-				if (pos.SqDistance(r->weaponMuzzlePos) >= (totRad * totRad))
+				if (!InColVolRange(r, pos, radius))
 					continue;
 
 				repulsers->push_back(r);
@@ -1034,4 +1296,61 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 		}
 	}
 }
+
+void CQuadField::GetUnitsAndFeaturesInQuads(
+	const int onThread,
+	const float3& pos,
+	const float radius,
+	std::vector<CUnit*>& units,
+	std::vector<CFeature*>& features,
+	std::vector<CPlasmaRepulser*>& repulsers
+) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	const int tempNum = gs->GetMtTempNum(onThread);
+
+	QuadFieldQuery qfQuery;
+	qfQuery.threadOwner = onThread;
+	GetQuads(qfQuery, pos, radius);
+
+	for (const int qi: *qfQuery.quads) {
+		const Quad& quad = baseQuads[qi];
+
+		for (CUnit* u: quad.units) {
+			if (u->mtTempNum[onThread] == tempNum)
+				continue;
+
+			u->mtTempNum[onThread] = tempNum;
+			units.push_back(u);
+		}
+
+		for (CFeature* f: quad.features) {
+			if (f->mtTempNum[onThread] == tempNum)
+				continue;
+
+			f->mtTempNum[onThread] = tempNum;
+			features.push_back(f);
+		}
+
+		// repulsers have no per-thread tempNum, but are few
+		for (CPlasmaRepulser* r: quad.repulsers) {
+			if (std::find(repulsers.begin(), repulsers.end(), r) != repulsers.end())
+				continue;
+
+			repulsers.push_back(r);
+		}
+	}
+}
+
+void CQuadField::FilterUnitsAndFeaturesColVol(
+	const float3& pos,
+	const float radius,
+	std::vector<CUnit*>& units,
+	std::vector<CFeature*>& features,
+	std::vector<CPlasmaRepulser*>& repulsers
+) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	units.erase(std::remove_if(units.begin(), units.end(), [&](const CUnit* u) { return !InColVolRange(u, pos, radius); }), units.end());
+	features.erase(std::remove_if(features.begin(), features.end(), [&](const CFeature* f) { return !InColVolRange(f, pos, radius); }), features.end());
+	repulsers.erase(std::remove_if(repulsers.begin(), repulsers.end(), [&](const CPlasmaRepulser* r) { return !InColVolRange(r, pos, radius); }), repulsers.end());
+}
 #endif // UNIT_TEST
@@ -5,12 +5,14 @@
 
 #include <algorithm>
 #include <array>
+#include <span>
 #include <vector>
 
+#include "Sim/Misc/QuadFieldSIMD.h"
 #include "System/Misc/NonCopyable.h"
 #include "System/Threading/ThreadPool.h"
 #include "System/creg/creg_cond.h"
-#include "System/float3.h"
+#include "System/float4.h"
 #include "System/type2.h"
 
 class CUnit;
@@ -92,6 +94,7 @@ public:
 
 	void Init(int2 mapDims, int quadSize);
 	void Kill();
+	void PostLoad();
 
 	void GetQuads(QuadFieldQuery& qfq, float3 pos, float radius);
 	void GetQuadsRectangle(QuadFieldQuery& qfq, const float3& mins, const float3& maxs);
@@ -105,6 +108,28 @@ public:
 		std::vector<CFeature*>& features,
 		std::vector<CPlasmaRepulser*>* repulsers = nullptr
 	);
+	/**
+	 * Thread-safe first half of GetUnitsAndFeaturesColVol: appends every
+	 * unit, feature and repulser in the quads overlapping the sphere in the
+	 * order GetUnitsAndFeaturesColVol visits them, without testing distances.
+	 * The candidates stay valid as long as GetSolidsVersion does not change.
+	 */
+	void GetUnitsAndFeaturesInQuads(
+		const int onThread,
+		const float3& pos,
+		const float radius,
+		std::vector<CUnit*>& units,
+		std::vector<CFeature*>& features,
+		std::vector<CPlasmaRepulser*>& repulsers
+	);
+	/// second half, keeps the candidates GetUnitsAndFeaturesColVol would return
+	static void FilterUnitsAndFeaturesColVol(
+		const float3& pos,
+		const float radius,
+		std::vector<CUnit*>& units,
+		std::vector<CFeature*>& features,
+		std::vector<CPlasmaRepulser*>& repulsers
+	);
 
 	/**
 	 * Returns all units within @c radius of @c pos,
@@ -158,6 +183,16 @@ public:
 
 	void MovedUnit(CUnit* unit);
 	void RemoveUnit(CUnit* unit);
+	/// copies the unit's current position and radius into the quads it is part of
+	void UpdateUnitSphere(const CUnit* unit);
+	/**
+	 * Equivalent to calling MovedUnit for each element of @c units in order
+	 * (including the resulting per-quad orderings), but computes the new quad
+	 * memberships in parallel and applies insertions/removals grouped by quad.
+	 * Only for moves that no query can observe in between; the units updated
+	 * by CUnitHandler::UpdateUnits call MovedUnit one at a time for that reason.
+	 */
+	void MovedUnitsBatch(std::span<CUnit* const> units);
 
 	void AddFeature(CFeature* feature);
 	void RemoveFeature(CFeature* feature);
@@ -188,6 +223,7 @@ public:
 		Quad& operator = (const Quad& q) = delete;
 		Quad& operator = (Quad&& q) {
 			units = std::move(q.units);
+			unitSpheres = std::move(q.unitSpheres);
 			teamUnits = std::move(q.teamUnits);
 			features = std::move(q.features);
 			projectiles = std::move(q.projectiles);
@@ -197,8 +233,14 @@ public:
 
 		void PostLoad();
 		void Resize(int numAllyTeams) { teamUnits.resize(numAllyTeams); }
+		/// returns the index of <unit> in units (and unitSpheres)
+		int AddUnit(CUnit* unit);
+		/// the last unit takes the place of <unit>, returns it unless that was <unit>
+		CUnit* EraseUnit(CUnit* unit, int slot);
+
 		void Clear() {
 			units.clear();
+			unitSpheres.clear();
 			// reuse inner vectors when reloading
 			// teamUnits.clear();
 			for (auto& v: teamUnits) {
@@ -211,12 +253,44 @@ public:
 
 	public:
 		std::vector<CUnit*> units;
+		// positions and radii of <units>, same order; kept current by
+		// UpdateUnitSphere for the QuadFieldSIMD kernels
+		PackedSpheres unitSpheres;
 		std::vector< std::vector<CUnit*> > teamUnits;
 		std::vector<CFeature*> features;
 		std::vector<CProjectile*> projectiles;
 		std::vector<CPlasmaRepulser*> repulsers;
 	};
 
+	/**
+	 * Quad membership changes of a batch of moved units, grouped by quad in
+	 * the order sequential MovedUnit calls would apply them (all removals of
+	 * a unit precede its insertions), so each quad can be updated on its own.
+	 */
+	class MoveBatch {
+	public:
+		struct Op {
+			int quad;
+			int unit; // index into the batch
+			bool insert;
+		};
+
+		void Clear() { ops.clear(); }
+		void AddMove(int unit, const std::vector<int>& oldQuads, const std::vector<int>& newQuads);
+		/// stable counting-sort of all ops added since Clear by quad
+		void Group(size_t numQuads);
+
+		const std::vector<int>& GetTouchedQuads() const { return quadsTouched; }
+		std::span<const Op> GetQuadOps(int quad) const;
+
+	private:
+		std::vector<Op> ops;
+		std::vector<Op> groupedOps;
+		// end of each quad's range in groupedOps, after Group
+		std::vector<int> quadEnds;
+		std::vector<int> quadsTouched;
+	};
+
 	const Quad& GetQuad(unsigned i) const {
 		assert(i < baseQuads.size());
 		return baseQuads[i];
@@ -230,6 +304,9 @@ public:
 	int GetNumQuadsX() const { return numQuadsX; }
 	int GetNumQuadsZ() const { return numQuadsZ; }
 
+	/// changes whenever a unit, feature or repulser enters or leaves a quad
+	unsigned int GetSolidsVersion() const { return solidsVersion; }
+
 	int GetQuadSizeX() const { return quadSizeX; }
 	int GetQuadSizeZ() const { return quadSizeZ; }
 
@@ -239,15 +316,32 @@ private:
 	int2 WorldPosToQuadField(const float3 p) const;
 	int WorldPosToQuadFieldIdx(const float3 p) const;
 
+	/// removes <unit> from quad unit->quads[i], leaves unit->quads alone
+	void EraseUnitFromQuad(CUnit* unit, size_t i);
+
+	uint64_t* ReserveMasks(int onThread, size_t numElems) {
+		tempMasks[onThread].resize(std::max(tempMasks[onThread].size(), QuadFieldSIMD::NumMaskWords(numElems)));
+		return tempMasks[onThread].data();
+	}
+
 private:
 	std::vector<Quad> baseQuads;
 
+	// scratch for MovedUnitsBatch
+	std::vector< std::vector<int> > batchQuads;
+	std::vector<uint8_t> batchChanged;
+	MoveBatch moveBatch;
+
+	unsigned int solidsVersion = 0;
+
 	// preallocated vectors for Get*Exact functions
 	std::array< QueryVectorCache<CUnit*>, ThreadPool::MAX_THREADS >  tempUnits;
 	std::array< QueryVectorCache<CFeature*>, ThreadPool::MAX_THREADS >  tempFeatures;
 	QueryVectorCache<CProjectile*> tempProjectiles;
 	std::array< QueryVectorCache<CSolidObject*>, ThreadPool::MAX_THREADS > tempSolids;
 	std::array< QueryVectorCache<int>, ThreadPool::MAX_THREADS > tempQuads;
+	// per-quad candidate bitmasks filled by the QuadFieldSIMD kernels
+	std::array< std::vector<uint64_t>, ThreadPool::MAX_THREADS > tempMasks;
 
 	float2 invQuadSize;
 
@@ -0,0 +1,97 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "QuadFieldSIMD.h"
+#include "QuadFieldSIMDImpl.hpp"
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+namespace QuadFieldSIMD {
+	SphereMaskFunc SphereMask = SphereMaskScalar;
+	RectMaskFunc RectMask = RectMaskScalar;
+
+	static const char* implName = "Scalar";
+
+
+	void SphereMaskScalar(const PackedSpheres& ps, const float3& pos, float radius, bool spherical, uint64_t* masks)
+	{
+		Impl::ClearMasks(ps.size(), masks);
+
+		for (size_t i = 0, n = ps.size(); i < n; ++i) {
+			Impl::SetMaskBits(i, SphereTest(ps.get(i), pos, radius, spherical), masks);
+		}
+	}
+
+	void RectMaskScalar(const PackedSpheres& ps, const float3& mins, const float3& maxs, uint64_t* masks)
+	{
+		Impl::ClearMasks(ps.size(), masks);
+
+		for (size_t i = 0, n = ps.size(); i < n; ++i) {
+			Impl::SetMaskBits(i, RectTest(ps.get(i), mins, maxs), masks);
+		}
+	}
+
+
+#if defined(XSIMD_X86_INSTR_SET) && (XSIMD_X86_INSTR_SET >= XSIMD_X86_SSE2_VERSION)
+	static uint64_t MoveMaskSSE(const xsimd::batch_bool<float, 4>& b) { return _mm_movemask_ps(b); }
+
+	void SphereMaskSSE(const PackedSpheres& ps, const float3& pos, float radius, bool spherical, uint64_t* masks)
+	{
+		Impl::SphereMask<4>(ps, pos, radius, spherical, masks, MoveMaskSSE);
+	}
+
+	void RectMaskSSE(const PackedSpheres& ps, const float3& mins, const float3& maxs, uint64_t* masks)
+	{
+		Impl::RectMask<4>(ps, mins, maxs, masks, MoveMaskSSE);
+	}
+#else
+	void SphereMaskSSE(const PackedSpheres& ps, const float3& pos, float radius, bool spherical, uint64_t* masks)
+	{
+		SphereMaskScalar(ps, pos, radius, spherical, masks);
+	}
+
+	void RectMaskSSE(const PackedSpheres& ps, const float3& mins, const float3& maxs, uint64_t* masks)
+	{
+		RectMaskScalar(ps, mins, maxs, masks);
+	}
+#endif
+
+
+	bool HaveAVX()
+	{
+	#if !defined(XSIMD_X86_INSTR_SET)
+		return false;
+	#elif defined(_MSC_VER)
+		int regs[4] = {0, 0, 0, 0};
+
+		__cpuid(regs, 1);
+
+		// AVX and OSXSAVE, then check the OS saves the YMM state
+		if ((regs[2] & (1 << 28)) == 0 || (regs[2] & (1 << 27)) == 0)
+			return false;
+
+		return ((_xgetbv(0) & 0x6) == 0x6);
+	#else
+		return __builtin_cpu_supports("avx");
+	#endif
+	}
+
+	void Init()
+	{
+	#if defined(XSIMD_X86_INSTR_SET) && (XSIMD_X86_INSTR_SET >= XSIMD_X86_SSE2_VERSION)
+		SphereMask = SphereMaskSSE;
+		RectMask = RectMaskSSE;
+		implName = "SSE";
+	#endif
+
+		if (!HaveAVX())
+			return;
+
+		SphereMask = SphereMaskAVX;
+		RectMask = RectMaskAVX;
+		implName = "AVX";
+	}
+
+	const char* GetImplName() { return implName; }
+}
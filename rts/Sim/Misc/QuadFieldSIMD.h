@@ -0,0 +1,116 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef QUAD_FIELD_SIMD_H
+#define QUAD_FIELD_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "System/float4.h"
+
+/**
+ * Positions and radii of a set of objects, one stream per component
+ * so that the QuadField *Exact queries can test several candidates
+ * per instruction. Element order is managed by the owner.
+ */
+struct PackedSpheres {
+public:
+	size_t size() const { return xs.size(); }
+
+	void clear() {
+		xs.clear();
+		ys.clear();
+		zs.clear();
+		rs.clear();
+	}
+	void resize(size_t n) {
+		xs.resize(n);
+		ys.resize(n);
+		zs.resize(n);
+		rs.resize(n);
+	}
+
+	void push_back(const float3& p, float r) {
+		xs.push_back(p.x);
+		ys.push_back(p.y);
+		zs.push_back(p.z);
+		rs.push_back(r);
+	}
+	void pop_back() {
+		xs.pop_back();
+		ys.pop_back();
+		zs.pop_back();
+		rs.pop_back();
+	}
+	void set(size_t i, const float3& p, float r) {
+		xs[i] = p.x;
+		ys[i] = p.y;
+		zs[i] = p.z;
+		rs[i] = r;
+	}
+
+	float4 get(size_t i) const { return {xs[i], ys[i], zs[i], rs[i]}; }
+
+public:
+	std::vector<float> xs;
+	std::vector<float> ys;
+	std::vector<float> zs;
+	std::vector<float> rs;
+};
+
+
+/**
+ * Candidate filters for the QuadField *Exact queries. Each sets bit i
+ * of masks[i / 64] iff element i passes; masks must hold at least
+ * NumMaskWords(ps.size()) words. All implementations evaluate the same
+ * IEEE operations in the same order (no FMA contraction, see CMake) as
+ * the scalar reference, so results are bit-identical whichever one Init
+ * picks for the running CPU.
+ */
+namespace QuadFieldSIMD {
+	typedef void (*SphereMaskFunc)(const PackedSpheres& ps, const float3& pos, float radius, bool spherical, uint64_t* masks);
+	typedef void (*RectMaskFunc)(const PackedSpheres& ps, const float3& mins, const float3& maxs, uint64_t* masks);
+
+	/// selects the widest implementation the CPU supports
+	void Init();
+	const char* GetImplName();
+
+	static inline size_t NumMaskWords(size_t n) { return ((n + 63) / 64); }
+
+	/// scalar reference: element overlaps the sphere (or the infinite cylinder if !spherical)
+	static inline bool SphereTest(const float4& e, const float3& pos, float radius, bool spherical) {
+		const float totRad = radius + e.w;
+		const float totRadSq = totRad * totRad;
+		const float posDstSq = spherical?
+			pos.SqDistance(e):
+			pos.SqDistance2D(e);
+
+		return !(posDstSq >= totRadSq);
+	}
+	/// scalar reference: element is inside the xz-rectangle (mins, maxs)
+	static inline bool RectTest(const float4& e, const float3& mins, const float3& maxs) {
+		if (e.x < mins.x || e.x > maxs.x)
+			return false;
+		if (e.z < mins.z || e.z > maxs.z)
+			return false;
+
+		return true;
+	}
+
+	void SphereMaskScalar(const PackedSpheres& ps, const float3& pos, float radius, bool spherical, uint64_t* masks);
+	void SphereMaskSSE(const PackedSpheres& ps, const float3& pos, float radius, bool spherical, uint64_t* masks);
+	void SphereMaskAVX(const PackedSpheres& ps, const float3& pos, float radius, bool spherical, uint64_t* masks);
+
+	void RectMaskScalar(const PackedSpheres& ps, const float3& mins, const float3& maxs, uint64_t* masks);
+	void RectMaskSSE(const PackedSpheres& ps, const float3& mins, const float3& maxs, uint64_t* masks);
+	void RectMaskAVX(const PackedSpheres& ps, const float3& mins, const float3& maxs, uint64_t* masks);
+
+	extern SphereMaskFunc SphereMask;
+	extern RectMaskFunc RectMask;
+
+	/// true if the AVX kernels were compiled in and the CPU/OS support them
+	bool HaveAVX();
+}
+
+#endif
@@ -0,0 +1,95 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+// kernel templates of QuadFieldSIMD.cpp, kept apart from the dispatch code;
+// do not include elsewhere
+
+#include <cstring>
+
+#include "QuadFieldSIMD.h"
+#include "xsimd/xsimd.hpp"
+
+namespace QuadFieldSIMD {
+namespace Impl {
+	static inline void ClearMasks(size_t n, uint64_t* masks) {
+		std::memset(masks, 0, NumMaskWords(n) * sizeof(uint64_t));
+	}
+	static inline void SetMaskBits(size_t i, uint64_t bits, uint64_t* masks) {
+		// N divides 64, so a batch never straddles two words
+		masks[i >> 6] |= (bits << (i & 63));
+	}
+
+	// operand order matches float3::SqDistance{2D} and SphereTest exactly
+	template<size_t N, typename MoveMask>
+	static void SphereMask(const PackedSpheres& ps, const float3& pos, float radius, bool spherical, uint64_t* masks, MoveMask moveMask)
+	{
+		typedef xsimd::batch<float, N> batch_t;
+
+		const size_t n = ps.size();
+		const batch_t px(pos.x);
+		const batch_t py(pos.y);
+		const batch_t pz(pos.z);
+		const batch_t pr(radius);
+
+		size_t i = 0;
+
+		ClearMasks(n, masks);
+
+		for (; (i + N) <= n; i += N) {
+			const batch_t ex(&ps.xs[i], xsimd::unaligned_mode());
+			const batch_t ez(&ps.zs[i], xsimd::unaligned_mode());
+			const batch_t er(&ps.rs[i], xsimd::unaligned_mode());
+
+			const batch_t dx = px - ex;
+			const batch_t dz = pz - ez;
+			const batch_t totRad = pr + er;
+			const batch_t totRadSq = totRad * totRad;
+
+			batch_t posDstSq;
+
+			if (spherical) {
+				const batch_t ey(&ps.ys[i], xsimd::unaligned_mode());
+				const batch_t dy = py - ey;
+
+				posDstSq = ((dx * dx) + (dy * dy)) + (dz * dz);
+			} else {
+				posDstSq = (dx * dx) + (dz * dz);
+			}
+
+			const uint64_t outside = moveMask(posDstSq >= totRadSq);
+			SetMaskBits(i, outside ^ ((uint64_t(1) << N) - 1), masks);
+		}
+
+		for (; i < n; ++i) {
+			SetMaskBits(i, SphereTest(ps.get(i), pos, radius, spherical), masks);
+		}
+	}
+
+	template<size_t N, typename MoveMask>
+	static void RectMask(const PackedSpheres& ps, const float3& mins, const float3& maxs, uint64_t* masks, MoveMask moveMask)
+	{
+		typedef xsimd::batch<float, N> batch_t;
+
+		const size_t n = ps.size();
+		const batch_t minx(mins.x);
+		const batch_t minz(mins.z);
+		const batch_t maxx(maxs.x);
+		const batch_t maxz(maxs.z);
+
+		size_t i = 0;
+
+		ClearMasks(n, masks);
+
+		for (; (i + N) <= n; i += N) {
+			const batch_t ex(&ps.xs[i], xsimd::unaligned_mode());
+			const batch_t ez(&ps.zs[i], xsimd::unaligned_mode());
+
+			const uint64_t outside = moveMask(((ex < minx) || (ex > maxx)) || ((ez < minz) || (ez > maxz)));
+			SetMaskBits(i, outside ^ ((uint64_t(1) << N) - 1), masks);
+		}
+
+		for (; i < n; ++i) {
+			SetMaskBits(i, RectTest(ps.get(i), mins, maxs), masks);
+		}
+	}
+}
+}
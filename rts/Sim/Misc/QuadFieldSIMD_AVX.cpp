@@ -0,0 +1,103 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+// only reached through QuadFieldSIMD::Init after a runtime CPU check; this
+// file is NOT built with AVX enabled, only the kernels below are, so no AVX
+// code can end up in the out-of-line copies of shared inline functions
+
+#include <cstring>
+
+#include "QuadFieldSIMD.h"
+#include "xsimd/config/xsimd_instruction_set.hpp"
+
+#if defined(XSIMD_X86_INSTR_SET) && (XSIMD_X86_INSTR_SET >= XSIMD_X86_SSE2_VERSION)
+	#include <immintrin.h>
+
+	#if defined(_MSC_VER)
+		#define QF_TARGET_AVX
+	#else
+		#define QF_TARGET_AVX __attribute__((target("avx")))
+	#endif
+#endif
+
+namespace QuadFieldSIMD {
+#if defined(QF_TARGET_AVX)
+	static inline void SetMaskBits(size_t i, uint64_t bits, uint64_t* masks) { masks[i >> 6] |= (bits << (i & 63)); }
+
+	// operand order and comparisons (ordered, non-signalling) match the
+	// scalar reference and the SSE kernels exactly, see QuadFieldSIMDImpl
+	QF_TARGET_AVX void SphereMaskAVX(const PackedSpheres& ps, const float3& pos, float radius, bool spherical, uint64_t* masks)
+	{
+		const size_t n = ps.size();
+		const __m256 px = _mm256_set1_ps(pos.x);
+		const __m256 py = _mm256_set1_ps(pos.y);
+		const __m256 pz = _mm256_set1_ps(pos.z);
+		const __m256 pr = _mm256_set1_ps(radius);
+
+		size_t i = 0;
+
+		std::memset(masks, 0, NumMaskWords(n) * sizeof(uint64_t));
+
+		for (; (i + 8) <= n; i += 8) {
+			const __m256 dx = _mm256_sub_ps(px, _mm256_loadu_ps(&ps.xs[i]));
+			const __m256 dz = _mm256_sub_ps(pz, _mm256_loadu_ps(&ps.zs[i]));
+			const __m256 totRad = _mm256_add_ps(pr, _mm256_loadu_ps(&ps.rs[i]));
+			const __m256 totRadSq = _mm256_mul_ps(totRad, totRad);
+
+			__m256 posDstSq;
+
+			if (spherical) {
+				const __m256 dy = _mm256_sub_ps(py, _mm256_loadu_ps(&ps.ys[i]));
+
+				posDstSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+			} else {
+				posDstSq = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dz, dz));
+			}
+
+			const uint64_t outside = _mm256_movemask_ps(_mm256_cmp_ps(posDstSq, totRadSq, _CMP_GE_OQ));
+			SetMaskBits(i, outside ^ 0xFF, masks);
+		}
+
+		for (; i < n; ++i) {
+			SetMaskBits(i, SphereTest(ps.get(i), pos, radius, spherical), masks);
+		}
+	}
+
+	QF_TARGET_AVX void RectMaskAVX(const PackedSpheres& ps, const float3& mins, const float3& maxs, uint64_t* masks)
+	{
+		const size_t n = ps.size();
+		const __m256 minx = _mm256_set1_ps(mins.x);
+		const __m256 minz = _mm256_set1_ps(mins.z);
+		const __m256 maxx = _mm256_set1_ps(maxs.x);
+		const __m256 maxz = _mm256_set1_ps(maxs.z);
+
+		size_t i = 0;
+
+		std::memset(masks, 0, NumMaskWords(n) * sizeof(uint64_t));
+
+		for (; (i + 8) <= n; i += 8) {
+			const __m256 ex = _mm256_loadu_ps(&ps.xs[i]);
+			const __m256 ez = _mm256_loadu_ps(&ps.zs[i]);
+
+			const __m256 outx = _mm256_or_ps(_mm256_cmp_ps(ex, minx, _CMP_LT_OQ), _mm256_cmp_ps(ex, maxx, _CMP_GT_OQ));
+			const __m256 outz = _mm256_or_ps(_mm256_cmp_ps(ez, minz, _CMP_LT_OQ), _mm256_cmp_ps(ez, maxz, _CMP_GT_OQ));
+
+			const uint64_t outside = _mm256_movemask_ps(_mm256_or_ps(outx, outz));
+			SetMaskBits(i, outside ^ 0xFF, masks);
+		}
+
+		for (; i < n; ++i) {
+			SetMaskBits(i, RectTest(ps.get(i), mins, maxs), masks);
+		}
+	}
+#else
+	void SphereMaskAVX(const PackedSpheres& ps, const float3& pos, float radius, bool spherical, uint64_t* masks)
+	{
+		SphereMaskSSE(ps, pos, radius, spherical, masks);
+	}
+
+	void RectMaskAVX(const PackedSpheres& ps, const float3& mins, const float3& maxs, uint64_t* masks)
+	{
+		RectMaskSSE(ps, mins, maxs, masks);
+	}
+#endif
+}
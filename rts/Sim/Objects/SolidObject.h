@@ -149,7 +149,11 @@ public:
 		pos += dv;
 		midPos += dv;
 		aimPos += dv;
+
+		Moved();
 	}
+	// lets objects update copies of their position kept elsewhere
+	virtual void Moved() {}
 
 	// this should be called whenever the direction
 	// vectors are changed (ie. after a rotation) in
@@ -112,6 +112,26 @@ public:
 	) const {
 	}
 
+	/**
+	 * Diagnostics of the search that produced a path, for benchmarking.
+	 *
+	 * @param pathID
+	 *     The path-id returned by RequestPath.
+	 * @param numNodesSearched
+	 *     Number of nodes expanded by the search.
+	 * @param searchTimeMs
+	 *     Wall-clock duration of the search in milliseconds.
+	 * @return
+	 *     false if the path is unknown or the pathfinder keeps no stats
+	 */
+	virtual bool GetPathSearchStats(
+		unsigned int pathID,
+		unsigned int& numNodesSearched,
+		float& searchTimeMs
+	) const {
+		return false;
+	}
+
 
 	/**
 	 * Generate a path from startPos to the target defined by
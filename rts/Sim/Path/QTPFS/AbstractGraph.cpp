@@ -0,0 +1,278 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+
+#include "AbstractGraph.h"
+#include "PathThreads.h"
+
+#include "System/Misc/TracyDefs.h"
+
+void QTPFS::AbstractGraph::Clear() {
+	clusters.clear();
+	nodeRefs.clear();
+	regionOffsets.clear();
+	regionClusters.clear();
+	dirtyClusters.clear();
+
+	xClusters = 0;
+	zClusters = 0;
+	clusterSize = 0;
+}
+
+void QTPFS::AbstractGraph::MarkDirty(const SRectangle& area) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (!IsBuilt())
+		return;
+
+	const int xmin = std::clamp(area.x1    , 0, xClusters * clusterSize - 1) / clusterSize;
+	const int zmin = std::clamp(area.z1    , 0, zClusters * clusterSize - 1) / clusterSize;
+	const int xmax = std::clamp(area.x2 - 1, 0, xClusters * clusterSize - 1) / clusterSize;
+	const int zmax = std::clamp(area.z2 - 1, 0, zClusters * clusterSize - 1) / clusterSize;
+
+	for (int z = zmin; z <= zmax; ++z) {
+		for (int x = xmin; x <= xmax; ++x) {
+			const int clusterIdx = z * xClusters + x;
+
+			if (clusters[clusterIdx].dirty)
+				continue;
+
+			clusters[clusterIdx].dirty = true;
+			dirtyClusters.push_back(clusterIdx);
+		}
+	}
+}
+
+void QTPFS::AbstractGraph::ClearDirtyNodeRefs(int maxNodesAlloced) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	// retesselation can have pushed the pool beyond its previous high-water mark
+	if (nodeRefs.size() < size_t(maxNodesAlloced))
+		nodeRefs.resize(maxNodesAlloced);
+
+	// pool slots freed in one dirty cluster may since have been handed out to
+	// another one, so all stale references have to go before any are rebuilt
+	for (const int clusterIdx: dirtyClusters) {
+		for (const unsigned int nodeIdx: clusters[clusterIdx].leaves) {
+			nodeRefs[nodeIdx] = RegionRef();
+		}
+	}
+}
+
+void QTPFS::AbstractGraph::GetDirtyEdgeClusters(std::vector<int>& edgeClusters) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	// the regions of a dirty cluster were renumbered, which also invalidates
+	// the edges its neighbours hold towards it
+	edgeClusters.clear();
+	edgeClusters.reserve(dirtyClusters.size() * 9);
+
+	for (const int clusterIdx: dirtyClusters) {
+		const int cx = clusterIdx % xClusters;
+		const int cz = clusterIdx / xClusters;
+
+		for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, zClusters - 1); ++z) {
+			for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, xClusters - 1); ++x) {
+				edgeClusters.push_back(z * xClusters + x);
+			}
+		}
+
+		clusters[clusterIdx].dirty = false;
+	}
+
+	std::sort(edgeClusters.begin(), edgeClusters.end());
+	edgeClusters.erase(std::unique(edgeClusters.begin(), edgeClusters.end()), edgeClusters.end());
+
+	dirtyClusters.clear();
+}
+
+int QTPFS::AbstractGraph::FindLeafRegions(int numLeaves) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	// Tarjan's algorithm over leafLinks (iterative, clusters can hold
+	// thousands of leaves); a leaf that has been visited but not assigned
+	// to a component yet is still on leafStack
+	leafOrders.assign(numLeaves, -1);
+	leafLowLinks.assign(numLeaves, -1);
+	leafRegions.assign(numLeaves, -1);
+	leafStack.clear();
+	leafCallStack.clear();
+
+	int numOrdered = 0;
+	int numComponents = 0;
+
+	const auto VisitLeaf = [&](int i) {
+		leafOrders[i] = numOrdered;
+		leafLowLinks[i] = numOrdered;
+		numOrdered += 1;
+
+		leafStack.push_back(i);
+		leafCallStack.emplace_back(i, leafLinkOffsets[i]);
+	};
+
+	for (int root = 0; root < numLeaves; ++root) {
+		if (leafOrders[root] >= 0)
+			continue;
+
+		VisitLeaf(root);
+
+		while (!leafCallStack.empty()) {
+			const int i = leafCallStack.back().first;
+			const int link = leafCallStack.back().second;
+
+			if (link < leafLinkOffsets[i + 1]) {
+				const int j = leafLinks[link];
+
+				leafCallStack.back().second += 1;
+
+				if (leafOrders[j] < 0) {
+					VisitLeaf(j);
+				} else if (leafRegions[j] < 0) {
+					leafLowLinks[i] = std::min(leafLowLinks[i], leafOrders[j]);
+				}
+
+				continue;
+			}
+
+			leafCallStack.pop_back();
+
+			if (!leafCallStack.empty()) {
+				const int parent = leafCallStack.back().first;
+				leafLowLinks[parent] = std::min(leafLowLinks[parent], leafLowLinks[i]);
+			}
+
+			if (leafLowLinks[i] != leafOrders[i])
+				continue;
+
+			int j = -1;
+
+			do {
+				j = leafStack.back();
+				leafStack.pop_back();
+				leafRegions[j] = numComponents;
+			} while (j != i);
+
+			numComponents += 1;
+		}
+	}
+
+	// number the regions in leaf order rather than in the (reverse topological)
+	// order Tarjan completes them, which keeps them independent of link order
+	componentRegions.assign(numComponents, -1);
+
+	int numRegions = 0;
+
+	for (int i = 0; i < numLeaves; ++i) {
+		int& region = componentRegions[leafRegions[i]];
+
+		if (region < 0)
+			region = numRegions++;
+
+		leafRegions[i] = region;
+	}
+
+	return numRegions;
+}
+
+void QTPFS::AbstractGraph::UpdateRegionOffsets() {
+	RECOIL_DETAILED_TRACY_ZONE;
+	regionOffsets.resize(clusters.size() + 1);
+	regionOffsets[0] = 0;
+
+	for (size_t i = 0; i < clusters.size(); ++i) {
+		regionOffsets[i + 1] = regionOffsets[i] + clusters[i].regions.size();
+	}
+
+	regionClusters.resize(regionOffsets.back());
+
+	for (size_t i = 0; i < clusters.size(); ++i) {
+		std::fill(regionClusters.begin() + regionOffsets[i], regionClusters.begin() + regionOffsets[i + 1], i);
+	}
+}
+
+bool QTPFS::AbstractGraph::FindCorridor(int srcRegion, int tgtRegion, float hCostMult, AbstractSearchData& data) const {
+	ZoneScoped;
+	assert(srcRegion >= 0 && srcRegion < GetNumRegions());
+	assert(tgtRegion >= 0 && tgtRegion < GetNumRegions());
+
+	data.Init(GetNumRegions(), GetNumClusters());
+
+	const auto getRegion = [this](int globalIdx) -> const Region& {
+		const int clusterIdx = regionClusters[globalIdx];
+		return clusters[clusterIdx].regions[globalIdx - regionOffsets[clusterIdx]];
+	};
+
+	const float2 tgtCenter = getRegion(tgtRegion).center;
+	bool foundTarget = false;
+
+	data.gCosts[srcRegion] = 0.0f;
+	data.prevRegions[srcRegion] = -1;
+	data.regionStamps[srcRegion] = data.regionStamp;
+	data.openRegions.emplace(srcRegion, getRegion(srcRegion).center.Distance(tgtCenter) * hCostMult);
+
+	while (!data.openRegions.empty()) {
+		const SearchQueueNode curOpenRegion = data.openRegions.top();
+		data.openRegions.pop();
+
+		const int curRegionIdx = curOpenRegion.nodeIndex;
+		const Region& curRegion = getRegion(curRegionIdx);
+		const float curCost = data.gCosts[curRegionIdx];
+
+		// superseded by a cheaper entry for the same region
+		if (curOpenRegion.heapPriority > (curCost + curRegion.center.Distance(tgtCenter) * hCostMult))
+			continue;
+
+		if ((foundTarget = (curRegionIdx == tgtRegion)))
+			break;
+
+		for (const RegionRef& edge: curRegion.edges) {
+			const int nxtRegionIdx = regionOffsets[edge.cluster] + edge.region;
+			const Region& nxtRegion = clusters[edge.cluster].regions[edge.region];
+
+			const float edgeCost = curRegion.center.Distance(nxtRegion.center) * (curRegion.moveCost + nxtRegion.moveCost) * 0.5f;
+			const float nxtCost = curCost + edgeCost;
+
+			if (data.regionStamps[nxtRegionIdx] == data.regionStamp && nxtCost >= data.gCosts[nxtRegionIdx])
+				continue;
+
+			data.gCosts[nxtRegionIdx] = nxtCost;
+			data.prevRegions[nxtRegionIdx] = curRegionIdx;
+			data.regionStamps[nxtRegionIdx] = data.regionStamp;
+			data.openRegions.emplace(nxtRegionIdx, nxtCost + nxtRegion.center.Distance(tgtCenter) * hCostMult);
+		}
+	}
+
+	if (!foundTarget)
+		return false;
+
+	// widen the route by one cluster so the node search can still
+	// cut corners and pick the better side of an obstacle
+	for (int regionIdx = tgtRegion; regionIdx >= 0; regionIdx = data.prevRegions[regionIdx]) {
+		const int cx = regionClusters[regionIdx] % xClusters;
+		const int cz = regionClusters[regionIdx] / xClusters;
+
+		for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, zClusters - 1); ++z) {
+			for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, xClusters - 1); ++x) {
+				data.corridorStamps[z * xClusters + x] = data.corridorStamp;
+			}
+		}
+	}
+
+	return true;
+}
+
+std::uint64_t QTPFS::AbstractGraph::GetMemFootPrint() const {
+	std::uint64_t memFootPrint = 0;
+
+	memFootPrint += clusters.size() * sizeof(decltype(clusters)::value_type);
+	memFootPrint += nodeRefs.size() * sizeof(decltype(nodeRefs)::value_type);
+	memFootPrint += regionOffsets.size() * sizeof(decltype(regionOffsets)::value_type);
+	memFootPrint += regionClusters.size() * sizeof(decltype(regionClusters)::value_type);
+
+	for (const Cluster& cluster: clusters) {
+		memFootPrint += cluster.leaves.size() * sizeof(decltype(cluster.leaves)::value_type);
+		memFootPrint += cluster.regions.size() * sizeof(Region);
+
+		for (const Region& region: cluster.regions) {
+			memFootPrint += region.edges.size() * sizeof(RegionRef);
+		}
+	}
+
+	return memFootPrint;
+}
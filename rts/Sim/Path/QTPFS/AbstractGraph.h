@@ -0,0 +1,290 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef QTPFS_ABSTRACTGRAPH_HDR
+#define QTPFS_ABSTRACTGRAPH_HDR
+
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <utility>
+#include <vector>
+
+#include "Node.h"
+#include "PathDefines.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "System/Rectangle.h"
+#include "System/type2.h"
+#include "System/Misc/TracyDefs.h"
+
+namespace QTPFS {
+	struct AbstractSearchData;
+
+	/**
+	 * Coarse graph over the leaf nodes of a NodeLayer, used to plan long searches
+	 * before the node-level search runs (see PathSearch::InitAbstractCorridor).
+	 *
+	 * Every root node of the layer is a cluster. The passable leaves of a cluster
+	 * are grouped into regions (strongly connected components over the neighbour
+	 * links that stay inside the cluster) and a region gets an edge to every other
+	 * region one of its leaves links to. Links are directed (nothing links into an
+	 * exit-only node from outside), and so are the edges: a region can reach
+	 * another one iff a unit can get from its leaves to the other's. Leaves never
+	 * cross root boundaries, so retesselating an area only invalidates the clusters
+	 * touching it and the edges of their direct neighbours; see MarkDirty and Repair.
+	 *
+	 * The layer is a template parameter (a NodeLayer in the engine) so that the
+	 * graph can be tested without one.
+	 */
+	class AbstractGraph {
+	public:
+		struct RegionRef {
+			bool operator == (const RegionRef& r) const { return (cluster == r.cluster && region == r.region); }
+			bool operator <  (const RegionRef& r) const { return (cluster < r.cluster || (cluster == r.cluster && region < r.region)); }
+
+			int32_t cluster = -1;
+			int32_t region = -1; // local to cluster
+		};
+
+		void Clear();
+		template<typename TNodeLayer> void Build(const TNodeLayer& nodeLayer);
+
+		/// flags the clusters overlapping <area>; does nothing until Build has run
+		void MarkDirty(const SRectangle& area);
+		template<typename TNodeLayer> void Repair(const TNodeLayer& nodeLayer);
+
+		bool IsBuilt() const { return (!clusters.empty()); }
+
+		int GetNumClusters() const { return (clusters.size()); }
+		int GetNumRegions() const { return (regionClusters.size()); }
+
+		/// global region id of a leaf node, -1 for impassable or unknown nodes
+		int GetNodeRegion(unsigned int nodeIndex) const {
+			if (nodeIndex >= nodeRefs.size() || nodeRefs[nodeIndex].region < 0)
+				return -1;
+
+			return (regionOffsets[nodeRefs[nodeIndex].cluster] + nodeRefs[nodeIndex].region);
+		}
+		int GetNodeCluster(unsigned int nodeIndex) const {
+			return ((nodeIndex < nodeRefs.size())? nodeRefs[nodeIndex].cluster: -1);
+		}
+
+		/**
+		 * A* over the regions; on success the clusters on the route and the ring
+		 * of clusters around them are marked in data.corridorStamps, which the
+		 * node-level search then uses to prune neighbours.
+		 */
+		bool FindCorridor(int srcRegion, int tgtRegion, float hCostMult, AbstractSearchData& data) const;
+
+		std::uint64_t GetMemFootPrint() const;
+
+	private:
+		struct Region {
+			float2 center;
+			float moveCost = 0.0f;
+
+			std::vector<RegionRef> edges;
+		};
+
+		struct Cluster {
+			std::vector<Region> regions;
+			std::vector<unsigned int> leaves; // passable leaves, pool indices
+
+			bool dirty = false;
+		};
+
+		template<typename TNodeLayer> void BuildClusterRegions(const TNodeLayer& nodeLayer, int clusterIdx);
+		template<typename TNodeLayer> void BuildClusterEdges(const TNodeLayer& nodeLayer, int clusterIdx);
+
+		void ClearDirtyNodeRefs(int maxNodesAlloced);
+		void GetDirtyEdgeClusters(std::vector<int>& edgeClusters);
+		void UpdateRegionOffsets();
+
+		int FindLeafRegions(int numLeaves);
+
+	private:
+		std::vector<Cluster> clusters;
+		std::vector<RegionRef> nodeRefs; // indexed by pool index
+
+		// global region id = regionOffsets[cluster] + local region id
+		std::vector<int> regionOffsets;
+		std::vector<int> regionClusters;
+
+		std::vector<int> dirtyClusters;
+
+		// scratch for BuildClusterRegions; links are stored per leaf from
+		// leafLinkOffsets[i] to leafLinkOffsets[i + 1] (as leaf indices)
+		std::vector<int> leafLinkOffsets;
+		std::vector<int> leafLinks;
+		std::vector<int> leafOrders;
+		std::vector<int> leafLowLinks;
+		std::vector<int> leafStack;
+		std::vector<std::pair<int, int>> leafCallStack;
+		std::vector<int> componentRegions;
+		std::vector<int> leafRegions;
+		std::vector<float> regionAreas;
+		std::vector<unsigned int> openNodes;
+
+		int xClusters = 0;
+		int zClusters = 0;
+		int clusterSize = 0;
+	};
+}
+
+
+template<typename TNodeLayer>
+void QTPFS::AbstractGraph::Build(const TNodeLayer& nodeLayer) {
+	ZoneScoped;
+	Clear();
+
+	xClusters = nodeLayer.GetXRootNodes();
+	zClusters = nodeLayer.GetZRootNodes();
+	clusterSize = nodeLayer.GetRootNodeSize();
+
+	assert(xClusters * zClusters == nodeLayer.GetRootNodeCount());
+
+	clusters.resize(nodeLayer.GetRootNodeCount());
+	nodeRefs.resize(nodeLayer.GetMaxNodesAlloced());
+
+	// edges refer to the regions of neighbouring clusters, so all of those have to exist first
+	for (int i = 0, n = clusters.size(); i < n; ++i) {
+		BuildClusterRegions(nodeLayer, i);
+	}
+	for (int i = 0, n = clusters.size(); i < n; ++i) {
+		BuildClusterEdges(nodeLayer, i);
+	}
+
+	UpdateRegionOffsets();
+}
+
+template<typename TNodeLayer>
+void QTPFS::AbstractGraph::Repair(const TNodeLayer& nodeLayer) {
+	ZoneScoped;
+	if (dirtyClusters.empty())
+		return;
+
+	ClearDirtyNodeRefs(nodeLayer.GetMaxNodesAlloced());
+
+	for (const int clusterIdx: dirtyClusters) {
+		BuildClusterRegions(nodeLayer, clusterIdx);
+	}
+
+	std::vector<int> edgeClusters;
+	GetDirtyEdgeClusters(edgeClusters);
+
+	for (const int clusterIdx: edgeClusters) {
+		BuildClusterEdges(nodeLayer, clusterIdx);
+	}
+
+	UpdateRegionOffsets();
+}
+
+template<typename TNodeLayer>
+void QTPFS::AbstractGraph::BuildClusterRegions(const TNodeLayer& nodeLayer, int clusterIdx) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	Cluster& cluster = clusters[clusterIdx];
+
+	cluster.leaves.clear();
+	cluster.regions.clear();
+
+	// root nodes occupy the first pool slots, in cluster order
+	openNodes.clear();
+	openNodes.push_back(clusterIdx);
+
+	while (!openNodes.empty()) {
+		const auto* curNode = nodeLayer.GetPoolNode(openNodes.back());
+		openNodes.pop_back();
+
+		if (!curNode->IsLeaf()) {
+			for (int i = QTNODE_CHILD_COUNT - 1; i >= 0; --i) {
+				openNodes.push_back(curNode->GetChildBaseIndex() + i);
+			}
+			continue;
+		}
+
+		if (curNode->AllSquaresImpassable())
+			continue;
+
+		assert(curNode->GetIndex() < nodeRefs.size());
+
+		nodeRefs[curNode->GetIndex()] = {clusterIdx, int32_t(cluster.leaves.size())};
+		cluster.leaves.push_back(curNode->GetIndex());
+	}
+
+	const int numLeaves = cluster.leaves.size();
+
+	leafLinkOffsets.clear();
+	leafLinks.clear();
+
+	// nodeRefs[...].region still holds the leaf index here
+	for (int i = 0; i < numLeaves; ++i) {
+		leafLinkOffsets.push_back(leafLinks.size());
+
+		for (const auto& neighbour: nodeLayer.GetPoolNode(cluster.leaves[i])->GetNeighbours()) {
+			const RegionRef& ngbRef = nodeRefs[neighbour.nodeId];
+
+			if (ngbRef.cluster != clusterIdx)
+				continue;
+
+			leafLinks.push_back(ngbRef.region);
+		}
+	}
+
+	leafLinkOffsets.push_back(leafLinks.size());
+
+	cluster.regions.resize(FindLeafRegions(numLeaves));
+	regionAreas.assign(cluster.regions.size(), 0.0f);
+
+	for (int i = 0; i < numLeaves; ++i) {
+		const auto* curNode = nodeLayer.GetPoolNode(cluster.leaves[i]);
+
+		const int regionIdx = leafRegions[i];
+		const float area = curNode->area();
+
+		Region& region = cluster.regions[regionIdx];
+		region.center.x += area * (curNode->xmin() + curNode->xmax()) * (SQUARE_SIZE * 0.5f);
+		region.center.y += area * (curNode->zmin() + curNode->zmax()) * (SQUARE_SIZE * 0.5f);
+		region.moveCost += area * std::min(curNode->GetMoveCost(), QTPFS_CLOSED_NODE_COST);
+		regionAreas[regionIdx] += area;
+
+		nodeRefs[cluster.leaves[i]].region = regionIdx;
+	}
+
+	for (size_t i = 0; i < cluster.regions.size(); ++i) {
+		Region& region = cluster.regions[i];
+		region.center /= regionAreas[i];
+		region.moveCost /= regionAreas[i];
+	}
+}
+
+template<typename TNodeLayer>
+void QTPFS::AbstractGraph::BuildClusterEdges(const TNodeLayer& nodeLayer, int clusterIdx) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	Cluster& cluster = clusters[clusterIdx];
+
+	for (Region& region: cluster.regions) {
+		region.edges.clear();
+	}
+
+	// a leaf's neighbours are the nodes it can move into, so every edge
+	// points the same way as the link it comes from
+	for (const unsigned int nodeIdx: cluster.leaves) {
+		const RegionRef& nodeRef = nodeRefs[nodeIdx];
+		Region& region = cluster.regions[nodeRef.region];
+
+		for (const auto& neighbour: nodeLayer.GetPoolNode(nodeIdx)->GetNeighbours()) {
+			const RegionRef& ngbRef = nodeRefs[neighbour.nodeId];
+
+			if (ngbRef.region < 0 || ngbRef == nodeRef)
+				continue;
+
+			region.edges.push_back(ngbRef);
+		}
+	}
+
+	for (Region& region: cluster.regions) {
+		std::sort(region.edges.begin(), region.edges.end());
+		region.edges.erase(std::unique(region.edges.begin(), region.edges.end()), region.edges.end());
+	}
+}
+
+#endif
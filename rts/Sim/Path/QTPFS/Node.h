@@ -27,9 +27,11 @@ namespace QTPFS {
 	struct NodeLayer;
 	struct SearchNode;
 	struct UpdateThreadData;
+	class NodeLayerCache;
 
 	struct INode {
 			friend SearchNode;
+			friend NodeLayerCache;
 	public:
 		struct NeighbourPoints {
 			int nodeId;
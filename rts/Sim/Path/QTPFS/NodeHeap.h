@@ -3,7 +3,10 @@
 #ifndef QTPFS_NODEHEAP_HDR
 #define QTPFS_NODEHEAP_HDR
 
+#include <cassert>
+#include <functional>
 #include <limits>
+#include <utility>
 #include <vector>
 #include "PathDefines.h"
 
@@ -291,7 +294,108 @@ namespace QTPFS {
 		size_t cur_idx; // index of first free (unused) slot
 		size_t max_idx; // index of last free (unused) slot
 	};
+
+
+	/**
+	 * Implicit D-ary heap with the same interface and ordering semantics as
+	 * std::priority_queue<T, std::vector<T>, TCmp>: top() is the element no
+	 * other element compares "greater" than under TCmp. As long as TCmp is a
+	 * strict total order on the stored keys, pop order is identical to the
+	 * std::priority_queue it replaces, which keeps synced searches unchanged.
+	 *
+	 * A wider fan-out halves the tree height compared to a binary heap; pops
+	 * compare more children per level, but those sit in one cache line and
+	 * pushes (the more frequent operation in a lazy-deletion A*) get cheaper.
+	 * Elements are moved through a hole instead of being swapped.
+	 */
+	template<typename T, typename TCmp = std::less<T>, size_t D = 4> class d_ary_heap {
+	public:
+		static_assert(D >= 2, "heap arity must be at least 2");
+
+		typedef std::vector<T> container_type;
+		typedef T value_type;
+		typedef size_t size_type;
+
+		const T& top() const { assert(!empty()); return nodes[0]; }
+
+		bool empty() const { return nodes.empty(); }
+		size_t size() const { return nodes.size(); }
+
+		// keeps the allocation
+		void clear() { nodes.clear(); }
+		void reserve(size_t n) { nodes.reserve(n); }
+
+		void push(const T& n) { nodes.push_back(n); sift_up(nodes.size() - 1); }
+		void push(T&& n) { nodes.push_back(std::move(n)); sift_up(nodes.size() - 1); }
+
+		template<typename... Args> void emplace(Args&&... args) {
+			nodes.emplace_back(std::forward<Args>(args)...);
+			sift_up(nodes.size() - 1);
+		}
+
+		void pop() {
+			assert(!empty());
+
+			if (nodes.size() > 1) {
+				T last = std::move(nodes.back());
+				nodes.pop_back();
+				sift_down(0, std::move(last));
+			} else {
+				nodes.pop_back();
+			}
+		}
+
+	private:
+		// true if <a> has to be closer to the root than <b>
+		bool before(const T& a, const T& b) const { return cmp(b, a); }
+
+		void sift_up(size_t idx) {
+			T n = std::move(nodes[idx]);
+
+			while (idx > 0) {
+				const size_t p_idx = (idx - 1) / D;
+
+				if (!before(n, nodes[p_idx]))
+					break;
+
+				nodes[idx] = std::move(nodes[p_idx]);
+				idx = p_idx;
+			}
+
+			nodes[idx] = std::move(n);
+		}
+
+		void sift_down(size_t idx, T&& n) {
+			const size_t num = nodes.size();
+
+			while (true) {
+				const size_t c_beg = idx * D + 1;
+
+				if (c_beg >= num)
+					break;
+
+				const size_t c_end = std::min(c_beg + D, num);
+				size_t c_idx = c_beg;
+
+				for (size_t i = c_beg + 1; i < c_end; ++i) {
+					if (before(nodes[i], nodes[c_idx]))
+						c_idx = i;
+				}
+
+				if (!before(nodes[c_idx], n))
+					break;
+
+				nodes[idx] = std::move(nodes[c_idx]);
+				idx = c_idx;
+			}
+
+			nodes[idx] = std::move(n);
+		}
+
+	private:
+		std::vector<T> nodes;
+		TCmp cmp;
+	};
 }
 
 #endif
-
@@ -11,6 +11,7 @@
 #include <cinttypes>
 
 #include "System/Rectangle.h"
+#include "AbstractGraph.h"
 #include "Node.h"
 #include "PathDefines.h"
 #include "PathThreads.h"
@@ -24,8 +25,10 @@ struct MoveDef;
 
 namespace QTPFS {
 	struct INode;
+	class NodeLayerCache;
 
 	struct NodeLayer {
+		friend NodeLayerCache;
 	public:
 		static void InitStatic();
 		static size_t MaxSpeedModTypeValue() { return (std::numeric_limits<SpeedModType>::max()); }
@@ -141,6 +144,7 @@ namespace QTPFS {
 			}
 
 			memFootPrint += (nodeIndcs.size() * sizeof(decltype(nodeIndcs)::value_type));
+			memFootPrint += abstractGraph.GetMemFootPrint();
 			return memFootPrint;
 		}
 
@@ -155,6 +159,10 @@ namespace QTPFS {
 			return numRootNodes;
 		}
 
+		int GetRootNodeSize() const { return rootNodeSize; }
+		int GetXRootNodes() const { return xRootNodes; }
+		int GetZRootNodes() const { return zRootNodes; }
+
 		int GetNodelayer() const {
 			return layerNumber;
 		}
@@ -165,6 +173,9 @@ namespace QTPFS {
 
 		bool UseShortestPath() { return useShortestPath; }
 
+		const AbstractGraph& GetAbstractGraph() const { return abstractGraph; }
+		      AbstractGraph& GetAbstractGraph()       { return abstractGraph; }
+
 	private:
 		std::vector<QTNode> poolNodes[16];
 		std::vector<unsigned int> nodeIndcs;
@@ -175,6 +186,8 @@ namespace QTPFS {
 		std::vector<SpeedModType> curSpeedMods;
 		std::vector<SpeedBinType> curSpeedBins;
 
+		AbstractGraph abstractGraph;
+
 public:
 		static constexpr unsigned int NUM_POOL_CHUNKS = sizeof(poolNodes) / sizeof(poolNodes[0]);
 		static constexpr unsigned int POOL_TOTAL_SIZE = (1024 * 1024) / 2;
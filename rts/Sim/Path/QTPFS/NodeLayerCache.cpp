@@ -0,0 +1,370 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include "NodeLayerCache.h"
+#include "NodeLayer.h"
+#include "Node.h"
+
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/FileSystem.h"
+#include "System/Log/ILog.h"
+#include "System/SpringHash.h"
+#include "System/StringUtil.h"
+
+#include "System/Misc/TracyDefs.h"
+
+namespace QTPFS {
+	static constexpr char CACHE_MAGIC[8] = {'Q', 'T', 'P', 'F', 'S', 'N', 'L', 'C'};
+	static constexpr uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+	struct CacheFileHeader {
+		char magic[8];
+		uint64_t fileSize;
+
+		uint32_t version;
+		uint32_t byteOrder;
+
+		NodeLayerCache::Key key;
+
+		uint32_t maxDepth;
+		uint32_t payloadChecksum;
+	};
+
+	struct CacheLayerHeader {
+		// byte offsets from the start of the file
+		uint64_t nodesOffset;
+		uint64_t neighboursOffset;
+		uint64_t freeIndcsOffset;
+
+		uint32_t numNodes; // NodeLayer::maxNodesAlloced
+		uint32_t numNeighbours;
+
+		// the free-list starts out as [POOL_TOTAL_SIZE - 1, ..., 0] and is
+		// popped from the back, so only its tail needs to be stored
+		uint32_t numUntouchedFreeIndcs;
+		uint32_t numStoredFreeIndcs;
+
+		uint32_t numLeafNodes;
+		uint32_t numOpenNodes;
+		uint32_t numClosedNodes;
+		uint32_t numRootNodes;
+		uint32_t rootMask;
+		uint32_t padding;
+	};
+
+	struct CacheNode {
+		uint32_t nodeNumber;
+		uint32_t index;
+		uint16_t points[4];
+		float moveCostAvg;
+		uint32_t childBaseIndex;
+
+		uint32_t neighboursBeg;
+		uint32_t numNeighbours;
+	};
+
+	typedef INode::NeighbourPoints CacheNeighbour;
+
+	static_assert(std::is_trivially_copyable_v<CacheNeighbour>);
+	static_assert((sizeof(CacheFileHeader) % sizeof(uint64_t)) == 0);
+	static_assert((sizeof(CacheLayerHeader) % sizeof(uint64_t)) == 0);
+	static_assert(sizeof(NodeLayerCache::Key) == (10 * sizeof(uint32_t)));
+
+	static constexpr uint64_t AlignedSize(uint64_t size) { return ((size + 7) & ~uint64_t(7)); }
+
+	static const std::string GetPathCacheDir() {
+		return (FileSystem::GetCacheDir() + FileSystemAbstraction::GetNativePathSeparator() + "paths" + FileSystemAbstraction::GetNativePathSeparator());
+	}
+
+	static uint32_t CalcPayloadChecksum(const uint8_t* image, uint64_t fileSize) {
+		return (spring::LiteHash(image + sizeof(CacheFileHeader), fileSize - sizeof(CacheFileHeader), CACHE_BYTE_ORDER));
+	}
+}
+
+
+bool QTPFS::NodeLayerCache::Key::operator == (const Key& k) const {
+	return (std::memcmp(this, &k, sizeof(Key)) == 0);
+}
+
+uint32_t QTPFS::NodeLayerCache::Key::GetHash() const {
+	return (spring::LiteHash(this, sizeof(Key), CACHE_VERSION));
+}
+
+
+std::string QTPFS::NodeLayerCache::GetFileName(const std::string& mapName, const Key& key) {
+	return (GetPathCacheDir() + mapName + ".qtpfs-" + IntToString(key.GetHash(), "%x") + ".bin");
+}
+
+
+bool QTPFS::NodeLayerCache::Write(const std::string& fileName, const Key& key, const std::vector<NodeLayer>& nodeLayers) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	assert(key.numLayers == nodeLayers.size());
+
+	std::vector<CacheLayerHeader> layerHeaders(nodeLayers.size());
+
+	uint64_t fileSize = sizeof(CacheFileHeader) + AlignedSize(layerHeaders.size() * sizeof(CacheLayerHeader));
+
+	// first pass: sizes and offsets
+	for (size_t layerNum = 0; layerNum < nodeLayers.size(); layerNum++) {
+		const NodeLayer& nl = nodeLayers[layerNum];
+		CacheLayerHeader& lh = layerHeaders[layerNum];
+
+		std::memset(&lh, 0, sizeof(lh));
+
+		lh.numNodes = nl.maxNodesAlloced;
+
+		for (uint32_t i = 0; i < lh.numNodes; i++) {
+			lh.numNeighbours += nl.GetPoolNode(i)->neighbours.size();
+		}
+
+		while (lh.numUntouchedFreeIndcs < nl.nodeIndcs.size() && nl.nodeIndcs[lh.numUntouchedFreeIndcs] == (NodeLayer::POOL_TOTAL_SIZE - 1 - lh.numUntouchedFreeIndcs))
+			lh.numUntouchedFreeIndcs++;
+
+		lh.numStoredFreeIndcs = nl.nodeIndcs.size() - lh.numUntouchedFreeIndcs;
+
+		lh.numLeafNodes = nl.numLeafNodes;
+		lh.numOpenNodes = nl.numOpenNodes;
+		lh.numClosedNodes = nl.numClosedNodes;
+		lh.numRootNodes = nl.numRootNodes;
+		lh.rootMask = nl.rootMask;
+
+		lh.nodesOffset = fileSize; fileSize += AlignedSize(lh.numNodes * sizeof(CacheNode));
+		lh.neighboursOffset = fileSize; fileSize += AlignedSize(lh.numNeighbours * sizeof(CacheNeighbour));
+		lh.freeIndcsOffset = fileSize; fileSize += AlignedSize(lh.numStoredFreeIndcs * sizeof(uint32_t));
+	}
+
+	std::vector<uint64_t> buffer(fileSize / sizeof(uint64_t), 0);
+	uint8_t* image = reinterpret_cast<uint8_t*>(buffer.data());
+
+	std::memcpy(image + sizeof(CacheFileHeader), layerHeaders.data(), layerHeaders.size() * sizeof(CacheLayerHeader));
+
+	// second pass: contents
+	for (size_t layerNum = 0; layerNum < nodeLayers.size(); layerNum++) {
+		const NodeLayer& nl = nodeLayers[layerNum];
+		const CacheLayerHeader& lh = layerHeaders[layerNum];
+
+		CacheNode* nodes = reinterpret_cast<CacheNode*>(image + lh.nodesOffset);
+		CacheNeighbour* neighbours = reinterpret_cast<CacheNeighbour*>(image + lh.neighboursOffset);
+
+		uint32_t neighboursBeg = 0;
+
+		for (uint32_t i = 0; i < lh.numNodes; i++) {
+			const INode* n = nl.GetPoolNode(i);
+			CacheNode& cn = nodes[i];
+
+			cn.nodeNumber = n->nodeNumber;
+			cn.index = n->index;
+			cn.moveCostAvg = n->moveCostAvg;
+			cn.childBaseIndex = n->childBaseIndex;
+
+			std::copy(n->points.begin(), n->points.end(), &cn.points[0]);
+
+			cn.neighboursBeg = neighboursBeg;
+			cn.numNeighbours = n->neighbours.size();
+
+			std::memcpy(neighbours + neighboursBeg, n->neighbours.data(), cn.numNeighbours * sizeof(CacheNeighbour));
+			neighboursBeg += cn.numNeighbours;
+		}
+
+		std::memcpy(image + lh.freeIndcsOffset, nl.nodeIndcs.data() + lh.numUntouchedFreeIndcs, lh.numStoredFreeIndcs * sizeof(uint32_t));
+	}
+
+	{
+		CacheFileHeader fh;
+		std::memset(&fh, 0, sizeof(fh));
+		std::memcpy(fh.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+
+		fh.fileSize = fileSize;
+		fh.version = CACHE_VERSION;
+		fh.byteOrder = CACHE_BYTE_ORDER;
+		fh.key = key;
+		fh.maxDepth = QTNode::MAX_DEPTH;
+		fh.payloadChecksum = CalcPayloadChecksum(image, fileSize);
+
+		std::memcpy(image, &fh, sizeof(fh));
+	}
+
+	const std::string filePath = dataDirsAccess.LocateFile(fileName, FileQueryFlags::WRITE | FileQueryFlags::CREATE_DIRS);
+	// written in full before it replaces the cache, so a crash or another
+	// instance loading the same map never sees a partial image
+	const std::string tempPath = filePath + ".tmp";
+
+	{
+		std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+
+		ofs.write(reinterpret_cast<const char*>(image), fileSize);
+		ofs.close();
+
+		if (!ofs.good()) {
+			FileSystemAbstraction::DeleteFile(tempPath);
+			return false;
+		}
+	}
+
+	if (!FileSystemAbstraction::RenameFile(tempPath, filePath)) {
+		FileSystemAbstraction::DeleteFile(tempPath);
+		return false;
+	}
+
+	LOG("[QTPFS::NodeLayerCache::%s] wrote \"%s\" (%" PRIu64 " bytes)", __func__, fileName.c_str(), fileSize);
+	return true;
+}
+
+
+bool QTPFS::NodeLayerCache::Read(const std::string& fileName, const Key& key) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	image.clear();
+
+	std::ifstream ifs(dataDirsAccess.LocateFile(fileName), std::ios::binary | std::ios::ate);
+
+	if (!ifs.is_open())
+		return false;
+
+	const uint64_t fileSize = ifs.tellg();
+
+	if (fileSize < sizeof(CacheFileHeader) || (fileSize % sizeof(uint64_t)) != 0) {
+		LOG_L(L_WARNING, "[QTPFS::NodeLayerCache::%s] \"%s\" has bad size %" PRIu64 ", rebuilding", __func__, fileName.c_str(), fileSize);
+		return false;
+	}
+
+	image.resize(fileSize / sizeof(uint64_t));
+	ifs.seekg(0);
+
+	if (!ifs.read(reinterpret_cast<char*>(image.data()), fileSize) || !Validate(key)) {
+		LOG_L(L_WARNING, "[QTPFS::NodeLayerCache::%s] \"%s\" is stale or damaged, rebuilding", __func__, fileName.c_str());
+		image.clear();
+		return false;
+	}
+
+	LOG("[QTPFS::NodeLayerCache::%s] read \"%s\" (%" PRIu64 " bytes)", __func__, fileName.c_str(), fileSize);
+	return true;
+}
+
+bool QTPFS::NodeLayerCache::Validate(const Key& key) const {
+	RECOIL_DETAILED_TRACY_ZONE;
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(image.data());
+	const uint64_t fileSize = image.size() * sizeof(uint64_t);
+
+	CacheFileHeader fh;
+	std::memcpy(&fh, bytes, sizeof(fh));
+
+	if (std::memcmp(fh.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0)
+		return false;
+	if (fh.version != CACHE_VERSION || fh.byteOrder != CACHE_BYTE_ORDER)
+		return false;
+	if (fh.fileSize != fileSize || fh.key != key)
+		return false;
+	if (fh.maxDepth != QTNode::MAX_DEPTH)
+		return false;
+
+	const uint64_t tableSize = AlignedSize(key.numLayers * sizeof(CacheLayerHeader));
+
+	if ((sizeof(CacheFileHeader) + tableSize) > fileSize)
+		return false;
+	if (fh.payloadChecksum != CalcPayloadChecksum(bytes, fileSize))
+		return false;
+
+	const auto InsideFile = [&](uint64_t offset, uint64_t size) {
+		return ((offset % sizeof(uint64_t)) == 0 && offset <= fileSize && size <= (fileSize - offset));
+	};
+
+	// the checksum guards against damage, these against writer bugs that
+	// would otherwise turn into out-of-bounds accesses in ApplyLayer
+	for (uint32_t layerNum = 0; layerNum < key.numLayers; layerNum++) {
+		const CacheLayerHeader* lh = reinterpret_cast<const CacheLayerHeader*>(bytes + sizeof(CacheFileHeader)) + layerNum;
+
+		if (lh->numNodes < lh->numRootNodes || lh->numNodes > NodeLayer::POOL_TOTAL_SIZE)
+			return false;
+		if ((uint64_t(lh->numUntouchedFreeIndcs) + lh->numStoredFreeIndcs) > NodeLayer::POOL_TOTAL_SIZE)
+			return false;
+		if ((lh->numOpenNodes + lh->numClosedNodes) != lh->numLeafNodes)
+			return false;
+
+		if (!InsideFile(lh->nodesOffset, uint64_t(lh->numNodes) * sizeof(CacheNode)))
+			return false;
+		if (!InsideFile(lh->neighboursOffset, uint64_t(lh->numNeighbours) * sizeof(CacheNeighbour)))
+			return false;
+		if (!InsideFile(lh->freeIndcsOffset, uint64_t(lh->numStoredFreeIndcs) * sizeof(uint32_t)))
+			return false;
+
+		const CacheNode* nodes = reinterpret_cast<const CacheNode*>(bytes + lh->nodesOffset);
+		const CacheNeighbour* neighbours = reinterpret_cast<const CacheNeighbour*>(bytes + lh->neighboursOffset);
+		const uint32_t* freeIndcs = reinterpret_cast<const uint32_t*>(bytes + lh->freeIndcsOffset);
+
+		for (uint32_t i = 0; i < lh->numNodes; i++) {
+			const CacheNode& cn = nodes[i];
+
+			if (cn.childBaseIndex != -1u && (uint64_t(cn.childBaseIndex) + QTNODE_CHILD_COUNT) > lh->numNodes)
+				return false;
+			if ((uint64_t(cn.neighboursBeg) + cn.numNeighbours) > lh->numNeighbours)
+				return false;
+		}
+		for (uint32_t i = 0; i < lh->numNeighbours; i++) {
+			if (uint32_t(neighbours[i].nodeId) >= lh->numNodes)
+				return false;
+		}
+		for (uint32_t i = 0; i < lh->numStoredFreeIndcs; i++) {
+			if (freeIndcs[i] >= NodeLayer::POOL_TOTAL_SIZE)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void QTPFS::NodeLayerCache::ApplyLayer(unsigned int layerNum, NodeLayer& nl) const {
+	RECOIL_DETAILED_TRACY_ZONE;
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(image.data());
+
+	const CacheFileHeader* fh = reinterpret_cast<const CacheFileHeader*>(bytes);
+	const CacheLayerHeader* lh = reinterpret_cast<const CacheLayerHeader*>(bytes + sizeof(CacheFileHeader)) + layerNum;
+
+	assert(!image.empty());
+	assert(layerNum < fh->key.numLayers);
+
+	// the root layout follows from map dimensions and root size, both in the key
+	assert(fh->maxDepth == QTNode::MAX_DEPTH);
+	assert(lh->numRootNodes == uint32_t(nl.numRootNodes));
+	assert(lh->rootMask == nl.rootMask);
+
+	const CacheNode* nodes = reinterpret_cast<const CacheNode*>(bytes + lh->nodesOffset);
+	const CacheNeighbour* neighbours = reinterpret_cast<const CacheNeighbour*>(bytes + lh->neighboursOffset);
+	const uint32_t* freeIndcs = reinterpret_cast<const uint32_t*>(bytes + lh->freeIndcsOffset);
+
+	for (uint32_t i = 0; i < lh->numNodes; i += NodeLayer::POOL_CHUNK_SIZE) {
+		if (nl.poolNodes[i / NodeLayer::POOL_CHUNK_SIZE].empty())
+			nl.poolNodes[i / NodeLayer::POOL_CHUNK_SIZE].resize(NodeLayer::POOL_CHUNK_SIZE);
+	}
+
+	for (uint32_t i = 0; i < lh->numNodes; i++) {
+		const CacheNode& cn = nodes[i];
+		INode* n = nl.GetPoolNode(i);
+
+		n->nodeNumber = cn.nodeNumber;
+		n->index = cn.index;
+		n->moveCostAvg = cn.moveCostAvg;
+		n->childBaseIndex = cn.childBaseIndex;
+
+		std::copy(&cn.points[0], &cn.points[0] + 4, n->points.begin());
+
+		n->neighbours.assign(neighbours + cn.neighboursBeg, neighbours + cn.neighboursBeg + cn.numNeighbours);
+	}
+
+	nl.nodeIndcs.resize(lh->numUntouchedFreeIndcs);
+
+	for (uint32_t i = 0; i < lh->numUntouchedFreeIndcs; i++) {
+		nl.nodeIndcs[i] = NodeLayer::POOL_TOTAL_SIZE - 1 - i;
+	}
+
+	nl.nodeIndcs.insert(nl.nodeIndcs.end(), freeIndcs, freeIndcs + lh->numStoredFreeIndcs);
+
+	nl.numLeafNodes = lh->numLeafNodes;
+	nl.numOpenNodes = lh->numOpenNodes;
+	nl.numClosedNodes = lh->numClosedNodes;
+	nl.maxNodesAlloced = lh->numNodes;
+}
@@ -0,0 +1,70 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef QTPFS_NODELAYERCACHE_HDR
+#define QTPFS_NODELAYERCACHE_HDR
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+namespace QTPFS {
+	struct NodeLayer;
+
+	/**
+	 * On-disk image of the node-layers as tesselated by PathManager::Load,
+	 * so that later loads with identical inputs can skip the tesselation.
+	 *
+	 * The file is a flat binary image: a fixed-size header, one table entry
+	 * per layer and then the per-layer arrays at 8-byte aligned offsets, so
+	 * it can be read in one go or mapped. Read rejects the file (and the
+	 * caller rebuilds the layers) unless version, byte order, key, sizes and
+	 * payload checksum all match; nothing is applied before that succeeds.
+	 * Write goes through a temporary file, so an existing image is replaced
+	 * only by a complete one.
+	 */
+	class NodeLayerCache {
+	public:
+		static constexpr uint32_t CACHE_VERSION = 1;
+
+		// everything the initial tesselation depends on
+		struct Key {
+			bool operator == (const Key& k) const;
+			bool operator != (const Key& k) const { return !(*this == k); }
+
+			uint32_t GetHash() const;
+
+			uint32_t heightMapChecksum = 0;
+			uint32_t typeMapChecksum = 0;
+			uint32_t moveDefChecksum = 0;
+			uint32_t blockMapChecksum = 0;
+			uint32_t modChecksum = 0;
+			uint32_t constantsChecksum = 0;
+
+			uint32_t mapx = 0;
+			uint32_t mapy = 0;
+			uint32_t rootSize = 0;
+			uint32_t numLayers = 0;
+		};
+
+		static std::string GetFileName(const std::string& mapName, const Key& key);
+
+		static bool Write(const std::string& fileName, const Key& key, const std::vector<NodeLayer>& nodeLayers);
+
+		bool Read(const std::string& fileName, const Key& key);
+
+		/// layer must have been set up by PathManager::InitNodeLayer; only valid after Read succeeded
+		void ApplyLayer(unsigned int layerNum, NodeLayer& nodeLayer) const;
+
+		void Clear() { image.clear(); }
+
+	private:
+		bool Validate(const Key& key) const;
+
+	private:
+		// uint64_t elements keep the per-layer arrays aligned
+		std::vector<uint64_t> image;
+	};
+}
+
+#endif
+
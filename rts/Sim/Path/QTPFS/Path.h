@@ -110,6 +110,7 @@ namespace QTPFS {
 
 			owner = other.owner;
 			searchTime = other.searchTime;
+			numNodesSearched = other.numNodesSearched;
 			return *this;
 		}
 		IPath(IPath&& other) { *this = std::move(other); }
@@ -142,6 +143,7 @@ namespace QTPFS {
 
 			owner = other.owner;
 			searchTime = other.searchTime;
+			numNodesSearched = other.numNodesSearched;
 
 			return *this;
 		}
@@ -318,6 +320,9 @@ namespace QTPFS {
 
 		spring_time GetSearchTime() const { return searchTime; }
 
+		void SetNumNodesSearched(unsigned int n) { numNodesSearched = n; }
+		unsigned int GetNumNodesSearched() const { return numNodesSearched; }
+
 		// Incomplete paths need to be rebuilt from time to time as the owner makes progress.
 		unsigned int GetRepathTriggerIndex() const { return repathAtPointIndex; }
 		void SetRepathTriggerIndex(unsigned int index) { repathAtPointIndex = index; }
@@ -384,6 +389,7 @@ namespace QTPFS {
 		const CSolidObject* owner = nullptr;
 
 		spring_time searchTime;
+		unsigned int numNodesSearched = 0;
 	};
 }
 
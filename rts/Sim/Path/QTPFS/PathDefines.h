@@ -10,6 +10,8 @@
 #define QTPFS_SMOOTH_PATHS
 // #define QTPFS_CONSERVATIVE_NODE_SPLITS
 // #define QTPFS_DEBUG_NODE_HEAP
+// comment out to fall back to std::priority_queue for the search open-lists
+#define QTPFS_DARY_HEAP_OPEN_LIST
 
 #define QTPFS_CORNER_CONNECTED_NODES
 
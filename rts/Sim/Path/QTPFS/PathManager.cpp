@@ -21,8 +21,10 @@
 #include "Game/GameSetup.h"
 #include "Game/LoadScreen.h"
 #include "Map/MapInfo.h"
+#include "Map/ReadMap.h"
 
 #include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/GroundBlockingObjectMap.h"
 #include "Sim/Misc/ModInfo.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "Sim/MoveTypes/MoveDefHandler.h"
@@ -34,6 +36,7 @@
 #include "System/Log/ILog.h"
 #include "System/Platform/Threading.h"
 #include "System/Rectangle.h"
+#include "System/SpringHash.h"
 #include "System/TimeProfiler.h"
 #include "System/StringUtil.h"
 
@@ -57,6 +60,7 @@
 #define MAP_RECTANGLE SRectangle(0, 0,  mapDims.mapx, mapDims.mapy)
 
 CONFIG(int, PathingThreadCount).defaultValue(0).safemodeValue(1).minimumValue(0);
+CONFIG(bool, PathingNodeLayerCache).defaultValue(true).safemodeValue(false).description("Store the initial QTPFS node-layers in the cache directory and reuse them while map, movedefs and blocking objects stay unchanged; stale files are detected and rebuilt.");
 
 namespace QTPFS {
 	struct PMLoadScreen {
@@ -127,6 +131,50 @@ namespace QTPFS {
 		return ((numThreads == 0)? numCores: numThreads);
 	}
 
+	static NodeLayerCache::Key CalcNodeLayerCacheKey(unsigned int rootSize, unsigned int numLayers) {
+		RECOIL_DETAILED_TRACY_ZONE;
+		NodeLayerCache::Key key;
+
+		// HAPFS keys its cache on the same terrain inputs; the blocking-map and
+		// game checksums are needed here since the initial tree also includes
+		// the structures (features, Lua-spawned objects) present at load
+		key.heightMapChecksum = readMap->CalcHeightmapChecksum();
+		key.typeMapChecksum = readMap->CalcTypemapChecksum();
+		key.moveDefChecksum = moveDefHandler.GetCheckSum();
+		key.blockMapChecksum = groundBlockingObjectMap.CalcChecksum();
+
+		{
+			const sha512::raw_digest modCheckSum = archiveScanner->GetArchiveCompleteChecksumBytes(gameSetup->modName);
+			key.modChecksum = spring::LiteHash(modCheckSum.data(), modCheckSum.size(), 0);
+		}
+		{
+			const auto& qtc = mapInfo->pfs.qtpfs_constants;
+
+			uint32_t checksum = 0;
+			checksum = spring::LiteHash(qtc.minNodeSizeX, checksum);
+			checksum = spring::LiteHash(qtc.minNodeSizeZ, checksum);
+			checksum = spring::LiteHash(qtc.maxNodeDepth, checksum);
+			checksum = spring::LiteHash(NodeLayer::NUM_SPEEDMOD_BINS, checksum);
+			checksum = spring::LiteHash(NodeLayer::MIN_SPEEDMOD_VALUE, checksum);
+			checksum = spring::LiteHash(NodeLayer::MAX_SPEEDMOD_VALUE, checksum);
+			checksum = spring::LiteHash(NodeLayer::POOL_TOTAL_SIZE, checksum);
+			checksum = spring::LiteHash(QTPFS_MAX_NODE_SIZE, checksum);
+			checksum = spring::LiteHash(QTPFS_MAX_NETPOINTS_PER_NODE_EDGE, checksum);
+
+			key.constantsChecksum = checksum;
+		}
+
+		key.mapx = mapDims.mapx;
+		key.mapy = mapDims.mapy;
+		key.rootSize = rootSize;
+		key.numLayers = numLayers;
+
+		LOG("[QTPFS::PathManager::%s] heightMapChecksum=%x typeMapChecksum=%x moveDefChecksum=%x blockMapChecksum=%x", __func__, key.heightMapChecksum, key.typeMapChecksum, key.moveDefChecksum, key.blockMapChecksum);
+		LOG("[QTPFS::PathManager::%s] modChecksum=%x constantsChecksum=%x hash=%x", __func__, key.modChecksum, key.constantsChecksum, key.GetHash());
+
+		return key;
+	}
+
 	unsigned int PathManager::LAYERS_PER_UPDATE;
 	unsigned int PathManager::MAX_TEAM_SEARCHES;
 }
@@ -322,7 +370,26 @@ void QTPFS::PathManager::Load() {
 		sha512::dump_digest(mapCheckSum, mapCheckSumHex);
 		sha512::dump_digest(modCheckSum, modCheckSumHex);
 
-		InitNodeLayersThreaded(MAP_RECTANGLE);
+		{
+			const bool useCache = configHandler->GetBool("PathingNodeLayerCache");
+			const NodeLayerCache::Key cacheKey = CalcNodeLayerCacheKey(rootSize, nodeLayers.size());
+			const std::string cacheFileName = NodeLayerCache::GetFileName(mapInfo->map.name, cacheKey);
+
+			NodeLayerCache cache;
+
+			if (useCache && cache.Read(cacheFileName, cacheKey)) {
+				InitNodeLayersFromCache(cache, MAP_RECTANGLE);
+			} else {
+				InitNodeLayersThreaded(MAP_RECTANGLE);
+
+				if (useCache && !NodeLayerCache::Write(cacheFileName, cacheKey, nodeLayers))
+					LOG_L(L_WARNING, "[QTPFS] failed to write node-layer cache \"%s\"", cacheFileName.c_str());
+			}
+		}
+
+		if (modInfo.qtAbstractGraphMinDist > 0.0f)
+			InitAbstractGraphs();
+
 		PathSpeedModInfoSystem::Init();
 		RemoveDeadPathsSystem::Init();
 		RequeuePathsSystem::Init();
@@ -467,6 +534,35 @@ void QTPFS::PathManager::InitNodeLayersThreaded(const SRectangle& rect) {
 	streflop::streflop_init<streflop::Simple>();
 }
 
+void QTPFS::PathManager::InitNodeLayersFromCache(const NodeLayerCache& cache, const SRectangle& rect) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	char loadMsg[512] = {'\0'};
+	const char* fmtString = "[PathManager::%s] reading %u cached node-layers";
+	snprintf(loadMsg, sizeof(loadMsg), fmtString, __func__, nodeLayers.size());
+	pmLoadScreen.AddMessage(loadMsg);
+
+	// same end state as InitNodeLayersThreaded, so pfsCheckSum is unaffected
+	for_mt(0, nodeLayers.size(), [this, &cache, &rect](const int layerNum){
+		InitNodeLayer(layerNum, rect);
+		cache.ApplyLayer(layerNum, nodeLayers[layerNum]);
+
+		pathCache.SetLayerPathCount(layerNum, INITIAL_PATH_RESERVE);
+	});
+}
+
+void QTPFS::PathManager::InitAbstractGraphs() {
+	RECOIL_DETAILED_TRACY_ZONE;
+	char loadMsg[512] = {'\0'};
+	const char* fmtString = "[PathManager::%s] building abstract graphs for %u node-layers";
+	snprintf(loadMsg, sizeof(loadMsg), fmtString, __func__, nodeLayers.size());
+	pmLoadScreen.AddMessage(loadMsg);
+
+	for_mt(0, nodeLayers.size(), [this](const int layerNum){
+		NodeLayer& nodeLayer = nodeLayers[layerNum];
+		nodeLayer.GetAbstractGraph().Build(nodeLayer);
+	});
+}
+
 void QTPFS::PathManager::InitRootSize(const SRectangle& r) {
 	RECOIL_DETAILED_TRACY_ZONE;
 	// setup the root node system
@@ -638,6 +734,9 @@ void QTPFS::PathManager::UpdateNodeLayer(unsigned int layerNum, const SRectangle
 		#ifndef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
 		nodeLayers[layerNum].ExecNodeNeighborCacheUpdates(ur, updateThreadData[currentThread]);
 		#endif
+
+		// relinking reaches one square beyond the retesselated area
+		nodeLayer.GetAbstractGraph().MarkDirty(SRectangle(ur.x1 - 1, ur.z1 - 1, ur.x2 + 1, ur.z2 + 1));
 	}
 }
 
@@ -718,6 +817,9 @@ void QTPFS::PathManager::Update() {
 			int layerNum = nodeLayerUpdatePriorityOrder[index];
 			int blocksToUpdate = numBlocksToUpdate(layerNum);
 			for (int i = 0; i < blocksToUpdate; ++i) { UpdateNodeLayer(layerNum, rect, curThread); }
+
+			// once per frame, blocks updated in the same frame often share clusters
+			nodeLayers[layerNum].GetAbstractGraph().Repair(nodeLayers[layerNum]);
 		});
 
 		// Mark all dirty paths so that they can be recalculated
@@ -875,28 +977,75 @@ void QTPFS::PathManager::ReadyQueuedSearches() {
 	}
 }
 
+void QTPFS::PathManager::GetSharedSearches(entt::entity pathSearchEntity, std::vector<entt::entity>& headSearches) const {
+	const PathSearch* search = &registry.get<PathSearch>(pathSearchEntity);
+	entt::entity pathEntity = (entt::entity)search->GetID();
+	const IPath* path = registry.try_get<IPath>(pathEntity);
+
+	if (path == nullptr || !path->IsSynced())
+		return;
+
+	// a chain head that still has a search attached is being searched in this or a later update
+	const auto addPendingHead = [&](entt::entity headEntity) {
+		if (headEntity == pathEntity)
+			return;
+		if (const PathSearchRef* headSearch = registry.try_get<PathSearchRef>(headEntity); headSearch != nullptr)
+			headSearches.push_back(headSearch->value);
+	};
+
+	if (search->allowPartialSearch) {
+		PartialSharedPathMap::const_iterator partialSharedPathsIt = partialSharedPaths.find(path->GetVirtualHash());
+		if (partialSharedPathsIt != partialSharedPaths.end())
+			addPendingHead(partialSharedPathsIt->second);
+	}
+
+	SharedPathMap::const_iterator sharedPathsIt = sharedPaths.find(path->GetHash());
+	if (sharedPathsIt != sharedPaths.end())
+		addPendingHead(sharedPathsIt->second);
+}
+
+void QTPFS::PathManager::SortQueuedSearchesIntoWaves() {
+	RECOIL_DETAILED_TRACY_ZONE;
+	auto pathView = registry.group<PathSearch, ProcessPath>();
+
+	// A group order typically queues many searches with the same start and goal areas. Their paths
+	// are chained by hash in InitializeSearch; the head of each chain is searched first and the
+	// others copy or extend its path in a later wave, instead of waiting for the next update.
+	searchWaves.Sort(pathView, [this](entt::entity pathSearchEntity, std::vector<entt::entity>& headSearches) {
+		GetSharedSearches(pathSearchEntity, headSearches);
+	});
+}
+
 void QTPFS::PathManager::ExecuteQueuedSearches() {
 	ZoneScoped;
 
 	ReadyQueuedSearches();
-
-	auto pathView = registry.group<PathSearch, ProcessPath>();
+	SortQueuedSearchesIntoWaves();
 
 	// execute pending searches collected via
 	// RequestPath and QueueDeadPathSearches
-	for_mt(0, pathView.size(), [this, &pathView](int i){
-		entt::entity pathSearchEntity = pathView.begin()[i];
-        // entt::entity pathSearchEntity = pathView.storage<PathSearch>()[i];
+	for (const auto& wave: searchWaves) {
+		for_mt(0, wave.size(), [this, &wave](int i){
+			entt::entity pathSearchEntity = wave[i];
 
-		assert(registry.valid(pathSearchEntity));
-		assert(registry.all_of<PathSearch>(pathSearchEntity));
+			assert(registry.valid(pathSearchEntity));
+			assert(registry.all_of<PathSearch>(pathSearchEntity));
 
-		PathSearch* search = &pathView.get<PathSearch>(pathSearchEntity);
-		int pathType = search->GetPathType();
-		NodeLayer& nodeLayer = nodeLayers[pathType];
-		ExecuteSearch(search, nodeLayer, pathType);
-	});
+			PathSearch* search = &registry.get<PathSearch>(pathSearchEntity);
+			int pathType = search->GetPathType();
+			NodeLayer& nodeLayer = nodeLayers[pathType];
+			ExecuteSearch(search, nodeLayer, pathType);
+		});
 
+		// completion releases the PathSearchRef's the next wave's searches are waiting on
+		for (auto pathSearchEntity: wave) {
+			CompleteQueuedSearch(pathSearchEntity);
+		}
+	}
+}
+
+void QTPFS::PathManager::CompleteQueuedSearch(entt::entity pathSearchEntity) {
+	RECOIL_DETAILED_TRACY_ZONE;
 	auto completePath = [this](entt::entity pathEntity, IPath* path){
 		// inform the movement system that the path has been changed.
 		if (registry.all_of<PathUpdatedCounterIncrease>(pathEntity)) {
@@ -915,54 +1064,51 @@ void QTPFS::PathManager::ExecuteQueuedSearches() {
 		}
 	};
 
-	// TODO: make a function?
-	for (auto pathSearchEntity : pathView) {
-		assert(registry.valid(pathSearchEntity));
-		assert(registry.all_of<PathSearch>(pathSearchEntity));
-
-		PathSearch* search = &pathView.get<PathSearch>(pathSearchEntity);
-		entt::entity pathEntity = (entt::entity)search->GetID();
-		if (registry.valid(pathEntity)) {
-			IPath* path = registry.try_get<IPath>(pathEntity);
-			if (path != nullptr) {
-				if (search->PathWasFound()) {
+	assert(registry.valid(pathSearchEntity));
+	assert(registry.all_of<PathSearch>(pathSearchEntity));
+
+	PathSearch* search = &registry.get<PathSearch>(pathSearchEntity);
+	entt::entity pathEntity = (entt::entity)search->GetID();
+	if (registry.valid(pathEntity)) {
+		IPath* path = registry.try_get<IPath>(pathEntity);
+		if (path != nullptr) {
+			if (search->PathWasFound()) {
+				completePath(pathEntity, path);
+				// LOG("%s: %x - path found", __func__, entt::to_integral(pathEntity));
+			} else {
+				if (search->rawPathCheck) {
+					registry.remove<PathSearchRef>(pathEntity);
+					registry.remove<PathIsDirty>(pathEntity);
+
+					// adding a new search doesn't break the wave loops because new paths do not
+					// have the tag ProcessPath and are not part of any wave.
+					RequeueSearch(path, false, true, search->tryPathRepair);
+					// LOG("%s: %x - raw path check failed", __func__, entt::to_integral(pathEntity));
+				} else if (search->pathRequestWaiting) {
+					// nothing to do - it will be rerun next frame
+					// LOG("%s: %x - waiting for partial root path", __func__, entt::to_integral(pathEntity));
+					// continue;
+					registry.remove<PathSearchRef>(pathEntity);
+					RequeueSearch(path, false, search->allowPartialSearch, false);
+				} else if (search->rejectPartialSearch) {
+					registry.remove<PathSearchRef>(pathEntity);
+					RequeueSearch(path, false, false, false);
+				}
+				else {
+					// LOG("%s: %x - search failed", __func__, entt::to_integral(pathEntity));
+					// Don't invalid the path, now, give the unit the chance to escape from
+					// being stuck inside something.
+					// DeletePathEntity(pathEntity);
+					path->SetBoundingBox();
 					completePath(pathEntity, path);
-					// LOG("%s: %x - path found", __func__, entt::to_integral(pathEntity));
-				} else {
-					if (search->rawPathCheck) {
-						registry.remove<PathSearchRef>(pathEntity);
-						registry.remove<PathIsDirty>(pathEntity);
-
-						// adding a new search doesn't break this loop because new paths do not
-						// have the tag ProcessPath and so don't impact this group view.
-						RequeueSearch(path, false, true, search->tryPathRepair);
-						// LOG("%s: %x - raw path check failed", __func__, entt::to_integral(pathEntity));
-					} else if (search->pathRequestWaiting) {
-						// nothing to do - it will be rerun next frame
-						// LOG("%s: %x - waiting for partial root path", __func__, entt::to_integral(pathEntity));
-						// continue;
-						registry.remove<PathSearchRef>(pathEntity);
-						RequeueSearch(path, false, search->allowPartialSearch, false);
-					} else if (search->rejectPartialSearch) {
-						registry.remove<PathSearchRef>(pathEntity);
-						RequeueSearch(path, false, false, false);
-					}
-					else {
-						// LOG("%s: %x - search failed", __func__, entt::to_integral(pathEntity));
-						// Don't invalid the path, now, give the unit the chance to escape from
-						// being stuck inside something.
-						// DeletePathEntity(pathEntity);
-						path->SetBoundingBox();
-						completePath(pathEntity, path);
-					}
 				}
 			}
 		}
-
-		// LOG("%s: delete search %x", __func__, entt::to_integral(pathSearchEntity));
-		if (registry.valid(pathSearchEntity))
-			registry.destroy(pathSearchEntity);
 	}
+
+	// LOG("%s: delete search %x", __func__, entt::to_integral(pathSearchEntity));
+	if (registry.valid(pathSearchEntity))
+		registry.destroy(pathSearchEntity);
 }
 
 // #pragma GCC push_options
@@ -1121,6 +1267,7 @@ bool QTPFS::PathManager::ExecuteSearch(
 	}
 
 	path->SetSearchTime(searchTimer.GetDuration());
+	path->SetNumNodesSearched(search->GetNumNodesSearched());
 
 	return true;
 }
@@ -1671,6 +1818,28 @@ void QTPFS::PathManager::GetPathWayPoints(
 	}
 }
 
+bool QTPFS::PathManager::GetPathSearchStats(
+	unsigned int pathID,
+	unsigned int& numNodesSearched,
+	float& searchTimeMs
+) const {
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (!IsFinalized())
+		return false;
+
+	entt::entity pathEntity = (entt::entity)pathID;
+	if (!registry.valid(pathEntity))
+		return false;
+
+	const IPath* path = registry.try_get<IPath>(pathEntity);
+	if (path == nullptr)
+		return false;
+
+	numNodesSearched = path->GetNumNodesSearched();
+	searchTimeMs = path->GetSearchTime().toMilliSecsf();
+	return true;
+}
+
 int2 QTPFS::PathManager::GetNumQueuedUpdates() const {
 	RECOIL_DETAILED_TRACY_ZONE;
 	int2 data;
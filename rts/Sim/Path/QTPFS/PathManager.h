@@ -8,8 +8,10 @@
 #include "Sim/Misc/ModInfo.h"
 #include "Sim/Path/IPathManager.h"
 #include "NodeLayer.h"
+#include "NodeLayerCache.h"
 #include "PathCache.h"
 #include "PathSearch.h"
+#include "SearchWaves.h"
 #include "System/UnorderedMap.hpp"
 
 struct MoveDef;
@@ -82,6 +84,11 @@ namespace QTPFS {
 			std::vector<float3>& points,
 			std::vector<int>& starts
 		) const override;
+		bool GetPathSearchStats(
+			unsigned int pathID,
+			unsigned int& numNodesSearched,
+			float& searchTimeMs
+		) const override;
 
 		int2 GetNumQueuedUpdates() const override;
 
@@ -117,6 +124,8 @@ namespace QTPFS {
 		typedef std::vector<PathSearch*>::iterator PathSearchVectIt;
 
 		void InitNodeLayersThreaded(const SRectangle& rect);
+		void InitNodeLayersFromCache(const NodeLayerCache& cache, const SRectangle& rect);
+		void InitAbstractGraphs();
 		void InitNodeLayer(unsigned int layerNum, const SRectangle& r);
 		void InitRootSize(const SRectangle& r);
 		void UpdateNodeLayer(unsigned int layerNum, const SRectangle& r, int currentThread);
@@ -127,7 +136,10 @@ namespace QTPFS {
 		void RemovePathSearch(entt::entity pathEntity);
 
 		void ReadyQueuedSearches();
+		void SortQueuedSearchesIntoWaves();
+		void GetSharedSearches(entt::entity pathSearchEntity, std::vector<entt::entity>& headSearches) const;
 		void ExecuteQueuedSearches();
+		void CompleteQueuedSearch(entt::entity pathSearchEntity);
 		void QueueDeadPathSearches();
 
 		unsigned int QueueSearch(
@@ -174,6 +186,10 @@ namespace QTPFS {
 		SharedPathMap sharedPaths;
 		PartialSharedPathMap partialSharedPaths;
 
+		// queued searches of the current update; searches that would copy or extend the
+		// path of another search in the same update are executed after it in a later wave
+		SearchWaves<entt::entity, 3> searchWaves;
+
 		// std::vector<unsigned int> numCurrExecutedSearches;
 		// std::vector<unsigned int> numPrevExecutedSearches;
 
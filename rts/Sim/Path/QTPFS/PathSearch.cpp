@@ -141,6 +141,10 @@ void QTPFS::PathSearch::Initialize(
 
 	fwdNodesSearched = 0;
 	bwdNodesSearched = 0;
+	discardedNodesSearched = 0;
+
+	allowAbstractCorridor = true;
+	useAbstractCorridor = false;
 }
 
 // #pragma GCC push_options
@@ -269,8 +273,7 @@ void QTPFS::PathSearch::InitializeThread(SearchThreadData* threadData) {
 		data.openNodes = &searchThreadData->openNodes[i];
 		data.minSearchNode = data.srcSearchNode;
 
-		while (!data.openNodes->empty())
-			data.openNodes->pop();
+		ClearPriorityQueue(*data.openNodes);
 	}
 
 	// Set search boundaries for path repairs. If a repair cannot be made within the boundaries then the path is better
@@ -546,7 +549,52 @@ bool QTPFS::PathSearch::Execute(unsigned int searchStateOffset) {
 	if (rawPathCheck)
 		return ExecuteRawSearch();
 
-	return ExecutePathSearch();
+	const bool pathFound = ExecutePathSearch();
+
+	// Regions are only approximately connected (links between nodes are directed), so the corridor can turn out to be
+	// a dead end. If the search ran out of nodes to visit, rather than into its limit, try again without the corridor.
+	if (useAbstractCorridor && !haveFullPath && fwdNodesSearched < fwdNodeSearchLimit) {
+		discardedNodesSearched += fwdNodesSearched + bwdNodesSearched;
+		fwdNodesSearched = 0;
+		bwdNodesSearched = 0;
+
+		#ifdef QTPFS_TRACE_PATH_SEARCHES
+		delete searchExec;
+		searchExec = nullptr;
+		#endif
+
+		allowAbstractCorridor = false;
+		InitializeThread(searchThreadData);
+
+		return ExecutePathSearch();
+	}
+
+	return pathFound;
+}
+
+void QTPFS::PathSearch::InitAbstractCorridor() {
+	RECOIL_DETAILED_TRACY_ZONE;
+	const auto& fwd = directionalSearchData[SearchThreadData::SEARCH_FORWARD];
+	const AbstractGraph& abstractGraph = nodeLayer->GetAbstractGraph();
+
+	useAbstractCorridor = false;
+
+	// Repairs are confined to the damaged area already and partial searches have to reach the shared path.
+	if (!allowAbstractCorridor || doPathRepair || doPartialSearch || !abstractGraph.IsBuilt())
+		return;
+
+	if (fwd.srcPoint.distance2D(fwd.tgtPoint) < modInfo.qtAbstractGraphMinDist)
+		return;
+
+	const int srcRegion = abstractGraph.GetNodeRegion(fwd.srcSearchNode->GetIndex());
+	const int tgtRegion = abstractGraph.GetNodeRegion(fwd.tgtSearchNode->GetIndex());
+
+	// a closed start node has no region, the search needs to be free to find its way out
+	if (srcRegion < 0 || tgtRegion < 0)
+		return;
+
+	// if not even the coarse graph connects the two, then leave it to the normal search to find the nearest reachable node
+	useAbstractCorridor = abstractGraph.FindCorridor(srcRegion, tgtRegion, hCostMult, searchThreadData->abstractSearchData);
 }
 
 void QTPFS::PathSearch::InitStartingSearchNodes() {
@@ -693,6 +741,7 @@ bool QTPFS::PathSearch::ExecutePathSearch() {
 	#endif
 
 	UpdateHcostMult();
+	InitAbstractCorridor();
 	InitStartingSearchNodes();
 
 	auto& fwd = directionalSearchData[SearchThreadData::SEARCH_FORWARD];
@@ -1412,6 +1461,9 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const INode* curNode, unsigned int
 	// Allow units to escape if starting in a closed node - a cost of infinity would prevent them escaping.
 	const float curNodeSanitizedCost = curNode->AllSquaresImpassable() ? QTPFS_CLOSED_NODE_COST : curNode->GetMoveCost();
 
+	const AbstractGraph& abstractGraph = nodeLayer->GetAbstractGraph();
+	const AbstractSearchData& abstractSearchData = searchThreadData->abstractSearchData;
+
 	const std::vector<INode::NeighbourPoints>& nxtNodes = curNode->GetNeighbours();
 	for (unsigned int i = 0; i < nxtNodes.size(); i++) {
 		// NOTE:
@@ -1432,6 +1484,10 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const INode* curNode, unsigned int
 		//   nightmare), while in the second we would get low-quality paths (player
 		//   nightmare)
 		int nxtNodesId = nxtNodes[i].nodeId;
+
+		// Long searches are kept to the clusters along the route planned by InitAbstractCorridor.
+		if (useAbstractCorridor && !abstractSearchData.InCorridor(abstractGraph.GetNodeCluster(nxtNodesId)))
+			continue;
 		
 		// LOG("%s: target node search from %d to %d", __func__
 		// 		, curNode->GetIndex()
@@ -2568,6 +2624,7 @@ bool QTPFS::PathSearch::SharedFinalize(const IPath* srcPath, IPath* dstPath) {
 	dstPath->SetHasFullPath(srcPath->IsFullPath());
 	dstPath->SetHasPartialPath(srcPath->IsPartialPath());
 	dstPath->SetSearchTime(srcPath->GetSearchTime());
+	dstPath->SetNumNodesSearched(srcPath->GetNumNodesSearched());
 	dstPath->SetRepathTriggerIndex(srcPath->GetRepathTriggerIndex());
 	dstPath->SetGoalPosition(goalPos);
 	dstPath->SetIsRawPath(srcPath->IsRawPath());
@@ -130,6 +130,8 @@ namespace QTPFS {
 
 		void SetGoalDistance(float dist) { goalDistance = dist; }
 
+		size_t GetNumNodesSearched() const { return fwdNodesSearched + bwdNodesSearched + discardedNodesSearched; }
+
 		const CSolidObject* Getowner() const { return pathOwner; }
 
 	private:
@@ -175,6 +177,7 @@ namespace QTPFS {
 		void SmoothSharedPath(IPath* path);
 		int SmoothPathPoints(const INode* nn0, const INode* nn1, const float3& p0, const float3& p1, const float3& p2, float3& result) const;
 
+		void InitAbstractCorridor();
 		void InitStartingSearchNodes();
 		void UpdateHcostMult();
 		void RemoveOutdatedOpenNodesFromQueue(int searchDir);
@@ -243,10 +246,15 @@ namespace QTPFS {
 		size_t fwdNodesSearched = 0;
 		size_t bwdNodesSearched = 0;
 
+		// nodes searched by a corridor-restricted attempt that had to be repeated without it
+		size_t discardedNodesSearched = 0;
+
 		bool haveFullPath;
 		bool havePartPath;
 		bool badGoal;
 		bool disallowNodeRevisit = false;
+		bool allowAbstractCorridor = true;
+		bool useAbstractCorridor = false;
 
 public:
 		bool rawPathCheck = false;
@@ -1,12 +1,15 @@
 #ifndef PATH_THREADS_H__
 #define PATH_THREADS_H__
 
+#include <algorithm>
 #include <cstddef>
 #include <functional>
 #include <queue>
 #include <vector>
 
 #include "Node.h"
+#include "NodeHeap.h"
+#include "PathDefines.h"
 
 #include "Map/ReadMap.h"
 #include "Sim/MoveTypes/MoveDefHandler.h"
@@ -110,8 +113,69 @@ namespace QTPFS {
 
     // Reminder that std::priority does comparisons to push element back to the bottom. So using
     // ShouldMoveTowardsBottomOfPriorityQueue here means the smallest value will be top()
+    // The comparison is a total order (ties on priority fall back to the node index), so both
+    // queue types pop in exactly the same order.
+    #ifdef QTPFS_DARY_HEAP_OPEN_LIST
+    typedef d_ary_heap<SearchQueueNode, ShouldMoveTowardsBottomOfPriorityQueue, 4> SearchPriorityQueue;
+
+    inline void ClearPriorityQueue(SearchPriorityQueue& queue) { queue.clear(); }
+    #else
     typedef std::priority_queue<SearchQueueNode, std::vector<SearchQueueNode>, ShouldMoveTowardsBottomOfPriorityQueue> SearchPriorityQueue;
 
+    inline void ClearPriorityQueue(SearchPriorityQueue& queue) { while (!queue.empty()) queue.pop(); }
+    #endif
+
+    // per thread, used by AbstractGraph::FindCorridor
+    struct AbstractSearchData {
+        std::vector<float> gCosts;
+        std::vector<int> prevRegions;
+
+        // entries are only valid when they match the current stamp, so
+        // nothing needs to be cleared between searches
+        std::vector<std::uint32_t> regionStamps;
+        std::vector<std::uint32_t> corridorStamps;
+        std::uint32_t regionStamp = 0;
+        std::uint32_t corridorStamp = 0;
+
+        SearchPriorityQueue openRegions;
+
+        void Init(size_t numRegions, size_t numClusters) {
+            if (gCosts.size() < numRegions) {
+                gCosts.resize(numRegions);
+                prevRegions.resize(numRegions);
+                regionStamps.resize(numRegions, 0);
+            }
+            if (corridorStamps.size() < numClusters)
+                corridorStamps.resize(numClusters, 0);
+
+            if ((++regionStamp) == 0) {
+                std::fill(regionStamps.begin(), regionStamps.end(), 0);
+                regionStamp = 1;
+            }
+            if ((++corridorStamp) == 0) {
+                std::fill(corridorStamps.begin(), corridorStamps.end(), 0);
+                corridorStamp = 1;
+            }
+
+            ClearPriorityQueue(openRegions);
+        }
+
+        bool InCorridor(int cluster) const {
+            return (cluster >= 0 && corridorStamps[cluster] == corridorStamp);
+        }
+
+        std::size_t GetMemFootPrint() const {
+            std::size_t memFootPrint = 0;
+
+            memFootPrint += gCosts.size() * sizeof(decltype(gCosts)::value_type);
+            memFootPrint += prevRegions.size() * sizeof(decltype(prevRegions)::value_type);
+            memFootPrint += regionStamps.size() * sizeof(decltype(regionStamps)::value_type);
+            memFootPrint += corridorStamps.size() * sizeof(decltype(corridorStamps)::value_type);
+
+            return memFootPrint;
+        }
+    };
+
 	struct SearchThreadData {
 
         static constexpr int SEARCH_FORWARD = 0;
@@ -120,6 +184,7 @@ namespace QTPFS {
 
 		SparseData<SearchNode> allSearchedNodes[SEARCH_DIRECTIONS];
         SearchPriorityQueue openNodes[SEARCH_DIRECTIONS];
+        AbstractSearchData abstractSearchData;
         std::vector<INode*> tmpNodesStore;
         int threadId = 0;
 
@@ -130,7 +195,7 @@ namespace QTPFS {
 
         void ResetQueue() { ZoneScoped; for (int i=0; i<SEARCH_DIRECTIONS; ++i) ResetQueue(i); }
 
-        void ResetQueue(int i) { ZoneScoped; while (!openNodes[i].empty()) openNodes[i].pop(); }
+        void ResetQueue(int i) { ZoneScoped; ClearPriorityQueue(openNodes[i]); }
 
 		void Init(size_t sparseSize, size_t denseSize) {
             constexpr size_t tmpNodeStoreInitialReserve = 128;
@@ -151,6 +216,7 @@ namespace QTPFS {
                 memFootPrint += openNodes[i].size() * sizeof(std::remove_reference_t<decltype(openNodes[0])>::value_type);
             }
             memFootPrint += tmpNodesStore.size() * sizeof(decltype(tmpNodesStore)::value_type);
+            memFootPrint += abstractSearchData.GetMemFootPrint();
 
             return memFootPrint;
         }
@@ -0,0 +1,101 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef QTPFS_SEARCHWAVES_HDR
+#define QTPFS_SEARCHWAVES_HDR
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "System/UnorderedMap.hpp"
+
+namespace QTPFS {
+	/**
+	 * @brief Orders the searches of one update by the searches whose paths they share
+	 *
+	 * Requests with nearby start and goal areas are chained by hash, and all but
+	 * the head of a chain copy or extend the head's path; which they can only do
+	 * once the head's search is complete. Each search goes into the wave after
+	 * the latest of its heads that is searched in the same update, so a chain
+	 * (also a chain whose head shares another chain's path) resolves within one
+	 * update. Searches that would need more than NumWaves waves, or whose heads
+	 * depend on each other, go into the last wave and find their head busy,
+	 * which requeues them for the next update.
+	 *
+	 * Within a wave searches keep the order they were given in.
+	 */
+	template<typename TSearch, size_t NumWaves>
+	class SearchWaves {
+	public:
+		static_assert(NumWaves >= 1);
+
+		/**
+		 * getHeads(search, heads) appends the heads <search> shares a path
+		 * with; those that are not among <searches> are ignored.
+		 */
+		template<typename TRange, typename TGetHeads>
+		void Sort(const TRange& searches, TGetHeads&& getHeads) {
+			for (auto& wave: waves)
+				wave.clear();
+
+			searchWaves.clear();
+
+			for (const TSearch& search: searches) {
+				searchWaves[search] = UNSORTED;
+			}
+
+			for (const TSearch& search: searches) {
+				waves[GetWave(search, getHeads, 0)].push_back(search);
+			}
+		}
+
+		const std::vector<TSearch>& operator [] (size_t i) const { return waves[i]; }
+
+		auto begin() const { return waves.begin(); }
+		auto end() const { return waves.end(); }
+
+		static constexpr size_t size() { return NumWaves; }
+
+	private:
+		static constexpr int UNSORTED = -1;
+		static constexpr int SORTING = -2;
+
+		template<typename TGetHeads>
+		int GetWave(const TSearch& search, TGetHeads& getHeads, size_t depth) {
+			const auto it = searchWaves.find(search);
+
+			if (it == searchWaves.end())
+				return -1;
+			if (it->second >= 0)
+				return it->second;
+
+			// heads depending on each other; give up on sharing within this update
+			if (it->second == SORTING || depth >= NumWaves)
+				return (NumWaves - 1);
+
+			it->second = SORTING;
+
+			std::vector<TSearch> heads;
+			getHeads(search, heads);
+
+			int wave = 0;
+
+			for (const TSearch& head: heads) {
+				if (head == search)
+					continue;
+
+				wave = std::max(wave, GetWave(head, getHeads, depth + 1) + 1);
+			}
+
+			// <it> may have been invalidated by the recursion
+			return (searchWaves[search] = std::min(wave, int(NumWaves - 1)));
+		}
+
+	private:
+		std::array<std::vector<TSearch>, NumWaves> waves;
+
+		spring::unordered_map<TSearch, int> searchWaves;
+	};
+}
+
+#endif
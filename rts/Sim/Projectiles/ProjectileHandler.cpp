@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include <algorithm>
+#include <cstring>
 
 #include "Projectile.h"
 #include "ProjectileHandler.h"
@@ -42,6 +43,7 @@
 
 CONFIG(int, MaxParticles).defaultValue(10000).headlessValue(0).minimumValue(0);
 CONFIG(int, MaxNanoParticles).defaultValue(2000).headlessValue(0).minimumValue(0);
+CONFIG(bool, CheckProjectileCollisionsMT).defaultValue(true).description("Gather the units, features and shields each projectile might hit on all threads before checking the collisions in order. Results are identical either way.");
 
 
 CR_BIND(CProjectileHandler, )
@@ -55,7 +57,10 @@ CR_REG_METADATA(CProjectileHandler, (
 	CR_MEMBER(maxNanoParticles),
 	CR_MEMBER(currentNanoParticles),
 	CR_MEMBER_UN(frameCurrentParticles),
-	CR_MEMBER_UN(frameProjectileCounts)
+	CR_MEMBER_UN(frameProjectileCounts),
+	CR_IGNORED(checkCollisionsMT),
+	CR_IGNORED(collisionCandidates),
+	CR_IGNORED(numCollisionCandidates)
 ))
 
 
@@ -79,6 +84,7 @@ void CProjectileHandler::Init()
 
 	maxParticles     = configHandler->GetInt("MaxParticles");
 	maxNanoParticles = configHandler->GetInt("MaxNanoParticles");
+	checkCollisionsMT = configHandler->GetBool("CheckProjectileCollisionsMT");
 
 	projMemPool.clear();
 	projMemPool.reserve(1024);
@@ -94,7 +100,7 @@ void CProjectileHandler::Init()
 	CExpGenSpawnable::InitSpawnables();
 
 	// register ConfigNotify()
-	configHandler->NotifyOnChange(this, {"MaxParticles", "MaxNanoParticles"});
+	configHandler->NotifyOnChange(this, {"MaxParticles", "MaxNanoParticles", "CheckProjectileCollisionsMT"});
 }
 
 void CProjectileHandler::Kill()
@@ -139,6 +145,7 @@ void CProjectileHandler::ConfigNotify(const std::string& key, const std::string&
 	RECOIL_DETAILED_TRACY_ZONE;
 	maxParticles     = configHandler->GetInt("MaxParticles");
 	maxNanoParticles = configHandler->GetInt("MaxNanoParticles");
+	checkCollisionsMT = configHandler->GetBool("CheckProjectileCollisionsMT");
 
 	projectiles[false].reserve(static_cast<size_t>(maxParticles) * 2);
 }
@@ -205,17 +212,25 @@ void CProjectileHandler::UpdateProjectilesImpl()
 			MAPPOS_SANITY_CHECK(p->pos);
 		}
 	}
-	else {
-		SCOPED_TIMER("Sim::Projectiles::UpdateUnsyncedMT");
-		for_mt_chunk(0, pc.size(), [&pc](int i) {
-			CProjectile* p = pc[i];
-			assert(p != nullptr);
 
-			MAPPOS_SANITY_CHECK(p->pos);
-			p->Update();
-			MAPPOS_SANITY_CHECK(p->pos);
-		});
-	}
+	// unsynced projectiles are moved by UpdateUnsyncedProjectiles, which
+	// the sim frame schedules separately since nothing synced reads them
+}
+
+void CProjectileHandler::UpdateUnsyncedProjectiles()
+{
+	SCOPED_TIMER("Sim::Projectiles::UpdateUnsyncedMT");
+
+	auto& pc = projectiles[false];
+
+	for_mt_chunk(0, pc.size(), [&pc](int i) {
+		CProjectile* p = pc[i];
+		assert(p != nullptr);
+
+		MAPPOS_SANITY_CHECK(p->pos);
+		p->Update();
+		MAPPOS_SANITY_CHECK(p->pos);
+	});
 }
 
 
@@ -557,6 +572,68 @@ void CProjectileHandler::CheckShieldCollisions(
 	}
 }
 
+void CProjectileHandler::GatherCollisionCandidates(bool synced)
+{
+	SCOPED_TIMER("Sim::Projectiles::GatherCollisionsMT");
+
+	const auto& pc = projectiles[synced];
+	const unsigned int solidsVersion = quadField.GetSolidsVersion();
+
+	// never shrunk, so the candidate vectors keep their capacity
+	if (collisionCandidates.size() < pc.size())
+		collisionCandidates.resize(pc.size());
+
+	numCollisionCandidates = pc.size();
+
+	// only reads the QuadField and writes the i-th scratch entry
+	for_mt_chunk(0, pc.size(), [&](int i) {
+		const CProjectile* p = pc[i];
+		CollisionCandidates& cc = collisionCandidates[i];
+
+		cc.units.clear();
+		cc.features.clear();
+		cc.repulsers.clear();
+		cc.proj = nullptr;
+
+		if (!p->checkCol) return;
+		if ( p->deleteMe) return;
+
+		cc.proj = p;
+		cc.pos = p->pos;
+		cc.radius = p->speed.w + p->radius;
+		cc.solidsVersion = solidsVersion;
+
+		quadField.GetUnitsAndFeaturesInQuads(ThreadPool::GetThreadNum(), cc.pos, cc.radius, cc.units, cc.features, cc.repulsers);
+	});
+}
+
+bool CProjectileHandler::GetCollisionCandidates(size_t i, const CProjectile* p, const float3 pos, const float radius)
+{
+	// projectiles added by earlier collisions were not gathered
+	if (i >= numCollisionCandidates)
+		return false;
+
+	CollisionCandidates& cc = collisionCandidates[i];
+
+	if (cc.proj != p)
+		return false;
+
+	cc.proj = nullptr;
+
+	// earlier collisions (or the Lua callins they trigger) may have moved
+	// solids between quads or this projectile itself; compare bitwise since
+	// float3::operator== has a tolerance
+	if (cc.solidsVersion != quadField.GetSolidsVersion())
+		return false;
+	if (std::memcmp(&cc.pos, &pos, sizeof(float) * 3) != 0)
+		return false;
+	if (std::memcmp(&cc.radius, &radius, sizeof(float)) != 0)
+		return false;
+
+	CQuadField::FilterUnitsAndFeaturesColVol(pos, radius, cc.units, cc.features, cc.repulsers);
+	return true;
+}
+
 void CProjectileHandler::CheckUnitFeatureCollisions(bool synced)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
@@ -564,6 +641,14 @@ void CProjectileHandler::CheckUnitFeatureCollisions(bool synced)
 	static std::vector<CFeature*> tempFeatures;
 	static std::vector<CPlasmaRepulser*> tempRepulsers;
 
+	// the QuadField lookups are gathered up front, the collisions themselves
+	// still happen in ID order below since they change simulation state
+	// (read once, ConfigNotify may change it in between)
+	const bool gathered = checkCollisionsMT;
+
+	if (gathered)
+		GatherCollisionCandidates(synced);
+
 	//can't use iterators here, because instructions inside the loop modify projectiles[synced]
 	for (size_t i = 0; i < projectiles[synced].size(); ++i) {
 		CProjectile* p = projectiles[synced][i];
@@ -575,7 +660,18 @@ void CProjectileHandler::CheckUnitFeatureCollisions(bool synced)
 		const float3 ppos1 = p->pos + p->speed;
 		// const float3 ppos1 = p->pos + p->dir * (p->speed.w + p->radius);
 
-		quadField.GetUnitsAndFeaturesColVol(p->pos, p->speed.w + p->radius, tempUnits, tempFeatures, &tempRepulsers);
+		const float radius = p->speed.w + p->radius;
+
+		if (gathered && GetCollisionCandidates(i, p, p->pos, radius)) {
+			CollisionCandidates& cc = collisionCandidates[i];
+
+			CheckShieldCollisions (p, cc.repulsers, ppos0, ppos1);
+			CheckUnitCollisions   (p, cc.units    , ppos0, ppos1);
+			CheckFeatureCollisions(p, cc.features , ppos0, ppos1);
+			continue;
+		}
+
+		quadField.GetUnitsAndFeaturesColVol(p->pos, radius, tempUnits, tempFeatures, &tempRepulsers);
 
 		CheckShieldCollisions (p, tempRepulsers, ppos0, ppos1); tempRepulsers.clear();
 		CheckUnitCollisions   (p, tempUnits    , ppos0, ppos1); tempUnits.clear();
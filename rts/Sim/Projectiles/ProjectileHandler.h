@@ -54,6 +54,8 @@ public:
 	void SetMaxNanoParticles(int value) { maxNanoParticles = std::max(0, value); }
 
 	void Update();
+	/// moves the unsynced projectiles, which nothing synced ever reads
+	void UpdateUnsyncedProjectiles();
 
 	float GetParticleSaturation(bool randomized = true) const;
 	float GetNanoParticleSaturation(float priority) const {
@@ -84,6 +86,9 @@ public:
 	int maxNanoParticles = 0;
 	int currentNanoParticles = 0;
 
+	// whether collision candidates are gathered in parallel (see CheckUnitFeatureCollisions)
+	bool checkCollisionsMT = true;
+
 	// these vars are used to precache parts of GetCurrentParticles() calculations
 	mutable int frameCurrentParticles = 0;
 	mutable int frameProjectileCounts[2] = {0, 0};
@@ -110,7 +115,27 @@ private:
 		UpdateProjectilesImpl<false>();
 	}
 
+	// collision candidates of projectiles[synced][i], gathered in parallel
+	// and only used by the serial collision checks while still current
+	struct CollisionCandidates {
+		const CProjectile* proj = nullptr;
+
+		float3 pos;
+		float radius = 0.0f;
+		unsigned int solidsVersion = 0;
+
+		std::vector<CUnit*> units;
+		std::vector<CFeature*> features;
+		std::vector<CPlasmaRepulser*> repulsers;
+	};
+
+	void GatherCollisionCandidates(bool synced);
+	bool GetCollisionCandidates(size_t i, const CProjectile* p, const float3 pos, const float radius);
+
 private:
+	std::vector<CollisionCandidates> collisionCandidates;
+	size_t numCollisionCandidates = 0;
+
 	// [0] contains only projectiles that can not change simulation state
 	// [1] contains only projectiles that can     change simulation state
 	spring::FreeListMapCompact<CProjectile*, int> projectiles[2];
@@ -0,0 +1,226 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "CobDecoder.h"
+#include "CobOpcodes.h"
+
+
+struct RawOpInfo {
+	CobOp::Type type;
+	int numOperands;
+};
+
+static RawOpInfo GetRawOpInfo(int opcode)
+{
+	switch (opcode) {
+		case MOVE      : return {CobOp::OP_MOVE      , 2};
+		case TURN      : return {CobOp::OP_TURN      , 2};
+		case SPIN      : return {CobOp::OP_SPIN      , 2};
+		case STOP_SPIN : return {CobOp::OP_STOP_SPIN , 2};
+		case SHOW      : return {CobOp::OP_SHOW      , 1};
+		case HIDE      : return {CobOp::OP_HIDE      , 1};
+		case CACHE     : return {CobOp::OP_NOP       , 1};
+		case DONT_CACHE: return {CobOp::OP_NOP       , 1};
+		case MOVE_NOW  : return {CobOp::OP_MOVE_NOW  , 2};
+		case TURN_NOW  : return {CobOp::OP_TURN_NOW  , 2};
+		case SHADE     : return {CobOp::OP_NOP       , 1};
+		case DONT_SHADE: return {CobOp::OP_NOP       , 1};
+		case EMIT_SFX  : return {CobOp::OP_EMIT_SFX  , 1};
+
+		case WAIT_TURN: return {CobOp::OP_WAIT_TURN, 2};
+		case WAIT_MOVE: return {CobOp::OP_WAIT_MOVE, 2};
+		case SLEEP    : return {CobOp::OP_SLEEP    , 0};
+
+		case PUSH_CONSTANT   : return {CobOp::OP_PUSH_CONSTANT   , 1};
+		case PUSH_LOCAL_VAR  : return {CobOp::OP_PUSH_LOCAL_VAR  , 1};
+		case PUSH_STATIC     : return {CobOp::OP_PUSH_STATIC     , 1};
+		case CREATE_LOCAL_VAR: return {CobOp::OP_CREATE_LOCAL_VAR, 0};
+		case POP_LOCAL_VAR   : return {CobOp::OP_POP_LOCAL_VAR   , 1};
+		case POP_STATIC      : return {CobOp::OP_POP_STATIC      , 1};
+		case POP_STACK       : return {CobOp::OP_POP_STACK       , 0};
+
+		case ADD        : return {CobOp::OP_ADD        , 0};
+		case SUB        : return {CobOp::OP_SUB        , 0};
+		case MUL        : return {CobOp::OP_MUL        , 0};
+		case DIV        : return {CobOp::OP_DIV        , 0};
+		case MOD        : return {CobOp::OP_MOD        , 0};
+		case BITWISE_AND: return {CobOp::OP_BITWISE_AND, 0};
+		case BITWISE_OR : return {CobOp::OP_BITWISE_OR , 0};
+		case BITWISE_XOR: return {CobOp::OP_BITWISE_XOR, 0};
+		case BITWISE_NOT: return {CobOp::OP_BITWISE_NOT, 0};
+
+		case RAND          : return {CobOp::OP_RAND          , 0};
+		case GET_UNIT_VALUE: return {CobOp::OP_GET_UNIT_VALUE, 0};
+		case GET           : return {CobOp::OP_GET           , 0};
+
+		case SET_LESS            : return {CobOp::OP_SET_LESS            , 0};
+		case SET_LESS_OR_EQUAL   : return {CobOp::OP_SET_LESS_OR_EQUAL   , 0};
+		case SET_GREATER         : return {CobOp::OP_SET_GREATER         , 0};
+		case SET_GREATER_OR_EQUAL: return {CobOp::OP_SET_GREATER_OR_EQUAL, 0};
+		case SET_EQUAL           : return {CobOp::OP_SET_EQUAL           , 0};
+		case SET_NOT_EQUAL       : return {CobOp::OP_SET_NOT_EQUAL       , 0};
+		case LOGICAL_AND         : return {CobOp::OP_LOGICAL_AND         , 0};
+		case LOGICAL_OR          : return {CobOp::OP_LOGICAL_OR          , 0};
+		case LOGICAL_XOR         : return {CobOp::OP_LOGICAL_XOR         , 0};
+		case LOGICAL_NOT         : return {CobOp::OP_LOGICAL_NOT         , 0};
+
+		case START          : return {CobOp::OP_START          , 2};
+		case CALL           : return {CobOp::OP_REAL_CALL      , 2}; // resolved below
+		case REAL_CALL      : return {CobOp::OP_REAL_CALL      , 2};
+		case LUA_CALL       : return {CobOp::OP_LUA_CALL       , 2};
+		case JUMP           : return {CobOp::OP_JUMP           , 1};
+		case RETURN         : return {CobOp::OP_RETURN         , 0};
+		case JUMP_NOT_EQUAL : return {CobOp::OP_JUMP_NOT_EQUAL , 1};
+		case SIGNAL         : return {CobOp::OP_SIGNAL         , 0};
+		case SET_SIGNAL_MASK: return {CobOp::OP_SET_SIGNAL_MASK, 0};
+
+		case EXPLODE   : return {CobOp::OP_EXPLODE   , 1};
+		case PLAY_SOUND: return {CobOp::OP_PLAY_SOUND, 1};
+
+		case SET   : return {CobOp::OP_SET   , 0};
+		case ATTACH: return {CobOp::OP_ATTACH, 0};
+		case DROP  : return {CobOp::OP_DROP  , 0};
+	}
+
+	return {CobOp::OP_UNKNOWN, 0};
+}
+
+
+static CobOp DecodeSingle(
+	const std::vector<int>& code,
+	const std::vector<std::string>& scriptNames,
+	const std::vector<int>& scriptOffsets,
+	const std::vector<int>& scriptLengths,
+	int pc
+) {
+	const int codeSize = static_cast<int>(code.size());
+	const RawOpInfo info = GetRawOpInfo(code[pc]);
+
+	CobOp op;
+	op.type = info.type;
+	op.next = pc + 1 + info.numOperands;
+
+	if (op.type == CobOp::OP_UNKNOWN) {
+		op.args[0] = code[pc];
+		return op;
+	}
+
+	// the interpreter would read operands past the end
+	if (op.next > codeSize) {
+		op.type = CobOp::OP_OUT_OF_RANGE;
+		op.next = codeSize;
+		return op;
+	}
+
+	for (int i = 0; i < info.numOperands; ++i) {
+		op.args[i] = code[pc + 1 + i];
+	}
+
+	// a target outside the code faults as soon as it is fetched from; point
+	// these at the OUT_OF_RANGE entry past the end, which does the same
+	const auto ClampTarget = [&](int target) { return ((target >= 0 && target <= codeSize)? target: codeSize); };
+
+	switch (op.type) {
+		case CobOp::OP_JUMP:
+		case CobOp::OP_JUMP_NOT_EQUAL: {
+			op.args[0] = ClampTarget(op.args[0]);
+		} break;
+
+		case CobOp::OP_START:
+		case CobOp::OP_REAL_CALL: {
+			const int fn = op.args[0];
+
+			if (static_cast<size_t>(fn) >= scriptNames.size()) {
+				op.type = CobOp::OP_NOP;
+				break;
+			}
+
+			// a plain CALL is turned into one of these the first time it runs
+			if (code[pc] == CALL && scriptNames[fn].find("lua_") == 0) {
+				op.type = CobOp::OP_LUA_CALL;
+				break;
+			}
+
+			// zero-length functions are not called
+			if (scriptLengths[fn] == 0) {
+				op.type = CobOp::OP_NOP;
+				break;
+			}
+
+			if (op.type == CobOp::OP_START)
+				break;
+
+			op.args[2] = ClampTarget(scriptOffsets[fn]);
+		} break;
+
+		default: {
+		} break;
+	}
+
+	return op;
+}
+
+
+void CobDecoder::Decode(
+	const std::vector<int>& code,
+	const std::vector<std::string>& scriptNames,
+	const std::vector<int>& scriptOffsets,
+	const std::vector<int>& scriptLengths,
+	std::vector<CobOp>& ops
+) {
+	const int codeSize = static_cast<int>(code.size());
+
+	ops.clear();
+	ops.resize(codeSize + 1);
+
+	for (int pc = 0; pc < codeSize; ++pc) {
+		ops[pc] = DecodeSingle(code, scriptNames, scriptOffsets, scriptLengths, pc);
+	}
+
+	ops[codeSize].type = CobOp::OP_OUT_OF_RANGE;
+	ops[codeSize].next = codeSize;
+
+	// fuse common sequences; each entry only looks at entries after it, which
+	// are not fused yet when the forward pass gets to it
+	for (int pc = 0; pc < codeSize; ++pc) {
+		CobOp& op = ops[pc];
+
+		const CobOp& op1 = ops[op.next];
+		const CobOp& op2 = ops[op1.next];
+
+		switch (op.type) {
+			case CobOp::OP_PUSH_CONSTANT: {
+				switch (op1.type) {
+					case CobOp::OP_SLEEP: {
+						op = {CobOp::OP_SLEEP_CONST, op1.next, {op.args[0], 0, 0, 0}};
+					} break;
+					case CobOp::OP_POP_LOCAL_VAR: {
+						op = {CobOp::OP_POP_LOCAL_CONST, op1.next, {op1.args[0], op.args[0], 0, 0}};
+					} break;
+					case CobOp::OP_POP_STATIC: {
+						op = {CobOp::OP_POP_STATIC_CONST, op1.next, {op1.args[0], op.args[0], 0, 0}};
+					} break;
+					case CobOp::OP_PUSH_CONSTANT: {
+						if (op2.type == CobOp::OP_MOVE)
+							op = {CobOp::OP_MOVE_CONST, op2.next, {op2.args[0], op2.args[1], op.args[0], op1.args[0]}};
+						if (op2.type == CobOp::OP_TURN)
+							op = {CobOp::OP_TURN_CONST, op2.next, {op2.args[0], op2.args[1], op.args[0], op1.args[0]}};
+					} break;
+					default: {
+					} break;
+				}
+			} break;
+
+			case CobOp::OP_PUSH_LOCAL_VAR: {
+				if (op1.type == CobOp::OP_JUMP_NOT_EQUAL)
+					op = {CobOp::OP_JUMP_IF_LOCAL_ZERO, op1.next, {op.args[0], op1.args[0], 0, 0}};
+			} break;
+			case CobOp::OP_PUSH_STATIC: {
+				if (op1.type == CobOp::OP_JUMP_NOT_EQUAL)
+					op = {CobOp::OP_JUMP_IF_STATIC_ZERO, op1.next, {op.args[0], op1.args[0], 0, 0}};
+			} break;
+
+			default: {
+			} break;
+		}
+	}
+}
@@ -0,0 +1,132 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef COB_DECODER_H
+#define COB_DECODER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// every type of decoded instruction, in dispatch-table order
+#define COB_DECODED_OPS(X) \
+	X(NOP)                  \
+	X(PUSH_CONSTANT)        \
+	X(PUSH_LOCAL_VAR)       \
+	X(PUSH_STATIC)          \
+	X(CREATE_LOCAL_VAR)     \
+	X(POP_LOCAL_VAR)        \
+	X(POP_STATIC)           \
+	X(POP_STACK)            \
+	X(ADD)                  \
+	X(SUB)                  \
+	X(MUL)                  \
+	X(DIV)                  \
+	X(MOD)                  \
+	X(BITWISE_AND)          \
+	X(BITWISE_OR)           \
+	X(BITWISE_XOR)          \
+	X(BITWISE_NOT)          \
+	X(RAND)                 \
+	X(GET_UNIT_VALUE)       \
+	X(GET)                  \
+	X(SET_LESS)             \
+	X(SET_LESS_OR_EQUAL)    \
+	X(SET_GREATER)          \
+	X(SET_GREATER_OR_EQUAL) \
+	X(SET_EQUAL)            \
+	X(SET_NOT_EQUAL)        \
+	X(LOGICAL_AND)          \
+	X(LOGICAL_OR)           \
+	X(LOGICAL_XOR)          \
+	X(LOGICAL_NOT)          \
+	X(START)                \
+	X(REAL_CALL)            \
+	X(LUA_CALL)             \
+	X(JUMP)                 \
+	X(RETURN)               \
+	X(JUMP_NOT_EQUAL)       \
+	X(SIGNAL)               \
+	X(SET_SIGNAL_MASK)      \
+	X(EXPLODE)              \
+	X(PLAY_SOUND)           \
+	X(SET)                  \
+	X(ATTACH)               \
+	X(DROP)                 \
+	X(MOVE)                 \
+	X(TURN)                 \
+	X(SPIN)                 \
+	X(STOP_SPIN)            \
+	X(SHOW)                 \
+	X(HIDE)                 \
+	X(MOVE_NOW)             \
+	X(TURN_NOW)             \
+	X(EMIT_SFX)             \
+	X(WAIT_TURN)            \
+	X(WAIT_MOVE)            \
+	X(SLEEP)                \
+	X(SLEEP_CONST)          \
+	X(MOVE_CONST)           \
+	X(TURN_CONST)           \
+	X(POP_LOCAL_CONST)      \
+	X(POP_STATIC_CONST)     \
+	X(JUMP_IF_LOCAL_ZERO)   \
+	X(JUMP_IF_STATIC_ZERO)  \
+	X(UNKNOWN)              \
+	X(OUT_OF_RANGE)
+
+
+/**
+ * One COB instruction as decoded at load time.
+ *
+ * Operands are stored in the order they appear in the bytecode; calls have
+ * their target resolved (args[2] for REAL_CALL) and CALL is already split
+ * into REAL_CALL and LUA_CALL. The *_CONST and JUMP_IF_* types are fused
+ * sequences:
+ *   SLEEP_CONST         = PUSH_CONSTANT c; SLEEP           args {c}
+ *   MOVE_CONST          = PUSH_CONSTANT a; PUSH_CONSTANT b;
+ *                         MOVE p x                         args {p, x, a, b}
+ *   TURN_CONST          = (as MOVE_CONST, for TURN)
+ *   POP_LOCAL_CONST     = PUSH_CONSTANT c; POP_LOCAL_VAR i args {i, c}
+ *   POP_STATIC_CONST    = PUSH_CONSTANT c; POP_STATIC i    args {i, c}
+ *   JUMP_IF_LOCAL_ZERO  = PUSH_LOCAL_VAR i; JUMP_NOT_EQUAL t args {i, t}
+ *   JUMP_IF_STATIC_ZERO = PUSH_STATIC i; JUMP_NOT_EQUAL t   args {i, t}
+ */
+struct CobOp {
+	#define COB_DECODED_OP_TYPE(name) OP_##name,
+	enum Type: std::uint8_t { COB_DECODED_OPS(COB_DECODED_OP_TYPE) NUM_OP_TYPES };
+	#undef COB_DECODED_OP_TYPE
+
+	std::uint8_t type = OP_UNKNOWN;
+
+	/// code offset of the next instruction, past all fused ones
+	int next = 0;
+	int args[4] = {0, 0, 0, 0};
+};
+
+
+namespace CobDecoder {
+	/**
+	 * Decodes the instruction starting at every word of <code>; ops[i] is the
+	 * instruction at code offset i, which keeps program counters (including
+	 * those in savegames) and jump targets as plain code offsets. An entry is
+	 * made for each word, not only those reached from a script start, since
+	 * jumps may land anywhere; jumping into the middle of a fused sequence
+	 * runs the unfused remainder.
+	 *
+	 * ops gets one entry more than code, the OUT_OF_RANGE instruction a thread
+	 * reaches by running off its end. Jumps and calls to targets outside the
+	 * code go there as well, so no decoded instruction leaves <ops>.
+	 *
+	 * Calls to functions that do not exist are treated as calls to functions
+	 * of length zero, i.e. skipped.
+	 */
+	void Decode(
+		const std::vector<int>& code,
+		const std::vector<std::string>& scriptNames,
+		const std::vector<int>& scriptOffsets,
+		const std::vector<int>& scriptLengths,
+		std::vector<CobOp>& ops
+	);
+}
+
+#endif // COB_DECODER_H
@@ -11,57 +11,99 @@
 CR_BIND(CCobEngine, )
 
 CR_REG_METADATA(CCobEngine, (
-	CR_MEMBER(threadInstances),
+	CR_MEMBER(threadSlots),
+	CR_MEMBER(slotThreadIDs),
+	CR_MEMBER(slotGenerations),
+	CR_MEMBER(freeSlots),
 	CR_MEMBER(tickAddedThreads),
 	CR_MEMBER(tickRemovedThreads),
 	CR_MEMBER(runningThreadIDs),
-	CR_MEMBER(sleepingThreadIDs),
+	CR_MEMBER(sleepingThreads),
 	// always null/empty when saving
 	CR_IGNORED(waitingThreadIDs),
 
 	CR_IGNORED(curThread),
 
 	CR_MEMBER(currentTime),
+	CR_MEMBER(numThreads),
 	CR_MEMBER(threadCounter)
 ))
 
-CR_BIND(CCobEngine::SleepingThread, )
-CR_REG_METADATA(CCobEngine::SleepingThread, (
-	CR_MEMBER(id),
-	CR_MEMBER(wt)
-))
-
 static const char* const numCobThreadsPlot = "CobThreads";
 
+int CCobEngine::GenThreadID()
+{
+	int slot = -1;
+
+	if (freeSlots.empty()) {
+		slot = int(slotThreadIDs.size());
+
+		assert(slot <= SLOT_MASK);
+
+		threadSlots.emplace_back();
+		slotThreadIDs.push_back(-1);
+		slotGenerations.push_back(0);
+	} else {
+		slot = freeSlots.front();
+		freeSlots.pop_front();
+	}
+
+	return (slot | (slotGenerations[slot] << SLOT_BITS));
+}
+
+void CCobEngine::ReleaseThreadID(int threadID)
+{
+	const int slot = threadID & SLOT_MASK;
+
+	assert(slotThreadIDs[slot] == -1);
+
+	slotGenerations[slot] = (slotGenerations[slot] + 1) & GENERATION_MASK;
+	freeSlots.push_back(slot);
+}
+
 int CCobEngine::AddThread(CCobThread&& thread)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
 	if (thread.GetID() == -1)
-		thread.SetID(GenThreadID());
+		thread.SetID(GenThreadID(), GenThreadSeqNum());
+
+	const int threadID = thread.GetID();
+	const int slot = threadID & SLOT_MASK;
 
 	CCobInstance* o = thread.cobInst;
-	CCobThread& t = threadInstances[thread.GetID()];
+	CCobThread& t = threadSlots[slot];
 
-	// move thread into registry, hand its ID to owner
+	// move thread into its reserved slot, hand its ID to owner
 	t = std::move(thread);
-	o->AddThreadID(t.GetID());
+	o->AddThreadID(threadID);
 
-	TracyPlot(numCobThreadsPlot, static_cast<int64_t>(threadInstances.size()));
+	slotThreadIDs[slot] = threadID;
+	numThreads += 1;
 
-	return (t.GetID());
+	TracyPlot(numCobThreadsPlot, static_cast<int64_t>(numThreads));
+
+	return threadID;
 }
 
 bool CCobEngine::RemoveThread(int threadID) {
 	RECOIL_DETAILED_TRACY_ZONE;
-	const auto it = threadInstances.find(threadID);
+	CCobThread* t = GetThread(threadID);
 
-	if (it != threadInstances.end()) {
-		threadInstances.erase(it);
-		TracyPlot(numCobThreadsPlot, static_cast<int64_t>(threadInstances.size()));
-		return true;
-	}
+	if (t == nullptr)
+		return false;
+
+	// the dtor runs callbacks which may add threads, so the slot has to be
+	// released (and its thread moved out) before the thread is destroyed
+	CCobThread thread = std::move(*t);
+
+	*t = CCobThread();
+
+	slotThreadIDs[threadID & SLOT_MASK] = -1;
+	numThreads -= 1;
 
-	return false;
+	ReleaseThreadID(threadID);
+	TracyPlot(numCobThreadsPlot, static_cast<int64_t>(numThreads));
+	return true;
 }
 
 void CCobEngine::ProcessQueuedThreads() {
@@ -74,9 +116,9 @@ void CCobEngine::ProcessQueuedThreads() {
 	}
 	tickRemovedThreads.clear();
 
-	// move new threads spawned by START into threadInstances;
+	// move new threads spawned by START into their slots;
 	// their ID's will already have been scheduled into either
-	// waitingThreadIDs or sleepingThreadIDs
+	// waitingThreadIDs or sleepingThreads
 	for (CCobThread& t: tickAddedThreads) {
 		AddThread(std::move(t));
 	}
@@ -93,7 +135,7 @@ void CCobEngine::ScheduleThread(const CCobThread* thread)
 			waitingThreadIDs.push_back(thread->GetID());
 		} break;
 		case CCobThread::Sleep: {
-			sleepingThreadIDs.push(SleepingThread{thread->GetID(), thread->GetWakeTime()});
+			sleepingThreads.Insert(thread->GetWakeTime(), thread->GetSeqNum(), thread->GetID());
 		} break;
 		default: {
 			LOG_L(L_ERROR, "[COBEngine::%s] unknown state %d for thread %d", __func__, thread->GetState(), thread->GetID());
@@ -106,9 +148,9 @@ void CCobEngine::SanityCheckThreads(const CCobInstance* owner)
 	RECOIL_DETAILED_TRACY_ZONE;
 	if (false) {
 		// no threads belonging to owner should be left
-		for (const auto& p: threadInstances) {
-			assert(p.second.cobInst != owner);
-		}
+		ForEachThread([&](const CCobThread& t) {
+			assert(t.cobInst != owner);
+		});
 		for (const CCobThread& t: tickAddedThreads) {
 			assert(t.cobInst != owner);
 		}
@@ -132,24 +174,17 @@ void CCobEngine::TickThread(CCobThread* thread)
 void CCobEngine::WakeSleepingThreads()
 {
 	ZoneScoped;
-	// check on the sleeping threads, remove any whose owner died
-	while (!sleepingThreadIDs.empty()) {
-		CCobThread* zzzThread = GetThread((sleepingThreadIDs.top()).id);
-
-		if (zzzThread == nullptr) {
-			sleepingThreadIDs.pop();
-			continue;
-		}
-
-		// not yet time to execute this thread or any subsequent sleepers
-		if (zzzThread->GetWakeTime() >= currentTime)
-			break;
+	// wake every thread whose time has come, skip those that have died
+	// (owner removed or signalled) since going to sleep; a slot reused by
+	// a newer thread gets a new ID, which the entry will not match
+	sleepingThreads.Advance(currentTime, [&](int wakeTime, int threadID) {
+		CCobThread* zzzThread = GetThread(threadID);
 
-		// remove executing thread from the queue
-		sleepingThreadIDs.pop();
+		if (zzzThread == nullptr || zzzThread->GetWakeTime() != wakeTime)
+			return;
 
 		// wake up the thread and tick it (if not dead)
-		// this can quite possibly re-add the thread to <sleepingThreadIDs>
+		// this can quite possibly re-add the thread to <sleepingThreads>
 		// again, but any thread is guaranteed to sleep for at least 1 tick
 		switch (zzzThread->GetState()) {
 			case CCobThread::Sleep: {
@@ -163,7 +198,7 @@ void CCobEngine::WakeSleepingThreads()
 				LOG_L(L_ERROR, "[COBEngine::%s] unknown state %d for thread %d", __func__, zzzThread->GetState(), zzzThread->GetID());
 			} break;
 		}
-	}
+	});
 }
 
 void CCobEngine::TickRunningThreads()
@@ -8,13 +8,13 @@
  * It also manages reading and caching of the actual .cob files.
  */
 
+#include <deque>
 #include <vector>
 
 #include "CobThread.h"
+#include "System/TimingWheel.h"
 #include "System/creg/creg_cond.h"
-#include "System/creg/STL_Queue.h"
-#include "System/creg/STL_Map.h"
-#include "System/Cpp11Compat.hpp"
+#include "System/creg/STL_Deque.h"
 
 class CCobThread;
 class CCobInstance;
@@ -25,48 +25,36 @@ class CCobEngine
 {
 	CR_DECLARE_STRUCT(CCobEngine)
 
-public:
-	struct SleepingThread {
-		CR_DECLARE_STRUCT(SleepingThread)
-
-		int id;
-		int wt;
-	};
-
-	struct CCobThreadComp {
-	public:
-		bool operator() (const SleepingThread& a, const SleepingThread& b) const {
-			return a.wt > b.wt || (a.wt == b.wt && a.id > b.id);
-		}
-	};
-
 public:
 	void Init() {
-		threadInstances.reserve(2048);
+		slotThreadIDs.reserve(2048);
+		slotGenerations.reserve(2048);
 		tickAddedThreads.reserve(128);
 
 		runningThreadIDs.reserve(512);
 		waitingThreadIDs.reserve(512);
 
-		sleepingThreadIDs = {};
+		sleepingThreads.Clear(0);
 
 		curThread = nullptr;
 
 		currentTime = 0;
+		numThreads = 0;
 		threadCounter = 0;
 	}
 	void Kill() {
-		// threadInstances is never explicitly iterated in the actual code,
-		// but iterated during sync dumps, so clean it with clear_unordered_map
-		spring::clear_unordered_map(threadInstances);
+		threadSlots.clear();
+		slotThreadIDs.clear();
+		slotGenerations.clear();
+		freeSlots.clear();
 		tickAddedThreads.clear();
 
 		runningThreadIDs.clear();
 		waitingThreadIDs.clear();
 
-		while (!sleepingThreadIDs.empty()) {
-			sleepingThreadIDs.pop();
-		}
+		sleepingThreads.Clear(currentTime);
+
+		numThreads = 0;
 	}
 
 	void Tick(int deltaTime);
@@ -74,17 +62,23 @@ public:
 
 
 	CCobThread* GetThread(int threadID) {
-		const auto it = threadInstances.find(threadID);
+		const unsigned int slot = threadID & SLOT_MASK;
 
-		if (it == threadInstances.end())
+		if (threadID < 0 || slot >= slotThreadIDs.size() || slotThreadIDs[slot] != threadID)
 			return nullptr;
 
-		return &(it->second);
+		return &threadSlots[slot];
 	}
 
 	bool RemoveThread(int threadID);
 	int AddThread(CCobThread&& thread);
-	int GenThreadID() { return (threadCounter++); }
+
+	/// reserves a slot for a thread, which AddThread fills
+	int GenThreadID();
+	/// frees the slot of a thread that finished before it was added
+	void ReleaseThreadID(int threadID);
+	/// threads waking on the same tick run in the order of these
+	int GenThreadSeqNum() { return threadCounter++; }
 
 	void QueueAddThread(CCobThread&& thread) { tickAddedThreads.emplace_back(std::move(thread)); }
 	void QueueRemoveThread(int threadID) { tickRemovedThreads.emplace_back(threadID); }
@@ -93,15 +87,21 @@ public:
 	void ScheduleThread(const CCobThread* thread);
 	void SanityCheckThreads(const CCobInstance* owner);
 
-	const auto& GetThreadInstances() const { return threadInstances; }
+	template<typename F>
+	void ForEachThread(F&& func) const {
+		for (size_t slot = 0; slot < slotThreadIDs.size(); ++slot) {
+			if (slotThreadIDs[slot] != -1)
+				func(threadSlots[slot]);
+		}
+	}
+
+	int GetNumThreads() const { return numThreads; }
 //	const auto& GetTickAddedThreads() const { return tickAddedThreads; }
 //	const auto& GetTickRemovedThreads() const { return tickRemovedThreads; }
 //	const auto& GetRunningThreadIDs() const { return runningThreadIDs; }
 	const auto& GetWaitingThreadIDs() const { return waitingThreadIDs; }
-	const auto& GetSleepingThreadIDs() const { return sleepingThreadIDs; }
+	const auto& GetSleepingThreads() const { return sleepingThreads; }
 	const auto  GetCurrTime() const { return currentTime; }
-	const auto  GetThreadCounter() const { return threadCounter; }
-	const auto  GetCurrCounter() const { return threadCounter; }
 private:
 	void TickThread(CCobThread* thread);
 
@@ -109,8 +109,22 @@ private:
 	void TickRunningThreads();
 
 private:
-	// registry of every thread across all script instances
-	spring::unordered_map<int, CCobThread> threadInstances;
+	// thread IDs are slot | (generation << SLOT_BITS), the generation is
+	// bumped whenever a slot is freed so stale IDs do not match its next
+	// thread; 2^20 slots leave 11 bits (2048 reuses) for the generation
+	static constexpr int SLOT_BITS = 20;
+	static constexpr int SLOT_MASK = (1 << SLOT_BITS) - 1;
+	static constexpr int GENERATION_MASK = (1 << (31 - SLOT_BITS)) - 1;
+
+	// registry of every thread across all script instances; a deque since
+	// threads can be added while a reference to another is being ticked
+	std::deque<CCobThread> threadSlots;
+	// ID of the thread in each slot, -1 if the slot is empty or reserved
+	std::vector<int> slotThreadIDs;
+	std::vector<int> slotGenerations;
+	// reused in FIFO order, which spreads generation bumps over all slots
+	std::deque<int> freeSlots;
+
 	// threads that are spawned during Tick
 	std::vector<CCobThread> tickAddedThreads;
 	// threads that are killed during Tick
@@ -119,13 +133,15 @@ private:
 	std::vector<int> runningThreadIDs;
 	std::vector<int> waitingThreadIDs;
 
-	// stores <id, waketime> pairs s.t. after waking up the ID can be checked
+	// <waketime, seqnum, id> entries s.t. after waking up the ID can be checked
 	// for validity; thread owner might get removed while a thread is sleeping
-	std::priority_queue<SleepingThread, std::vector<SleepingThread>, CCobThreadComp> sleepingThreadIDs;
+	// IDs reuse slots in no particular order, so ties go by creation order
+	CTimingWheel sleepingThreads;
 
 	CCobThread* curThread = nullptr;
 
 	int currentTime = 0;
+	int numThreads = 0;
 	int threadCounter = 0;
 };
 
@@ -16,7 +16,6 @@
 
 #include "System/Misc/TracyDefs.h"
 
-
 //The following structure is taken from http://visualta.tauniverse.com/Downloads/ta-cob-fmt.txt
 //Information on missing fields from Format_Cob.pas
 typedef struct tagCOBHeader
@@ -164,6 +163,9 @@ CCobFile::CCobFile(CFileHandler& in, const std::string& scriptName)
 
 	numStaticVars = ch.NumberOfStaticVars;
 
+	// the same for every client, so that all of them run the same interpreter
+	CobDecoder::Decode(code, scriptNames, scriptOffsets, scriptLengths, ops);
+
 	// if this is a TA:K script, read the sound names
 	if (ch.VersionSignature == 6) {
 		sounds.reserve(ch.NumberOfSounds);
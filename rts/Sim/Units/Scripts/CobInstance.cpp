@@ -561,7 +561,7 @@ int CCobInstance::RealCall(int functionId, std::array<int, 1 + MAX_COB_ARGS>& ar
 
 	// tick the thread locally in case we're recursively running this function and then the threads may reallocate
 	CCobThread newThread(this);
-	newThread.SetID(cobEngine->GenThreadID());
+	newThread.SetID(cobEngine->GenThreadID(), cobEngine->GenThreadSeqNum());
 
 	// make sure this is run even if the call terminates instantly
 	if (cb != CBNone)
@@ -596,6 +596,9 @@ int CCobInstance::RealCall(int functionId, std::array<int, 1 + MAX_COB_ARGS>& ar
 		// dtor runs the callback
 		if (retCode != nullptr)
 			*retCode = newThread.GetRetCode();
+
+		// thread never made it into the engine, give back its slot
+		cobEngine->ReleaseThreadID(newThread.GetID());
 	} else {
 		cobEngine->AddThread(std::move(newThread));
 	}
@@ -0,0 +1,1110 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef COB_INTERPRETER_H
+#define COB_INTERPRETER_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "CobDecoder.h"
+#include "CobOpcodes.h"
+#include "System/creg/creg_cond.h"
+#include "System/Log/ILog.h"
+#include "System/Misc/TracyDefs.h"
+
+
+struct CCobCallInfo {
+	CR_DECLARE_STRUCT(CCobCallInfo)
+	int functionId = -1;
+	int returnAddr = -1;
+	int stackTop = -1;
+};
+
+
+/**
+ * The state of a COB thread and the two interpreters running it, apart from
+ * everything the thread calls out to. <Thread> derives from this and has to
+ * provide
+ *   cobInst                     script instance with staticVars and the
+ *                               unit callouts (Move, Turn, NeedsWait, ...)
+ *   ANIM_TURN, ANIM_MOVE        animation types passed to NeedsWait
+ *   GetCurrTime, Schedule       sleeping
+ *   StartThread, LuaCall        START and Lua calls
+ *   RandInt, InFireScript
+ * and <File> the fields of CCobFile that the interpreters read.
+ *
+ * CCobThread is the only Thread in the engine; tests run the same interpreters
+ * with their own callouts.
+ */
+template<typename Thread, typename File>
+class CCobInterpreter
+{
+public:
+	enum State {Init, Sleep, Run, Dead, WaitTurn, WaitMove};
+
+	static constexpr int NUM_LUA_ARGS = LUA9 - LUA0 + 1;
+
+	using CallInfo = CCobCallInfo;
+
+	/**
+	 * Shows an errormessage which includes the current state of the script
+	 * interpreter.
+	 */
+	void ShowError(const char* msg);
+
+	File* cobFile = nullptr;
+
+protected:
+	/// interprets cobFile->code directly
+	void TickRaw();
+	/// runs cobFile->ops, the same code decoded at load time
+	void TickDecoded();
+
+	Thread* Self() { return static_cast<Thread*>(this); }
+	auto* Inst() { return (Self()->cobInst); }
+
+	void PushCallStack(CallInfo v) { callStack.push_back(v); }
+	void PushDataStack(int v) { dataStack.push_back(v); }
+	CallInfo& PushCallStackRef() { return callStack.emplace_back(); }
+
+	int LocalFunctionID() const { return callStack.back().functionId; }
+	int LocalReturnAddr() const { return callStack.back().returnAddr; }
+	int LocalStackFrame() const { return callStack.back().stackTop; }
+
+	int PopDataStack() {
+		if (dataStack.empty()) {
+			return 0;
+		}
+		int ret = dataStack.back();
+		dataStack.pop_back();
+		return ret;
+	}
+
+protected:
+	int pc = 0;
+
+	int wakeTime = 0;
+	int paramCount = 0;
+	int retCode = -1;
+	int signalMask = 0;
+
+	int waitAxis = -1;
+	int waitPiece = -1;
+
+	int errorCounter = 100;
+
+	int luaArgs[NUM_LUA_ARGS] = {0};
+
+
+	std::vector<CallInfo> callStack;
+	std::vector<int> dataStack;
+	// std::vector<int> execTrace;
+
+	State state = Init;
+};
+
+
+
+#if 0
+#define GET_LONG_PC() (cobFile->code[pc++])
+#else
+// mantis #5981
+#define GET_LONG_PC() (cobFile->code.at(pc++))
+#endif
+
+
+template<typename Thread, typename File>
+void CCobInterpreter<Thread, File>::TickRaw()
+{
+	int r1, r2, r3, r4, r5, r6;
+
+	while (state == Run) {
+		const int opcode = GET_LONG_PC();
+
+		switch (opcode) {
+			case PUSH_CONSTANT: {
+				r1 = GET_LONG_PC();
+				PushDataStack(r1);
+			} break;
+			case SLEEP: {
+				r1 = PopDataStack();
+				wakeTime = Self()->GetCurrTime() + r1;
+				state = Sleep;
+
+				Self()->Schedule();
+				return;
+			} break;
+			case SPIN: {
+				r1 = GET_LONG_PC();
+				r2 = GET_LONG_PC();
+				r3 = PopDataStack();         // speed
+				r4 = PopDataStack();         // accel
+				Inst()->Spin(r1, r2, r3, r4);
+			} break;
+			case STOP_SPIN: {
+				r1 = GET_LONG_PC();
+				r2 = GET_LONG_PC();
+				r3 = PopDataStack();         // decel
+
+				Inst()->StopSpin(r1, r2, r3);
+			} break;
+			case RETURN: {
+				retCode = PopDataStack();
+
+				if (LocalReturnAddr() == -1) {
+					state = Dead;
+
+					// leave values intact on stack in case caller wants to check them
+					// callStackSize -= 1;
+					return;
+				}
+
+				// return to caller
+				pc = LocalReturnAddr();
+				if (dataStack.size() > LocalStackFrame())
+					dataStack.resize(LocalStackFrame());
+
+				callStack.pop_back();
+			} break;
+
+
+			case SHADE: {
+				r1 = GET_LONG_PC();
+			} break;
+			case DONT_SHADE: {
+				r1 = GET_LONG_PC();
+			} break;
+			case CACHE: {
+				r1 = GET_LONG_PC();
+			} break;
+			case DONT_CACHE: {
+				r1 = GET_LONG_PC();
+			} break;
+
+
+			case CALL: {
+				r1 = GET_LONG_PC();
+				pc--;
+
+				if (cobFile->scriptNames[r1].find("lua_") == 0) {
+					cobFile->code[pc - 1] = LUA_CALL;
+					r1 = GET_LONG_PC();
+					r2 = GET_LONG_PC();
+					Self()->LuaCall(r1, r2);
+					break;
+				}
+
+				cobFile->code[pc - 1] = REAL_CALL;
+
+				// fall-through
+			}
+			case REAL_CALL: {
+				r1 = GET_LONG_PC();
+				r2 = GET_LONG_PC();
+
+				// do not call zero-length functions
+				if (cobFile->scriptLengths[r1] == 0)
+					break;
+
+				CallInfo& ci = PushCallStackRef();
+				ci.functionId = r1;
+				ci.returnAddr = pc;
+				ci.stackTop = dataStack.size() - r2;
+
+				paramCount = r2;
+
+				// call cobFile->scriptNames[r1]
+				pc = cobFile->scriptOffsets[r1];
+			} break;
+			case LUA_CALL: {
+				r1 = GET_LONG_PC();
+				r2 = GET_LONG_PC();
+				Self()->LuaCall(r1, r2);
+			} break;
+
+
+			case POP_STATIC: {
+				r1 = GET_LONG_PC();
+				r2 = PopDataStack();
+
+				if (static_cast<size_t>(r1) < Inst()->staticVars.size())
+					Inst()->staticVars[r1] = r2;
+			} break;
+			case POP_STACK: {
+				PopDataStack();
+			} break;
+
+
+			case START: {
+				r1 = GET_LONG_PC();
+				r2 = GET_LONG_PC();
+
+				if (cobFile->scriptLengths[r1] == 0)
+					break;
+
+
+				Self()->StartThread(r1, r2);
+			} break;
+
+			case CREATE_LOCAL_VAR: {
+				if (paramCount == 0) {
+					PushDataStack(0);
+				} else {
+					paramCount--;
+				}
+			} break;
+			case GET_UNIT_VALUE: {
+				r1 = PopDataStack();
+				if ((r1 >= LUA0) && (r1 <= LUA9)) {
+					PushDataStack(luaArgs[r1 - LUA0]);
+					break;
+				}
+				r1 = Inst()->GetUnitVal(r1, 0, 0, 0, 0);
+				PushDataStack(r1);
+			} break;
+
+
+			case JUMP_NOT_EQUAL: {
+				r1 = GET_LONG_PC();
+				r2 = PopDataStack();
+
+				if (r2 == 0)
+					pc = r1;
+
+			} break;
+			case JUMP: {
+				r1 = GET_LONG_PC();
+				// this seem to be an error in the docs..
+				//r2 = cobFile->scriptOffsets[LocalFunctionID()] + r1;
+				pc = r1;
+			} break;
+
+
+			case POP_LOCAL_VAR: {
+				r1 = GET_LONG_PC();
+				r2 = PopDataStack();
+				dataStack[LocalStackFrame() + r1] = r2;
+			} break;
+			case PUSH_LOCAL_VAR: {
+				r1 = GET_LONG_PC();
+				r2 = dataStack[LocalStackFrame() + r1];
+				PushDataStack(r2);
+			} break;
+
+
+			case BITWISE_AND: {
+				r1 = PopDataStack();
+				r2 = PopDataStack();
+				PushDataStack(r1 & r2);
+			} break;
+			case BITWISE_OR: {
+				r1 = PopDataStack();
+				r2 = PopDataStack();
+				PushDataStack(r1 | r2);
+			} break;
+			case BITWISE_XOR: {
+				r1 = PopDataStack();
+				r2 = PopDataStack();
+				PushDataStack(r1 ^ r2);
+			} break;
+			case BITWISE_NOT: {
+				r1 = PopDataStack();
+				PushDataStack(~r1);
+			} break;
+
+			case EXPLODE: {
+				r1 = GET_LONG_PC();
+				r2 = PopDataStack();
+				Inst()->Explode(r1, r2);
+			} break;
+
+			case PLAY_SOUND: {
+				r1 = GET_LONG_PC();
+				r2 = PopDataStack();
+				Inst()->PlayUnitSound(r1, r2);
+			} break;
+
+			case PUSH_STATIC: {
+				r1 = GET_LONG_PC();
+
+				if (static_cast<size_t>(r1) < Inst()->staticVars.size())
+					PushDataStack(Inst()->staticVars[r1]);
+			} break;
+
+			case SET_NOT_EQUAL: {
+				r1 = PopDataStack();
+				r2 = PopDataStack();
+
+				PushDataStack(int(r1 != r2));
+			} break;
+			case SET_EQUAL: {
+				r1 = PopDataStack();
+				r2 = PopDataStack();
+
+				PushDataStack(int(r1 == r2));
+			} break;
+
+			case SET_LESS: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+
+				PushDataStack(int(r1 < r2));
+			} break;
+			case SET_LESS_OR_EQUAL: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+
+				PushDataStack(int(r1 <= r2));
+			} break;
+
+			case SET_GREATER: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+
+				PushDataStack(int(r1 > r2));
+			} break;
+			case SET_GREATER_OR_EQUAL: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+
+				PushDataStack(int(r1 >= r2));
+			} break;
+
+			case RAND: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+				r3 = Self()->RandInt(r2 - r1 + 1) + r1;
+				PushDataStack(r3);
+			} break;
+			case EMIT_SFX: {
+				r1 = PopDataStack();
+				r2 = GET_LONG_PC();
+				Inst()->EmitSfx(r1, r2);
+			} break;
+			case MUL: {
+				r1 = PopDataStack();
+				r2 = PopDataStack();
+				PushDataStack(r1 * r2);
+			} break;
+
+
+			case SIGNAL: {
+				r1 = PopDataStack();
+				Inst()->Signal(r1);
+			} break;
+			case SET_SIGNAL_MASK: {
+				r1 = PopDataStack();
+				signalMask = r1;
+			} break;
+
+
+			case TURN: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+				r3 = GET_LONG_PC(); // piece
+				r4 = GET_LONG_PC(); // axis
+
+				Inst()->Turn(r3, r4, r1, r2);
+			} break;
+			case GET: {
+				r5 = PopDataStack();
+				r4 = PopDataStack();
+				r3 = PopDataStack();
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+				if ((r1 >= LUA0) && (r1 <= LUA9)) {
+					PushDataStack(luaArgs[r1 - LUA0]);
+					break;
+				}
+				r6 = Inst()->GetUnitVal(r1, r2, r3, r4, r5);
+				PushDataStack(r6);
+			} break;
+			case ADD: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+				PushDataStack(r1 + r2);
+			} break;
+			case SUB: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+				r3 = r1 - r2;
+				PushDataStack(r3);
+			} break;
+
+			case DIV: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+
+				if (r2 != 0) {
+					r3 = r1 / r2;
+				} else {
+					r3 = 1000; // infinity!
+					ShowError("division by zero");
+				}
+				PushDataStack(r3);
+			} break;
+			case MOD: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+
+				if (r2 != 0) {
+					PushDataStack(r1 % r2);
+				} else {
+					PushDataStack(0);
+					ShowError("modulo division by zero");
+				}
+			} break;
+
+
+			case MOVE: {
+				r1 = GET_LONG_PC();
+				r2 = GET_LONG_PC();
+				r4 = PopDataStack();
+				r3 = PopDataStack();
+				Inst()->Move(r1, r2, r3, r4);
+			} break;
+			case MOVE_NOW: {
+				r1 = GET_LONG_PC();
+				r2 = GET_LONG_PC();
+				r3 = PopDataStack();
+				Inst()->MoveNow(r1, r2, r3);
+			} break;
+			case TURN_NOW: {
+				r1 = GET_LONG_PC();
+				r2 = GET_LONG_PC();
+				r3 = PopDataStack();
+				Inst()->TurnNow(r1, r2, r3);
+			} break;
+
+
+			case WAIT_TURN: {
+				r1 = GET_LONG_PC();
+				r2 = GET_LONG_PC();
+
+				if (Inst()->NeedsWait(Thread::ANIM_TURN, r1, r2)) {
+					state = WaitTurn;
+					waitPiece = r1;
+					waitAxis = r2;
+					return;
+				}
+			} break;
+			case WAIT_MOVE: {
+				r1 = GET_LONG_PC();
+				r2 = GET_LONG_PC();
+
+				if (Inst()->NeedsWait(Thread::ANIM_MOVE, r1, r2)) {
+					state = WaitMove;
+					waitPiece = r1;
+					waitAxis = r2;
+					return;
+				}
+			} break;
+
+
+			case SET: {
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+
+				if ((r1 >= LUA0) && (r1 <= LUA9)) {
+					luaArgs[r1 - LUA0] = r2;
+					break;
+				}
+
+				Inst()->SetUnitVal(r1, r2);
+			} break;
+
+
+			case ATTACH: {
+				r3 = PopDataStack();
+				r2 = PopDataStack();
+				r1 = PopDataStack();
+				Inst()->AttachUnit(r2, r1);
+			} break;
+			case DROP: {
+				r1 = PopDataStack();
+				Inst()->DropUnit(r1);
+			} break;
+
+			// like bitwise ops, but only on values 1 and 0
+			case LOGICAL_NOT: {
+				r1 = PopDataStack();
+				PushDataStack(int(r1 == 0));
+			} break;
+			case LOGICAL_AND: {
+				r1 = PopDataStack();
+				r2 = PopDataStack();
+				PushDataStack(int(r1 && r2));
+			} break;
+			case LOGICAL_OR: {
+				r1 = PopDataStack();
+				r2 = PopDataStack();
+				PushDataStack(int(r1 || r2));
+			} break;
+			case LOGICAL_XOR: {
+				r1 = PopDataStack();
+				r2 = PopDataStack();
+				PushDataStack(int((!!r1) ^ (!!r2)));
+			} break;
+
+
+			case HIDE: {
+				r1 = GET_LONG_PC();
+				Inst()->SetVisibility(r1, false);
+			} break;
+
+			case SHOW: {
+				r1 = GET_LONG_PC();
+
+				// if true, we are in a Fire-script and should show a special flare effect
+				if (Self()->InFireScript()) {
+					Inst()->ShowFlare(r1);
+				} else {
+					Inst()->SetVisibility(r1, true);
+				}
+			} break;
+
+			default: {
+				const char* name = cobFile->name.c_str();
+				const char* func = cobFile->scriptNames[LocalFunctionID()].c_str();
+
+				LOG_L(L_ERROR, "[COBThread::%s] unknown opcode %x (in %s:%s at %x)", __func__, opcode, name, func, pc - 1);
+
+				#if 0
+				auto ei = execTrace.begin();
+				while (ei != execTrace.end()) {
+					LOG_L(L_ERROR, "\tprogctr: %3x  opcode: %s", __func__, *ei, GetOpcodeName(cobFile->code[*ei]));
+					++ei;
+				}
+				#endif
+
+				state = Dead;
+				return;
+			} break;
+		}
+	}
+}
+
+// where supported, every handler dispatches the next instruction through its
+// own indirect jump (which predicts far better than the single one a switch
+// compiles to); elsewhere the same handlers are the cases of a switch
+#if defined(__GNUC__)
+	#define COB_COMPUTED_GOTO
+#endif
+
+template<typename Thread, typename File>
+void CCobInterpreter<Thread, File>::TickDecoded()
+{
+	const CobOp* ops = cobFile->ops.data();
+	const CobOp* op = nullptr;
+
+	// jumps and calls are checked by the decoder, this catches a thread that
+	// was started or loaded at a bad offset
+	if (static_cast<size_t>(pc) >= cobFile->ops.size())
+		throw std::out_of_range("[CCobThread::TickDecoded] pc out of range");
+
+	int r1, r2, r3, r4, r5;
+
+	#ifdef COB_COMPUTED_GOTO
+	#define COB_OP_LABEL(name) &&op_##name,
+	static const void* const dispatchTable[CobOp::NUM_OP_TYPES] = {COB_DECODED_OPS(COB_OP_LABEL)};
+	#undef COB_OP_LABEL
+
+	#define COB_CASE(name) op_##name:
+	#define COB_NEXT() do { op = &ops[pc]; goto *dispatchTable[op->type]; } while (false)
+
+	COB_NEXT();
+	#else
+	#define COB_CASE(name) case CobOp::OP_##name:
+	#define COB_NEXT() continue
+
+	for (;;) {
+	op = &ops[pc];
+
+	switch (op->type) {
+	#endif
+
+	// after calling out of the interpreter, which can kill the thread (SIGNAL)
+	#define COB_NEXT_IF_RUNNING() if (state != Run) { return; } COB_NEXT()
+
+	COB_CASE(NOP) {
+		pc = op->next;
+	} COB_NEXT();
+
+	COB_CASE(PUSH_CONSTANT) {
+		pc = op->next;
+		PushDataStack(op->args[0]);
+	} COB_NEXT();
+	COB_CASE(PUSH_LOCAL_VAR) {
+		pc = op->next;
+		r1 = dataStack[LocalStackFrame() + op->args[0]];
+		PushDataStack(r1);
+	} COB_NEXT();
+	COB_CASE(PUSH_STATIC) {
+		pc = op->next;
+
+		if (static_cast<size_t>(op->args[0]) < Inst()->staticVars.size())
+			PushDataStack(Inst()->staticVars[op->args[0]]);
+	} COB_NEXT();
+	COB_CASE(CREATE_LOCAL_VAR) {
+		pc = op->next;
+
+		if (paramCount == 0) {
+			PushDataStack(0);
+		} else {
+			paramCount--;
+		}
+	} COB_NEXT();
+	COB_CASE(POP_LOCAL_VAR) {
+		pc = op->next;
+		r1 = PopDataStack();
+		dataStack[LocalStackFrame() + op->args[0]] = r1;
+	} COB_NEXT();
+	COB_CASE(POP_STATIC) {
+		pc = op->next;
+		r1 = PopDataStack();
+
+		if (static_cast<size_t>(op->args[0]) < Inst()->staticVars.size())
+			Inst()->staticVars[op->args[0]] = r1;
+	} COB_NEXT();
+	COB_CASE(POP_STACK) {
+		pc = op->next;
+		PopDataStack();
+	} COB_NEXT();
+
+
+	COB_CASE(ADD) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+		PushDataStack(r1 + r2);
+	} COB_NEXT();
+	COB_CASE(SUB) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+		PushDataStack(r1 - r2);
+	} COB_NEXT();
+	COB_CASE(MUL) {
+		pc = op->next;
+		r1 = PopDataStack();
+		r2 = PopDataStack();
+		PushDataStack(r1 * r2);
+	} COB_NEXT();
+	COB_CASE(DIV) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+
+		if (r2 != 0) {
+			r3 = r1 / r2;
+		} else {
+			r3 = 1000; // infinity!
+			ShowError("division by zero");
+		}
+		PushDataStack(r3);
+	} COB_NEXT();
+	COB_CASE(MOD) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+
+		if (r2 != 0) {
+			PushDataStack(r1 % r2);
+		} else {
+			PushDataStack(0);
+			ShowError("modulo division by zero");
+		}
+	} COB_NEXT();
+	COB_CASE(BITWISE_AND) {
+		pc = op->next;
+		r1 = PopDataStack();
+		r2 = PopDataStack();
+		PushDataStack(r1 & r2);
+	} COB_NEXT();
+	COB_CASE(BITWISE_OR) {
+		pc = op->next;
+		r1 = PopDataStack();
+		r2 = PopDataStack();
+		PushDataStack(r1 | r2);
+	} COB_NEXT();
+	COB_CASE(BITWISE_XOR) {
+		pc = op->next;
+		r1 = PopDataStack();
+		r2 = PopDataStack();
+		PushDataStack(r1 ^ r2);
+	} COB_NEXT();
+	COB_CASE(BITWISE_NOT) {
+		pc = op->next;
+		r1 = PopDataStack();
+		PushDataStack(~r1);
+	} COB_NEXT();
+
+
+	COB_CASE(RAND) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+		PushDataStack(Self()->RandInt(r2 - r1 + 1) + r1);
+	} COB_NEXT();
+	COB_CASE(GET_UNIT_VALUE) {
+		pc = op->next;
+		r1 = PopDataStack();
+
+		if ((r1 >= LUA0) && (r1 <= LUA9)) {
+			PushDataStack(luaArgs[r1 - LUA0]);
+			COB_NEXT();
+		}
+
+		PushDataStack(Inst()->GetUnitVal(r1, 0, 0, 0, 0));
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(GET) {
+		pc = op->next;
+		r5 = PopDataStack();
+		r4 = PopDataStack();
+		r3 = PopDataStack();
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+
+		if ((r1 >= LUA0) && (r1 <= LUA9)) {
+			PushDataStack(luaArgs[r1 - LUA0]);
+			COB_NEXT();
+		}
+
+		PushDataStack(Inst()->GetUnitVal(r1, r2, r3, r4, r5));
+	} COB_NEXT_IF_RUNNING();
+
+
+	COB_CASE(SET_LESS) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+		PushDataStack(int(r1 < r2));
+	} COB_NEXT();
+	COB_CASE(SET_LESS_OR_EQUAL) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+		PushDataStack(int(r1 <= r2));
+	} COB_NEXT();
+	COB_CASE(SET_GREATER) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+		PushDataStack(int(r1 > r2));
+	} COB_NEXT();
+	COB_CASE(SET_GREATER_OR_EQUAL) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+		PushDataStack(int(r1 >= r2));
+	} COB_NEXT();
+	COB_CASE(SET_EQUAL) {
+		pc = op->next;
+		r1 = PopDataStack();
+		r2 = PopDataStack();
+		PushDataStack(int(r1 == r2));
+	} COB_NEXT();
+	COB_CASE(SET_NOT_EQUAL) {
+		pc = op->next;
+		r1 = PopDataStack();
+		r2 = PopDataStack();
+		PushDataStack(int(r1 != r2));
+	} COB_NEXT();
+	COB_CASE(LOGICAL_AND) {
+		pc = op->next;
+		r1 = PopDataStack();
+		r2 = PopDataStack();
+		PushDataStack(int(r1 && r2));
+	} COB_NEXT();
+	COB_CASE(LOGICAL_OR) {
+		pc = op->next;
+		r1 = PopDataStack();
+		r2 = PopDataStack();
+		PushDataStack(int(r1 || r2));
+	} COB_NEXT();
+	COB_CASE(LOGICAL_XOR) {
+		pc = op->next;
+		r1 = PopDataStack();
+		r2 = PopDataStack();
+		PushDataStack(int((!!r1) ^ (!!r2)));
+	} COB_NEXT();
+	COB_CASE(LOGICAL_NOT) {
+		pc = op->next;
+		r1 = PopDataStack();
+		PushDataStack(int(r1 == 0));
+	} COB_NEXT();
+
+
+	COB_CASE(START) {
+		pc = op->next;
+
+		Self()->StartThread(op->args[0], op->args[1]);
+	} COB_NEXT();
+	COB_CASE(REAL_CALL) {
+		CallInfo& ci = PushCallStackRef();
+		ci.functionId = op->args[0];
+		ci.returnAddr = op->next;
+		ci.stackTop = dataStack.size() - op->args[1];
+
+		paramCount = op->args[1];
+
+		pc = op->args[2];
+	} COB_NEXT();
+	COB_CASE(LUA_CALL) {
+		pc = op->next;
+		Self()->LuaCall(op->args[0], op->args[1]);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(JUMP) {
+		pc = op->args[0];
+	} COB_NEXT();
+	COB_CASE(RETURN) {
+		pc = op->next;
+		retCode = PopDataStack();
+
+		if (LocalReturnAddr() == -1) {
+			// leave values intact on stack in case caller wants to check them
+			state = Dead;
+			return;
+		}
+
+		// return to caller
+		pc = LocalReturnAddr();
+		if (dataStack.size() > LocalStackFrame())
+			dataStack.resize(LocalStackFrame());
+
+		callStack.pop_back();
+	} COB_NEXT();
+	COB_CASE(JUMP_NOT_EQUAL) {
+		pc = op->next;
+
+		if (PopDataStack() == 0)
+			pc = op->args[0];
+	} COB_NEXT();
+	COB_CASE(SIGNAL) {
+		pc = op->next;
+		Inst()->Signal(PopDataStack());
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(SET_SIGNAL_MASK) {
+		pc = op->next;
+		signalMask = PopDataStack();
+	} COB_NEXT();
+
+
+	COB_CASE(EXPLODE) {
+		pc = op->next;
+		r1 = PopDataStack();
+		Inst()->Explode(op->args[0], r1);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(PLAY_SOUND) {
+		pc = op->next;
+		r1 = PopDataStack();
+		Inst()->PlayUnitSound(op->args[0], r1);
+	} COB_NEXT_IF_RUNNING();
+
+
+	COB_CASE(SET) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+
+		if ((r1 >= LUA0) && (r1 <= LUA9)) {
+			luaArgs[r1 - LUA0] = r2;
+			COB_NEXT();
+		}
+
+		Inst()->SetUnitVal(r1, r2);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(ATTACH) {
+		pc = op->next;
+		r3 = PopDataStack();
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+		Inst()->AttachUnit(r2, r1);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(DROP) {
+		pc = op->next;
+		Inst()->DropUnit(PopDataStack());
+	} COB_NEXT_IF_RUNNING();
+
+
+	COB_CASE(MOVE) {
+		pc = op->next;
+		r2 = PopDataStack();
+		r1 = PopDataStack();
+		Inst()->Move(op->args[0], op->args[1], r1, r2);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(TURN) {
+		pc = op->next;
+		r2 = PopDataStack(); // speed
+		r1 = PopDataStack();
+		Inst()->Turn(op->args[0], op->args[1], r1, r2);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(SPIN) {
+		pc = op->next;
+		r1 = PopDataStack(); // speed
+		r2 = PopDataStack(); // accel
+		Inst()->Spin(op->args[0], op->args[1], r1, r2);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(STOP_SPIN) {
+		pc = op->next;
+		r1 = PopDataStack(); // decel
+		Inst()->StopSpin(op->args[0], op->args[1], r1);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(SHOW) {
+		pc = op->next;
+
+		// if true, we are in a Fire-script and should show a special flare effect
+		if (Self()->InFireScript()) {
+			Inst()->ShowFlare(op->args[0]);
+		} else {
+			Inst()->SetVisibility(op->args[0], true);
+		}
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(HIDE) {
+		pc = op->next;
+		Inst()->SetVisibility(op->args[0], false);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(MOVE_NOW) {
+		pc = op->next;
+		Inst()->MoveNow(op->args[0], op->args[1], PopDataStack());
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(TURN_NOW) {
+		pc = op->next;
+		Inst()->TurnNow(op->args[0], op->args[1], PopDataStack());
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(EMIT_SFX) {
+		pc = op->next;
+		Inst()->EmitSfx(PopDataStack(), op->args[0]);
+	} COB_NEXT_IF_RUNNING();
+
+
+	COB_CASE(WAIT_TURN) {
+		pc = op->next;
+
+		if (Inst()->NeedsWait(Thread::ANIM_TURN, op->args[0], op->args[1])) {
+			state = WaitTurn;
+			waitPiece = op->args[0];
+			waitAxis = op->args[1];
+			return;
+		}
+	} COB_NEXT();
+	COB_CASE(WAIT_MOVE) {
+		pc = op->next;
+
+		if (Inst()->NeedsWait(Thread::ANIM_MOVE, op->args[0], op->args[1])) {
+			state = WaitMove;
+			waitPiece = op->args[0];
+			waitAxis = op->args[1];
+			return;
+		}
+	} COB_NEXT();
+	COB_CASE(SLEEP) {
+		pc = op->next;
+		wakeTime = Self()->GetCurrTime() + PopDataStack();
+		state = Sleep;
+
+		Self()->Schedule();
+		return;
+	}
+
+
+	COB_CASE(SLEEP_CONST) {
+		pc = op->next;
+		wakeTime = Self()->GetCurrTime() + op->args[0];
+		state = Sleep;
+
+		Self()->Schedule();
+		return;
+	}
+	COB_CASE(MOVE_CONST) {
+		pc = op->next;
+		Inst()->Move(op->args[0], op->args[1], op->args[2], op->args[3]);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(TURN_CONST) {
+		pc = op->next;
+		Inst()->Turn(op->args[0], op->args[1], op->args[2], op->args[3]);
+	} COB_NEXT_IF_RUNNING();
+	COB_CASE(POP_LOCAL_CONST) {
+		pc = op->next;
+		dataStack[LocalStackFrame() + op->args[0]] = op->args[1];
+	} COB_NEXT();
+	COB_CASE(POP_STATIC_CONST) {
+		pc = op->next;
+
+		if (static_cast<size_t>(op->args[0]) < Inst()->staticVars.size())
+			Inst()->staticVars[op->args[0]] = op->args[1];
+	} COB_NEXT();
+	COB_CASE(JUMP_IF_LOCAL_ZERO) {
+		pc = op->next;
+
+		if (dataStack[LocalStackFrame() + op->args[0]] == 0)
+			pc = op->args[1];
+	} COB_NEXT();
+	COB_CASE(JUMP_IF_STATIC_ZERO) {
+		pc = op->next;
+
+		// an out-of-range PUSH_STATIC pushes nothing, JUMP_NOT_EQUAL then pops what is there
+		if (static_cast<size_t>(op->args[0]) < Inst()->staticVars.size()) {
+			r1 = Inst()->staticVars[op->args[0]];
+		} else {
+			r1 = PopDataStack();
+		}
+
+		if (r1 == 0)
+			pc = op->args[1];
+	} COB_NEXT();
+
+
+	COB_CASE(UNKNOWN) {
+		pc = op->next;
+
+		const char* name = cobFile->name.c_str();
+		const char* func = cobFile->scriptNames[LocalFunctionID()].c_str();
+
+		LOG_L(L_ERROR, "[COBThread::%s] unknown opcode %x (in %s:%s at %x)", __func__, op->args[0], name, func, pc - 1);
+
+		state = Dead;
+		return;
+	}
+	COB_CASE(OUT_OF_RANGE) {
+		// the raw interpreter's bounds-checked reads throw the same
+		throw std::out_of_range("[CCobThread::TickDecoded] pc out of range");
+	}
+
+	#ifndef COB_COMPUTED_GOTO
+	default: {
+		assert(false);
+		return;
+	}
+	}
+	}
+	#endif
+
+	#undef COB_NEXT_IF_RUNNING
+	#undef COB_NEXT
+	#undef COB_CASE
+}
+
+template<typename Thread, typename File>
+void CCobInterpreter<Thread, File>::ShowError(const char* msg)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	if ((errorCounter = std::max(errorCounter - 1, 0)) == 0)
+		return;
+
+	if (callStack.size() == 0) {
+		LOG_L(L_ERROR, "[COBThread::%s] %s outside script execution (?)", __func__, msg);
+		return;
+	}
+
+	const char* name = cobFile->name.c_str();
+	const char* func = cobFile->scriptNames[LocalFunctionID()].c_str();
+
+	LOG_L(L_ERROR, "[COBThread::%s] %s (in %s:%s at %x)", __func__, msg, name, func, pc - 1);
+}
+
+#undef COB_COMPUTED_GOTO
+#undef GET_LONG_PC
+
+#endif // COB_INTERPRETER_H
@@ -7,16 +7,18 @@
 #include <array>
 
 #include "CobInstance.h"
+#include "CobInterpreter.h"
 #include "Lua/LuaRules.h"
 
 class CCobFile;
 class CCobInstance;
 
 
-class CCobThread
+class CCobThread: public CCobInterpreter<CCobThread, CCobFile>
 {
 	CR_DECLARE_STRUCT(CCobThread)
-	CR_DECLARE_SUB(CallInfo)
+
+	friend class CCobInterpreter<CCobThread, CCobFile>;
 
 public:
 	// default and copy-ctor are creg only
@@ -31,8 +33,6 @@ public:
 	CCobThread& operator = (CCobThread&& t);
 	CCobThread& operator = (const CCobThread& t);
 
-	enum State {Init, Sleep, Run, Dead, WaitTurn, WaitMove};
-
 	/**
 	 * Returns false if this thread is dead and needs to be killed.
 	 */
@@ -45,7 +45,10 @@ public:
 	void Start(int functionId, int sigMask, const std::array<int, 1 + MAX_COB_ARGS>& args, bool schedule);
 	void Stop();
 
-	void SetID(int threadID) { id = threadID; }
+	void SetID(int threadID, int threadSeqNum) {
+		id = threadID;
+		seqNum = threadSeqNum;
+	}
 	void SetState(State s) { state = s; }
 
 	/**
@@ -69,16 +72,12 @@ public:
 	int CheckStack(unsigned int size, bool warn);
 	void InitStack(unsigned int n, CCobThread* t);
 
-	/**
-	 * Shows an errormessage which includes the current state of the script
-	 * interpreter.
-	 */
-	void ShowError(const char* msg);
 	void AnimFinished(CUnitScript::AnimType type, int piece, int axis);
 
 	const std::string& GetName();
 
 	int GetID() const { return id; }
+	int GetSeqNum() const { return seqNum; }
 	int GetStackVal(int pos) const { return dataStack[pos]; }
 	int GetWakeTime() const { return wakeTime; }
 	int GetRetCode() const { return retCode; }
@@ -95,58 +94,24 @@ public:
 
 	// script instance that owns this thread
 	CCobInstance* cobInst = nullptr;
-	CCobFile* cobFile = nullptr;
 
 protected:
-	struct CallInfo {
-		CR_DECLARE_STRUCT(CallInfo)
-		int functionId = -1;
-		int returnAddr = -1;
-		int stackTop = -1;
-	};
-
-	void LuaCall();
-
-	void PushCallStack(CallInfo v) { callStack.push_back(v); }
-	void PushDataStack(int v) { dataStack.push_back(v); }
-	CallInfo& PushCallStackRef() { return callStack.emplace_back(); }
-
-	int LocalFunctionID() const { return callStack.back().functionId; }
-	int LocalReturnAddr() const { return callStack.back().returnAddr; }
-	int LocalStackFrame() const { return callStack.back().stackTop; }
-
-	int PopDataStack() {
-		if (dataStack.empty()) {
-			return 0;
-		}
-		int ret = dataStack.back();
-		dataStack.pop_back();
-		return ret;
-	}
+	// callouts of the interpreters, see CCobInterpreter
+	static constexpr CUnitScript::AnimType ANIM_TURN = CUnitScript::ATurn;
+	static constexpr CUnitScript::AnimType ANIM_MOVE = CUnitScript::AMove;
+
+	int GetCurrTime() const;
+	void Schedule();
+	void StartThread(int functionId, int argCount);
+	void LuaCall(int scriptId, int argCount);
+	int RandInt(int n) const;
+	bool InFireScript() const;
 
 protected:
 	int id = -1;
-	int pc = 0;
-
-	int wakeTime = 0;
-	int paramCount = 0;
-	int retCode = -1;
+	// creation order, breaks ties between threads waking on the same tick
+	int seqNum = -1;
 	int cbParam = 0;
-	int signalMask = 0;
-
-	int waitAxis = -1;
-	int waitPiece = -1;
-
-	int errorCounter = 100;
-
-	int luaArgs[MAX_LUA_COB_ARGS] = {0};
-
-
-	std::vector<CallInfo> callStack;
-	std::vector<int> dataStack;
-	// std::vector<int> execTrace;
-
-	State state = Init;
 
 	CCobInstance::ThreadCallbackType cbType = CCobInstance::CBNone;
 
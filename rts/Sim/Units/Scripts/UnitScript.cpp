@@ -101,110 +101,97 @@ CUnitScript::~CUnitScript()
 
 
 /**
- * @brief Updates move animations
- * @param cur float value to update
- * @param dest float final value
- * @param speed float max increment per tick
- * @return returns true if destination was reached, false otherwise
+ * @brief The multithreaded first half of the original CUnitScript::Tick function first does the heavy lifting of calculating all
+			  new piece positions according to the animations. Every animation type of a whole range of scripts is advanced as
+			  one batch by the UnitScriptAnimSIMD kernels, so the range must not share pieces with any other being ticked.
+ * @param finished set to 1 for every script that has finished animations or none left, which TickAnimFinished must then see
  */
-bool CUnitScript::MoveToward(float& cur, float dest, float speed)
+void CUnitScript::TickAllAnims(CUnitScript* const* scripts, std::uint8_t* finished, size_t numScripts, int deltaTime, UnitScriptAnimSIMD::AnimBatch& batch)
 {
-	const float delta = dest - cur;
+	ZoneScoped;
 
-	if (math::fabsf(delta) <= speed) {
-		cur = dest;
-		return true;
-	}
+	const UnitScriptAnimSIMD::TickAnimsFunc tickAnimFuncs[] = {
+		UnitScriptAnimSIMD::TickTurns,
+		UnitScriptAnimSIMD::TickSpins,
+		UnitScriptAnimSIMD::TickMoves,
+	};
 
-	cur += (speed * Sign(delta));
-	return false;
-}
+	const int tickRate = 1000 / deltaTime;
 
+	for (int animType = ATurn; animType <= AMove; animType++) {
+		batch.Clear();
 
-/**
- * @brief Updates turn animations
- * @param cur float value to update
- * @param dest float final value
- * @param speed float max increment per tick
- * @return returns true if destination was reached, false otherwise
- */
-bool CUnitScript::TurnToward(float& cur, float dest, float speed)
-{
-	assert(dest < math::TWOPI);
-	assert(cur  < math::TWOPI);
+		for (size_t n = 0; n < numScripts; n++) {
+			const CUnitScript* script = scripts[n];
 
-	float delta = math::fmod(dest - cur + math::THREEPI, math::TWOPI) - math::PI;
+			for (const AnimInfo& ai: script->anims[animType]) {
+				const LocalModelPiece& lmp = *script->pieces[ai.piece];
 
-	if (math::fabsf(delta) <= speed) {
-		cur = dest;
-		return true;
-	}
+				const float cur = (animType == AMove)? lmp.GetPosition()[ai.axis]: lmp.GetRotation()[ai.axis];
 
-	cur = ClampRad(cur + speed * Sign(delta));
-	return false;
-}
+				batch.AddLane(cur, ai.speed, ai.dest, ai.accel);
+			}
+		}
 
+		if (batch.cur.empty())
+			continue;
 
-/**
- * @brief Updates spin animations
- * @param cur float value to update
- * @param dest float the final desired speed (NOT the final angle!)
- * @param speed float is updated if it is not equal to dest
- * @param divisor int is the deltatime, it is not added before the call because speed may have to be updated
- * @return true if the desired speed is 0 and it is reached, false otherwise
- */
-bool CUnitScript::DoSpin(float& cur, float dest, float& speed, float accel, int divisor)
-{
-	const float delta = dest - speed;
+		tickAnimFuncs[animType](batch.GetLanes(), tickRate);
 
-	// Check if we are not at the final speed and
-	// make sure we do not go past desired speed
-	if (math::fabsf(delta) <= accel) {
-		if ((speed = dest) == 0.0f)
-			return true;
-	} else {
-		// accelerations are defined in speed/frame (at GAME_SPEED fps)
-		speed += (accel * (GAME_SPEED * 1.0f / divisor) * Sign(delta));
-	}
+		for (size_t n = 0, lane = 0; n < numScripts; n++) {
+			CUnitScript* script = scripts[n];
 
-	cur = ClampRad(cur + (speed / divisor));
-	return false;
-}
+			auto& currAnims = script->anims[animType];
+			auto& currDoneAnims = script->doneAnims[animType];
 
-/**
- * @brief The multithreaded first half of the original CUnitScript::Tick function first does the heavy lifting of calculating all
-			  new piece positions according to the animations
-*/
-void CUnitScript::TickAllAnims(int deltaTime)
-{
-	ZoneScoped;
+			// note: must copy-and-set here (LMP dirty flag, etc)
+			for (size_t i = 0; i < currAnims.size(); i++) {
+				AnimInfo& ai = currAnims[i];
+				LocalModelPiece& lmp = *script->pieces[ai.piece];
 
-	// tick-functions; these never change address
-	static constexpr std::array<TickAnimFunc, AMove + 1> TICK_ANIM_FUNCS = { &CUnitScript::TickTurnAnim, &CUnitScript::TickSpinAnim, &CUnitScript::TickMoveAnim };
+				if (animType == AMove) {
+					float3 pos = lmp.GetPosition();
+					pos[ai.axis] = batch.cur[lane + i];
+					lmp.SetPosition(pos);
+				} else {
+					float3 rot = lmp.GetRotation();
+					rot[ai.axis] = batch.cur[lane + i];
+					lmp.SetRotation(rot);
+				}
 
-	const int tickRate = 1000 / deltaTime;
+				ai.speed = batch.speed[lane + i];
+			}
 
-	for (int animType = ATurn; animType <= AMove; animType++) {
-		auto& currAnims = anims[animType];
-		const auto& currFunc = TICK_ANIM_FUNCS[animType];
-		auto& currDoneAnims = doneAnims[animType];
+			// remove finished animations in the same order as when each was
+			// ticked right before its removal; the flags move along with them
+			std::uint8_t* doneFlags = &batch.done[lane];
+
+			lane += currAnims.size();
 
-		for (size_t i = 0; i < currAnims.size(); ) {
-			AnimInfo& ai = currAnims[i];
-			LocalModelPiece& lmp = *pieces[ai.piece];
+			for (size_t i = 0; i < currAnims.size(); ) {
+				AnimInfo& ai = currAnims[i];
+
+				if (!(ai.done |= doneFlags[i])) {
+					++i;
+					continue;
+				}
 
-			if ((ai.done |= std::invoke(currFunc, this, tickRate, lmp, ai))) {
 				if (ai.hasWaiting)
 					currDoneAnims.emplace_back(ai);
 
 				ai = std::move(currAnims.back());
+				doneFlags[i] = doneFlags[currAnims.size() - 1];
 				currAnims.pop_back();
-				continue;
 			}
-
-			++i;
 		}
 	}
+
+	for (size_t n = 0; n < numScripts; n++) {
+		const CUnitScript* script = scripts[n];
+		const auto& currDoneAnims = script->doneAnims;
+
+		finished[n] = (!currDoneAnims[ATurn].empty() || !currDoneAnims[ASpin].empty() || !currDoneAnims[AMove].empty() || !script->HaveAnimations());
+	}
 }
 
 /**
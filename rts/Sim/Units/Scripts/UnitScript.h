@@ -5,9 +5,11 @@
 #ifndef UNIT_SCRIPT_H
 #define UNIT_SCRIPT_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "UnitScriptAnimSIMD.h"
 #include "Rendering/Models/3DModel.h"
 #include "System/creg/creg_cond.h"
 
@@ -40,8 +42,6 @@ protected:
 	typedef std::vector<AnimInfo> AnimContainerType;
 	typedef AnimContainerType::iterator AnimContainerTypeIt;
 
-	typedef bool(CUnitScript::*TickAnimFunc)(int, LocalModelPiece&, AnimInfo&);
-
 	std::array<AnimContainerType, AMove + 1> anims;
 	std::array<AnimContainerType, AMove + 1> doneAnims;
 
@@ -49,10 +49,6 @@ protected:
 	bool hasRockUnit;
 	bool hasStartBuilding;
 
-	bool MoveToward(float& cur, float dest, float speed);
-	bool TurnToward(float& cur, float dest, float speed);
-	bool DoSpin(float& cur, float dest, float& speed, float accel, int divisor);
-
 	AnimContainerTypeIt FindAnim(AnimType type, int piece, int axis);
 	void RemoveAnim(AnimType type, const AnimContainerTypeIt& animInfoIt);
 	void AddAnim(AnimType type, int piece, int axis, float speed, float dest, float accel);
@@ -106,12 +102,8 @@ public:
 	      CUnit* GetUnit()       { return unit; }
 	const CUnit* GetUnit() const { return unit; }
 
-	void TickAllAnims(int tickRate);
+	static void TickAllAnims(CUnitScript* const* scripts, std::uint8_t* finished, size_t numScripts, int deltaTime, UnitScriptAnimSIMD::AnimBatch& batch);
 	bool TickAnimFinished(int tickRate);
-	// note: must copy-and-set here (LMP dirty flag, etc)
-	bool TickMoveAnim(int tickRate, LocalModelPiece& lmp, AnimInfo& ai) { float3 pos = lmp.GetPosition(); const bool ret = MoveToward(pos[ai.axis], ai.dest, ai.speed / tickRate); lmp.SetPosition(pos); return ret; }
-	bool TickTurnAnim(int tickRate, LocalModelPiece& lmp, AnimInfo& ai) { float3 rot = lmp.GetRotation(); rot[ai.axis] = ClampRad(rot[ai.axis]); const bool ret = TurnToward(rot[ai.axis], ai.dest, ai.speed / tickRate         ); lmp.SetRotation(rot); return ret; }
-	bool TickSpinAnim(int tickRate, LocalModelPiece& lmp, AnimInfo& ai) { float3 rot = lmp.GetRotation(); rot[ai.axis] = ClampRad(rot[ai.axis]); const bool ret =     DoSpin(rot[ai.axis], ai.dest, ai.speed, ai.accel, tickRate); lmp.SetRotation(rot); return ret; }
 
 	// animation, used by CCobThread
 	void Spin(int piece, int axis, float speed, float accel);
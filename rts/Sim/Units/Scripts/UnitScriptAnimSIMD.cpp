@@ -0,0 +1,266 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <bit>
+
+#include "UnitScriptAnimSIMD.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "System/SpringMath.h"
+
+#include "xsimd/xsimd.hpp"
+
+namespace UnitScriptAnimSIMD {
+	/**
+	 * @brief Updates move animations
+	 * @param cur float value to update
+	 * @param dest float final value
+	 * @param speed float max increment per tick
+	 * @return returns true if destination was reached, false otherwise
+	 */
+	static inline bool MoveToward(float& cur, float dest, float speed)
+	{
+		const float delta = dest - cur;
+
+		if (math::fabsf(delta) <= speed) {
+			cur = dest;
+			return true;
+		}
+
+		cur += (speed * Sign(delta));
+		return false;
+	}
+
+	/**
+	 * @brief Updates turn animations
+	 * @param cur float value to update
+	 * @param dest float final value
+	 * @param speed float max increment per tick
+	 * @return returns true if destination was reached, false otherwise
+	 */
+	static inline bool TurnToward(float& cur, float dest, float speed)
+	{
+		assert(dest < math::TWOPI);
+		assert(cur  < math::TWOPI);
+
+		float delta = math::fmod(dest - cur + math::THREEPI, math::TWOPI) - math::PI;
+
+		if (math::fabsf(delta) <= speed) {
+			cur = dest;
+			return true;
+		}
+
+		cur = ClampRad(cur + speed * Sign(delta));
+		return false;
+	}
+
+	/**
+	 * @brief Updates spin animations
+	 * @param cur float value to update
+	 * @param dest float the final desired speed (NOT the final angle!)
+	 * @param speed float is updated if it is not equal to dest
+	 * @param divisor int is the deltatime, it is not added before the call because speed may have to be updated
+	 * @return true if the desired speed is 0 and it is reached, false otherwise
+	 */
+	static inline bool DoSpin(float& cur, float dest, float& speed, float accel, int divisor)
+	{
+		const float delta = dest - speed;
+
+		// Check if we are not at the final speed and
+		// make sure we do not go past desired speed
+		if (math::fabsf(delta) <= accel) {
+			if ((speed = dest) == 0.0f)
+				return true;
+		} else {
+			// accelerations are defined in speed/frame (at GAME_SPEED fps)
+			speed += (accel * (GAME_SPEED * 1.0f / divisor) * Sign(delta));
+		}
+
+		cur = ClampRad(cur + (speed / divisor));
+		return false;
+	}
+
+
+	static void TickTurnLanes(const AnimLanes& lanes, size_t i, size_t n, int tickRate)
+	{
+		for (; i < n; i++) {
+			float cur = ClampRad(lanes.cur[i]);
+
+			lanes.done[i] |= TurnToward(cur, lanes.dest[i], lanes.speed[i] / tickRate);
+			lanes.cur[i] = cur;
+		}
+	}
+
+	static void TickSpinLanes(const AnimLanes& lanes, size_t i, size_t n, int tickRate)
+	{
+		for (; i < n; i++) {
+			float cur = ClampRad(lanes.cur[i]);
+
+			lanes.done[i] |= DoSpin(cur, lanes.dest[i], lanes.speed[i], lanes.accel[i], tickRate);
+			lanes.cur[i] = cur;
+		}
+	}
+
+	static void TickMoveLanes(const AnimLanes& lanes, size_t i, size_t n, int tickRate)
+	{
+		for (; i < n; i++) {
+			lanes.done[i] |= MoveToward(lanes.cur[i], lanes.dest[i], lanes.speed[i] / tickRate);
+		}
+	}
+
+
+	void TickTurnsScalar(const AnimLanes& lanes, int tickRate) { TickTurnLanes(lanes, 0, lanes.count, tickRate); }
+	void TickSpinsScalar(const AnimLanes& lanes, int tickRate) { TickSpinLanes(lanes, 0, lanes.count, tickRate); }
+	void TickMovesScalar(const AnimLanes& lanes, int tickRate) { TickMoveLanes(lanes, 0, lanes.count, tickRate); }
+
+
+#if defined(XSIMD_X86_INSTR_SET) && (XSIMD_X86_INSTR_SET >= XSIMD_X86_SSE2_VERSION)
+	typedef xsimd::batch<float, 4> batch_t;
+	typedef xsimd::batch_bool<float, 4> batch_bool_t;
+
+	static inline batch_t SignedSpeed(const batch_t& delta, const batch_t& speed)
+	{
+		// speed * Sign(delta), where Sign(0) is -1
+		return xsimd::select(delta > batch_t(0.0f), speed, -speed);
+	}
+
+	static inline batch_t ClampRadBatch(batch_t f, batch_bool_t& exact)
+	{
+		f = f + batch_t(0.0f);
+
+		// floor as math::floor computes it, by truncation; this agrees with
+		// std::floor (up to the sign of zero, which the subtraction below
+		// does not see) for all quotients that fit an int, lanes with other
+		// quotients (or NaN) are recomputed by the scalar code
+		const batch_t q = f / batch_t(math::TWOPI);
+		const batch_t t = xsimd::to_float(xsimd::to_int(q));
+		const batch_t r = t - xsimd::select(t > q, batch_t(1.0f), batch_t(0.0f));
+
+		exact = exact & (xsimd::abs(q) < batch_t(2147483648.0f));
+
+		return (f - batch_t(math::TWOPI) * r);
+	}
+
+	static inline unsigned LaneMask(const batch_bool_t& b) { return _mm_movemask_ps(b); }
+
+	static inline void StoreDone(std::uint8_t* done, const batch_bool_t& finished)
+	{
+		for (unsigned mask = LaneMask(finished); mask != 0; mask &= (mask - 1)) {
+			done[std::countr_zero(mask)] = 1;
+		}
+	}
+
+
+	void TickTurnsSSE(const AnimLanes& lanes, int tickRate)
+	{
+		const batch_t tickRates{float(tickRate)};
+
+		const batch_t twoPi(math::TWOPI);
+		const batch_t fourPi(math::TWOPI * 2.0f);
+		// below 3 * 2pi, fmod(x, 2pi) of any x >= 0 is x - 2pi * n exactly with
+		// n in [0, 2] (Sterbenz), so stay clear of the rounded bound
+		const batch_t fmodLimit(math::TWOPI * 2.75f);
+
+		size_t i = 0;
+
+		for (; (i + 4) <= lanes.count; i += 4) {
+			const batch_t dest(&lanes.dest[i], xsimd::unaligned_mode());
+			const batch_t speed = batch_t(&lanes.speed[i], xsimd::unaligned_mode()) / tickRates;
+
+			batch_bool_t exact(true);
+
+			const batch_t cur = ClampRadBatch(batch_t(&lanes.cur[i], xsimd::unaligned_mode()), exact);
+			const batch_t x = (dest - cur) + batch_t(math::THREEPI);
+
+			exact = exact & (x >= batch_t(0.0f)) & (x < fmodLimit);
+
+			const batch_t rem = x - xsimd::select(x >= fourPi, fourPi, xsimd::select(x >= twoPi, twoPi, batch_t(0.0f)));
+			const batch_t delta = rem - batch_t(math::PI);
+
+			const batch_bool_t reached = (xsimd::abs(delta) <= speed);
+			const batch_t stepped = ClampRadBatch(cur + SignedSpeed(delta, speed), exact);
+
+			if (LaneMask(exact) != 0xF) {
+				TickTurnLanes(lanes, i, i + 4, tickRate);
+				continue;
+			}
+
+			xsimd::select(reached, dest, stepped).store_unaligned(&lanes.cur[i]);
+			StoreDone(&lanes.done[i], reached);
+		}
+
+		TickTurnLanes(lanes, i, lanes.count, tickRate);
+	}
+
+	void TickSpinsSSE(const AnimLanes& lanes, int tickRate)
+	{
+		const batch_t divisors{float(tickRate)};
+		const batch_t accelScales(GAME_SPEED * 1.0f / tickRate);
+
+		size_t i = 0;
+
+		for (; (i + 4) <= lanes.count; i += 4) {
+			const batch_t dest(&lanes.dest[i], xsimd::unaligned_mode());
+			const batch_t accel(&lanes.accel[i], xsimd::unaligned_mode());
+			const batch_t speed(&lanes.speed[i], xsimd::unaligned_mode());
+
+			batch_bool_t exact(true);
+
+			const batch_t cur = ClampRadBatch(batch_t(&lanes.cur[i], xsimd::unaligned_mode()), exact);
+			const batch_t delta = dest - speed;
+
+			const batch_bool_t reached = (xsimd::abs(delta) <= accel);
+			const batch_t newSpeed = xsimd::select(reached, dest, speed + SignedSpeed(delta, accel * accelScales));
+			const batch_bool_t stopped = reached & (newSpeed == batch_t(0.0f));
+
+			const batch_t spun = ClampRadBatch(cur + (newSpeed / divisors), exact);
+
+			if (LaneMask(exact) != 0xF) {
+				TickSpinLanes(lanes, i, i + 4, tickRate);
+				continue;
+			}
+
+			newSpeed.store_unaligned(&lanes.speed[i]);
+			xsimd::select(stopped, cur, spun).store_unaligned(&lanes.cur[i]);
+			StoreDone(&lanes.done[i], stopped);
+		}
+
+		TickSpinLanes(lanes, i, lanes.count, tickRate);
+	}
+
+	void TickMovesSSE(const AnimLanes& lanes, int tickRate)
+	{
+		const batch_t tickRates{float(tickRate)};
+
+		size_t i = 0;
+
+		for (; (i + 4) <= lanes.count; i += 4) {
+			const batch_t cur(&lanes.cur[i], xsimd::unaligned_mode());
+			const batch_t dest(&lanes.dest[i], xsimd::unaligned_mode());
+			const batch_t speed = batch_t(&lanes.speed[i], xsimd::unaligned_mode()) / tickRates;
+			const batch_t delta = dest - cur;
+
+			const batch_bool_t reached = (xsimd::abs(delta) <= speed);
+
+			xsimd::select(reached, dest, cur + SignedSpeed(delta, speed)).store_unaligned(&lanes.cur[i]);
+			StoreDone(&lanes.done[i], reached);
+		}
+
+		TickMoveLanes(lanes, i, lanes.count, tickRate);
+	}
+
+	TickAnimsFunc TickTurns = TickTurnsSSE;
+	TickAnimsFunc TickSpins = TickSpinsSSE;
+	TickAnimsFunc TickMoves = TickMovesSSE;
+
+	const char* GetImplName() { return "SSE"; }
+#else
+	void TickTurnsSSE(const AnimLanes& lanes, int tickRate) { TickTurnsScalar(lanes, tickRate); }
+	void TickSpinsSSE(const AnimLanes& lanes, int tickRate) { TickSpinsScalar(lanes, tickRate); }
+	void TickMovesSSE(const AnimLanes& lanes, int tickRate) { TickMovesScalar(lanes, tickRate); }
+
+	TickAnimsFunc TickTurns = TickTurnsScalar;
+	TickAnimsFunc TickSpins = TickSpinsScalar;
+	TickAnimsFunc TickMoves = TickMovesScalar;
+
+	const char* GetImplName() { return "Scalar"; }
+#endif
+}
@@ -0,0 +1,77 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef UNIT_SCRIPT_ANIM_SIMD_H
+#define UNIT_SCRIPT_ANIM_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/**
+ * Animation kernels for CUnitScript. A batch holds one lane per turn, spin
+ * or move animation, gathered from the animations of many scripts into flat
+ * arrays, and every lane is advanced by one tick. All implementations give
+ * the same bits as the scalar reference (no FMA contraction, see CMake), so
+ * piece transforms stay in sync whichever kernel runs.
+ */
+namespace UnitScriptAnimSIMD {
+	struct AnimLanes {
+		// piece position or rotation along the axis of each animation;
+		// rotations do not have to be clamped to [0, 2pi) beforehand
+		float* cur;
+		// speed is only written by spins
+		float* speed;
+		const float* dest;
+		const float* accel;
+		// set to 1 for every animation that has finished, left alone otherwise
+		std::uint8_t* done;
+
+		size_t count;
+	};
+
+	/// storage for the lanes of a batch, reused from one batch to the next
+	struct AnimBatch {
+		void Clear() {
+			cur.clear();
+			speed.clear();
+			dest.clear();
+			accel.clear();
+			done.clear();
+		}
+		void AddLane(float c, float s, float d, float a) {
+			cur.push_back(c);
+			speed.push_back(s);
+			dest.push_back(d);
+			accel.push_back(a);
+			done.push_back(0);
+		}
+
+		AnimLanes GetLanes() { return {cur.data(), speed.data(), dest.data(), accel.data(), done.data(), cur.size()}; }
+
+		std::vector<float> cur;
+		std::vector<float> speed;
+		std::vector<float> dest;
+		std::vector<float> accel;
+		std::vector<std::uint8_t> done;
+	};
+
+	typedef void (*TickAnimsFunc)(const AnimLanes& lanes, int tickRate);
+
+	void TickTurnsScalar(const AnimLanes& lanes, int tickRate);
+	void TickSpinsScalar(const AnimLanes& lanes, int tickRate);
+	void TickMovesScalar(const AnimLanes& lanes, int tickRate);
+
+	void TickTurnsSSE(const AnimLanes& lanes, int tickRate);
+	void TickSpinsSSE(const AnimLanes& lanes, int tickRate);
+	void TickMovesSSE(const AnimLanes& lanes, int tickRate);
+
+	/// widest implementation compiled in (SSE2 is part of the x86-64 baseline)
+	extern TickAnimsFunc TickTurns;
+	extern TickAnimsFunc TickSpins;
+	extern TickAnimsFunc TickMoves;
+
+	const char* GetImplName();
+}
+
+#endif
@@ -14,6 +14,7 @@
 #include "System/ContainerUtil.h"
 #include "System/SafeUtil.h"
 #include "System/Config/ConfigHandler.h"
+#include "System/Threading/ThreadPool.h"
 
 #include "System/Misc/TracyDefs.h"
 
@@ -32,12 +33,21 @@ CR_BIND(CUnitScriptEngine, )
 
 CR_REG_METADATA(CUnitScriptEngine, (
 	CR_MEMBER(animating),
+	// rewritten by every Tick
+	CR_IGNORED(animFinished),
+	CR_IGNORED(animBatches),
 
 	// always null when saving
-	CR_IGNORED(currentScript)
+	CR_IGNORED(currentScript),
+
+	CR_POSTLOAD(PostLoad)
 ))
 
 
+// scripts per CUnitScript::TickAllAnims call; their animations share a batch
+static constexpr int ANIM_BATCH_SCRIPTS = 64;
+
+
 void CUnitScriptEngine::InitStatic() {
 	RECOIL_DETAILED_TRACY_ZONE;
 	cobEngine = &gCobEngine;
@@ -105,13 +115,23 @@ void CUnitScriptEngine::ReloadScripts(const UnitDef* udef)
 }
 
 
+void CUnitScriptEngine::PostLoad()
+{
+	animFinished.clear();
+	animFinished.resize(animating.size(), 0);
+}
+
+
 void CUnitScriptEngine::AddInstance(CUnitScript* instance)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
 	if (instance == currentScript)
 		return;
 
+	// flagged, so instances added by AnimFinished callbacks in Tick are
+	// still visited by its loop (as they were when it visited every one)
 	spring::VectorInsertUnique(animating, instance/*, true*/);
+	animFinished.push_back(1);
 }
 
 void CUnitScriptEngine::RemoveInstance(CUnitScript* instance)
@@ -120,7 +140,18 @@ void CUnitScriptEngine::RemoveInstance(CUnitScript* instance)
 	if (instance == currentScript)
 		return;
 
-	spring::VectorErase(animating, instance);
+	const auto it = std::find(animating.begin(), animating.end(), instance);
+
+	if (it == animating.end())
+		return;
+
+	// same swap-and-pop as VectorErase, for both vectors
+	const size_t idx = it - animating.begin();
+
+	animating[idx] = animating.back();
+	animating.pop_back();
+	animFinished[idx] = animFinished.back();
+	animFinished.pop_back();
 }
 
 void CUnitScriptEngine::Tick(int deltaTime)
@@ -133,19 +164,39 @@ void CUnitScriptEngine::Tick(int deltaTime)
 	{
 		ZoneScopedN("CUnitScriptEngine::Tick(MT)");
 
+		const int numScripts = animating.size();
+		const int numBatches = (numScripts + ANIM_BATCH_SCRIPTS - 1) / ANIM_BATCH_SCRIPTS;
+
+		assert(animFinished.size() == animating.size());
+		animBatches.resize(ThreadPool::GetMaxThreads());
+
 		// setting currentScript = animating[i]; is not required here, only in ST section below
-		for_mt(0, animating.size(), [&](const int i) {
-			animating[i]->TickAllAnims(deltaTime);
+		for_mt(0, numBatches, [&](const int i) {
+			const int beg = i * ANIM_BATCH_SCRIPTS;
+			const int end = std::min(beg + ANIM_BATCH_SCRIPTS, numScripts);
+
+			CUnitScript::TickAllAnims(&animating[beg], &animFinished[beg], end - beg, deltaTime, animBatches[ThreadPool::GetThreadNum()]);
 		});
 	}
 	{
+		// only the flagged scripts have finished animations (or none left),
+		// visit them in order; callbacks may add or remove instances, which
+		// animFinished follows
 		ZoneScopedN("CUnitScriptEngine::Tick(ST)");
 		for (size_t i = 0; i < animating.size(); ) {
+			if (animFinished[i] == 0) {
+				i++;
+				continue;
+			}
+
+			animFinished[i] = 0;
 			currentScript = animating[i];
 
 			if (!currentScript->TickAnimFinished(deltaTime)) {
 				animating[i] = animating.back();
 				animating.pop_back();
+				animFinished[i] = animFinished.back();
+				animFinished.pop_back();
 				continue;
 			}
 			i++;
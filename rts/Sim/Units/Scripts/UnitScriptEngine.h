@@ -5,8 +5,10 @@
 #ifndef UNIT_SCRIPT_ENGINE_H
 #define UNIT_SCRIPT_ENGINE_H
 
+#include <cstdint>
 #include <vector>
 
+#include "UnitScriptAnimSIMD.h"
 #include "System/creg/creg_cond.h"
 
 struct UnitDef;
@@ -25,15 +27,29 @@ public:
 
 	void Tick(int deltaTime);
 
-	void Init() { animating.reserve(256); }
-	void Kill() { animating.clear(); }
+	void Init() {
+		animating.reserve(256);
+		animFinished.reserve(256);
+	}
+	void Kill() {
+		animating.clear();
+		animFinished.clear();
+	}
 
 	static void InitStatic();
 	static void KillStatic();
+private:
+	void PostLoad();
+
 private:
 	CUnitScript* currentScript = nullptr;
 
 	std::vector<CUnitScript*> animating;
+	// animFinished[i] is set if animating[i] has to run TickAnimFinished
+	std::vector<std::uint8_t> animFinished;
+
+	// per-thread scratch space for CUnitScript::TickAllAnims
+	std::vector<UnitScriptAnimSIMD::AnimBatch> animBatches;
 };
 
 extern CUnitScriptEngine* unitScriptEngine;
@@ -535,6 +535,12 @@ void CUnit::ForcedMove(const float3& newPos)
 	quadField.MovedUnit(this);
 }
 
+void CUnit::Moved()
+{
+	// the QuadField's exact queries test against its own copy
+	quadField.UpdateUnitSphere(this);
+}
+
 
 
 float3 CUnit::GetErrorVector(int argAllyTeam) const
@@ -2904,6 +2910,7 @@ CR_REG_METADATA(CUnit, (
 	CR_MEMBER(losStatus),
 	CR_MEMBER(posErrorMask),
 	CR_MEMBER(quads),
+	CR_IGNORED(quadSlots), // rebuilt by CQuadField::PostLoad
 
 
 	CR_MEMBER(loadingTransportId),
@@ -110,6 +110,7 @@ public:
 	virtual void Deactivate();
 
 	void ForcedMove(const float3& newPos);
+	void Moved();
 
 	void DeleteScript();
 	void EnableScriptMoveType();
@@ -327,6 +328,8 @@ public:
 
 	// quads the unit is part of
 	std::vector<int> quads;
+	// index of the unit in each of those quads' unit lists, same order as <quads>
+	std::vector<int> quadSlots;
 
 	std::vector<TransportedUnit> transportedUnits;
 	// incoming projectiles for which flares can cause retargeting
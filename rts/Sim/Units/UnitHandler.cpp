@@ -14,6 +14,7 @@
 #include "Sim/Ecs/Registry.h"
 #include "Sim/Misc/GlobalSynced.h"
 #include "Sim/Misc/ModInfo.h"
+#include "Sim/Misc/QuadField.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "Sim/MoveTypes/MoveType.h"
 #include "Sim/MoveTypes/Systems/GeneralMoveSystem.h"
@@ -21,6 +22,7 @@
 #include "Sim/MoveTypes/Systems/UnitTrapCheckSystem.h"
 #include "Sim/Path/IPathManager.h"
 #include "Sim/Weapons/Weapon.h"
+#include "Sim/Weapons/WeaponAutoTarget.h"
 #include "System/EventHandler.h"
 #include "System/Log/ILog.h"
 #include "System/SpringMath.h"
@@ -366,7 +368,9 @@ void CUnitHandler::SlowUpdateUnits()
 	// stagger the SlowUpdate's
 
 	static std::vector<CUnit*> updateBoundingVolumeList;
+	static std::vector<CWeapon*> autoTargetWeapons;
 	updateBoundingVolumeList.clear();
+	autoTargetWeapons.clear();
 	{
 		ZoneScopedN("Sim::Unit::SlowUpdateST");
 		for (size_t i = idxBeg; i < idxEnd; ++i) {
@@ -377,10 +381,28 @@ void CUnitHandler::SlowUpdateUnits()
 			unit->SlowUpdateWeapons();
 			unit->SanityCheck();
 
+			for (CWeapon* w: unit->weapons) {
+				if (w->HasPendingAutoTarget())
+					autoTargetWeapons.push_back(w);
+			}
+
 			if (!unit->isDead && unit->localModel.GetBoundariesNeedsRecalc())
 				updateBoundingVolumeList.emplace_back(unit);
 		}
 	}
+	// weapons only decide whether to look for a new target during SlowUpdate;
+	// the (read-only) search runs here for all of them at once and the Lua-
+	// facing part of the selection follows in the original weapon order
+	{
+		ZoneScopedN("Sim::Unit::AutoTargetMT");
+		for_mt(0, autoTargetWeapons.size(), [](int i) {
+			autoTargetWeapons[i]->GatherAutoTargets(ThreadPool::GetThreadNum());
+		});
+	}
+	{
+		ZoneScopedN("Sim::Unit::AutoTargetST");
+		WeaponAutoTarget::CommitTargets(autoTargetWeapons);
+	}
 	// Since the bounding volumes are calculated from the maximum piecematrix-offset piece vertices
 	// They dont have much of an effect if updated late-ish.
 	{
@@ -401,6 +423,7 @@ void CUnitHandler::UpdateUnits()
 
 		unit->SanityCheck();
 		unit->Update();
+		// units updated after this one have to see its new quads
 		unit->moveType->UpdateCollisionMap();
 		// unsynced; done on-demand when drawing unit
 		// unit->UpdateLocalModel();
@@ -30,6 +30,7 @@
 #include "System/creg/DefTypes.h"
 #include "System/Sound/ISoundChannels.h"
 #include "System/Log/ILog.h"
+#include "System/Threading/ThreadPool.h"
 
 #include "System/Misc/TracyDefs.h"
 
@@ -105,6 +106,8 @@ CR_REG_METADATA(CWeapon, (
 
 	CR_MEMBER(currentTarget),
 	CR_MEMBER(currentTargetPos),
+	CR_IGNORED(autoTargetPending),
+	CR_IGNORED(autoTargetCandidates),
 
 	CR_MEMBER(incomingProjectileIDs),
 
@@ -708,24 +711,55 @@ bool CWeapon::AllowWeaponAutoTarget() const
 bool CWeapon::AutoTarget()
 {
 	RECOIL_DETAILED_TRACY_ZONE;
+	if (!PrepareAutoTarget())
+		return false;
+
+	GatherAutoTargets(ThreadPool::GetThreadNum());
+	return (CommitAutoTarget());
+}
+
+bool CWeapon::PrepareAutoTarget()
+{
 	if (!AllowWeaponAutoTarget())
 		return false;
 
 	// search for other in-range targets
 	lastTargetRetry = gs->frameNum;
+	return (autoTargetPending = true);
+}
+
+void CWeapon::GatherAutoTargets(int thread)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	assert(autoTargetPending);
 
 	const CUnit* avoidUnit = (avoidTarget && HaveUnitTarget()) ? currentTarget.unit : nullptr;
 
+	CGameHelper::GatherWeaponTargets(this, avoidUnit, thread, autoTargetCandidates);
+}
+
+bool CWeapon::CommitAutoTarget()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	assert(autoTargetPending);
+	autoTargetPending = false;
+
+	// owner can die between SlowUpdate and the deferred commit
+	if (owner->isDead) {
+		autoTargetCandidates.clear();
+		return false;
+	}
+
 	CUnit* goodTargetUnit = nullptr;
 	CUnit*  badTargetUnit = nullptr;
 
 	auto& targetPairs = helper->targetPairs;
 
 	// NOTE:
-	//   GenerateWeaponTargets sorts by INCREASING order of priority, so lower equals better
+	//   CommitWeaponTargets sorts by INCREASING order of priority, so lower equals better
 	//   <targetPairs> is normally sorted such that all bad TargetCategory units live at the
 	//   end, but Lua can mess with the ordering arbitrarily
-	for (size_t i = 0, n = CGameHelper::GenerateWeaponTargets(this, avoidUnit, targetPairs); i < n; i++, assert(n == targetPairs.size())) {
+	for (size_t i = 0, n = CGameHelper::CommitWeaponTargets(this, autoTargetCandidates, targetPairs); i < n; i++, assert(n == targetPairs.size())) {
 		CUnit* unit = targetPairs[i].second;
 
 		// save the "best" bad target in case we have no other
@@ -752,6 +786,8 @@ bool CWeapon::AutoTarget()
 		break;
 	}
 
+	autoTargetCandidates.clear();
+
 	if (goodTargetUnit == nullptr)
 		goodTargetUnit = badTargetUnit;
 
@@ -795,8 +831,9 @@ void CWeapon::SlowUpdate()
 		//Try to return fire
 		Attack(owner->lastAttacker);
 	}
-	// AutoTarget: Find new/better Target
-	AutoTarget();
+	// AutoTarget: Find new/better Target; the search itself is
+	// done by CUnitHandler::SlowUpdateUnits after all SlowUpdates
+	PrepareAutoTarget();
 }
 
 
@@ -83,6 +83,14 @@ public:
 	virtual void UpdateRange(const float val) { range = val; }
 
 	bool AutoTarget();
+	/**
+	 * AutoTarget split into phases for CUnitHandler::SlowUpdateUnits, which
+	 * runs GatherAutoTargets for all weapons with a pending search in
+	 * parallel, then CommitAutoTarget for each of them in order.
+	 */
+	bool HasPendingAutoTarget() const { return autoTargetPending; }
+	void GatherAutoTargets(int thread);
+	bool CommitAutoTarget();
 	void AimReady(const int value);
 	void Fire(const bool scriptCall);
 
@@ -119,6 +127,7 @@ private:
 
 	void UpdateInterceptTarget();
 	bool AllowWeaponAutoTarget() const;
+	bool PrepareAutoTarget();
 	bool CobBlockShot() const;
 	bool CheckAimingAngle() const;
 	bool CanCallAimingScript(bool validAngle) const;
@@ -211,6 +220,10 @@ protected:
 	SWeaponTarget currentTarget;
 	float3 currentTargetPos;
 
+	// set by SlowUpdate, cleared by CommitAutoTarget (never saved, both run within one frame)
+	bool autoTargetPending = false;
+	std::vector<SWeaponTargetCandidate> autoTargetCandidates;
+
 	// projectiles that are on the way to our interception zone
 	// (eg. nuke toward a repulsor, or missile toward a shield)
 	std::vector<int> incomingProjectileIDs;
@@ -0,0 +1,49 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef WEAPON_AUTO_TARGET_H
+#define WEAPON_AUTO_TARGET_H
+
+#include <cstddef>
+#include <vector>
+
+namespace WeaponAutoTarget {
+	/**
+	 * Gives the weapons slaved (directly or through other slaves) to <master>
+	 * its current target. Slaves are always loaded after the weapon they are
+	 * slaved to, so only the weapons following <master> need to be visited.
+	 */
+	template<typename Weapon, typename Weapons>
+	void CloneSlavedTargets(const Weapons& weapons, const Weapon* master) {
+		for (std::size_t i = master->weaponNum + 1; i < weapons.size(); i++) {
+			Weapon* slave = weapons[i];
+
+			if (slave->slavedTo == nullptr || slave->slavedTo->weaponNum < master->weaponNum)
+				continue;
+
+			slave->SetAttackTarget(slave->slavedTo->GetCurrentTarget());
+		}
+	}
+
+	/**
+	 * Commits the deferred target searches of <weapons> in order.
+	 *
+	 * Slaved weapons clone their master's target in their own SlowUpdate,
+	 * which runs before the master's search is committed here; they are
+	 * handed the new target right away so they do not lag a slow update
+	 * behind. Templated on the weapon type for the unit tests.
+	 */
+	template<typename Weapon>
+	void CommitTargets(const std::vector<Weapon*>& weapons) {
+		for (Weapon* w: weapons) {
+			// an earlier Lua callin may already have resolved it
+			if (!w->HasPendingAutoTarget())
+				continue;
+			if (!w->CommitAutoTarget())
+				continue;
+
+			CloneSlavedTargets(w->owner->weapons, w);
+		}
+	}
+}
+
+#endif
@@ -48,4 +48,13 @@ public:
 	float3 groundPos;             // if targettype=ground: the ground position
 };
 
+
+// produced by CGameHelper::GatherWeaponTargets, consumed by CommitWeaponTargets
+struct SWeaponTargetCandidate {
+	CUnit* unit = nullptr;
+	float priority = 0.0f;
+	// TargetWeight and the LOS_PREVLOS terms still need to be applied
+	bool needsTargetWeight = false;
+};
+
 #endif // WEAPONTARGET_H
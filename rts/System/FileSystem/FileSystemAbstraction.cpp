@@ -393,6 +393,21 @@ bool FileSystemAbstraction::DeleteFile(const std::string& file)
 }
 
 
+bool FileSystemAbstraction::RenameFile(const std::string& from, const std::string& to)
+{
+	// unlike ::rename, this also replaces an existing target on Windows
+	std::error_code ec;
+	std::filesystem::rename(from, to, ec);
+
+	if (ec) {
+		LOG_L(L_WARNING, "[FSA::%s] error '%s' renaming file '%s' to '%s'", __func__, ec.message().c_str(), from.c_str(), to.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
 bool FileSystemAbstraction::FileExists(const std::string& file)
 {
 	struct stat info;
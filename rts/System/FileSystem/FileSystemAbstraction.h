@@ -28,6 +28,8 @@ public:
 	// almost direct wrappers to system calls
 	static bool MkDir(const std::string& dir);
 	static bool DeleteFile(const std::string& file);
+	/// moves <from> to <to>, replacing <to> in one step if it exists
+	static bool RenameFile(const std::string& from, const std::string& to);
 	/// Returns true if the file exists, and is not a directory
 	static bool FileExists(const std::string& file);
 	static bool DirExists(const std::string& dir);
@@ -17,12 +17,15 @@ public:
 	CGZFileHandler(const char* fileName, const char* modes = SPRING_VFS_RAW_FIRST);
 	CGZFileHandler(const std::string& fileName, const std::string& modes = SPRING_VFS_RAW_FIRST);
 
+protected:
+	/// inflates fileBuffer in place; it may hold several gzip members
+	bool UncompressBuffer();
+
 private:
 	bool TryReadFromPWD(const std::string& fileName) override;
 	bool TryReadFromRawFS(const std::string& fileName) override;
 	bool TryReadFromVFS(const std::string& fileName, int section) override;
 	bool ReadToBuffer(const std::string& path);
-	bool UncompressBuffer();
 };
 
 #endif // _GZ_FILE_HANDLER_H
@@ -0,0 +1,230 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "GzStreamWriter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <zlib.h>
+
+#include "System/Log/ILog.h"
+
+
+CGzStreamWriter::CGzStreamWriter(const std::string& _fileName, int _level, int numThreads, size_t _blockSize)
+	: fileName(_fileName)
+	, level(_level)
+	, blockSize(std::max(_blockSize, size_t(4096)))
+{
+	if ((file = fopen(fileName.c_str(), "wb")) == nullptr) {
+		LOG_L(L_ERROR, "[GzStreamWriter::%s] could not open \"%s\" for writing", __func__, fileName.c_str());
+		return;
+	}
+
+	if (numThreads <= 0)
+		numThreads = std::clamp(int(std::thread::hardware_concurrency() / 2), 1, 4);
+
+	curBlock = std::make_unique<Block>();
+	curBlock->input.reserve(blockSize);
+
+	workers.reserve(numThreads);
+
+	for (int i = 0; i < numThreads; i++) {
+		workers.emplace_back(&CGzStreamWriter::WorkerLoop, this);
+	}
+}
+
+CGzStreamWriter::~CGzStreamWriter()
+{
+	Close();
+}
+
+
+bool CGzStreamWriter::CompressMember(const std::uint8_t* data, size_t size, int level, std::vector<std::uint8_t>& member)
+{
+	z_stream zstream;
+	memset(&zstream, 0, sizeof(zstream));
+
+	// +16 writes a gzip instead of a zlib wrapper
+	if (deflateInit2(&zstream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+
+	member.resize(deflateBound(&zstream, size) + 32);
+
+	zstream.next_in = const_cast<std::uint8_t*>(data);
+	zstream.avail_in = size;
+	zstream.next_out = member.data();
+	zstream.avail_out = member.size();
+
+	int ret = Z_OK;
+
+	while ((ret = deflate(&zstream, Z_FINISH)) == Z_OK) {
+		// deflateBound is exact for the gzip wrapper in any recent zlib, but not in all of them
+		const size_t used = member.size() - zstream.avail_out;
+
+		member.resize(member.size() * 2);
+
+		zstream.next_out = member.data() + used;
+		zstream.avail_out = member.size() - used;
+	}
+
+	member.resize(zstream.total_out);
+	deflateEnd(&zstream);
+
+	return (ret == Z_STREAM_END);
+}
+
+
+void CGzStreamWriter::SetHeader(const void* data, size_t size)
+{
+	if (file == nullptr)
+		return;
+
+	std::lock_guard<spring::mutex> lock(mutex);
+
+	const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(data);
+
+	if (headerMemberSize != 0) {
+		// can only be patched in place if the stored member keeps its size
+		assert(size == headerData.size());
+
+		headerData.assign(bytes, bytes + std::min(size, headerData.size()));
+		headerChanged = true;
+		return;
+	}
+
+	assert(inputSize == 0);
+	headerData.assign(bytes, bytes + size);
+
+	std::vector<std::uint8_t> member;
+
+	if (!CompressMember(headerData.data(), headerData.size(), Z_NO_COMPRESSION, member) || !WriteMember(member))
+		return;
+
+	headerMemberSize = member.size();
+}
+
+void CGzStreamWriter::Write(const void* data, size_t size)
+{
+	if (file == nullptr)
+		return;
+
+	const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(data);
+
+	inputSize += size;
+
+	while (size > 0) {
+		const size_t n = std::min(size, blockSize - curBlock->input.size());
+
+		curBlock->input.insert(curBlock->input.end(), bytes, bytes + n);
+
+		bytes += n;
+		size -= n;
+
+		if (curBlock->input.size() < blockSize)
+			continue;
+
+		std::lock_guard<spring::mutex> lock(mutex);
+		SubmitBlock();
+	}
+}
+
+bool CGzStreamWriter::Close()
+{
+	if (file == nullptr)
+		return false;
+
+	{
+		std::lock_guard<spring::mutex> lock(mutex);
+
+		if (!curBlock->input.empty())
+			SubmitBlock();
+
+		closing = true;
+	}
+
+	// workers drain the queue before they exit
+	blockCond.notify_all();
+
+	for (spring::thread& worker: workers) {
+		worker.join();
+	}
+
+	workers.clear();
+	assert(blocks.empty() || failed);
+
+	if (headerChanged && !failed) {
+		std::vector<std::uint8_t> member;
+
+		if (!CompressMember(headerData.data(), headerData.size(), Z_NO_COMPRESSION, member) || member.size() != headerMemberSize) {
+			LOG_L(L_ERROR, "[GzStreamWriter::%s] header of \"%s\" changed size", __func__, fileName.c_str());
+			failed = true;
+		} else {
+			failed |= (fseek(file, 0, SEEK_SET) != 0);
+			failed |= !WriteMember(member);
+		}
+	}
+
+	failed |= (fclose(file) != 0);
+	file = nullptr;
+
+	if (failed)
+		LOG_L(L_ERROR, "[GzStreamWriter::%s] error writing \"%s\"", __func__, fileName.c_str());
+
+	return (!failed);
+}
+
+
+void CGzStreamWriter::SubmitBlock()
+{
+	blocks.emplace_back(std::move(curBlock));
+	blockCond.notify_one();
+
+	curBlock = std::make_unique<Block>();
+	curBlock->input.reserve(blockSize);
+}
+
+void CGzStreamWriter::WorkerLoop()
+{
+	std::unique_lock<spring::mutex> lock(mutex);
+
+	while (true) {
+		const auto pred = [](const std::unique_ptr<Block>& b) { return (!b->started); };
+		const auto iter = std::find_if(blocks.begin(), blocks.end(), pred);
+
+		if (iter == blocks.end()) {
+			if (closing)
+				break;
+
+			blockCond.wait(lock);
+			continue;
+		}
+
+		// blocks are only popped by whoever holds the lock after they were
+		// finished, so the pointer stays valid while compressing unlocked
+		Block* block = iter->get();
+		block->started = true;
+
+		lock.unlock();
+		const bool compressed = CompressMember(block->input.data(), block->input.size(), level, block->output);
+		lock.lock();
+
+		failed |= !compressed;
+		block->finished = true;
+		block->input = {};
+
+		WriteFinishedBlocks();
+	}
+}
+
+void CGzStreamWriter::WriteFinishedBlocks()
+{
+	while (!blocks.empty() && blocks.front()->finished) {
+		failed |= !WriteMember(blocks.front()->output);
+		blocks.pop_front();
+	}
+}
+
+bool CGzStreamWriter::WriteMember(const std::vector<std::uint8_t>& member)
+{
+	return (fwrite(member.data(), 1, member.size(), file) == member.size());
+}
@@ -0,0 +1,96 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _GZ_STREAM_WRITER_H
+#define _GZ_STREAM_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "System/Threading/SpringThreading.h"
+
+/**
+ * @brief Writes a gzip file in the background while data is still coming in
+ *
+ * Input is cut into blocks which worker threads owned by the writer compress
+ * as independent gzip members; these are appended to the file in input order.
+ * A sequence of members is itself a valid gzip file (RFC 1952), so anything
+ * that reads the old single-member files (gzread, CGZFileHandler, gunzip)
+ * reads these as well.
+ *
+ * Optionally the file can start with a header that is stored uncompressed
+ * in its own member: as long as its size stays the same it can be changed
+ * until the writer is closed, after which it is patched in place.
+ */
+class CGzStreamWriter
+{
+public:
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+	/// numThreads <= 0 picks a count based on the number of cores
+	CGzStreamWriter(const std::string& fileName, int level, int numThreads = 0, size_t blockSize = DEFAULT_BLOCK_SIZE);
+	~CGzStreamWriter();
+
+	CGzStreamWriter(const CGzStreamWriter&) = delete;
+	CGzStreamWriter& operator = (const CGzStreamWriter&) = delete;
+
+	bool IsOpen() const { return (file != nullptr); }
+
+	/// must be called before the first Write, later calls have to pass the same size
+	void SetHeader(const void* data, size_t size);
+	void Write(const void* data, size_t size);
+	void Write(const std::string& data) { Write(data.data(), data.size()); }
+
+	/// compresses and writes whatever is left; blocks until the file is complete
+	bool Close();
+
+	/// uncompressed bytes passed in so far, including the header
+	size_t GetInputSize() const { return (headerData.size() + inputSize); }
+
+	static bool CompressMember(const std::uint8_t* data, size_t size, int level, std::vector<std::uint8_t>& member);
+
+private:
+	struct Block {
+		std::vector<std::uint8_t> input;
+		std::vector<std::uint8_t> output;
+
+		bool started = false;
+		bool finished = false;
+	};
+
+	void WorkerLoop();
+	void SubmitBlock();
+	/// caller has to hold <mutex>
+	void WriteFinishedBlocks();
+	bool WriteMember(const std::vector<std::uint8_t>& member);
+
+private:
+	std::string fileName;
+	FILE* file = nullptr;
+
+	int level = 0;
+	size_t blockSize = DEFAULT_BLOCK_SIZE;
+	size_t inputSize = 0;
+
+	std::vector<std::uint8_t> headerData;
+	size_t headerMemberSize = 0;
+	bool headerChanged = false;
+
+	// block being filled by Write, not visible to the workers yet
+	std::unique_ptr<Block> curBlock;
+	// submitted blocks in input order; popped once written
+	std::deque< std::unique_ptr<Block> > blocks;
+
+	std::vector<spring::thread> workers;
+
+	spring::mutex mutex;
+	spring::condition_variable blockCond;
+
+	bool closing = false;
+	bool failed = false;
+};
+
+#endif // _GZ_STREAM_WRITER_H
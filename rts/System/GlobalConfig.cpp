@@ -12,6 +12,12 @@ CONFIG(int, NetworkLossFactor)
 	.minimumValue(netcode::UDPConnection::MIN_LOSS_FACTOR)
 	.maximumValue(netcode::UDPConnection::MAX_LOSS_FACTOR);
 
+CONFIG(int, NetworkCompressionLevel)
+	.defaultValue(9)
+	.minimumValue(0)
+	.maximumValue(9)
+	.description("Highest deflate level the game server may use for data sent to us, 0 asks it not to compress. The server picks the lower of this and ServerNetworkCompressionLevel.");
+
 CONFIG(int, InitialNetworkTimeout)
 	.defaultValue(30)
 	.minimumValue(10).description("Time to wait for the initial connection to the game server.");
@@ -72,6 +78,7 @@ void GlobalConfig::Init()
 	// Recommended semantics for "expert" type config values:
 	// <0 = disable (if applicable)
 	networkLossFactor = configHandler->GetInt("NetworkLossFactor");
+	networkCompressionLevel = configHandler->GetInt("NetworkCompressionLevel");
 	initialNetworkTimeout = configHandler->GetInt("InitialNetworkTimeout");
 	networkTimeout = configHandler->GetInt("NetworkTimeout");
 	reconnectTimeout = configHandler->GetInt("ReconnectTimeout");
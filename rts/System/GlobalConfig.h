@@ -17,6 +17,14 @@ public:
 	 */
 	int networkLossFactor = 0;
 
+	/**
+	 * @brief network compression level
+	 *
+	 * Highest deflate level (0-9) the server may apply to the stream it
+	 * sends us, 0 disables compression for this client
+	 */
+	int networkCompressionLevel = 0;
+
 	/**
 	 * @brief initial network timeout
 	 *
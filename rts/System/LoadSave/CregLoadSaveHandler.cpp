@@ -1,7 +1,8 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <future>
 #include <sstream>
-#include <zlib.h>
+#include <string_view>
 
 #include "ExternalAI/SkirmishAIHandler.h"
 #include "ExternalAI/EngineOutHandler.h"
@@ -40,10 +41,14 @@
 #include "Sim/Units/Scripts/NullUnitScript.h"
 #include "Sim/Weapons/PlasmaRepulser.h"
 #include "System/SafeUtil.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/Platform/errorhandler.h"
 #include "System/FileSystem/DataDirsAccess.h"
 #include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/FileSystemAbstraction.h"
 #include "System/FileSystem/GZFileHandler.h"
+#include "System/FileSystem/GzStreamWriter.h"
+#include "System/LoadSave/SaveDelta.h"
 #include "System/Threading/ThreadPool.h"
 #include "System/creg/SerializeLuaState.h"
 #include "System/creg/Serializer.h"
@@ -52,6 +57,8 @@
 
 #define MAX_STRING_SIZE (1 << 19) // 512kB excluding null-term
 
+CONFIG(bool, ParallelSaveGame).defaultValue(true).description("Serialize the game state of savegames on multiple threads. Produces the same savegame as serial saving.");
+
 
 CCregLoadSaveHandler::CCregLoadSaveHandler()
 {}
@@ -194,6 +201,8 @@ void CLuaStateCollector::Serialize(creg::ISerializer* s) {
 	creg::SerializeLuaThread(s, &L_GC);
 }
 
+static constexpr int SAVEGAME_COMPRESSION_LEVEL = 5;
+
 static void WriteString(std::ostream& s, const std::string& str)
 {
 	if (str.length() > MAX_STRING_SIZE)
@@ -251,32 +260,89 @@ static void LoadLuaState(CSplitLuaHandle* handle, creg::CInputStreamSerializer&
 }
 
 
-void CCregLoadSaveHandler::SaveGame(const std::string& path)
-{
 #ifdef USING_CREG
-	LOG("[LSH::%s] saving game to \"%s\"", __func__, path.c_str());
+static bool WriteSaveFile(const std::string& path, std::string_view data)
+{
+	// blocks are compressed in parallel by the writer's own threads while
+	// they are handed over, Close only waits for the last few of them
+	auto writer = std::make_unique<CGzStreamWriter>(dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE), SAVEGAME_COMPRESSION_LEVEL);
+
+	if (!writer->IsOpen()) {
+		LOG_L(L_ERROR, "[LSH::%s] could not open save-file \"%s\"", __func__, path.c_str());
+		return false;
+	}
+
+	writer->Write(data.data(), data.size());
+
+	std::function<void(std::unique_ptr<CGzStreamWriter>&&)> func = [](std::unique_ptr<CGzStreamWriter>&& writer) {
+		writer->Close();
+	};
+
+	// need to keep a reference to the future around or its destructor will block
+	ThreadPool::AddExtJob(std::move(std::async(std::launch::async, std::move(func), std::move(writer))));
+	return true;
+}
+
+/// writes <data> to <filePath> and blocks until done; on disk there is always either the old or the complete new file
+static bool WriteSaveFileReplace(const std::string& filePath, std::string_view data)
+{
+	const std::string tempPath = filePath + ".tmp";
+
+	CGzStreamWriter writer(tempPath, SAVEGAME_COMPRESSION_LEVEL);
+
+	if (!writer.IsOpen()) {
+		LOG_L(L_ERROR, "[LSH::%s] could not open save-file \"%s\"", __func__, tempPath.c_str());
+		return false;
+	}
+
+	writer.Write(data.data(), data.size());
+
+	if (!writer.Close()) {
+		LOG_L(L_ERROR, "[LSH::%s] could not write save-file \"%s\"", __func__, tempPath.c_str());
+		FileSystemAbstraction::DeleteFile(tempPath);
+		return false;
+	}
+
+	return FileSystemAbstraction::RenameFile(tempPath, filePath);
+}
+#endif //USING_CREG
+
 
+bool CCregLoadSaveHandler::SerializeGame(std::stringstream& oss, std::vector<std::uint64_t>* objectOffsets)
+{
+#ifdef USING_CREG
 	// NB: Selection leaves CObject reference as Unit's listener,
 	//     But isn't serialized - leak on load.
+	//     Cleared only while saving, autosaves must not touch it.
+	const std::vector<int> selectedUnitIDs(selectedUnitsHandler.selectedUnits.begin(), selectedUnitsHandler.selectedUnits.end());
 	selectedUnitsHandler.ClearSelected();
 
-	try {
-		std::stringstream oss;
+	bool ret = false;
 
+	try {
 		// write our own header. SavePackage() will add its own
 		WriteString(oss, SpringVersion::GetSync());
 		WriteString(oss, gameSetup->setupText);
 		WriteString(oss, modName);
 		WriteString(oss, mapName);
 
+		// section starts are cut points for deltas as well, so that their
+		// pieces do not move when an earlier section changes size
+		const auto AddOffset = [&](std::uint64_t offset) {
+			if (objectOffsets != nullptr)
+				objectOffsets->push_back(offset);
+		};
 
 		{
+			AddOffset(oss.tellp());
 			Sim::SaveComponents(oss);
 
 			creg::COutputStreamSerializer os;
+			os.SetObjectOffsets(objectOffsets);
 
 			// save lua state first as lua unit scripts depend on it
 			const int luaStart = oss.tellp();
+			AddOffset(luaStart);
 			SaveLuaState(luaGaia, os, oss);
 			SaveLuaState(luaRules, os, oss);
 			PrintSize("Lua", ((int)oss.tellp()) - luaStart);
@@ -284,7 +350,10 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 			// save creg state
 			const int gameStart = oss.tellp();
 			CGameStateCollector gsc;
-			os.SavePackage(&oss, &gsc, gsc.GetClass());
+			readMap->ReadOriginalTypeMap();
+			// lua states are always saved serially, the game state may use the thread pool
+			os.SavePackage(&oss, &gsc, gsc.GetClass(), configHandler->GetBool("ParallelSaveGame"));
+			readMap->FreeOriginalTypeMap();
 			PrintSize("Game", ((int)oss.tellp()) - gameStart);
 
 
@@ -295,6 +364,8 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 				std::stringstream aiData;
 				eoh->Save(&aiData, ai.first);
 
+				AddOffset(oss.tellp());
+
 				std::uint64_t aiSize = aiData.tellp();
 				creg::WriteUInt(&oss, aiSize);
 				if (aiSize > 0)
@@ -303,27 +374,8 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 			PrintSize("AIs", ((int)oss.tellp()) - aiStart);
 		}
 
-		{
-			gzFile file = gzopen(dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE).c_str(), "wb5");
-
-			if (file == nullptr) {
-				LOG_L(L_ERROR, "[LSH::%s] could not open save-file", __func__);
-				return;
-			}
-
-			std::string data = oss.str();
-			std::function<void(gzFile, std::string&&)> func = [](gzFile file, std::string&& data) {
-				gzwrite(file, data.c_str(), data.size());
-				gzflush(file, Z_FINISH);
-				gzclose(file);
-			};
-
-			// gzFile is just a plain typedef (struct gzFile_s {}* gzFile), can be copied
-			// need to keep a reference to the future around or its destructor will block
-			ThreadPool::AddExtJob(std::move(std::async(std::launch::async, std::move(func), file, std::move(data))));
-		}
-
 		//FIXME add lua state
+		ret = true;
 	} catch (const content_error& ex) {
 		LOG_L(L_ERROR, "[LSH::%s] content error \"%s\"", __func__, ex.what());
 	} catch (const std::exception& ex) {
@@ -335,8 +387,87 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 	} catch (...) {
 		LOG_L(L_ERROR, "[LSH::%s] unknown error", __func__);
 	}
+
+	for (const int unitID: selectedUnitIDs) {
+		selectedUnitsHandler.AddUnit(unitHandler.GetUnit(unitID));
+	}
+
+	return ret;
 #else //USING_CREG
 	LOG_L(L_ERROR, "[LSH::%s] creg is disabled", __func__);
+	return false;
+#endif //USING_CREG
+}
+
+
+void CCregLoadSaveHandler::SaveGame(const std::string& path)
+{
+#ifdef USING_CREG
+	LOG("[LSH::%s] saving game to \"%s\"", __func__, path.c_str());
+
+	std::stringstream oss;
+
+	if (!SerializeGame(oss, nullptr))
+		return;
+
+	WriteSaveFile(path, oss.view());
+#else //USING_CREG
+	LOG_L(L_ERROR, "[LSH::%s] creg is disabled", __func__);
+#endif //USING_CREG
+}
+
+std::future<CSaveDelta> CCregLoadSaveHandler::SaveGameDelta(const std::string& path, const std::string& basePath, CSaveDelta&& delta)
+{
+	const auto KeepDelta = [&delta]() {
+		return std::async(std::launch::deferred, [d = std::move(delta)]() mutable { return std::move(d); });
+	};
+
+#ifdef USING_CREG
+	LOG("[LSH::%s] saving game delta to \"%s\"", __func__, path.c_str());
+
+	std::stringstream oss;
+	std::vector<std::uint64_t> objectOffsets;
+
+	if (!SerializeGame(oss, &objectOffsets))
+		return KeepDelta();
+
+	const std::string filePath = dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE);
+	const std::string baseFilePath = dataDirsAccess.LocateFile(basePath, FileQueryFlags::WRITE);
+
+	// only serializing has to see the game state, hashing and writing run in the background
+	const auto WriteDelta = [=](std::string&& data, std::vector<std::uint64_t>&& offsets, CSaveDelta&& baseDelta) {
+		std::string deltaData;
+		size_t numLiteralBytes = data.size();
+
+		if (baseDelta.HasBase() && baseDelta.GetBaseName() == basePath)
+			numLiteralBytes = baseDelta.Create(data, offsets, deltaData);
+
+		// later deltas against an old base only grow, start over from a new one
+		if (numLiteralBytes > (data.size() / 2)) {
+			baseDelta.ClearBase();
+			deltaData.clear();
+
+			// the base is complete on disk before any delta refers to it
+			if (!WriteSaveFileReplace(baseFilePath, data))
+				return std::move(baseDelta);
+
+			baseDelta.SetBase(basePath, data, offsets);
+			numLiteralBytes = baseDelta.Create(data, offsets, deltaData);
+
+			LOG("[LSH::SaveGameDelta] wrote new base \"%s\"", basePath.c_str());
+		}
+
+		PrintSize("Delta", deltaData.size());
+		PrintSize("Changed", numLiteralBytes);
+
+		WriteSaveFileReplace(filePath, deltaData);
+		return std::move(baseDelta);
+	};
+
+	return std::async(std::launch::async, WriteDelta, std::move(oss).str(), std::move(objectOffsets), std::move(delta));
+#else //USING_CREG
+	LOG_L(L_ERROR, "[LSH::%s] creg is disabled", __func__);
+	return KeepDelta();
 #endif //USING_CREG
 }
 
@@ -354,6 +485,9 @@ bool CCregLoadSaveHandler::LoadGameStartInfo(const std::string& path)
 	while ((len = saveFile.Read(buf, sizeof(buf))) > 0)
 		sbuf->sputn(buf, len);
 
+	if (CSaveDelta::IsDelta(iss.view()) && !ExpandDelta(path))
+		return false;
+
 	ReadString(iss, saveVersion);
 
 	// check saved engine version against current build
@@ -371,6 +505,34 @@ bool CCregLoadSaveHandler::LoadGameStartInfo(const std::string& path)
 	return (saveVersion == syncVersion);
 }
 
+bool CCregLoadSaveHandler::ExpandDelta(const std::string& path)
+{
+	CSaveDelta::Header header;
+
+	if (!CSaveDelta::ReadHeader(iss.view(), header)) {
+		LOG_L(L_ERROR, "[LSH::%s] file \"%s\" is a corrupt or outdated save delta", __func__, path.c_str());
+		return false;
+	}
+
+	CGZFileHandler baseFile(dataDirsAccess.LocateFile(FindSaveFile(header.baseName)), SPRING_VFS_RAW_FIRST);
+
+	std::string base;
+	std::string data;
+
+	if (!baseFile.FileExists() || !baseFile.LoadStringData(base)) {
+		LOG_L(L_ERROR, "[LSH::%s] base \"%s\" of save delta \"%s\" is missing", __func__, header.baseName.c_str(), path.c_str());
+		return false;
+	}
+
+	if (!CSaveDelta::Apply(iss.view(), base, data))
+		return false;
+
+	LOG("[LSH::%s] applied save delta \"%s\" to \"%s\"", __func__, path.c_str(), header.baseName.c_str());
+
+	iss.str(std::move(data));
+	return true;
+}
+
 /// this should be called on frame 0 when the game has started
 void CCregLoadSaveHandler::LoadGame()
 {
@@ -389,7 +551,9 @@ void CCregLoadSaveHandler::LoadGame()
 		void* pGSC = nullptr;
 		creg::Class* gsccls = nullptr;
 
+		readMap->ReadOriginalTypeMap();
 		inputStream.LoadPackage(&iss, pGSC, gsccls);
+		readMap->FreeOriginalTypeMap();
 		assert(pGSC && gsccls == CGameStateCollector::StaticClass());
 
 		// the only job of gsc is to collect gamestate data
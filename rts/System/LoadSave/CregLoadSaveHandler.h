@@ -3,9 +3,13 @@
 #ifndef CREG_LOAD_SAVE_HANDLER_H
 #define CREG_LOAD_SAVE_HANDLER_H
 
+#include <cinttypes>
+#include <future>
 #include <string>
 #include <sstream>
+#include <vector>
 #include "LoadSaveHandler.h"
+#include "SaveDelta.h"
 
 class CCregLoadSaveHandler : public ILoadSaveHandler
 {
@@ -18,6 +22,22 @@ public:
 	void LoadAIData() override;
 	void SaveGame(const std::string& path) override;
 
+	/**
+	 * Saves the game as a delta against the base kept by <delta>. A full
+	 * save is first written to <basePath> and becomes the new base if there
+	 * is none yet, or if the delta would have to store more than half of the
+	 * game state as literal bytes.
+	 * Only the game state is serialized before returning; the rest happens
+	 * in the background, which hands <delta> back once both files are on disk.
+	 */
+	std::future<CSaveDelta> SaveGameDelta(const std::string& path, const std::string& basePath, CSaveDelta&& delta);
+
+private:
+	/// serializes the game state into <oss>; false if that failed (errors are logged)
+	bool SerializeGame(std::stringstream& oss, std::vector<std::uint64_t>* objectOffsets);
+	/// replaces the contents of a delta file in iss by the full save
+	bool ExpandDelta(const std::string& path);
+
 protected:
 	std::stringstream iss;
 };
@@ -0,0 +1,218 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "DemoIndex.h"
+
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileSystemAbstraction.h"
+#include "System/FileSystem/FileQueryFlags.h"
+#include "System/Log/ILog.h"
+#include "System/StringUtil.h"
+
+// "spring demofile" is 16 bytes including the terminator, so is this
+static constexpr char DEMOINDEX_MAGIC[16] = "spring demo idx";
+static constexpr std::int32_t DEMOINDEX_VERSION = 1;
+
+static_assert(sizeof(CDemoIndex::Entry) == 12, "index entries are written as-is");
+
+
+CDemoIndex::CDemoIndex(const std::string& _demoName, const DemoFileHeader& demoHeader, int _interval)
+	: demoName(_demoName)
+	, demoStreamSize(demoHeader.demoStreamSize)
+	, interval(_interval)
+{
+	memcpy(gameID, demoHeader.gameID, sizeof(gameID));
+}
+
+std::string CDemoIndex::GetSnapshotFileName(int frameNum) const
+{
+	return (demoName + "." + IntToString(frameNum, "%06d") + ".ssf");
+}
+
+
+bool CDemoIndex::Load()
+{
+	std::ifstream file(dataDirsAccess.LocateFile(GetIndexFileName(demoName)), std::ios::in | std::ios::binary);
+
+	if (!file.is_open())
+		return false;
+
+	char magic[sizeof(DEMOINDEX_MAGIC)] = {0};
+	std::uint8_t fileGameID[sizeof(gameID)] = {0};
+	std::int32_t version = 0;
+	std::int32_t streamSize = 0;
+	std::int32_t numEntries = 0;
+
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	file.read(reinterpret_cast<char*>(fileGameID), sizeof(fileGameID));
+	file.read(reinterpret_cast<char*>(&streamSize), sizeof(streamSize));
+	file.read(reinterpret_cast<char*>(&numEntries), sizeof(numEntries));
+
+	if (!file.good() || memcmp(magic, DEMOINDEX_MAGIC, sizeof(magic)) != 0 || version != DEMOINDEX_VERSION || numEntries < 0) {
+		LOG_L(L_WARNING, "[DemoIndex::%s] ignoring corrupt or outdated index for \"%s\"", __func__, demoName.c_str());
+		return false;
+	}
+	if (memcmp(fileGameID, gameID, sizeof(gameID)) != 0 || streamSize != demoStreamSize) {
+		LOG_L(L_WARNING, "[DemoIndex::%s] ignoring index for \"%s\", it belongs to a different demo", __func__, demoName.c_str());
+		return false;
+	}
+
+	std::vector<Entry> fileEntries;
+	Entry entry;
+
+	// one at a time, so a corrupt count can not allocate more than the file holds
+	while (int(fileEntries.size()) < numEntries) {
+		if (!file.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+			LOG_L(L_WARNING, "[DemoIndex::%s] ignoring truncated index for \"%s\"", __func__, demoName.c_str());
+			return false;
+		}
+
+		fileEntries.push_back(entry);
+	}
+
+	std::sort(fileEntries.begin(), fileEntries.end());
+
+	for (size_t i = 0; i < fileEntries.size(); i++) {
+		const Entry& e = fileEntries[i];
+
+		const bool validFrame = (e.frameNum > 0 && (i == 0 || e.frameNum != fileEntries[i - 1].frameNum));
+		const bool validChunk = (e.chunkPos >= 0 && e.chunkPos <= demoStreamSize);
+
+		if (validFrame && validChunk && e.modGameTime >= 0.0f)
+			continue;
+
+		LOG_L(L_WARNING, "[DemoIndex::%s] ignoring index for \"%s\", entry for frame %d is invalid", __func__, demoName.c_str(), e.frameNum);
+		return false;
+	}
+
+	std::lock_guard<spring::mutex> lock(mutex);
+	entries = std::move(fileEntries);
+
+	LOG("[DemoIndex::%s] loaded %d snapshot entries for \"%s\"", __func__, numEntries, demoName.c_str());
+	return true;
+}
+
+bool CDemoIndex::Save() const
+{
+	const std::string fileName = dataDirsAccess.LocateFile(GetIndexFileName(demoName), FileQueryFlags::WRITE);
+	// written in full before it replaces the index, so neither a crash nor a
+	// reader (e.g. the server of a reloaded game) ever sees half an index
+	const std::string tempName = fileName + ".tmp";
+
+	{
+		std::ofstream file(tempName, std::ios::out | std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open()) {
+			LOG_L(L_ERROR, "[DemoIndex::%s] could not open \"%s\" for writing", __func__, tempName.c_str());
+			return false;
+		}
+
+		std::lock_guard<spring::mutex> lock(mutex);
+
+		const std::int32_t numEntries = entries.size();
+
+		file.write(DEMOINDEX_MAGIC, sizeof(DEMOINDEX_MAGIC));
+		file.write(reinterpret_cast<const char*>(&DEMOINDEX_VERSION), sizeof(DEMOINDEX_VERSION));
+		file.write(reinterpret_cast<const char*>(gameID), sizeof(gameID));
+		file.write(reinterpret_cast<const char*>(&demoStreamSize), sizeof(demoStreamSize));
+		file.write(reinterpret_cast<const char*>(&numEntries), sizeof(numEntries));
+		file.write(reinterpret_cast<const char*>(entries.data()), numEntries * sizeof(Entry));
+		file.close();
+
+		if (!file.good()) {
+			LOG_L(L_ERROR, "[DemoIndex::%s] could not write \"%s\"", __func__, tempName.c_str());
+			FileSystemAbstraction::DeleteFile(tempName);
+			return false;
+		}
+	}
+
+	return (FileSystemAbstraction::RenameFile(tempName, fileName));
+}
+
+
+bool CDemoIndex::GetEntry(int frameNum, Entry& entry) const
+{
+	std::lock_guard<spring::mutex> lock(mutex);
+
+	const auto iter = std::lower_bound(entries.begin(), entries.end(), Entry{frameNum});
+
+	if (iter == entries.end() || iter->frameNum != frameNum)
+		return false;
+
+	entry = *iter;
+	return true;
+}
+
+bool CDemoIndex::FindEntry(int frameNum, Entry& entry) const
+{
+	std::lock_guard<spring::mutex> lock(mutex);
+
+	const auto iter = std::upper_bound(entries.begin(), entries.end(), Entry{frameNum});
+
+	if (iter == entries.begin())
+		return false;
+
+	entry = *(iter - 1);
+	return true;
+}
+
+bool CDemoIndex::HasSnapshot(int frameNum) const
+{
+	return (FileSystemAbstraction::FileExists(dataDirsAccess.LocateFile(GetSnapshotFileName(frameNum))));
+}
+
+
+void CDemoIndex::AddFramePos(int frameNum, int chunkPos, float modGameTime)
+{
+	if (interval <= 0 || frameNum <= 0 || (frameNum % interval) != 0)
+		return;
+
+	std::lock_guard<spring::mutex> lock(mutex);
+
+	if (std::binary_search(entries.begin(), entries.end(), Entry{frameNum}))
+		return;
+
+	pendingEntries.push_back({frameNum, chunkPos, modGameTime});
+}
+
+bool CDemoIndex::WantSnapshot(int frameNum) const
+{
+	if (interval <= 0 || frameNum <= 0 || (frameNum % interval) != 0)
+		return false;
+
+	std::lock_guard<spring::mutex> lock(mutex);
+
+	const auto pred = [&](const Entry& e) { return (e.frameNum == frameNum); };
+	return (std::find_if(pendingEntries.begin(), pendingEntries.end(), pred) != pendingEntries.end());
+}
+
+void CDemoIndex::AddSnapshot(int frameNum)
+{
+	{
+		std::lock_guard<spring::mutex> lock(mutex);
+
+		const auto pred = [&](const Entry& e) { return (e.frameNum == frameNum); };
+		const auto iter = std::find_if(pendingEntries.begin(), pendingEntries.end(), pred);
+
+		if (iter == pendingEntries.end())
+			return;
+
+		entries.insert(std::upper_bound(entries.begin(), entries.end(), *iter), *iter);
+		pendingEntries.erase(iter);
+
+		// everything older was skipped (e.g. by a reload) and will never be snapshotted
+		pendingEntries.erase(std::remove_if(pendingEntries.begin(), pendingEntries.end(), [&](const Entry& e) { return (e.frameNum < frameNum); }), pendingEntries.end());
+	}
+
+	Save();
+}
+
+int CDemoIndex::GetNumEntries() const
+{
+	std::lock_guard<spring::mutex> lock(mutex);
+	return (entries.size());
+}
@@ -0,0 +1,84 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef DEMO_INDEX_H
+#define DEMO_INDEX_H
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+#include "demofile.h"
+#include "System/Threading/SpringThreading.h"
+
+/**
+ * @brief Seek index for a demo, stored next to it as "<demo>.idx"
+ *
+ * Every entry pairs a creg savegame snapshot ("<demo>.<frame>.ssf") of the
+ * state after sim-frame <frameNum> with the position of the first demo-stream
+ * chunk following that frame's NETMSG_NEWFRAME, so a replay can load the
+ * snapshot and continue reading the demo from there instead of simulating
+ * everything before it.
+ *
+ * The server records stream positions while it reads the demo (AddFramePos)
+ * and the local client writes a snapshot once it has simulated such a frame
+ * (WantSnapshot, AddSnapshot); entries are only ever added for frames that
+ * are multiples of <interval>.
+ */
+class CDemoIndex
+{
+public:
+	struct Entry {
+		bool operator < (const Entry& e) const { return (frameNum < e.frameNum); }
+
+		std::int32_t frameNum = -1;
+		std::int32_t chunkPos = 0;
+		float modGameTime = 0.0f;
+	};
+
+public:
+	CDemoIndex(const std::string& demoName, const DemoFileHeader& demoHeader, int interval);
+
+	static std::string GetIndexFileName(const std::string& demoName) { return (demoName + ".idx"); }
+
+	std::string GetSnapshotFileName(int frameNum) const;
+
+	/// false if there is no index or it is invalid or belongs to another demo
+	bool Load();
+	/// replaces the index file as a whole, through a temporary file
+	bool Save() const;
+
+	/// entry for exactly <frameNum>
+	bool GetEntry(int frameNum, Entry& entry) const;
+	/// last entry at or before <frameNum>
+	bool FindEntry(int frameNum, Entry& entry) const;
+	/// whether the snapshot file of an entry still exists
+	bool HasSnapshot(int frameNum) const;
+
+	/// server; called for every frame read from the demo
+	void AddFramePos(int frameNum, int chunkPos, float modGameTime);
+
+	/// client; true if <frameNum> should be snapshotted now that it was simulated
+	bool WantSnapshot(int frameNum) const;
+	/// client; the snapshot for <frameNum> was written, makes its entry visible
+	void AddSnapshot(int frameNum);
+
+	int GetInterval() const { return interval; }
+	int GetNumEntries() const;
+
+private:
+	std::string demoName;
+
+	std::uint8_t gameID[16];
+	std::int32_t demoStreamSize = 0;
+
+	int interval = 0;
+
+	// sorted by frame
+	std::vector<Entry> entries;
+	// positions recorded by the server that do not have a snapshot yet
+	std::vector<Entry> pendingEntries;
+
+	mutable spring::mutex mutex;
+};
+
+#endif // DEMO_INDEX_H
@@ -153,6 +153,35 @@ bool CDemoReader::ReachedEnd()
 }
 
 
+int CDemoReader::GetNextChunkPos()
+{
+	// the header of the next chunk has always been read already
+	return (playbackDemo->GetPos() - sizeof(chunkHeader));
+}
+
+bool CDemoReader::SeekToChunk(int chunkPos, float curTime)
+{
+	const int streamBeg = fileHeader.headerSize + fileHeader.scriptSize;
+	const int streamEnd = (fileHeader.demoStreamSize != 0)? (streamBeg + fileHeader.demoStreamSize): playbackDemoSize;
+
+	if (chunkPos < streamBeg || (chunkPos + int(sizeof(chunkHeader))) > streamEnd)
+		return false;
+
+	playbackDemo->Seek(chunkPos);
+
+	if (playbackDemo->Read((char*)&chunkHeader, sizeof(chunkHeader)) < sizeof(chunkHeader))
+		return false;
+
+	chunkHeader.swab();
+
+	// same accounting as the ctor, which counts the first chunk's header too
+	bytesRemaining = streamEnd - chunkPos;
+	demoTimeOffset = curTime - chunkHeader.modGameTime - 0.1f;
+	nextDemoReadTime = curTime - 0.01f;
+	return true;
+}
+
+
 void CDemoReader::LoadStats()
 {
 	// Stats are not available if Spring crashed while writing the demo.
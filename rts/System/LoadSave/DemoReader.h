@@ -39,6 +39,17 @@ public:
 	*/
 	bool ReachedEnd();
 
+	/**
+	@brief Position of the chunk GetData will return next
+	@note Stays valid while the file is open; can be passed to SeekToChunk
+	*/
+	int GetNextChunkPos();
+	/**
+	@brief Continue reading from a position returned by GetNextChunkPos
+	@param curTime time at which the chunk at <chunkPos> should be read
+	*/
+	bool SeekToChunk(int chunkPos, float curTime);
+
 	float GetModGameTime() const { return chunkHeader.modGameTime; }
 	float GetDemoTimeOffset() const { return demoTimeOffset; }
 	float GetNextDemoReadTime() const { return nextDemoReadTime; }
@@ -0,0 +1,279 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <cstring>
+
+#include "SaveDelta.h"
+
+#include "System/Log/ILog.h"
+#include "lib/xxhash/xxh3.h"
+
+static constexpr std::int32_t DELTA_VERSION = 1;
+
+enum {
+	OP_END     = 0,
+	OP_COPY    = 1, // <offset, size> of bytes from the base
+	OP_LITERAL = 2, // <size> followed by that many bytes
+};
+
+
+template<typename T>
+static void AppendValue(std::string& s, const T& value)
+{
+	s.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void AppendHash(std::string& s, const std::uint64_t (&hash)[2])
+{
+	AppendValue(s, hash[0]);
+	AppendValue(s, hash[1]);
+}
+
+static void HashData(std::string_view data, std::uint64_t (&hash)[2])
+{
+	const XXH128_hash_t h = XXH3_128bits(data.data(), data.size());
+
+	hash[0] = h.low64;
+	hash[1] = h.high64;
+}
+
+
+struct DeltaReader {
+	template<typename T>
+	bool Read(T& value) {
+		if (data.size() - pos < sizeof(T))
+			return false;
+
+		memcpy(&value, data.data() + pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+
+	bool ReadHash(std::uint64_t (&hash)[2]) { return (Read(hash[0]) && Read(hash[1])); }
+
+	bool ReadString(std::string& str) {
+		const size_t end = data.find('\0', pos);
+
+		if (end == std::string_view::npos)
+			return false;
+
+		str.assign(data.data() + pos, end - pos);
+		pos = end + 1;
+		return true;
+	}
+
+	bool ReadHeader(CSaveDelta::Header& header) {
+		char magic[sizeof(CSaveDelta::MAGIC)];
+		std::int32_t version = 0;
+
+		if (!Read(magic) || memcmp(magic, CSaveDelta::MAGIC, sizeof(magic)) != 0)
+			return false;
+		if (!Read(version) || version != DELTA_VERSION)
+			return false;
+
+		return (ReadString(header.baseName) && Read(header.baseSize) && ReadHash(header.baseHash) && Read(header.dataSize) && ReadHash(header.dataHash));
+	}
+
+	std::string_view data;
+	size_t pos = 0;
+};
+
+
+/// calls func(offset, size) for consecutive pieces covering all of <data>
+template<typename F>
+static void ForEachPiece(std::string_view data, const std::vector<std::uint64_t>& offsets, F&& func)
+{
+	std::uint64_t pos = 0;
+
+	const auto CutUntil = [&](std::uint64_t end) {
+		while (pos < end) {
+			const std::uint64_t size = std::min(end - pos, std::uint64_t(CSaveDelta::MAX_PIECE_SIZE));
+
+			func(pos, size);
+			pos += size;
+		}
+	};
+
+	for (const std::uint64_t offset: offsets) {
+		CutUntil(std::min(offset, std::uint64_t(data.size())));
+	}
+
+	CutUntil(data.size());
+}
+
+
+
+bool CSaveDelta::IsDelta(std::string_view data)
+{
+	return (data.size() >= sizeof(MAGIC) && memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0);
+}
+
+bool CSaveDelta::ReadHeader(std::string_view delta, Header& header)
+{
+	DeltaReader reader = {delta};
+	return (reader.ReadHeader(header));
+}
+
+bool CSaveDelta::Apply(std::string_view delta, std::string_view base, std::string& data)
+{
+	DeltaReader reader = {delta};
+	Header header;
+
+	if (!reader.ReadHeader(header)) {
+		LOG_L(L_ERROR, "[SaveDelta::%s] corrupt or outdated delta", __func__);
+		return false;
+	}
+
+	std::uint64_t hash[2];
+	HashData(base, hash);
+
+	if (base.size() != header.baseSize || hash[0] != header.baseHash[0] || hash[1] != header.baseHash[1]) {
+		LOG_L(L_ERROR, "[SaveDelta::%s] base \"%s\" was overwritten since the delta was saved", __func__, header.baseName.c_str());
+		return false;
+	}
+
+	data.clear();
+	data.reserve(header.dataSize);
+
+	// anything malformed ends the loop early, which the hash check below catches
+	for (std::uint8_t op = OP_END; reader.Read(op) && op != OP_END; ) {
+		std::uint64_t offset = 0;
+		std::uint64_t size = 0;
+
+		if (op == OP_COPY) {
+			if (!reader.Read(offset) || !reader.Read(size) || offset > base.size() || size > (base.size() - offset))
+				break;
+
+			data.append(base.data() + offset, size);
+			continue;
+		}
+
+		if (op == OP_LITERAL) {
+			if (!reader.Read(size) || size > (delta.size() - reader.pos))
+				break;
+
+			data.append(delta.data() + reader.pos, size);
+			reader.pos += size;
+			continue;
+		}
+
+		break;
+	}
+
+	HashData(data, hash);
+
+	if (data.size() != header.dataSize || hash[0] != header.dataHash[0] || hash[1] != header.dataHash[1]) {
+		LOG_L(L_ERROR, "[SaveDelta::%s] corrupt delta against \"%s\"", __func__, header.baseName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+void CSaveDelta::SetBase(const std::string& name, std::string_view data, const std::vector<std::uint64_t>& offsets)
+{
+	ClearBase();
+
+	baseName = name;
+	baseSize = data.size();
+
+	HashData(data, baseHash);
+
+	pieces.reserve(offsets.size() + data.size() / MAX_PIECE_SIZE);
+
+	ForEachPiece(data, offsets, [&](std::uint64_t offset, std::uint64_t size) {
+		const XXH128_hash_t hash = XXH3_128bits(data.data() + offset, size);
+
+		// identical pieces are all equally good, keep the first
+		pieces.emplace(hash.low64, Piece{offset, size, hash.high64});
+	});
+}
+
+void CSaveDelta::ClearBase()
+{
+	baseName.clear();
+	baseSize = 0;
+	baseHash[0] = 0;
+	baseHash[1] = 0;
+
+	pieces.clear();
+}
+
+
+size_t CSaveDelta::Create(std::string_view data, const std::vector<std::uint64_t>& offsets, std::string& delta) const
+{
+	std::uint64_t dataHash[2];
+	HashData(data, dataHash);
+
+	delta.append(MAGIC, sizeof(MAGIC));
+	AppendValue(delta, DELTA_VERSION);
+	delta.append(baseName.c_str(), baseName.size() + 1);
+	AppendValue(delta, baseSize);
+	AppendHash(delta, baseHash);
+	AppendValue(delta, std::uint64_t(data.size()));
+	AppendHash(delta, dataHash);
+
+	// consecutive pieces are merged into one op while they stay contiguous in the base
+	std::uint64_t copyOffset = 0;
+	std::uint64_t copySize = 0;
+	std::uint64_t literalOffset = 0;
+	std::uint64_t literalSize = 0;
+
+	size_t numLiteralBytes = 0;
+
+	const auto FlushCopy = [&]() {
+		if (copySize == 0)
+			return;
+
+		AppendValue(delta, std::uint8_t(OP_COPY));
+		AppendValue(delta, copyOffset);
+		AppendValue(delta, copySize);
+		copySize = 0;
+	};
+	const auto FlushLiteral = [&]() {
+		if (literalSize == 0)
+			return;
+
+		AppendValue(delta, std::uint8_t(OP_LITERAL));
+		AppendValue(delta, literalSize);
+		delta.append(data.data() + literalOffset, literalSize);
+
+		numLiteralBytes += literalSize;
+		literalSize = 0;
+	};
+
+	ForEachPiece(data, offsets, [&](std::uint64_t offset, std::uint64_t size) {
+		const XXH128_hash_t hash = XXH3_128bits(data.data() + offset, size);
+		const auto it = pieces.find(hash.low64);
+
+		if (it == pieces.end() || it->second.size != size || it->second.hashHigh != hash.high64) {
+			FlushCopy();
+
+			// pieces arrive in order, so literal runs are contiguous in <data>
+			if (literalSize == 0)
+				literalOffset = offset;
+
+			literalSize += size;
+			return;
+		}
+
+		FlushLiteral();
+
+		if (copySize > 0 && (copyOffset + copySize) == it->second.offset) {
+			copySize += size;
+			return;
+		}
+
+		FlushCopy();
+
+		copyOffset = it->second.offset;
+		copySize = size;
+	});
+
+	FlushCopy();
+	FlushLiteral();
+
+	AppendValue(delta, std::uint8_t(OP_END));
+	return numLiteralBytes;
+}
@@ -0,0 +1,86 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef SAVE_DELTA_H
+#define SAVE_DELTA_H
+
+#include <cinttypes>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "System/UnorderedMap.hpp"
+
+/**
+ * @brief Incremental savegames: a full base save plus deltas against it
+ *
+ * A savegame is cut into pieces at the object boundaries reported by the
+ * creg serializer (COutputStreamSerializer::SetObjectOffsets), with pieces
+ * never larger than MAX_PIECE_SIZE. Every piece of the base is hashed; a
+ * delta then stores each piece of a newer save either as a reference to an
+ * identical piece of the base or as literal bytes, so unchanged objects cost
+ * a few bytes each (and runs of them only one reference).
+ *
+ * Deltas are computed on the serialized bytes and not on object identity:
+ * creg numbers objects in the order it reaches them, so IDs are not stable
+ * from one save to the next. An object whose own data is unchanged but
+ * which points at objects whose IDs moved is written as literal bytes.
+ *
+ * A delta file starts with MAGIC and names its base file, whose size and
+ * hash it also stores; it is only applied on top of exactly that base.
+ */
+class CSaveDelta
+{
+public:
+	// 15 characters plus terminator, like the demo and demo-index magics
+	static constexpr char MAGIC[16] = "spring ssfdelta";
+	static constexpr size_t MAX_PIECE_SIZE = 64 * 1024;
+
+	struct Header {
+		std::string baseName;
+		std::uint64_t baseSize = 0;
+		std::uint64_t baseHash[2] = {0, 0};
+		std::uint64_t dataSize = 0;
+		std::uint64_t dataHash[2] = {0, 0};
+	};
+
+public:
+	static bool IsDelta(std::string_view data);
+	static bool ReadHeader(std::string_view delta, Header& header);
+
+	/**
+	 * Rebuilds the savegame a delta was created from.
+	 * @return false if <base> is not the delta's base or the delta is corrupt
+	 */
+	static bool Apply(std::string_view delta, std::string_view base, std::string& data);
+
+	bool HasBase() const { return (!baseName.empty()); }
+	const std::string& GetBaseName() const { return baseName; }
+
+	/// remembers <data>, as written to <name>, as the base of later deltas
+	void SetBase(const std::string& name, std::string_view data, const std::vector<std::uint64_t>& offsets);
+	void ClearBase();
+
+	/**
+	 * Appends a delta of <data> against the base to <delta>.
+	 * @param offsets object boundaries within <data>, in ascending order
+	 * @return number of bytes of <data> stored as literals
+	 */
+	size_t Create(std::string_view data, const std::vector<std::uint64_t>& offsets, std::string& delta) const;
+
+private:
+	struct Piece {
+		std::uint64_t offset;
+		std::uint64_t size;
+		// the map is keyed by the low half
+		std::uint64_t hashHigh;
+	};
+
+	std::string baseName;
+
+	std::uint64_t baseSize = 0;
+	std::uint64_t baseHash[2] = {0, 0};
+
+	spring::unsynced_map<std::uint64_t, Piece> pieces;
+};
+
+#endif // SAVE_DELTA_H
@@ -13,6 +13,9 @@ const std::string ConnectAutohost = "Connecting to autohost on port %d";
 const std::string ConnectAutohostFailed = "Failed connecting to autohost on IP %s, port %d";
 const std::string DemoStart = "Beginning demo playback";
 const std::string DemoEnd = "End of demo reached";
+const std::string DemoSnapshotSeek = "Seeking to frame %d by loading demo snapshot of frame %d";
+const std::string DemoSnapshotResume = "Resuming demo playback from snapshot of frame %d";
+const std::string DemoSnapshotMissing = "Error: no demo index entry for frame %d, demo playback can not be resumed";
 const std::string GameEnd = "Game has ended";
 const std::string NoClientsExit = "No clients connected, shutting down server";
 
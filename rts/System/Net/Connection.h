@@ -3,6 +3,7 @@
 #ifndef _CONNECTION_H
 #define _CONNECTION_H
 
+#include <atomic>
 #include <string>
 #include <memory>
 
@@ -70,6 +71,10 @@ public:
 	virtual void Unmute() = 0;
 	virtual void Close(bool flush = false) = 0;
 	virtual void SetLossFactor(int factor) = 0;
+	/// deflate outgoing data at <level> (0 disables); the other end has to understand NETMSG_ZSTREAM
+	virtual void SetCompressionLevel(int level) {}
+	/// inflate incoming NETMSG_ZSTREAM's; links that receive one without this are dropped
+	virtual void AcceptCompressedData(bool accept) {}
 
 	/**
 	 * @brief update internals
@@ -77,10 +82,19 @@ public:
 	 */
 	virtual void Update() {}
 
+	/**
+	 * @brief whether Update() is driven by a relay thread
+	 * Listeners skip updating relayed connections; set from either thread.
+	 */
+	void SetRelayed(bool b) { relayed = b; }
+	bool IsRelayed() const { return relayed; }
+
 protected:
 	unsigned int dataSent = 0;
 	unsigned int dataRecv = 0;
 	unsigned int numPings = 0;
+
+	std::atomic<bool> relayed = {false};
 };
 
 } // namespace netcode
@@ -0,0 +1,102 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "PacketPool.h"
+
+#include <mutex>
+#include <new>
+
+#include "System/Threading/SpringThreading.h"
+
+namespace netcode
+{
+namespace PacketPool
+{
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	struct SizeClass {
+		spring::spinlock lock;
+
+		FreeBlock* head = nullptr;
+		uint32_t numFree = 0;
+	};
+
+	static_assert(sizeof(FreeBlock) <= MIN_BLOCK_SIZE, "");
+	static_assert((MIN_BLOCK_SIZE << (NUM_SIZE_CLASSES - 1)) == MAX_BLOCK_SIZE, "");
+
+	// constant-initialized, never destroyed in a way that matters
+	static SizeClass sizeClasses[NUM_SIZE_CLASSES];
+
+
+	static uint32_t GetSizeClass(size_t size)
+	{
+		uint32_t idx = 0;
+
+		for (size_t blockSize = MIN_BLOCK_SIZE; blockSize < size; blockSize <<= 1) {
+			idx++;
+		}
+
+		return idx;
+	}
+
+
+	void* Alloc(size_t size)
+	{
+		if (size > MAX_BLOCK_SIZE)
+			return (::operator new(size));
+
+		const uint32_t idx = GetSizeClass(size);
+
+		{
+			SizeClass& sc = sizeClasses[idx];
+			std::lock_guard<spring::spinlock> lock(sc.lock);
+
+			if (FreeBlock* block = sc.head; block != nullptr) {
+				sc.head = block->next;
+				sc.numFree -= 1;
+				return block;
+			}
+		}
+
+		return (::operator new(MIN_BLOCK_SIZE << idx));
+	}
+
+	void Free(void* ptr, size_t size)
+	{
+		if (ptr == nullptr)
+			return;
+
+		if (size > MAX_BLOCK_SIZE) {
+			::operator delete(ptr);
+			return;
+		}
+
+		{
+			SizeClass& sc = sizeClasses[GetSizeClass(size)];
+			std::lock_guard<spring::spinlock> lock(sc.lock);
+
+			if (sc.numFree < MAX_FREE_BLOCKS) {
+				FreeBlock* block = new (ptr) FreeBlock{sc.head};
+
+				sc.head = block;
+				sc.numFree += 1;
+				return;
+			}
+		}
+
+		::operator delete(ptr);
+	}
+
+	uint32_t GetNumFreeBlocks(size_t size)
+	{
+		if (size > MAX_BLOCK_SIZE)
+			return 0;
+
+		SizeClass& sc = sizeClasses[GetSizeClass(size)];
+		std::lock_guard<spring::spinlock> lock(sc.lock);
+
+		return sc.numFree;
+	}
+}
+}
@@ -0,0 +1,58 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace netcode
+{
+
+/**
+ * @brief recycles the small allocations made per network message
+ *
+ * Packet buffers, RawPacket objects, the shared_ptr control-blocks that
+ * wrap them and UDP chunks are all allocated and freed at message rate
+ * (on the server once per message and connection), so freed blocks are
+ * kept in per-size-class free-lists instead of going back to the heap.
+ * Sizes above MAX_BLOCK_SIZE are passed through to new/delete.
+ *
+ * Blocks can be freed from any thread; the state has no non-trivial
+ * destructors so packets released during static destruction are safe.
+ */
+namespace PacketPool
+{
+	static constexpr uint32_t MIN_BLOCK_SIZE = 16;
+	static constexpr uint32_t MAX_BLOCK_SIZE = 4096;
+	static constexpr uint32_t NUM_SIZE_CLASSES = 9; // 16, 32, ..., 4096
+	/// per size-class, anything freed beyond this goes back to the heap
+	static constexpr uint32_t MAX_FREE_BLOCKS = 2048;
+
+	void* Alloc(size_t size);
+	void Free(void* ptr, size_t size);
+
+	/// number of blocks awaiting reuse in the size-class of <size>
+	uint32_t GetNumFreeBlocks(size_t size);
+}
+
+
+/// std-compatible allocator on top of PacketPool, for control-blocks and containers
+template<typename T>
+struct PacketPoolAllocator {
+	typedef T value_type;
+
+	PacketPoolAllocator() = default;
+	template<typename U> PacketPoolAllocator(const PacketPoolAllocator<U>&) {}
+
+	T* allocate(size_t n) { return (static_cast<T*>(PacketPool::Alloc(n * sizeof(T)))); }
+	void deallocate(T* p, size_t n) { PacketPool::Free(p, n * sizeof(T)); }
+
+	template<typename U> bool operator == (const PacketPoolAllocator<U>&) const { return true; }
+	template<typename U> bool operator != (const PacketPoolAllocator<U>&) const { return false; }
+};
+
+} // namespace netcode
+
+#endif // PACKET_POOL_H
@@ -6,11 +6,13 @@
 #include <cassert>
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <utility>
 
 #include <string>
 #include <vector>
 
+#include "PacketPool.h"
 #include "System/Misc/NonCopyable.h"
 #include "System/SafeVector.h"
 
@@ -19,6 +21,8 @@ namespace netcode
 
 /**
  * @brief simple structure to hold some data
+ *
+ * Both the object and its data are allocated from the PacketPool.
  */
 class RawPacket
 {
@@ -40,7 +44,7 @@ public:
 		if (length == 0)
 			return;
 
-		data = new uint8_t[length];
+		data = static_cast<uint8_t*>(PacketPool::Alloc(length));
 	}
 
 	RawPacket(const uint32_t length, uint8_t msgID): RawPacket(length) {
@@ -52,6 +56,9 @@ public:
 
 	~RawPacket() { Delete(); }
 
+	static void* operator new(size_t size) { return (PacketPool::Alloc(size)); }
+	static void operator delete(void* ptr, size_t size) { PacketPool::Free(ptr, size); }
+
 
 	RawPacket& operator = (const RawPacket&  p) = delete;
 	RawPacket& operator = (      RawPacket&& p) {
@@ -117,7 +124,7 @@ public:
 		if (length == 0)
 			return;
 
-		delete[] data;
+		PacketPool::Free(data, length);
 		data = nullptr;
 
 		length = 0;
@@ -131,6 +138,13 @@ public:
 	uint32_t length = 0;
 };
 
+
+/// wraps a new packet in a shared_ptr whose control-block is pooled as well
+inline std::shared_ptr<const RawPacket> SharePacket(const RawPacket* packet)
+{
+	return {packet, std::default_delete<const RawPacket>(), PacketPoolAllocator<RawPacket>()};
+}
+
 } // namespace netcode
 
 #endif // RAW_PACKET_H
@@ -0,0 +1,149 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "StreamCompressor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#include "System/Log/ILog.h"
+
+
+namespace netcode
+{
+
+// raw deflate (no zlib header) with an 8KB window: a few dozen frames of
+// history at typical rates, at ~64KB of state per compressing connection
+static constexpr int WINDOW_BITS = 13;
+static constexpr int MEM_LEVEL = 6;
+
+
+StreamCompressor::StreamCompressor(int _level)
+	: stream(std::make_unique<z_stream_s>())
+	, level(std::clamp(_level, Z_BEST_SPEED, Z_BEST_COMPRESSION))
+{
+	memset(stream.get(), 0, sizeof(z_stream_s));
+
+	if (deflateInit2(stream.get(), level, Z_DEFLATED, -WINDOW_BITS, MEM_LEVEL, Z_DEFAULT_STRATEGY) == Z_OK)
+		return;
+
+	LOG_L(L_ERROR, "[StreamCompressor] failed to initialize deflate stream");
+	stream.reset();
+}
+
+StreamCompressor::~StreamCompressor()
+{
+	if (stream != nullptr)
+		deflateEnd(stream.get());
+}
+
+
+void StreamCompressor::SetLevel(int newLevel)
+{
+	newLevel = std::clamp(newLevel, Z_BEST_SPEED, Z_BEST_COMPRESSION);
+
+	if (stream == nullptr || newLevel == level)
+		return;
+
+	// only called between pieces, after a Flush, so there is nothing pending
+	if (deflateParams(stream.get(), newLevel, Z_DEFAULT_STRATEGY) == Z_OK)
+		level = newLevel;
+}
+
+
+bool StreamCompressor::Compress(const std::uint8_t* data, size_t size, std::vector<std::uint8_t>& out)
+{
+	return (Deflate(data, size, Z_NO_FLUSH, out));
+}
+
+bool StreamCompressor::Flush(std::vector<std::uint8_t>& out)
+{
+	return (Deflate(nullptr, 0, Z_SYNC_FLUSH, out));
+}
+
+bool StreamCompressor::Deflate(const std::uint8_t* data, size_t size, int flush, std::vector<std::uint8_t>& out)
+{
+	if (stream == nullptr)
+		return false;
+
+	stream->next_in = const_cast<std::uint8_t*>(data);
+	stream->avail_in = size;
+
+	// deflate keeps going as long as it fills the output
+	do {
+		const size_t pos = out.size();
+		const size_t room = std::max(size_t(64), deflateBound(stream.get(), stream->avail_in));
+
+		out.resize(pos + room);
+
+		stream->next_out = out.data() + pos;
+		stream->avail_out = room;
+
+		const int ret = deflate(stream.get(), flush);
+
+		out.resize(out.size() - stream->avail_out);
+
+		if (ret != Z_OK && ret != Z_BUF_ERROR)
+			return false;
+	} while (stream->avail_out == 0);
+
+	return (stream->avail_in == 0);
+}
+
+
+
+StreamDecompressor::StreamDecompressor(): stream(std::make_unique<z_stream_s>())
+{
+	memset(stream.get(), 0, sizeof(z_stream_s));
+
+	if (inflateInit2(stream.get(), -WINDOW_BITS) == Z_OK)
+		return;
+
+	LOG_L(L_ERROR, "[StreamDecompressor] failed to initialize inflate stream");
+	stream.reset();
+}
+
+StreamDecompressor::~StreamDecompressor()
+{
+	if (stream != nullptr)
+		inflateEnd(stream.get());
+}
+
+
+bool StreamDecompressor::Decompress(const std::uint8_t* data, size_t size, std::vector<std::uint8_t>& out, size_t maxSize)
+{
+	if (stream == nullptr)
+		return false;
+
+	stream->next_in = const_cast<std::uint8_t*>(data);
+	stream->avail_in = size;
+
+	const size_t start = out.size();
+
+	do {
+		const size_t pos = out.size();
+
+		// one byte more than allowed, so a stream that fills it is known to be too large
+		if ((pos - start) > maxSize)
+			return false;
+
+		const size_t room = std::min(std::max(size_t(4096), size * 4), maxSize + 1 - (pos - start));
+
+		out.resize(pos + room);
+
+		stream->next_out = out.data() + pos;
+		stream->avail_out = room;
+
+		const int ret = inflate(stream.get(), Z_SYNC_FLUSH);
+
+		out.resize(out.size() - stream->avail_out);
+
+		// Z_BUF_ERROR only means no progress was possible, i.e. all input is consumed
+		if (ret != Z_OK && ret != Z_BUF_ERROR)
+			return false;
+	} while (stream->avail_out == 0);
+
+	return (stream->avail_in == 0);
+}
+
+} // namespace netcode
@@ -0,0 +1,70 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _STREAM_COMPRESSOR_H
+#define _STREAM_COMPRESSOR_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "System/Misc/NonCopyable.h"
+
+struct z_stream_s;
+
+namespace netcode
+{
+
+/**
+ * @brief Deflates a byte stream in pieces, keeping the history between them
+ *
+ * Unlike compressing every packet on its own, later pieces can refer back
+ * to anything earlier in the window, which is what makes the many small and
+ * similar messages of a game stream compress well. Each Flush() ends on a
+ * byte boundary (Z_SYNC_FLUSH), so the output so far can be inflated by a
+ * StreamDecompressor that was fed all previous output in order.
+ */
+class StreamCompressor : spring::noncopyable
+{
+public:
+	StreamCompressor(int level);
+	~StreamCompressor();
+
+	bool IsValid() const { return (stream != nullptr); }
+
+	void SetLevel(int level);
+
+	/// appends compressed data to <out>, which may be held back until Flush
+	bool Compress(const std::uint8_t* data, size_t size, std::vector<std::uint8_t>& out);
+	bool Flush(std::vector<std::uint8_t>& out);
+
+private:
+	bool Deflate(const std::uint8_t* data, size_t size, int flush, std::vector<std::uint8_t>& out);
+
+private:
+	std::unique_ptr<z_stream_s> stream;
+	int level = 0;
+};
+
+
+class StreamDecompressor : spring::noncopyable
+{
+public:
+	StreamDecompressor();
+	~StreamDecompressor();
+
+	bool IsValid() const { return (stream != nullptr); }
+
+	/**
+	 * appends everything <data> decompresses to to <out>; fails (and leaves
+	 * the stream unusable) on undecodable data or if that would be more than
+	 * <maxSize> bytes, since the input comes from the other end of a link
+	 */
+	bool Decompress(const std::uint8_t* data, size_t size, std::vector<std::uint8_t>& out, size_t maxSize);
+
+private:
+	std::unique_ptr<z_stream_s> stream;
+};
+
+} // namespace netcode
+
+#endif // _STREAM_COMPRESSOR_H
@@ -0,0 +1,264 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "UDPBatch.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+#if defined(__linux__)
+	#include <cerrno>
+	#include <sys/socket.h>
+	#include <sys/uio.h>
+
+	#define HAVE_MMSG 1
+#else
+	#define HAVE_MMSG 0
+#endif
+
+#include "Socket.h"
+
+
+namespace netcode
+{
+
+// cleared if the running kernel turns out not to implement {send,recv}mmsg
+static std::atomic<bool> mmsgSupported = {HAVE_MMSG != 0};
+
+static thread_local UDPSendBatch* currentSendBatch = nullptr;
+
+
+UDPSendBatch::UDPSendBatch(bool capture): prevBatch(currentSendBatch), capturing(capture)
+{
+	datagrams.reserve(MAX_BATCH_SIZE);
+	buffer.reserve(MAX_BATCH_SIZE * 256);
+
+	if (capturing)
+		currentSendBatch = this;
+}
+
+UDPSendBatch::~UDPSendBatch()
+{
+	Flush();
+
+	if (!capturing)
+		return;
+
+	assert(currentSendBatch == this);
+	currentSendBatch = prevBatch;
+}
+
+UDPSendBatch* UDPSendBatch::GetCurrent() { return currentSendBatch; }
+
+
+void UDPSendBatch::Add(const std::shared_ptr<asio::ip::udp::socket>& socket, const asio::ip::udp::endpoint& to, const std::uint8_t* data, size_t size)
+{
+	datagrams.push_back({socket, to, buffer.size(), size});
+	buffer.insert(buffer.end(), data, data + size);
+}
+
+void UDPSendBatch::Append(UDPSendBatch& batch)
+{
+	const size_t offset = buffer.size();
+
+	for (const Datagram& dgram: batch.datagrams) {
+		datagrams.push_back({dgram.socket, dgram.to, offset + dgram.offset, dgram.size});
+	}
+
+	buffer.insert(buffer.end(), batch.buffer.begin(), batch.buffer.end());
+
+	batch.datagrams.clear();
+	batch.buffer.clear();
+}
+
+void UDPSendBatch::Flush()
+{
+	for (size_t first = 0, last = 0; first < datagrams.size(); first = last) {
+		const asio::ip::udp::socket* socket = datagrams[first].socket.get();
+
+		// all connections of a listener share its socket, so this is usually one run
+		for (last = first + 1; last < datagrams.size() && datagrams[last].socket.get() == socket; ++last) {
+		}
+
+		if (mmsgSupported) {
+			SendMulti(first, last);
+		} else {
+			SendSingle(first, last);
+		}
+	}
+
+	datagrams.clear();
+	buffer.clear();
+}
+
+
+size_t UDPSendBatch::SendMulti(size_t first, size_t last)
+{
+#if (HAVE_MMSG != 0)
+	std::array<mmsghdr, MAX_BATCH_SIZE> msgs;
+	std::array<iovec, MAX_BATCH_SIZE> iovs;
+
+	const int fd = datagrams[first].socket->native_handle();
+
+	size_t numSent = 0;
+
+	while (first < last) {
+		const size_t count = std::min(last - first, size_t(MAX_BATCH_SIZE));
+
+		for (size_t i = 0; i < count; i++) {
+			Datagram& dgram = datagrams[first + i];
+
+			iovs[i].iov_base = &buffer[dgram.offset];
+			iovs[i].iov_len = dgram.size;
+
+			memset(&msgs[i], 0, sizeof(msgs[i]));
+			msgs[i].msg_hdr.msg_name = dgram.to.data();
+			msgs[i].msg_hdr.msg_namelen = dgram.to.size();
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		const int ret = sendmmsg(fd, msgs.data(), count, 0);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == ENOSYS) {
+				mmsgSupported = false;
+				return (numSent + SendSingle(first, last));
+			}
+
+			asio::error_code err(errno, asio::error::get_system_category());
+			CheckErrorCode(err);
+
+			// the kernel refused the first datagram, drop it and carry on with the rest
+			first += 1;
+			continue;
+		}
+
+		numSent += ret;
+		first += ret;
+	}
+
+	return numSent;
+#else
+	return (SendSingle(first, last));
+#endif
+}
+
+size_t UDPSendBatch::SendSingle(size_t first, size_t last)
+{
+	size_t numSent = 0;
+
+	for (size_t i = first; i < last; i++) {
+		const Datagram& dgram = datagrams[i];
+
+		asio::ip::udp::socket::message_flags flags = 0;
+		asio::error_code err;
+
+		dgram.socket->send_to(asio::buffer(&buffer[dgram.offset], dgram.size), dgram.to, flags, err);
+
+		numSent += (!CheckErrorCode(err));
+	}
+
+	return numSent;
+}
+
+
+
+UDPReceiveBatch::UDPReceiveBatch()
+{
+	buffer.resize(MAX_BATCH_SIZE * MAX_DATAGRAM_SIZE, 0);
+	sizes.resize(MAX_BATCH_SIZE, 0);
+	endpoints.resize(MAX_BATCH_SIZE);
+}
+
+size_t UDPReceiveBatch::Receive(asio::ip::udp::socket& socket, asio::error_code& err)
+{
+	err.clear();
+
+	if (mmsgSupported)
+		return (ReceiveMulti(socket, err));
+
+	return (ReceiveSingle(socket, err));
+}
+
+
+size_t UDPReceiveBatch::ReceiveMulti(asio::ip::udp::socket& socket, asio::error_code& err)
+{
+#if (HAVE_MMSG != 0)
+	std::array<mmsghdr, MAX_BATCH_SIZE> msgs;
+	std::array<iovec, MAX_BATCH_SIZE> iovs;
+
+	for (size_t i = 0; i < MAX_BATCH_SIZE; i++) {
+		iovs[i].iov_base = &buffer[i * MAX_DATAGRAM_SIZE];
+		iovs[i].iov_len = MAX_DATAGRAM_SIZE;
+
+		memset(&msgs[i], 0, sizeof(msgs[i]));
+		msgs[i].msg_hdr.msg_name = endpoints[i].data();
+		msgs[i].msg_hdr.msg_namelen = endpoints[i].capacity();
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int ret = 0;
+
+	while ((ret = recvmmsg(socket.native_handle(), msgs.data(), MAX_BATCH_SIZE, MSG_DONTWAIT, nullptr)) < 0 && errno == EINTR) {
+	}
+
+	if (ret < 0) {
+		if (errno == ENOSYS) {
+			mmsgSupported = false;
+			return (ReceiveSingle(socket, err));
+		}
+
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			err.assign(errno, asio::error::get_system_category());
+
+		return 0;
+	}
+
+	for (int i = 0; i < ret; i++) {
+		endpoints[i].resize(msgs[i].msg_hdr.msg_namelen);
+		sizes[i] = ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0)? 0: msgs[i].msg_len;
+	}
+
+	return ret;
+#else
+	return (ReceiveSingle(socket, err));
+#endif
+}
+
+size_t UDPReceiveBatch::ReceiveSingle(asio::ip::udp::socket& socket, asio::error_code& err)
+{
+	size_t numReceived = 0;
+
+	while (numReceived < MAX_BATCH_SIZE && socket.available(err) > 0) {
+		asio::ip::udp::socket::message_flags flags = 0;
+		asio::mutable_buffer recvBuffer = asio::buffer(&buffer[numReceived * MAX_DATAGRAM_SIZE], MAX_DATAGRAM_SIZE);
+
+		sizes[numReceived] = socket.receive_from(recvBuffer, endpoints[numReceived], flags, err);
+
+		// Windows reports oversized datagrams as an error, drop them like recvmmsg does
+		if (err == asio::error::message_size) {
+			sizes[numReceived] = 0;
+			err.clear();
+		}
+
+		if (err)
+			break;
+
+		numReceived += 1;
+	}
+
+	// report errors on the next call, when there is nothing to hand out first
+	if (numReceived > 0)
+		err.clear();
+
+	return numReceived;
+}
+
+} // namespace netcode
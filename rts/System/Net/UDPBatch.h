@@ -0,0 +1,110 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _UDP_BATCH_H
+#define _UDP_BATCH_H
+
+#include <asio/ip/udp.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "System/Misc/NonCopyable.h"
+
+namespace netcode
+{
+
+/**
+ * @brief Collects outgoing datagrams and sends them with as few syscalls as possible
+ *
+ * While an instance is alive, every UDPConnection::SendPacket on the same
+ * thread appends to it instead of calling send_to. When it goes out of
+ * scope (or on Flush) the datagrams for each socket go out through
+ * sendmmsg on Linux, up to MAX_BATCH_SIZE per call. Elsewhere, or when the
+ * kernel lacks sendmmsg, they are sent one by one.
+ *
+ * As with send_to on a non-blocking socket, datagrams the kernel refuses
+ * are dropped; the protocol resends them like any other lost packet.
+ *
+ * A batch constructed with capture=false only collects what is appended to
+ * it, which lets one thread prepare datagrams for the socket's owner.
+ */
+class UDPSendBatch : spring::noncopyable
+{
+public:
+	static constexpr unsigned int MAX_BATCH_SIZE = 64;
+
+	UDPSendBatch(bool capture = true);
+	~UDPSendBatch();
+
+	/// innermost batch opened by the calling thread, or null
+	static UDPSendBatch* GetCurrent();
+
+	void Add(const std::shared_ptr<asio::ip::udp::socket>& socket, const asio::ip::udp::endpoint& to, const std::uint8_t* data, size_t size);
+	/// moves all datagrams queued in <batch> to the end of this one
+	void Append(UDPSendBatch& batch);
+	void Flush();
+
+	size_t GetNumQueued() const { return datagrams.size(); }
+
+private:
+	struct Datagram {
+		std::shared_ptr<asio::ip::udp::socket> socket;
+		asio::ip::udp::endpoint to;
+
+		size_t offset;
+		size_t size;
+	};
+
+	/// sends datagrams[first, last), which all share a socket; returns how many were passed to the kernel
+	size_t SendMulti(size_t first, size_t last);
+	size_t SendSingle(size_t first, size_t last);
+
+private:
+	std::vector<Datagram> datagrams;
+	std::vector<std::uint8_t> buffer;
+
+	UDPSendBatch* prevBatch = nullptr;
+
+	bool capturing = true;
+};
+
+
+/**
+ * @brief Receives all datagrams queued on a socket in as few syscalls as possible
+ *
+ * Receive() never blocks; on Linux it uses recvmmsg to read up to
+ * MAX_BATCH_SIZE datagrams at once, elsewhere it loops over receive_from.
+ */
+class UDPReceiveBatch : spring::noncopyable
+{
+public:
+	static constexpr unsigned int MAX_BATCH_SIZE = 64;
+	/// same as the largest packet UDPConnection sends
+	static constexpr unsigned int MAX_DATAGRAM_SIZE = 4096;
+
+	UDPReceiveBatch();
+
+	/**
+	 * @return number of datagrams read; zero if nothing was queued
+	 *   or an error occurred, which is then stored in <err>
+	 */
+	size_t Receive(asio::ip::udp::socket& socket, asio::error_code& err);
+
+	const std::uint8_t* GetData(size_t i) const { return &buffer[i * MAX_DATAGRAM_SIZE]; }
+	/// zero for datagrams that were truncated
+	size_t GetSize(size_t i) const { return sizes[i]; }
+	const asio::ip::udp::endpoint& GetEndpoint(size_t i) const { return endpoints[i]; }
+
+private:
+	size_t ReceiveMulti(asio::ip::udp::socket& socket, asio::error_code& err);
+	size_t ReceiveSingle(asio::ip::udp::socket& socket, asio::error_code& err);
+
+private:
+	std::vector<std::uint8_t> buffer;
+	std::vector<size_t> sizes;
+	std::vector<asio::ip::udp::endpoint> endpoints;
+};
+
+} // namespace netcode
+
+#endif // _UDP_BATCH_H
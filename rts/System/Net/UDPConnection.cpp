@@ -2,10 +2,13 @@
 
 #include "UDPConnection.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <limits>
 
 
 #include "Socket.h"
+#include "UDPBatch.h"
 #include "ProtocolDef.h"
 #include "Exception.h"
 #include "Net/Protocol/BaseNetProtocol.h"
@@ -27,6 +30,8 @@ using namespace asio;
 static constexpr unsigned udpMaxPacketSize = 4096;
 static constexpr int maxChunkSize = 254;
 static constexpr int chunksPerSec = 30;
+// raw bytes per NETMSG_ZSTREAM; keeps the deflated size far below the uint16_t limit
+static constexpr unsigned maxZStreamRawSize = 8192;
 
 
 
@@ -96,8 +101,9 @@ public:
 		pos += sizeof(t);
 	}
 
-	void Unpack(std::vector<std::uint8_t>& t, unsigned unpackLength) {
-		std::copy(data + pos, data + pos + unpackLength, std::back_inserter(t));
+	template<typename A>
+	void Unpack(std::vector<std::uint8_t, A>& t, unsigned unpackLength) {
+		t.assign(data + pos, data + pos + unpackLength);
 		pos += unpackLength;
 	}
 
@@ -125,8 +131,9 @@ public:
 		*reinterpret_cast<T*>(&data[pos]) = t;
 	}
 
-	void Pack(std::vector<std::uint8_t>& _data) {
-		std::copy(_data.begin(), _data.end(), std::back_inserter(data));
+	template<typename A>
+	void Pack(std::vector<std::uint8_t, A>& _data) {
+		data.insert(data.end(), _data.begin(), _data.end());
 	}
 
 private:
@@ -171,7 +178,7 @@ Packet::Packet(const unsigned char* data, unsigned length)
 	chunks.reserve(buf.Remaining() / Chunk::headerSize);
 
 	while (buf.Remaining() > Chunk::headerSize) {
-		ChunkPtr temp(new Chunk);
+		ChunkPtr temp = Chunk::Create();
 		buf.Unpack(temp->chunkNumber);
 		buf.Unpack(temp->chunkSize);
 
@@ -326,6 +333,7 @@ void UDPConnection::Init()
 }
 
 void UDPConnection::ReconnectTo(CConnection& conn) {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
 	dynamic_cast<UDPConnection&>(conn).CopyConnection(*this);
 }
 
@@ -348,12 +356,26 @@ UDPConnection::~UDPConnection()
 
 void UDPConnection::SendData(std::shared_ptr<const RawPacket> pkt)
 {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
 	assert(pkt->length > 0);
 	outgoingData.push_back(pkt);
 }
 
+bool UDPConnection::HasIncomingData() const
+{
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+	return !msgQueue.empty();
+}
+
+unsigned int UDPConnection::GetPacketQueueSize() const
+{
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+	return msgQueue.size();
+}
+
 std::shared_ptr<const RawPacket> UDPConnection::Peek(unsigned ahead) const
 {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
 	if (ahead >= msgQueue.size())
 		return {};
 
@@ -363,6 +385,7 @@ std::shared_ptr<const RawPacket> UDPConnection::Peek(unsigned ahead) const
 #ifdef ENABLE_DEBUG_STATS
 std::shared_ptr<const RawPacket> UDPConnection::GetData()
 {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
 	numTotalGetDataCalls++;
 
 	if (!msgQueue.empty()) {
@@ -382,6 +405,7 @@ std::shared_ptr<const RawPacket> UDPConnection::GetData()
 #else
 std::shared_ptr<const RawPacket> UDPConnection::GetData()
 {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
 	if (msgQueue.empty())
 		return {};
 
@@ -396,6 +420,7 @@ std::shared_ptr<const RawPacket> UDPConnection::GetData()
 
 void UDPConnection::DeleteBufferPacketAt(unsigned index)
 {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
 	if (index >= msgQueue.size())
 		return;
 
@@ -405,6 +430,8 @@ void UDPConnection::DeleteBufferPacketAt(unsigned index)
 
 void UDPConnection::Update()
 {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+
 	spring_time curTime = spring_gettime();
 	outgoing.UpdateTime(spring_tomsecs(curTime));
 
@@ -523,6 +550,11 @@ void UDPConnection::UpdateResendRequests()
 
 void UDPConnection::ProcessRawPacket(Packet& incoming)
 {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+
+	if (streamBroken)
+		return;
+
 	#ifdef ENABLE_DEBUG_STATS
 	if (logMessages)
 		LOG_L(L_INFO, "\t[%s] checksum=(%u : %u) mtu=%u", __func__, incoming.GetChecksum(), incoming.checksum, mtu);
@@ -644,36 +676,14 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 
 			// this returns false for zero/invalid pktLength
 			if (ProtocolDef::GetInstance()->IsValidLength(pktLength, msgLength)) {
-				msgQueue.emplace_back(new RawPacket(bufp, pktLength));
-				std::shared_ptr<const RawPacket>& msgPacket = msgQueue.back();
-
-				#ifdef ENABLE_DEBUG_STATS
-				// server sends both of these, clients send only keyframe messages
-				// TODO: would be easy to feed this data into a Q3A-style lagometer
-				//
-				if (msgPacket->data[0] == NETMSG_NEWFRAME || msgPacket->data[0] == NETMSG_KEYFRAME) {
-					const spring_time dt = spring_gettime() - lastFramePacketRecvTime;
-
-					sumDeltaFramePacketRecvTime += dt.toMilliSecsf();
-					minDeltaFramePacketRecvTime = std::min(dt.toMilliSecsf(), minDeltaFramePacketRecvTime);
-					maxDeltaFramePacketRecvTime = std::max(dt.toMilliSecsf(), maxDeltaFramePacketRecvTime);
-
-					numReceivedFramePackets += 1;
-					numEnqueuedFramePackets += 1;
-					lastFramePacketRecvTime = spring_gettime();
-
-					if (logMessages) {
-						LOG_L(L_INFO,
-							"\t[%s] (received=%u enqueued=%u) packets (dt=%fms mindt=%fms maxdt=%fms sumdt=%fms)",
-							__func__, numReceivedFramePackets, numEnqueuedFramePackets, dt.toMilliSecsf(),
-							minDeltaFramePacketRecvTime, maxDeltaFramePacketRecvTime, sumDeltaFramePacketRecvTime
-						);
-					}
+				if (*bufp == NETMSG_ZSTREAM) {
+					if (!DecompressMessages(bufp, pktLength))
+						return;
+				} else {
+					EnqueueMessage(bufp, pktLength);
 				}
-				#endif
 
 				pos += pktLength;
-				numPings += (msgPacket->data[0] == NETMSG_PING); // incoming
 			} else {
 				if (pktLength >= 0) {
 					// partial packet in buffer
@@ -693,8 +703,157 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 	UpdateWaitingPackets();
 }
 
+void UDPConnection::CompressOutgoingData()
+{
+	constexpr unsigned headerSize = sizeof(std::uint8_t) + sizeof(std::uint16_t);
+	// smaller runs gain less than the header and sync-flush marker cost
+	constexpr unsigned minRawSize = 64;
+
+	if (compressionLevel <= 0 || outgoingData.empty())
+		return;
+
+	const ProtocolDef* proto = ProtocolDef::GetInstance();
+
+	// invalid packets must not enter the stream, the loop in Flush discards them
+	const auto IsCompressible = [&](const std::shared_ptr<const RawPacket>& pkt) {
+		return (pkt->length <= maxZStreamRawSize && pkt->data[0] != NETMSG_ZSTREAM && proto->IsValidPacket(pkt->data, pkt->length));
+	};
+
+	// a bandwidth-limited Flush can leave NETMSG_ZSTREAM's behind, those are
+	// passed through as they are; order is preserved either way
+	std::deque< std::shared_ptr<const RawPacket> > packets;
+	std::swap(packets, outgoingData);
+
+	for (size_t first = 0, last = 0; first < packets.size(); first = last) {
+		unsigned rawSize = 0;
+
+		for (last = first; last < packets.size() && IsCompressible(packets[last]) && (rawSize + packets[last]->length) <= maxZStreamRawSize; ++last) {
+			rawSize += packets[last]->length;
+		}
+
+		if (last == first)
+			last += 1;
+
+		if (rawSize < minRawSize) {
+			for (size_t i = first; i < last; i++) {
+				outgoingData.push_back(std::move(packets[i]));
+			}
+			continue;
+		}
+
+		compressBuffer.clear();
+		compressBuffer.resize(headerSize, 0);
+
+		bool compressed = true;
+
+		for (size_t i = first; i < last; i++) {
+			compressed &= compressor->Compress(packets[i]->data, packets[i]->length, compressBuffer);
+		}
+
+		compressed &= compressor->Flush(compressBuffer);
+
+		if (!compressed || compressBuffer.size() > std::numeric_limits<std::uint16_t>::max()) {
+			// the stream is unusable from here on, nothing of it has been sent yet though
+			LOG_L(L_ERROR, "[UDPConnection::%s] compression failed, sending uncompressed from now on", __func__);
+
+			compressionLevel = 0;
+			compressor.reset();
+
+			for (size_t i = first; i < packets.size(); i++) {
+				outgoingData.push_back(std::move(packets[i]));
+			}
+			break;
+		}
+
+		const std::uint16_t packetSize = compressBuffer.size();
+
+		compressBuffer[0] = NETMSG_ZSTREAM;
+		memcpy(&compressBuffer[1], &packetSize, sizeof(packetSize));
+
+		outgoingData.push_back(SharePacket(new RawPacket(compressBuffer.data(), compressBuffer.size())));
+		outgoing.DataCompressed(rawSize, compressBuffer.size());
+	}
+}
+
+void UDPConnection::EnqueueMessage(const std::uint8_t* data, unsigned length)
+{
+	msgQueue.emplace_back(SharePacket(new RawPacket(data, length)));
+	std::shared_ptr<const RawPacket>& msgPacket = msgQueue.back();
+
+	#ifdef ENABLE_DEBUG_STATS
+	// server sends both of these, clients send only keyframe messages
+	// TODO: would be easy to feed this data into a Q3A-style lagometer
+	//
+	if (msgPacket->data[0] == NETMSG_NEWFRAME || msgPacket->data[0] == NETMSG_KEYFRAME) {
+		const spring_time dt = spring_gettime() - lastFramePacketRecvTime;
+
+		sumDeltaFramePacketRecvTime += dt.toMilliSecsf();
+		minDeltaFramePacketRecvTime = std::min(dt.toMilliSecsf(), minDeltaFramePacketRecvTime);
+		maxDeltaFramePacketRecvTime = std::max(dt.toMilliSecsf(), maxDeltaFramePacketRecvTime);
+
+		numReceivedFramePackets += 1;
+		numEnqueuedFramePackets += 1;
+		lastFramePacketRecvTime = spring_gettime();
+
+		if (logMessages) {
+			LOG_L(L_INFO,
+				"\t[%s] (received=%u enqueued=%u) packets (dt=%fms mindt=%fms maxdt=%fms sumdt=%fms)",
+				__func__, numReceivedFramePackets, numEnqueuedFramePackets, dt.toMilliSecsf(),
+				minDeltaFramePacketRecvTime, maxDeltaFramePacketRecvTime, sumDeltaFramePacketRecvTime
+			);
+		}
+	}
+	#endif
+
+	numPings += (msgPacket->data[0] == NETMSG_PING); // incoming
+}
+
+bool UDPConnection::DecompressMessages(const std::uint8_t* data, unsigned length)
+{
+	constexpr unsigned headerSize = sizeof(std::uint8_t) + sizeof(std::uint16_t);
+
+	if (!acceptCompressed) {
+		LOG_L(L_ERROR, "\t[%s] dropping link %s, compressed data was not negotiated", __func__, GetFullAddress().c_str());
+		streamBroken = true;
+		return false;
+	}
+
+	if (decompressor == nullptr)
+		decompressor = std::make_unique<StreamDecompressor>();
+
+	decompressBuffer.clear();
+
+	// everything after this in the stream depends on it, so there is no way to skip ahead
+	if (!decompressor->Decompress(data + headerSize, length - headerSize, decompressBuffer, maxZStreamRawSize)) {
+		LOG_L(L_ERROR, "\t[%s] dropping link %s, undecodable or oversized compressed data (LEN %u)", __func__, GetFullAddress().c_str(), length);
+		streamBroken = true;
+		return false;
+	}
+
+	// the sender only ever compresses whole and valid messages
+	for (unsigned pos = 0; pos < decompressBuffer.size(); ) {
+		const unsigned char* bufp = &decompressBuffer[pos];
+		const unsigned int msgLength = decompressBuffer.size() - pos;
+
+		const int pktLength = ProtocolDef::GetInstance()->PacketLength(bufp, msgLength);
+
+		if (!ProtocolDef::GetInstance()->IsValidLength(pktLength, msgLength) || *bufp == NETMSG_ZSTREAM) {
+			LOG_L(L_ERROR, "\t[%s] dropping link %s, invalid compressed packet: ID %d, LEN %d", __func__, GetFullAddress().c_str(), (int)*bufp, pktLength);
+			streamBroken = true;
+			return false;
+		}
+
+		EnqueueMessage(bufp, pktLength);
+		pos += pktLength;
+	}
+
+	return true;
+}
+
 void UDPConnection::Flush(const bool forced)
 {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+
 	if (muted)
 		return;
 
@@ -714,6 +873,8 @@ void UDPConnection::Flush(const bool forced)
 	}
 
 	if (forced || (!waitMore && outgoingLength > requiredLength)) {
+		CompressOutgoingData();
+
 		std::uint8_t buffer[udpMaxPacketSize];
 		unsigned pos = 0;
 
@@ -723,12 +884,17 @@ void UDPConnection::Flush(const bool forced)
 		bool partialPacket = false;
 		bool sendMore = true;
 
+		// bytes of the front packet already put into chunks; the packet is
+		// shared with every other connection it was sent to, so it is never
+		// copied or modified here
+		unsigned packetPos = 0;
+
 		do {
 			sendMore  = (outgoing.GetAverage(true) <= globalConfig.linkOutgoingBandwidth);
 			sendMore |= ((globalConfig.linkOutgoingBandwidth <= 0) || partialPacket || forced);
 
 			if (!outgoingData.empty() && sendMore) {
-				std::shared_ptr<const RawPacket>& packet = *(outgoingData.begin());
+				const std::shared_ptr<const RawPacket>& packet = *(outgoingData.begin());
 
 				if (!partialPacket && !ProtocolDef::GetInstance()->IsValidPacket(packet->data, packet->length)) {
 					LOG_L(L_ERROR,
@@ -737,22 +903,21 @@ void UDPConnection::Flush(const bool forced)
 					);
 					outgoingData.pop_front();
 				} else {
-					const unsigned numBytes = std::min((unsigned)maxChunkSize - pos, packet->length);
+					const unsigned numBytes = std::min((unsigned)maxChunkSize - pos, packet->length - packetPos);
 
 					assert(packet->length > 0);
-					memcpy(buffer + pos, packet->data, numBytes);
+					memcpy(buffer + pos, packet->data + packetPos, numBytes);
 
 					pos += numBytes;
+					packetPos += numBytes;
 					sentOverhead += Packet::headerSize;
 
 					outgoing.DataSent(numBytes, true);
 
-					if ((partialPacket = (numBytes != packet->length))) {
-						// partially transferred
-						packet.reset(new RawPacket(packet->data + numBytes, packet->length - numBytes));
-					} else {
+					if (!(partialPacket = (packetPos != packet->length))) {
 						// full packet copied
 						outgoingData.pop_front();
+						packetPos = 0;
 					}
 				}
 			}
@@ -768,6 +933,11 @@ void UDPConnection::Flush(const bool forced)
 
 bool UDPConnection::CheckTimeout(int seconds, bool initial) const {
 
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+
+	if (streamBroken)
+		return true;
+
 	int timeout;
 
 	if (seconds == 0) {
@@ -785,6 +955,8 @@ bool UDPConnection::CheckTimeout(int seconds, bool initial) const {
 
 bool UDPConnection::NeedsReconnect() {
 
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+
 	if (CanReconnect()) {
 		if (!CheckTimeout(-1)) {
 			reconnectTime = globalConfig.reconnectTimeout;
@@ -803,12 +975,15 @@ bool UDPConnection::CanReconnect() const {
 
 std::string UDPConnection::Statistics() const
 {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+
 	const char* fmts[] = {
 		"\t%u bytes sent   in %u packets (%.3f bytes/packet)\n",
 		"\t%u bytes recv'd in %u packets (%.3f bytes/packet)\n",
 		"\t{%.3fx, %.3fx} relative protocol overhead {up, down}\n",
 		"\t%u incoming chunks dropped, %u outgoing chunks resent\n",
 		"\t%u incoming chunks processed\n",
+		"\t%u bytes deflated to %u (%.3fx), level %d\n",
 	};
 
 	std::string msg = "[UDPConnection::Statistics]\n";
@@ -817,11 +992,13 @@ std::string UDPConnection::Statistics() const
 	msg += spring::format(fmts[2], spring::SafeDivide(sentOverhead * 1.0f, dataSent * 1.0f), spring::SafeDivide(recvOverhead * 1.0f, dataRecv * 1.0f));
 	msg += spring::format(fmts[3], droppedChunks, resentChunks);
 	msg += spring::format(fmts[4], lastInOrder + 1);
+	msg += spring::format(fmts[5], outgoing.GetRawCompressed(), outgoing.GetCompressed(), outgoing.GetCompressionRatio(), compressionLevel);
 	return msg;
 }
 
 std::string UDPConnection::GetFullAddress() const
 {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
 	return spring::format("[%s]:%u", addr.address().to_string().c_str(), addr.port());
 }
 
@@ -835,10 +1012,10 @@ void UDPConnection::SetMTU(unsigned mtu2)
 void UDPConnection::CreateChunk(const unsigned char* data, const unsigned length, const int packetNum)
 {
 	assert((length > 0) && (length < 255));
-	ChunkPtr buf(new Chunk);
+	ChunkPtr buf = Chunk::Create();
 	buf->chunkNumber = packetNum;
 	buf->chunkSize = length;
-	std::copy(data, data + length, std::back_inserter(buf->data));
+	buf->data.assign(data, data + length);
 	newChunks.push_back(buf);
 	lastChunkCreatedTime = spring_gettime();
 }
@@ -1057,7 +1234,12 @@ void UDPConnection::SendPacket(Packet& pkt)
 	asio::error_code err;
 
 	EMULATE_LATENCY( !EMULATE_PACKET_LOSS( LOSS_COUNTER ) ) {
-		mySocket->send_to(buffer(sendBuffer), addr, flags, err);
+		// errors of batched sends are logged when the batch is flushed
+		if (UDPSendBatch* batch = UDPSendBatch::GetCurrent(); batch != nullptr) {
+			batch->Add(mySocket, addr, sendBuffer.data(), sendBuffer.size());
+		} else {
+			mySocket->send_to(buffer(sendBuffer), addr, flags, err);
+		}
 	}
 
 	if (CheckErrorCode(err))
@@ -1119,14 +1301,27 @@ void UDPConnection::BandwidthUsage::DataSent(unsigned amount, bool prel)
 	}
 }
 
+void UDPConnection::BandwidthUsage::DataCompressed(unsigned rawAmount, unsigned compressedAmount)
+{
+	rawCompressed += rawAmount;
+	compressed += compressedAmount;
+}
+
 float UDPConnection::BandwidthUsage::GetAverage(bool prel) const
 {
 	// not exactly accurate, but does job
 	return average + (prel ? std::max(trafficSinceLastTime, prelTrafficSinceLastTime) : trafficSinceLastTime);
 }
 
+float UDPConnection::BandwidthUsage::GetCompressionRatio() const
+{
+	return (spring::SafeDivide(compressed * 1.0f, rawCompressed * 1.0f));
+}
+
 void UDPConnection::Close(bool flush) {
 
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+
 	if (closed)
 		return;
 
@@ -1142,10 +1337,39 @@ void UDPConnection::Close(bool flush) {
 	closed = true;
 }
 
+void UDPConnection::Unmute() {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+	muted = false;
+}
+
 void UDPConnection::SetLossFactor(int factor) {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
 	netLossFactor = factor;
 	netLossFactor = std::max(netLossFactor, int(MIN_LOSS_FACTOR));
 	netLossFactor = std::min(netLossFactor, int(MAX_LOSS_FACTOR));
 }
 
+void UDPConnection::SetCompressionLevel(int level) {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+
+	// the level is only ever changed between Flush calls, so the stream
+	// continues where it left off and the other end keeps decoding it
+	if ((compressionLevel = std::clamp(level, 0, 9)) == 0)
+		return;
+
+	if (compressor == nullptr) {
+		compressor = std::make_unique<StreamCompressor>(compressionLevel);
+	} else {
+		compressor->SetLevel(compressionLevel);
+	}
+
+	if (!compressor->IsValid())
+		compressionLevel = 0;
+}
+
+void UDPConnection::AcceptCompressedData(bool accept) {
+	std::lock_guard<spring::recursive_mutex> lock(mutex);
+	acceptCompressed = accept;
+}
+
 } // namespace netcode
@@ -8,7 +8,10 @@
 #include <deque>
 
 #include "Connection.h"
+#include "PacketPool.h"
+#include "StreamCompressor.h"
 #include "System/Misc/SpringTime.h"
+#include "System/Threading/SpringThreading.h"
 #include "System/UnorderedSet.hpp"
 
 class CRC;
@@ -35,7 +38,10 @@ public:
 	static constexpr unsigned headerSize = 5;
 	std::int32_t chunkNumber;
 	std::uint8_t chunkSize;
-	std::vector<std::uint8_t> data;
+	std::vector<std::uint8_t, PacketPoolAllocator<std::uint8_t> > data;
+
+	/// chunk and control-block in one pooled allocation
+	static std::shared_ptr<Chunk> Create() { return (std::allocate_shared<Chunk>(PacketPoolAllocator<Chunk>())); }
 };
 typedef std::shared_ptr<Chunk> ChunkPtr;
 
@@ -77,6 +83,9 @@ public:
 
 /**
  * @brief Communication class for sending and receiving over UDP
+ *
+ * Public members lock the connection, so that a relay thread can send and
+ * update while the listener's thread receives.
  */
 class UDPConnection : public CConnection
 {
@@ -94,7 +103,7 @@ public:
 
 	// START overriding CConnection
 	void SendData(std::shared_ptr<const RawPacket> pkt) override;
-	bool HasIncomingData() const override { return !msgQueue.empty(); }
+	bool HasIncomingData() const override;
 	std::shared_ptr<const RawPacket> Peek(unsigned ahead) const override;
 	std::shared_ptr<const RawPacket> GetData() override;
 	void DeleteBufferPacketAt(unsigned index) override;
@@ -105,7 +114,7 @@ public:
 	bool CanReconnect() const override;
 	bool NeedsReconnect() override;
 
-	unsigned int GetPacketQueueSize() const override { return msgQueue.size(); }
+	unsigned int GetPacketQueueSize() const override;
 
 	std::string Statistics() const override;
 	std::string GetFullAddress() const override;
@@ -128,9 +137,11 @@ public:
 	bool UseMinLossFactor() const { return (netLossFactor == MIN_LOSS_FACTOR); }
 
 	/// Connections are stealth by default, this allow them to send data
-	void Unmute() override { muted = false; }
+	void Unmute() override;
 	void Close(bool flush) override;
 	void SetLossFactor(int factor) override;
+	void SetCompressionLevel(int level) override;
+	void AcceptCompressedData(bool accept) override;
 
 	const asio::ip::udp::endpoint& GetEndpoint() const { return addr; }
 
@@ -155,6 +166,12 @@ private:
 	void UpdateWaitingPackets();
 	void UpdateResendRequests();
 
+	/// replaces runs of uncompressed messages in outgoingData by NETMSG_ZSTREAM messages
+	void CompressOutgoingData();
+	/// false if the link has to be dropped (see streamBroken)
+	bool DecompressMessages(const std::uint8_t* data, unsigned length);
+	void EnqueueMessage(const std::uint8_t* data, unsigned length);
+
 private:
 	spring_time lastChunkCreatedTime;
 	spring_time lastPacketSendTime;
@@ -222,8 +239,26 @@ private:
 	/// Our socket
 	std::shared_ptr<asio::ip::udp::socket> mySocket;
 
+	mutable spring::recursive_mutex mutex;
+
 	RawPacket fragmentBuffer;
 
+	/// outgoing messages are deflated as one stream while this is non-zero
+	int compressionLevel = 0;
+
+	/// kept when compression is switched off, the other end still holds its history
+	std::unique_ptr<StreamCompressor> compressor;
+	/// created when the first NETMSG_ZSTREAM arrives, if accepted at all
+	std::unique_ptr<StreamDecompressor> decompressor;
+
+	bool acceptCompressed = false;
+	/// set on a NETMSG_ZSTREAM that was not negotiated, too large or undecodable;
+	/// nothing more is read from the link and it counts as timed out
+	bool streamBroken = false;
+
+	std::vector<std::uint8_t> compressBuffer;
+	std::vector<std::uint8_t> decompressBuffer;
+
 	// Traffic statistics and stuff
 	#ifdef ENABLE_DEBUG_STATS
 	float sumDeltaFramePacketRecvTime;
@@ -249,14 +284,23 @@ private:
 		BandwidthUsage() = default;
 		void UpdateTime(unsigned newTime);
 		void DataSent(unsigned amount, bool prel = false);
+		void DataCompressed(unsigned rawAmount, unsigned compressedAmount);
 
 		float GetAverage(bool prel = false) const;
+		/// compressed size relative to the raw size, over all compressed data so far
+		float GetCompressionRatio() const;
+
+		unsigned GetRawCompressed() const { return rawCompressed; }
+		unsigned GetCompressed() const { return compressed; }
 
 	private:
 		unsigned lastTime = 0;
 		unsigned trafficSinceLastTime = 1;
 		unsigned prelTrafficSinceLastTime = 0;
 
+		unsigned rawCompressed = 0;
+		unsigned compressed = 0;
+
 		float average = 0.0f;
 	};
 
@@ -10,6 +10,8 @@
 #include <queue>
 #include <string>
 
+#include "UDPBatch.h"
+
 namespace netcode
 {
 class UDPConnection;
@@ -75,6 +77,10 @@ public:
 	void RejectConnection() { waiting.pop(); }
 	void UpdateConnections(); // Updates connections when the endpoint has been reconnected
 
+private:
+	/// hand a received datagram to its connection, or open a new one
+	void ProcessDatagram(const asio::ip::udp::endpoint& udpEndPoint, const std::uint8_t* bytes, size_t bytesReceived);
+
 private:
 	/**
 	 * @brief Do we accept packets from unknown sources?
@@ -85,7 +91,7 @@ private:
 	/// socket being listened on
 	std::shared_ptr<asio::ip::udp::socket> socket;
 
-	std::vector<std::uint8_t> recvBuffer;
+	UDPReceiveBatch recvBatch;
 
 	/// all connections
 	std::map< asio::ip::udp::endpoint, std::weak_ptr<UDPConnection> > connMap;
@@ -67,6 +67,9 @@ public:
 		pos += (text.size() + 1);
 	}
 
+	/// for optional trailing fields that older senders do not append
+	size_t GetBytesLeft() const { return (pckt->length - pos); }
+
 private:
 	std::shared_ptr<const RawPacket> pckt;
 	size_t pos;
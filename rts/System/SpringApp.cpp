@@ -27,6 +27,7 @@
 #include "aGui/Gui.h"
 #endif
 #include "ExternalAI/AILibraryManager.h"
+#include "Game/Benchmark.h"
 #include "Game/CameraHandler.h"
 #include "Game/ClientSetup.h"
 #include "Game/GameSetup.h"
@@ -156,6 +157,10 @@ DEFINE_string_EX(calc_checksum,      "calc-checksum",      "",    "Calculate nam
  * the same port number is heavily reused across many replays. Forcing onlyLocal solves this. */
 DEFINE_bool_EX  (onlyLocal,              "only-local",     false, "Force OnlyLocal mode (no network listening sockets). Use for parallelized watching of multiplayer replays");
 
+/* Replays the given demo as fast as possible and writes per-frame timings of all profiler timers
+ * to the report file (CSV if it ends in .csv, JSON otherwise); the engine quits when the demo ends. */
+DEFINE_string_EX(benchmark_report,   "benchmark-report",   "",    "Replay the demo as fast as possible and write a per-frame timing report to the given file");
+
 
 
 int spring::exitCode = spring::EXIT_CODE_SUCCESS;
@@ -573,6 +578,8 @@ void SpringApp::ParseCmdLine(int argc, char* argv[])
 	CTextureAtlas::SetDebug(FLAGS_textureatlas);
 
 	CGameSetup::forceOnlyLocal = FLAGS_onlyLocal;
+	CBenchmark::reportFileName = FLAGS_benchmark_report;
+	CGameServer::fastDemoPlayback = !FLAGS_benchmark_report.empty();
 
 	// if this fails, configHandler remains null
 	// logOutput's init depends on configHandler
@@ -452,15 +452,15 @@ void DumpState(int newMinFrameNum, int newMaxFrameNum, int newFramePeriod, std::
 	{
 		file << "\tCobEngine:\n";
 		file << "\t\tcurrentTime: " << cobEngine->GetCurrTime();
-		file << "\t\tCobThreads: " << cobEngine->GetThreadInstances().size() << "\n";
-		for (const auto& [tid, thread] : cobEngine->GetThreadInstances()) {
+		file << "\t\tCobThreads: " << cobEngine->GetNumThreads() << "\n";
+		cobEngine->ForEachThread([&](const CCobThread& thread) {
 			auto ownerID = thread.cobInst->GetUnit() ? thread.cobInst->GetUnit()->id : -1;
-			file << "\t\t\tid: " << tid << " t.id " << thread.GetID() << " t.wt " << thread.GetWakeTime()
+			file << "\t\t\tt.id " << thread.GetID() << " t.wt " << thread.GetWakeTime()
 				 << " owner " << ownerID
 				 << " t.state " << +thread.GetState() << " t.sigmask " << thread.GetSignalMask()
 				 << " t.retc " << thread.GetRetCode()
 				 << " dead|gargage|waiting " << thread.IsDead() << "|" << thread.IsGarbage() << "|" << thread.IsWaiting() << "\n";
-		}
+		});
 		file << "\t\tWaitingThreads: " << cobEngine->GetWaitingThreadIDs().size();
 		file << "\t\t\tids:";
 		for (const auto id : cobEngine->GetWaitingThreadIDs()) {
@@ -468,13 +468,12 @@ void DumpState(int newMinFrameNum, int newMaxFrameNum, int newFramePeriod, std::
 		}
 		file << "\n";
 
-		auto zzzThreads = cobEngine->GetSleepingThreadIDs(); //copied on purpose
+		std::vector<CTimingWheel::Entry> zzzThreads;
+		cobEngine->GetSleepingThreads().GetEntries(zzzThreads);
 		file << "\t\tSleepingThreads: " << zzzThreads.size();
-		file << "\t\t\twts|ids:";
-		while (!zzzThreads.empty()) {
-			const auto& zt = zzzThreads.top();
-			file << " " << zt.wt << "|" << zt.id;
-			zzzThreads.pop();
+		file << "\t\t\twts|seqs|ids:";
+		for (const auto& zt : zzzThreads) {
+			file << " " << zt.time << "|" << zt.key << "|" << zt.id;
 		}
 		file << "\n";
 	}
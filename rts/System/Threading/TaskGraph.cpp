@@ -0,0 +1,159 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "System/Threading/ThreadPool.h"
+#include "System/StringHash.h"
+
+#ifndef UNIT_TEST
+#include "System/TimeProfiler.h"
+#endif
+
+
+#ifdef THREADPOOL
+// runs one stage; kept for the lifetime of the graph and flagged as pooled
+// like the for_mt groups, since WaitForFinished leaves a group in a state
+// where only those may be deleted (and reused)
+class StageTaskGroup: public ITaskGroup
+{
+public:
+	StageTaskGroup(std::function<void()>&& _func): ITaskGroup(false, true), func(std::move(_func)) {}
+
+	void Enqueue() {
+		ResetState(true, true, true);
+		UpdateId();
+
+		claimed.store(false);
+		remainingTasks.store(1);
+	}
+
+	bool ExecuteStep() override {
+		// both the worker popping it and the thread waiting for it get here
+		if (claimed.exchange(true))
+			return false;
+
+		func();
+		remainingTasks.fetch_sub(1, std::memory_order_release);
+		return false;
+	}
+
+private:
+	std::function<void()> func;
+	std::atomic<bool> claimed = {true};
+};
+#endif
+
+
+CTaskGraph::CTaskGraph(const char* criticalPathName)
+	: criticalPathHash(hashString(criticalPathName))
+{
+	#ifndef UNIT_TEST
+	CTimeProfiler::RegisterTimer(criticalPathName);
+	#endif
+}
+
+
+void CTaskGraph::AddStage(const char* name, ResourceMask reads, ResourceMask writes, bool mainThread, std::function<void()>&& func)
+{
+	Stage& stage = stages.emplace_back();
+
+	stage.name = name;
+	stage.nameHash = hashString(name);
+	stage.reads = reads;
+	stage.writes = writes;
+	stage.mainThread = mainThread;
+	stage.func = std::move(func);
+
+	#ifdef THREADPOOL
+	if (!mainThread)
+		stage.task = std::make_shared<StageTaskGroup>([this, idx = stages.size() - 1]() { ExecuteStage(stages[idx]); });
+	#endif
+
+	for (size_t i = 0, n = stages.size() - 1; i < n; ++i) {
+		const Stage& prev = stages[i];
+
+		// write-after-write, read-after-write and write-after-read
+		if ((prev.writes & (reads | writes)) != 0 || (prev.reads & writes) != 0)
+			stage.deps.push_back(i);
+	}
+
+	#ifndef UNIT_TEST
+	CTimeProfiler::RegisterTimer(name);
+	#endif
+}
+
+
+void CTaskGraph::ExecuteStage(Stage& stage)
+{
+	#ifndef UNIT_TEST
+	ScopedMtTimer timer(stage.nameHash);
+	#endif
+
+	stage.startTime = spring_now();
+	stage.func();
+	stage.endTime = spring_now();
+}
+
+void CTaskGraph::WaitForStage(Stage& stage)
+{
+	#ifdef THREADPOOL
+	if (!stage.queued)
+		return;
+
+	ThreadPool::WaitForFinished(stage.task);
+	stage.queued = false;
+	#endif
+}
+
+
+void CTaskGraph::Run()
+{
+	for (Stage& stage: stages) {
+		for (const size_t dep: stage.deps) {
+			WaitForStage(stages[dep]);
+		}
+
+		#ifdef THREADPOOL
+		if (!stage.mainThread && ThreadPool::HasThreads()) {
+			static_cast<StageTaskGroup*>(stage.task.get())->Enqueue();
+			ThreadPool::PushTaskGroup(stage.task.get());
+
+			stage.queued = true;
+			continue;
+		}
+		#endif
+
+		ExecuteStage(stage);
+	}
+
+	for (Stage& stage: stages) {
+		WaitForStage(stage);
+	}
+
+	if (stages.empty())
+		return;
+
+	// longest chain of stage times through the dependencies; stages are
+	// added in topological order so one forward pass is enough
+	std::vector<spring_time> chainTimes(stages.size(), spring_notime);
+
+	criticalPathTime = spring_notime;
+
+	for (size_t i = 0; i < stages.size(); ++i) {
+		const Stage& stage = stages[i];
+
+		for (const size_t dep: stage.deps) {
+			chainTimes[i] = std::max(chainTimes[i], chainTimes[dep]);
+		}
+
+		chainTimes[i] += (stage.endTime - stage.startTime);
+		criticalPathTime = std::max(criticalPathTime, chainTimes[i]);
+	}
+
+	#ifndef UNIT_TEST
+	CTimeProfiler::GetInstance().AddTime(criticalPathHash, stages.front().startTime, criticalPathTime);
+	#endif
+}
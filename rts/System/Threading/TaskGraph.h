@@ -0,0 +1,87 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _TASK_GRAPH_H
+#define _TASK_GRAPH_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "System/Misc/NonCopyable.h"
+#include "System/Misc/SpringTime.h"
+
+class ITaskGroup;
+
+/**
+ * @brief Runs a fixed list of stages, overlapping those that do not conflict
+ *
+ * Every stage declares the resources it reads and writes as bitmasks. A stage
+ * depends on each earlier stage that writes anything it reads or writes, or
+ * reads anything it writes; conflicting stages therefore always run in the
+ * order they were added (which keeps synced code deterministic) while the
+ * others may run concurrently on ThreadPool workers.
+ *
+ * Stages flagged mainThread (anything that can reach Lua, GL or the event
+ * handler) run on the thread calling Run(), in order. The other stages are
+ * pushed to the pool once their dependencies are done, and the caller helps
+ * execute them while it waits on one.
+ *
+ * Each stage is timed as its own (thread-)timer in CTimeProfiler, and the sum
+ * of the stage times along the longest dependency chain is added under the
+ * graph's timer: the frame can not get shorter than that by adding threads.
+ */
+class CTaskGraph : public spring::noncopyable
+{
+public:
+	typedef std::uint32_t ResourceMask;
+
+	static constexpr ResourceMask RES_NONE = 0;
+	static constexpr ResourceMask RES_ALL = ~RES_NONE;
+
+public:
+	/// like all timer names, <criticalPathName> and stage names must be literals
+	CTaskGraph(const char* criticalPathName);
+
+	void AddStage(const char* name, ResourceMask reads, ResourceMask writes, bool mainThread, std::function<void()>&& func);
+	void Run();
+
+	size_t GetNumStages() const { return (stages.size()); }
+	/// indices of the earlier stages that stage <i> waits for
+	const std::vector<size_t>& GetDependencies(size_t i) const { return stages[i].deps; }
+
+	spring_time GetCriticalPathTime() const { return criticalPathTime; }
+
+private:
+	struct Stage {
+		const char* name = "";
+		unsigned nameHash = 0;
+
+		ResourceMask reads = RES_NONE;
+		ResourceMask writes = RES_NONE;
+
+		bool mainThread = true;
+
+		std::function<void()> func;
+		std::vector<size_t> deps;
+
+		// only for stages that may run on the pool
+		std::shared_ptr<ITaskGroup> task;
+		bool queued = false;
+
+		spring_time startTime;
+		spring_time endTime;
+	};
+
+	void ExecuteStage(Stage& stage);
+	void WaitForStage(Stage& stage);
+
+private:
+	std::vector<Stage> stages;
+
+	unsigned criticalPathHash;
+
+	spring_time criticalPathTime;
+};
+
+#endif // _TASK_GRAPH_H
@@ -69,10 +69,13 @@ static inline auto parallel_reduce(F&& f, G&& g) -> std::invoke_result_t<F>
 #include "System/Platform/Threading.h"
 #include "System/Threading/SpringThreading.h"
 
+#include <algorithm>
 #include  <array>
 #include <vector>
 #include <numeric>
 #include <atomic>
+#include <cstdint>
+#include <limits>
 
 #undef gt
 #include <memory>
@@ -112,7 +115,9 @@ namespace ThreadPool {
 	int GetNumThreads();
 	void NotifyWorkerThreads(bool force, bool async);
 
-	extern bool inMultiThreadedSection;
+	/// number of for_mt loops running, non-zero while any is; the task graph
+	/// can run several stages with their own loops at the same time
+	extern std::atomic<int> inMultiThreadedSection;
 
 	static constexpr int MAX_THREADS = 32;
 }
@@ -597,48 +602,137 @@ private:
 
 #else
 
+// work-stealing loop: the iteration space starts out split evenly over one
+// range per thread, each thread takes batches off the front of its own range
+// and once that is empty steals the back half of the largest remaining one
+// (which stays stealable in the thief's slot), so uneven per-element costs
+// get rebalanced instead of leaving threads idle at the join
 template<typename F>
 class ForTaskGroup: public ITaskGroup
 {
 public:
-	typedef  TTaskGroup<F, void, int>  ChildTaskType;
-
 	ForTaskGroup(bool pooled) : ITaskGroup(false, pooled) {}
 
-	void Enqueue(const int from, const int to, const int step, F& func)
+	void Enqueue(const int from, const int to, const int step, F& func, const int minBatch = 1, const int maxBatch = std::numeric_limits<int>::max())
 	{
 		assert(to >= from);
+		assert(minBatch >= 1 && minBatch <= maxBatch);
 
-		remainingTasks.store((step == 1) ? (to - from) : ((to - from + step - 1) / step));
-		ctr.store(0);
+		const int count = (step == 1) ? (to - from) : ((to - from + step - 1) / step);
+
+		remainingTasks.store(count);
+		numSlots = ThreadPool::GetNumThreads();
+
+		for (int i = 0; i < numSlots; i++) {
+			const int64_t beg = (int64_t(count) * (i    )) / numSlots;
+			const int64_t end = (int64_t(count) * (i + 1)) / numSlots;
+
+			slots[i].range.store(PackRange(beg, end), std::memory_order_relaxed);
+		}
 
 		this->from = from;
-		this->to   = to;
 		this->step = step;
+		this->minBatch = minBatch;
+		this->maxBatch = maxBatch;
 		this->func = func;
 	}
 
 	bool IsSliceTask() const override { return true; }
 	bool ExecuteStep() override
 	{
-		const int i = from + (step * ctr.fetch_add(1, std::memory_order_relaxed));
+		// external threads share id 0 with the main thread; harmless,
+		// every range update is a CAS so slots only affect locality
+		const int slot = ThreadPool::GetThreadNum() % numSlots;
 
-		if (i < to) {
-			func(i);
-			remainingTasks -= 1;
-			return true;
+		uint32_t beg = 0;
+		uint32_t end = 0;
+
+		if (!PopBatch(slot, beg, end) && !StealRange(slot, beg, end))
+			return false;
+
+		for (uint32_t k = beg; k < end; k++) {
+			func(from + step * int(k));
+		}
+
+		remainingTasks.fetch_sub(end - beg, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static uint64_t PackRange(uint64_t beg, uint64_t end) { return ((beg << 32) | end); }
+	static uint32_t RangeBeg(uint64_t range) { return (range >> 32); }
+	static uint32_t RangeEnd(uint64_t range) { return (range & 0xFFFFFFFFu); }
+	static uint32_t RangeSize(uint64_t range) { return ((RangeEnd(range) > RangeBeg(range))? (RangeEnd(range) - RangeBeg(range)): 0); }
+
+	bool PopBatch(int slot, uint32_t& beg, uint32_t& end) {
+		std::atomic<uint64_t>& range = slots[slot].range;
+
+		for (uint64_t cur = range.load(std::memory_order_acquire); RangeSize(cur) > 0; ) {
+			// an eighth of what is left, so batches shrink towards the tail
+			const uint32_t size = std::clamp<uint32_t>(RangeSize(cur) >> 3, minBatch, maxBatch);
+
+			beg = RangeBeg(cur);
+			end = std::min(RangeEnd(cur), beg + size);
+
+			if (range.compare_exchange_weak(cur, PackRange(end, RangeEnd(cur)), std::memory_order_acq_rel, std::memory_order_acquire))
+				return true;
 		}
 
 		return false;
 	}
 
+	bool StealRange(int slot, uint32_t& beg, uint32_t& end) {
+		while (true) {
+			int victim = -1;
+			uint64_t victimRange = 0;
+
+			for (int i = 0; i < numSlots; i++) {
+				const uint64_t r = slots[i].range.load(std::memory_order_relaxed);
+
+				if (RangeSize(r) > RangeSize(victimRange)) {
+					victim = i;
+					victimRange = r;
+				}
+			}
+
+			if (victim < 0)
+				return false;
+
+			// leave the front half to its owner; a single element is taken whole
+			const uint32_t vbeg = RangeBeg(victimRange);
+			const uint32_t vend = RangeEnd(victimRange);
+			const uint32_t vmid = vbeg + (vend - vbeg) / 2;
+
+			if (!slots[victim].range.compare_exchange_strong(victimRange, PackRange(vbeg, vmid), std::memory_order_acq_rel))
+				continue;
+
+			uint64_t own = slots[slot].range.load(std::memory_order_acquire);
+
+			// slot still in use by another thread with the same id, just run it
+			if (RangeSize(own) > 0 || !slots[slot].range.compare_exchange_strong(own, PackRange(vmid, vend), std::memory_order_acq_rel)) {
+				beg = vmid;
+				end = vend;
+				return true;
+			}
+
+			if (PopBatch(slot, beg, end))
+				return true;
+		}
+	}
+
 private:
-	std::atomic<int> ctr;
+	struct alignas(64) Slot {
+		std::atomic<uint64_t> range = {0};
+	};
+
+	std::array<Slot, ThreadPool::MAX_THREADS> slots;
 	std::function<void(const int)> func;
 
-	int from;
-	int to;
-	int step;
+	int numSlots = 1;
+	int from = 0;
+	int step = 1;
+	int minBatch = 1;
+	int maxBatch = 1;
 };
 #endif
 
@@ -674,11 +768,11 @@ struct TaskPool {
 
 
 template <typename F>
-static inline void for_mt(int start, int end, int step, F&& f)
+static inline void for_mt_batched(int start, int end, int step, F&& f, int minBatch, int maxBatch)
 {
-	ThreadPool::inMultiThreadedSection = true;
+	ThreadPool::inMultiThreadedSection.fetch_add(1);
 
-	if (!ThreadPool::HasThreads() || ((end - start) < step)) {
+	if (!ThreadPool::HasThreads() || ((end - start) <= (step * minBatch))) {
 		for (int i = start; i < end; i += step) {
 			f(i);
 		}
@@ -690,7 +784,7 @@ static inline void for_mt(int start, int end, int step, F&& f)
 		static TaskPool<ForTaskGroup, F> pool;
 		auto taskGroup = pool.GetTaskGroup();
 
-		taskGroup->Enqueue(start, end, step, f);
+		taskGroup->Enqueue(start, end, step, f, minBatch, maxBatch);
 		taskGroup->UpdateId();
 
 		assert(taskGroup->IsInJobQueue());
@@ -709,7 +803,13 @@ static inline void for_mt(int start, int end, int step, F&& f)
 		ThreadPool::WaitForFinished(taskGroup);
 	}
 
-	ThreadPool::inMultiThreadedSection = false;
+	ThreadPool::inMultiThreadedSection.fetch_sub(1);
+}
+
+template <typename F>
+static inline void for_mt(int start, int end, int step, F&& f)
+{
+	for_mt_batched(start, end, step, f, 1, std::numeric_limits<int>::max());
 }
 
 template <typename F>
@@ -718,32 +818,16 @@ static inline void for_mt(int start, int end, F&& f)
 	for_mt(start, end, 1, f);
 }
 
+// same as for_mt, but for loops over many cheap elements: batches taken
+// by one thread are never smaller than <minChunkSize> elements (except at
+// the end of a range) nor larger than <maxChunkSize>
 template <typename F>
 static inline void for_mt_chunk(int b, int e, F&& f, int minChunkSize = 1, int maxChunkSize = std::numeric_limits<int>::max())
 {
-	const int numElems = e - b;
-	if (numElems <= 0)
-		return;
-
-	static const int maxThreads = ThreadPool::GetNumThreads();
-
-	const int chunkSize = std::clamp(numElems / maxThreads + (numElems % maxThreads != 0), minChunkSize, maxChunkSize);
-	const int numThreads = numElems / chunkSize + (numElems % chunkSize != 0);
-
-	if (numThreads == 1) {
-		for (int i = b; i < e; ++i)
-			f(i);
-
+	if (e <= b)
 		return;
-	}
-
-	for_mt(0, numThreads, 1, [&f, b, e, chunkSize](const int jobId) {
-		const int bb = b + jobId * chunkSize;
-		const int ee = std::min(bb + chunkSize, e);
 
-		for (int i = bb; i < ee; ++i)
-			std::forward<F>(f)(i);
-	});
+	for_mt_batched(b, e, 1, f, std::max(minChunkSize, 1), std::max(maxChunkSize, std::max(minChunkSize, 1)));
 }
 
 
@@ -20,7 +20,8 @@ using HashNamMutexType = spring::mutex; //spring::spinlock
 static ProfileMutexType profileMutex;
 static HashNamMutexType hashToNameMutex;
 static spring::unordered_map<unsigned, std::string> hashToName;
-static spring::unordered_map<unsigned, int> refCounters;
+// per thread, ScopedTimer's can also be hit by stages running on pool workers
+static thread_local spring::unordered_map<unsigned, int> refCounters;
 
 static CGlobalUnsyncedRNG profileColorRNG;
 
@@ -348,6 +349,29 @@ void CTimeProfiler::CleanupOldThreadProfiles()
 	#endif
 }
 
+void CTimeProfiler::GetTotalTimes(std::vector< std::pair<unsigned, spring_time> >& totals)
+{
+	std::lock_guard<ProfileMutexType> lock(profileMutex);
+
+	totals.reserve(totals.size() + profiles.size());
+
+	for (const auto& p: profiles) {
+		totals.emplace_back(p.first, p.second.total);
+	}
+}
+
+std::string CTimeProfiler::GetTimerName(unsigned nameHash)
+{
+	std::lock_guard<HashNamMutexType> lock(hashToNameMutex);
+
+	const auto iter = hashToName.find(nameHash);
+
+	if (iter == hashToName.end())
+		return "???";
+
+	return iter->second;
+}
+
 const CTimeProfiler::TimeRecord& CTimeProfiler::GetTimeRecord(const char* name) const
 {
 	// if disabled, only special timers can pass AddTime
@@ -190,6 +190,10 @@ public:
 	void SetEnabled(bool b) { enabled = b; }
 	void PrintProfilingInfo() const;
 
+	/// appends (name-hash, accumulated time) of every timer that has been hit so far
+	void GetTotalTimes(std::vector< std::pair<unsigned, spring_time> >& totals);
+	static std::string GetTimerName(unsigned nameHash);
+
 	void AddTime(
 		unsigned nameHash,
 		const spring_time startTime,
@@ -0,0 +1,126 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "TimingWheel.h"
+
+#include <algorithm>
+#include <functional>
+
+CR_BIND(CTimingWheel, )
+CR_REG_METADATA(CTimingWheel, (
+	CR_MEMBER(buckets),
+	CR_MEMBER(due),
+	CR_MEMBER(wheelTime),
+	CR_MEMBER(numEntries)
+))
+
+CR_BIND(CTimingWheel::Entry, )
+CR_REG_METADATA_SUB(CTimingWheel, Entry, (
+	CR_MEMBER(time),
+	CR_MEMBER(key),
+	CR_MEMBER(id)
+))
+
+
+void CTimingWheel::Clear(int time)
+{
+	buckets.clear();
+	buckets.resize(LevelOffset(NUM_LEVELS) + 1);
+	due.clear();
+
+	wheelTime = time;
+	numEntries = 0;
+}
+
+void CTimingWheel::Insert(int time, int key, int id)
+{
+	InsertEntry({time, key, id});
+	numEntries += 1;
+}
+
+void CTimingWheel::InsertEntry(const Entry& e)
+{
+	if (e.time < wheelTime) {
+		due.push_back(e);
+		std::push_heap(due.begin(), due.end(), std::greater<Entry>());
+		return;
+	}
+
+	const std::int64_t delta = std::int64_t(e.time) - wheelTime;
+
+	for (int level = 0; level < NUM_LEVELS; ++level) {
+		if (delta >= (std::int64_t(1) << LevelShift(level + 1)))
+			continue;
+
+		buckets[LevelOffset(level) + ((e.time >> LevelShift(level)) & (LevelSlots(level) - 1))].push_back(e);
+		return;
+	}
+
+	buckets.back().push_back(e);
+}
+
+void CTimingWheel::Cascade(std::vector<Entry>& bucket)
+{
+	if (bucket.empty())
+		return;
+
+	// entries can land in the same bucket again (overflow list)
+	std::vector<Entry> entries;
+	entries.swap(bucket);
+
+	for (const Entry& e: entries) {
+		InsertEntry(e);
+	}
+}
+
+void CTimingWheel::LoadNextTick()
+{
+	// count the levels whose current bucket starts at wheelTime; these are
+	// moved down highest first, so entries can pass through several levels
+	int top = 0;
+
+	while (top < NUM_LEVELS && (wheelTime & ((1 << LevelShift(top + 1)) - 1)) == 0)
+		top += 1;
+
+	if (top == NUM_LEVELS)
+		Cascade(buckets.back());
+
+	for (int level = std::min(top, NUM_LEVELS - 1); level >= 1; --level) {
+		Cascade(buckets[LevelOffset(level) + ((wheelTime >> LevelShift(level)) & (LevelSlots(level) - 1))]);
+	}
+
+	// every entry in this bucket is for wheelTime exactly
+	std::vector<Entry>& bucket = buckets[wheelTime & (LevelSlots(0) - 1)];
+
+	for (const Entry& e: bucket) {
+		due.push_back(e);
+		std::push_heap(due.begin(), due.end(), std::greater<Entry>());
+	}
+
+	bucket.clear();
+	wheelTime += 1;
+}
+
+CTimingWheel::Entry CTimingWheel::PopDue()
+{
+	std::pop_heap(due.begin(), due.end(), std::greater<Entry>());
+
+	const Entry e = due.back();
+
+	due.pop_back();
+	numEntries -= 1;
+	return e;
+}
+
+
+void CTimingWheel::GetEntries(std::vector<Entry>& entries) const
+{
+	entries.clear();
+	entries.reserve(numEntries);
+	entries.insert(entries.end(), due.begin(), due.end());
+
+	for (const auto& bucket: buckets) {
+		entries.insert(entries.end(), bucket.begin(), bucket.end());
+	}
+
+	std::sort(entries.begin(), entries.end());
+}
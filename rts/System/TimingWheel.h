@@ -0,0 +1,104 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "System/creg/creg_cond.h"
+
+/**
+ * @brief Hierarchical timing wheel of <time, key, id> entries
+ *
+ * Hands out entries in the same order as a min-heap on <time, key> would, but
+ * only ever sorts the entries that are due: the rest wait in buckets, first
+ * by 256 ticks (one wheel of 1-tick buckets), then by 256 * 64^n ticks (three
+ * wheels of 64 buckets each) and beyond that (2^26 ticks) in one list. At the
+ * start of each bucket of a higher wheel its entries are moved down a level.
+ *
+ * Entries whose time has been reached wait in a small heap, which also takes
+ * any entry inserted for a time already passed; Advance drains it in order,
+ * including entries inserted by its own callback, as long as they are due.
+ */
+class CTimingWheel
+{
+	CR_DECLARE_STRUCT(CTimingWheel)
+	CR_DECLARE_SUB(Entry)
+
+public:
+	struct Entry {
+		CR_DECLARE_STRUCT(Entry)
+
+		bool operator < (const Entry& e) const { return (time < e.time || (time == e.time && key < e.key)); }
+		bool operator > (const Entry& e) const { return (e < *this); }
+		bool operator == (const Entry& e) const { return (time == e.time && key == e.key && id == e.id); }
+
+		int time;
+		/// orders entries with equal times, should be unique
+		int key;
+		int id;
+	};
+
+public:
+	CTimingWheel() { Clear(0); }
+
+	/// removes all entries; <time> becomes the first one Advance can reach
+	void Clear(int time);
+
+	void Insert(int time, int key, int id);
+
+	/**
+	 * Calls func(time, id) for every entry with a time before <time>, in
+	 * <time, key> order; func may insert entries. <time> should not decrease
+	 * from one call to the next.
+	 */
+	template<typename F>
+	void Advance(int time, F&& func) {
+		for (;;) {
+			if (!due.empty()) {
+				const Entry e = PopDue();
+				func(e.time, e.id);
+				continue;
+			}
+
+			if (wheelTime >= time)
+				break;
+
+			LoadNextTick();
+		}
+	}
+
+	int GetSize() const { return numEntries; }
+
+	/// all entries, in the order Advance would return them
+	void GetEntries(std::vector<Entry>& entries) const;
+
+private:
+	static constexpr int NUM_LEVELS = 4;
+	static constexpr int LEVEL0_BITS = 8;
+	static constexpr int LEVELN_BITS = 6;
+
+	static constexpr int LevelShift(int level) { return (level == 0)? 0: (LEVEL0_BITS + (level - 1) * LEVELN_BITS); }
+	static constexpr int LevelSlots(int level) { return (level == 0)? (1 << LEVEL0_BITS): (1 << LEVELN_BITS); }
+	static constexpr int LevelOffset(int level) { return (level == 0)? 0: (LevelSlots(0) + (level - 1) * LevelSlots(1)); }
+
+	void InsertEntry(const Entry& e);
+	void Cascade(std::vector<Entry>& bucket);
+	void LoadNextTick();
+
+	Entry PopDue();
+
+private:
+	// LevelSlots(n) buckets per level, after them the overflow list
+	std::vector< std::vector<Entry> > buckets;
+	// min-heap of everything before wheelTime
+	std::vector<Entry> due;
+
+	// all entries before this are in <due>, the others in <buckets>
+	int wheelTime = 0;
+
+	int numEntries = 0;
+};
+
+#endif // TIMING_WHEEL_H
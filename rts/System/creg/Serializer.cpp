@@ -13,6 +13,7 @@
 #include "System/Log/ILog.h"
 #include "System/Platform/byteorder.h"
 #include "System/Exceptions.h"
+#include "System/Threading/ThreadPool.h"
 
 #include <algorithm>
 #include <fstream>
@@ -23,6 +24,8 @@
 #include <string>
 #include <cstring>
 #include <cinttypes>
+#include <exception>
+#include <memory>
 
 using namespace creg;
 using std::string;
@@ -123,6 +126,141 @@ void creg::WriteUInt(std::ostream* stream, uint64_t val)
 	WriteVarSizeUInt(stream, val);
 }
 
+template<typename T>
+void WriteVarSizeUInt(std::vector<char>& buf, T val)
+{
+	std::uint64_t v = val;
+	do {
+		unsigned char a = v & 0x7F;
+		v >>= 7;
+
+		if (v > 0)
+			a |= 0x80;
+
+		buf.push_back(a);
+	} while (v > 0);
+}
+
+//-------------------------------------------------------------------------
+// Object writer
+//-------------------------------------------------------------------------
+
+/*
+ * Serializes a single object into memory instead of the output stream.
+ * Object IDs depend on the order in which objects are first referenced,
+ * so the writer leaves them out and records where each one goes; the
+ * main serializer registers the objects and fills in their IDs while it
+ * copies the data to the stream in the original order. Writers share no
+ * state, so any number of them can run at once.
+ */
+struct COutputStreamSerializer::ObjectWriter : public ISerializer
+{
+	struct Ref {
+		size_t pos; // the ID goes in front of data[pos]
+		void* ptr;
+		Class* class_;
+		bool isEmbedded;
+		// body of a split off embedded instance, written after its ID
+		ObjectWriter* instance;
+	};
+
+	void Reset(void* ptr, Class* cls, bool split) {
+		data.clear();
+		refs.clear();
+		instances.clear();
+		error = nullptr;
+
+		objPtr = ptr;
+		objClass = cls;
+		splitInstances = split;
+	}
+
+	void Run() {
+		try {
+			WriteMembers(objClass, objPtr);
+		} catch (...) {
+			// rethrown on the main thread, once WriteObject gets to this object
+			error = std::current_exception();
+		}
+	}
+
+	void WriteMembers(Class* c, void* ptr) {
+		if (c->base())
+			WriteMembers(c->base(), ptr);
+
+		for (creg::Class::Member& m: c->members) {
+			if (m.flags & CM_NoSerialize)
+				continue;
+
+			m.type->Serialize(this, ((char*)ptr) + m.offset);
+		}
+
+		if (c->HasSerialize())
+			c->CallSerializeProc(ptr, this);
+	}
+
+	bool IsWriting() override { return true; }
+
+	void Serialize(void* d, int byteSize) override {
+		data.insert(data.end(), (char*)d, (char*)d + byteSize);
+	}
+
+	void SerializeInt(void* d, int byteSize) override {
+		// see COutputStreamSerializer::SerializeInt
+		std::uint64_t x = 0;
+		switch (byteSize) {
+			case 1: { x = *(std::uint8_t* )d; break; }
+			case 2: { x = *(std::uint16_t*)d; break; }
+			case 4: { x = *(std::uint32_t*)d; break; }
+			case 8: { x = *(std::uint64_t*)d; break; }
+			default: {
+				throw "Unknown int type";
+			}
+		}
+		WriteVarSizeUInt(data, x);
+	}
+
+	void SerializeObjectPtr(void** ptr, Class* cls) override {
+		if (*ptr == nullptr) {
+			WriteVarSizeUInt(data, 0);
+			return;
+		}
+
+		refs.push_back({data.size(), *ptr, cls, false, nullptr});
+	}
+
+	void SerializeObjectInstance(void* inst, Class* cls) override {
+		if (splitInstances) {
+			// leave the instance to another writer, which can run concurrently
+			ObjectWriter& w = *instances.emplace_back(std::make_unique<ObjectWriter>());
+			w.Reset(inst, cls, false);
+			refs.push_back({data.size(), inst, cls, true, &w});
+			return;
+		}
+
+		refs.push_back({data.size(), inst, cls, true, nullptr});
+
+		// instances nested inside a split off one stay with its writer
+		const bool split = splitInstances;
+		splitInstances = false;
+		WriteMembers(cls, inst);
+		splitInstances = split;
+	}
+
+	void AddPostLoadCallback(void (*cb)(void* d), void* d) override {}
+
+	std::vector<char> data;
+	std::vector<Ref> refs;
+	std::vector<std::unique_ptr<ObjectWriter>> instances;
+	std::exception_ptr error;
+
+	void* objPtr = nullptr;
+	Class* objClass = nullptr;
+	// true for the objects of small rounds (i.e. the root), whose direct embedded
+	// instances are the top-level containers that make up most of a savegame
+	bool splitInstances = false;
+};
+
 //-------------------------------------------------------------------------
 // Base output serializer
 //-------------------------------------------------------------------------
@@ -131,6 +269,8 @@ COutputStreamSerializer::COutputStreamSerializer()
 	stream = nullptr;
 }
 
+COutputStreamSerializer::~COutputStreamSerializer() = default;
+
 bool COutputStreamSerializer::IsWriting()
 {
 	return true;
@@ -138,74 +278,36 @@ bool COutputStreamSerializer::IsWriting()
 
 COutputStreamSerializer::ObjectRef* COutputStreamSerializer::FindObjectRef(void* inst, creg::Class* objClass, bool isEmbedded)
 {
-	std::vector<ObjectRef*>& refs = ptrToId[inst];
-	for (auto& obj: refs) {
+	const auto it = ptrToId.find(inst);
+
+	if (it == ptrToId.end())
+		return nullptr;
+
+	for (ObjectRef* obj = it->second; obj != nullptr; obj = obj->next) {
 		if (obj->isThisObject(inst, objClass, isEmbedded))
 			return obj;
 	}
 	return nullptr;
 }
 
-void COutputStreamSerializer::SerializeObject(Class* c, void* ptr, ObjectRef* objr)
+COutputStreamSerializer::ObjectRef* COutputStreamSerializer::AddObjectRef(void* ptr, creg::Class* objClass, bool isEmbedded)
 {
-	const unsigned objstart = stream->tellp();
-
-	if (c->base())
-		SerializeObject(c->base(), ptr, objr);
-
-	ObjectMemberGroup omg;
-	omg.membersClass = c;
-	omg.size = 0;
-
-	for (uint a = 0; a < c->members.size(); a++)
-	{
-		creg::Class::Member* m = &c->members[a];
-		if (m->flags & CM_NoSerialize)
-			continue;
-
-		ObjectMember om;
-		om.member = m;
-		om.memberId = a;
-		void* memberAddr = ((char*)ptr) + m->offset;
-		unsigned mstart = stream->tellp();
-		LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Serialized %s::%s type:%s", c->name, m->name, m->type->GetName().c_str());
-		m->type->Serialize(this, memberAddr);
-		unsigned mend = stream->tellp();
-		om.size = mend - mstart;
-		omg.members.push_back(om);
-		omg.size += om.size;
-		LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Serialized %s::%s type:%s size:%d", c->name, m->name, m->type->GetName().c_str(), om.size);
-	}
+	ObjectRef* obj = &objects.emplace_back(ptr, objects.size(), isEmbedded, objClass);
+	ObjectRef** ref = &ptrToId[ptr];
 
+	// append, the first object at an address is the one preallocation refers to
+	while (*ref != nullptr)
+		ref = &(*ref)->next;
 
-	if (c->HasSerialize()) {
-		ObjectMember om;
-		om.member = nullptr;
-		om.memberId = -1;
-		unsigned mstart = stream->tellp();
-		c->CallSerializeProc(ptr, this);
-		unsigned mend = stream->tellp();
-		om.size = mend - mstart;
-		omg.members.push_back(om);
-		omg.size += om.size;
-	}
-
-	objr->memberGroups.push_back(omg);
-
-	const unsigned objend = stream->tellp();
-	const int sz = objend - objstart;
-	classSizes[c] += sz;
-	classCounts[c]++;
+	return (*ref = obj);
 }
 
-void COutputStreamSerializer::SerializeObjectInstance(void* inst, creg::Class* objClass)
+int COutputStreamSerializer::RegisterObjectInstance(void* inst, creg::Class* objClass)
 {
 	// register the object, and mark it as embedded if a pointer was already referencing it
 	ObjectRef* obj = FindObjectRef(inst, objClass, true);
 	if (!obj) {
-		objects.emplace_back(inst, objects.size(), true, objClass);
-		obj = &objects.back();
-		ptrToId[inst].push_back(obj);
+		obj = AddObjectRef(inst, objClass, true);
 	} else if (obj->isEmbedded) {
 		throw std::string("Reserialization of embedded object (") + objClass->name + ")";
 	} else {
@@ -219,34 +321,72 @@ void COutputStreamSerializer::SerializeObjectInstance(void* inst, creg::Class* o
 	obj->class_ = objClass;
 	obj->isEmbedded = true;
 
-	// write an object ID
-	WriteVarSizeUInt(stream, obj->id);
+	return obj->id;
+}
 
-	// write the object
-	SerializeObject(objClass, inst, obj);
+int COutputStreamSerializer::RegisterObjectPtr(void* ptr, creg::Class* objClass)
+{
+	ObjectRef* obj = FindObjectRef(ptr, objClass, false);
+	if (!obj) {
+		obj = AddObjectRef(ptr, objClass, false);
+		pendingObjects.push_back(obj);
+	}
+	return obj->id;
 }
 
-void COutputStreamSerializer::SerializeObjectPtr(void** ptr, creg::Class* objClass)
+void COutputStreamSerializer::WriteObject(const ObjectWriter& writer)
 {
-	if (*ptr) {
-		// valid pointer, write a one and the object ID
-		int id;
-		ObjectRef* obj = FindObjectRef(*ptr, objClass, false);
-		if (!obj) {
-			objects.emplace_back(*ptr, objects.size(), false, objClass);
-			obj = &objects.back();
-			ptrToId[*ptr].push_back(obj);
-			pendingObjects.push_back(obj);
+	if (writer.error != nullptr)
+		std::rethrow_exception(writer.error);
+
+	size_t pos = 0;
+
+	if (objectOffsets != nullptr)
+		objectOffsets->push_back(stream->tellp());
+
+	for (const ObjectWriter::Ref& ref: writer.refs) {
+		stream->write(writer.data.data() + pos, ref.pos - pos);
+		pos = ref.pos;
+
+		if (!ref.isEmbedded) {
+			WriteVarSizeUInt(stream, RegisterObjectPtr(ref.ptr, ref.class_));
+			continue;
 		}
-		id = obj->id;
 
-		WriteVarSizeUInt(stream, id);
-	} else {
-		// null pointer, write a zero
-		WriteVarSizeUInt(stream, 0);
+		// write an object ID, then the object (unless it is inlined in this writer's data)
+		WriteVarSizeUInt(stream, RegisterObjectInstance(ref.ptr, ref.class_));
+
+		if (ref.instance != nullptr)
+			WriteObject(*ref.instance);
+	}
+
+	stream->write(writer.data.data() + pos, writer.data.size() - pos);
+
+	if (objectOffsets != nullptr)
+		objectOffsets->push_back(stream->tellp());
+
+	if (LOG_IS_ENABLED(L_DEBUG)) {
+		classSizes[writer.objClass] += writer.data.size();
+		classCounts[writer.objClass]++;
 	}
 }
 
+void COutputStreamSerializer::SerializeObjectInstance(void* inst, creg::Class* objClass)
+{
+	ObjectWriter writer;
+	writer.SerializeObjectInstance(inst, objClass);
+	writer.objClass = objClass;
+	WriteObject(writer);
+}
+
+void COutputStreamSerializer::SerializeObjectPtr(void** ptr, creg::Class* objClass)
+{
+	ObjectWriter writer;
+	writer.SerializeObjectPtr(ptr, objClass);
+	writer.objClass = objClass;
+	WriteObject(writer);
+}
+
 void COutputStreamSerializer::Serialize(void* data, int byteSize)
 {
 	stream->write((char*)data, byteSize);
@@ -270,6 +410,64 @@ void COutputStreamSerializer::SerializeInt(void* data, int byteSize)
 	WriteVarSizeUInt(stream, x);
 }
 
+void COutputStreamSerializer::SavePendingObjects(bool parallel)
+{
+	// bounds the serialized data held in memory at once
+	constexpr size_t BATCH_SIZE = 1024;
+	// rounds smaller than this also hand the embedded instances of their objects to separate writers
+	constexpr size_t SPLIT_ROUND_SIZE = 16;
+
+	std::vector<ObjectWriter*> instances;
+
+	// Objects are saved in rounds: the ones referenced by the previous round, in order
+	// of their IDs. Loading reads them in the same order, only the writers run in parallel.
+	while (!pendingObjects.empty())
+	{
+		const std::vector<ObjectRef*> po = pendingObjects;
+		pendingObjects.clear();
+
+		const bool split = parallel && po.size() < SPLIT_ROUND_SIZE;
+
+		for (size_t first = 0; first < po.size(); first += BATCH_SIZE) {
+			const size_t count = std::min(po.size() - first, BATCH_SIZE);
+
+			if (writers.size() < count)
+				writers.resize(count);
+
+			for (size_t i = 0; i < count; i++) {
+				writers[i].Reset(po[first + i]->ptr, po[first + i]->class_, split);
+			}
+
+			if (parallel) {
+				for_mt(0, count, [&](const int i) { writers[i].Run(); });
+			} else {
+				for (size_t i = 0; i < count; i++) {
+					writers[i].Run();
+				}
+			}
+
+			if (split) {
+				instances.clear();
+
+				for (size_t i = 0; i < count; i++) {
+					for (const auto& w: writers[i].instances) {
+						instances.push_back(w.get());
+					}
+				}
+
+				for_mt(0, instances.size(), [&](const int i) { instances[i]->Run(); });
+			}
+
+			for (size_t i = 0; i < count; i++) {
+				WriteObject(writers[i]);
+			}
+		}
+	}
+
+	// release the buffers of large objects
+	writers.clear();
+}
+
 
 struct COutputStreamSerializer::ClassRef
 {
@@ -277,7 +475,7 @@ struct COutputStreamSerializer::ClassRef
 	creg::Class* class_;
 };
 
-void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class* rootObjClass)
+void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class* rootObjClass, bool parallel)
 {
 	PackageHeader ph;
 
@@ -293,22 +491,10 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 	obj->classIndex = 0;
 
 	// Insert the first object that will provide references to everything
-	objects.emplace_back(rootObj, objects.size(), false, rootObjClass);
-	obj = &objects.back();
-	ptrToId[rootObj].push_back(obj);
+	obj = AddObjectRef(rootObj, rootObjClass, false);
 	pendingObjects.push_back(obj);
 
-	// Save until all the referenced objects have been stored
-	while (!pendingObjects.empty())
-	{
-		const std::vector<ObjectRef*> po = pendingObjects;
-		pendingObjects.clear();
-
-		for (ObjectRef* obj: po) {
-			SerializeObject(obj->class_, obj->ptr, obj);
-			//LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Serialized %s size:%i", obj->class_->name.c_str(), sz);
-		}
-	}
+	SavePendingObjects(parallel);
 
 	// Collect a set of all used classes
 	std::map<creg::Class*, ClassRef> classMap;
@@ -373,7 +559,7 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 			const auto it = ptrToId.find(container);
 			if (container == nullptr || it == ptrToId.end())
 				throw std::string("Preallocation container of (") + oRef.class_->name + ") doesn't exist";
-			ObjectRef* objCont = it->second.front();
+			ObjectRef* objCont = it->second;
 			// write container ID and offset of placement-new location
 			WriteVarSizeUInt(stream, objCont->id);
 			WriteVarSizeUInt(stream, (char*)oRef.ptr - (char*)container);
@@ -13,6 +13,8 @@
 #include <deque>
 #include <istream>
 
+#include "System/UnorderedMap.hpp"
+
 namespace creg {
 
 	/**
@@ -23,43 +25,20 @@ namespace creg {
 	class COutputStreamSerializer : public ISerializer
 	{
 	protected:
-		struct ObjectMember {
-			Class::Member* member;
-			int memberId;
-			int size;
-		};
-		struct ObjectMemberGroup {
-			Class* membersClass;
-			std::vector<COutputStreamSerializer::ObjectMember> members;
-			int size;
-		};
 		struct ObjectRef {
-			ObjectRef() {
-				ptr = 0;
-				id=0;
-				classIndex=0;
-				isEmbedded=false;
-				class_=0;
-			}
+			ObjectRef() = default;
 			ObjectRef(void* ptr, int id, bool isEmbedded, Class* class_) {
 				this->ptr = ptr;
 				this->id=id;
-				classIndex=0;
 				this->isEmbedded=isEmbedded;
 				this->class_=class_;
 			}
-			ObjectRef(const ObjectRef&src) :memberGroups(src.memberGroups){
-				ptr=src.ptr;
-				id=src.id;
-				classIndex=src.classIndex;
-				isEmbedded=src.isEmbedded;
-				class_=src.class_;
-			}
-			void* ptr;
-			int id, classIndex;
-			bool isEmbedded;
-			Class* class_;
-			std::vector<COutputStreamSerializer::ObjectMemberGroup> memberGroups;
+			void* ptr = nullptr;
+			int id = 0, classIndex = 0;
+			bool isEmbedded = false;
+			Class* class_ = nullptr;
+			// next object registered at the same address, e.g. an embedded first member
+			ObjectRef* next = nullptr;
 			bool isThisObject(void* objPtr, Class* objClass, bool objEmbedded) const
 			{
 				if (ptr != objPtr) return false;
@@ -79,33 +58,49 @@ namespace creg {
 
 		// Temporary class reference
 		struct ClassRef;
+		// Serializes one object into memory, noting where object IDs go
+		struct ObjectWriter;
 
 		std::ostream* stream;
-		std::map<void*,std::vector<ObjectRef*> > ptrToId;
+		spring::unsynced_map<void*, ObjectRef*> ptrToId; // first ObjectRef per address
 		std::deque<ObjectRef> objects;
 		std::vector<ObjectRef*> pendingObjects; // these objects still have to be saved
+		std::vector<ObjectWriter> writers;
 		std::map<Class*, int> classSizes;
 		std::map<Class*, int> classCounts;
-
-		// Serialize all class names
-		void WriteObjectInfo();
-		// Helper for instance/ptr saving
-		void WriteObjectRef(void* inst, Class* cls, bool embedded);
+		std::vector<std::uint64_t>* objectOffsets = nullptr;
 
 		ObjectRef* FindObjectRef(void* inst, Class* objClass, bool isEmbedded);
+		ObjectRef* AddObjectRef(void* ptr, Class* objClass, bool isEmbedded);
+
+		// Register objects the way SerializeObjectInstance/Ptr do, returning their ID
+		int RegisterObjectInstance(void* inst, Class* objClass);
+		int RegisterObjectPtr(void* ptr, Class* objClass);
 
-		void SerializeObject(Class* c, void* ptr, ObjectRef* objr);
+		// Save until all the referenced objects have been stored
+		void SavePendingObjects(bool parallel);
+		// Copy the data of a writer to the stream, registering objects and filling in their IDs
+		void WriteObject(const ObjectWriter& writer);
 
 	public:
 		COutputStreamSerializer();
+		~COutputStreamSerializer();
 
 		/** Create a package of the given root object and all the objects that it references
 		 * @param s stream to serialize the data to
 		 * @param rootObj the rootObj: the starting point for finding all the objects to save
 		 * @param cls the class of the root object
+		 * @param parallel serialize objects on the thread pool; the package is
+		 *   identical either way, but every Serialize method reached from rootObj
+		 *   must then be safe to run concurrently (i.e. only read shared state)
 		 * This method throws an std::runtime_error when something goes wrong
 		 */
-		void SavePackage(std::ostream* s, void* rootObj, Class* cls);
+		void SavePackage(std::ostream* s, void* rootObj, Class* cls, bool parallel = false);
+
+		/** Collect the stream positions at which every object's data starts and ends
+		 * @param offsets appended to (in ascending order) by all following SavePackage calls, or null
+		 */
+		void SetObjectOffsets(std::vector<std::uint64_t>* offsets) { objectOffsets = offsets; }
 
 		/** @see ISerializer::IsWriting */
 		bool IsWriting();
@@ -266,6 +266,11 @@ LUA_API void lua_setallocf (lua_State *L, lua_Alloc f, void *ud);
 LUA_API lua_Hash (lua_calchash) (const char *s, size_t l);
 LUA_API void  (lua_pushhstring) (lua_State *L,
                                  lua_Hash h, const char *s, size_t l);
+/* string with the hash it was interned under, for lua_pushhstring */
+LUA_API const char *(lua_tohstring) (lua_State *L, int idx, size_t *len,
+                                     lua_Hash *h);
+/* array and hash sizes that fit the elements of a table, for lua_createtable */
+LUA_API void  (lua_tablesize) (lua_State *L, int idx, int *narr, int *nrec);
 
 
 /* 
@@ -359,6 +359,26 @@ LUA_API const char *lua_tolstring (lua_State *L, int idx, size_t *len) {
 }
 
 
+//SPRING
+LUA_API const char *lua_tohstring (lua_State *L, int idx, size_t *len,
+                                   lua_Hash *h) {
+  StkId o = index2adr(L, idx);
+  if (!ttisstring(o))
+    return NULL;
+  *len = tsvalue(o)->len;
+  *h = tsvalue(o)->hash;
+  return svalue(o);
+}
+
+
+//SPRING
+LUA_API void lua_tablesize (lua_State *L, int idx, int *narr, int *nrec) {
+  StkId t = index2adr(L, idx);
+  api_check(L, ttistable(t));
+  luaH_sizeused(hvalue(t), narr, nrec);
+}
+
+
 LUA_API size_t lua_objlen (lua_State *L, int idx) {
   StkId o = index2adr(L, idx);
   switch (ttype(o)) {
@@ -350,6 +350,23 @@ static void rehash (lua_State *L, Table *t, const TValue *ek) {
 }
 
 
+//SPRING
+/* the sizes rehash would give a table holding just the elements of <t> */
+void luaH_sizeused (const Table *t, int *narr, int *nrec) {
+  int nasize, na;
+  int nums[MAXBITS+1];
+  int i;
+  int totaluse;
+  for (i=0; i<=MAXBITS; i++) nums[i] = 0;
+  nasize = numusearray(t, nums);
+  totaluse = nasize;
+  totaluse += numusehash(t, nums, &nasize);
+  na = computesizes(nums, &nasize);
+  *narr = nasize;
+  *nrec = totaluse - na;
+}
+
+
 
 /*
 ** }=============================================================
@@ -29,6 +29,8 @@ LUAI_FUNC void luaH_resizearray (lua_State *L, Table *t, int nasize);
 LUAI_FUNC void luaH_free (lua_State *L, Table *t);
 LUAI_FUNC int luaH_next (lua_State *L, Table *t, StkId key);
 LUAI_FUNC int luaH_getn (Table *t);
+//SPRING
+LUAI_FUNC void luaH_sizeused (const Table *t, int *narr, int *nrec);
 
 
 #if defined(LUA_DEBUG)
@@ -0,0 +1,136 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Lua/LuaSyncedBatch.h"
+
+#include <string>
+
+#include <catch_amalgamated.hpp>
+
+
+// checks that list <i> of the batch on top of L holds the numbers first..first+n-1
+static void CheckList(lua_State* L, int i, int first, int n)
+{
+	lua_rawgeti(L, -1, i);
+	REQUIRE(lua_istable(L, -1));
+
+	lua_getfield(L, -1, "n");
+	CHECK(lua_tonumber(L, -1) == n);
+	lua_pop(L, 1);
+
+	for (int k = 1; k <= n; k++) {
+		lua_rawgeti(L, -1, k);
+		CHECK(lua_tonumber(L, -1) == first + k - 1);
+		lua_pop(L, 1);
+	}
+
+	lua_pop(L, 1);
+}
+
+static void PushNumbers(lua_State* L, int first, int n)
+{
+	for (int k = 0; k < n; k++) {
+		lua_pushnumber(L, first + k);
+	}
+}
+
+
+TEST_CASE("LuaSyncedBatch")
+{
+	lua_State* L = luaL_newstate();
+	LuaSyncedBatch batch;
+
+	// something the batch must not touch
+	lua_pushstring(L, "below");
+
+	SECTION("empty") {
+		CHECK(batch.Empty());
+		CHECK(!batch.Pop(L));
+		CHECK(lua_gettop(L) == 1);
+	}
+
+	SECTION("lists in sent order") {
+		PushNumbers(L, 10, 3);
+		batch.Push(L, 3);
+		CHECK(lua_gettop(L) == 1);
+
+		batch.Push(L, 0);
+		CHECK(lua_gettop(L) == 1);
+
+		PushNumbers(L, 20, 1);
+		batch.Push(L, 1);
+
+		CHECK(batch.Size() == 3);
+		REQUIRE(batch.Pop(L));
+		CHECK(batch.Empty());
+		CHECK(lua_gettop(L) == 2);
+		CHECK(lua_objlen(L, -1) == 3);
+
+		CheckList(L, 1, 10, 3);
+		CheckList(L, 2,  0, 0);
+		CheckList(L, 3, 20, 1);
+
+		lua_pop(L, 1);
+		CHECK(lua_tostring(L, -1) == std::string("below"));
+
+		// the next batch starts over
+		CHECK(!batch.Pop(L));
+
+		PushNumbers(L, 30, 2);
+		batch.Push(L, 2);
+
+		REQUIRE(batch.Pop(L));
+		CHECK(lua_objlen(L, -1) == 1);
+		CheckList(L, 1, 30, 2);
+		lua_pop(L, 1);
+	}
+
+	SECTION("nil arguments") {
+		// the argument count has to survive trailing nils
+		lua_pushnil(L);
+		lua_pushnumber(L, 1);
+		lua_pushnil(L);
+		batch.Push(L, 3);
+
+		REQUIRE(batch.Pop(L));
+		lua_rawgeti(L, -1, 1);
+
+		lua_getfield(L, -1, "n");
+		CHECK(lua_tonumber(L, -1) == 3);
+		lua_pop(L, 1);
+
+		lua_rawgeti(L, -1, 1);
+		CHECK(lua_isnil(L, -1));
+		lua_rawgeti(L, -2, 2);
+		CHECK(lua_tonumber(L, -1) == 1);
+		lua_rawgeti(L, -3, 3);
+		CHECK(lua_isnil(L, -1));
+		lua_pop(L, 5);
+	}
+
+	SECTION("batches do not leak references") {
+		const size_t registrySize = lua_objlen(L, LUA_REGISTRYINDEX);
+
+		for (int n = 0; n < 100; n++) {
+			PushNumbers(L, n, 1);
+			batch.Push(L, 1);
+
+			REQUIRE(batch.Pop(L));
+			lua_pop(L, 1);
+		}
+
+		CHECK(lua_objlen(L, LUA_REGISTRYINDEX) <= registrySize + 1);
+	}
+
+	SECTION("reset") {
+		PushNumbers(L, 1, 1);
+		batch.Push(L, 1);
+
+		// as if L was replaced by a new state; the old list is not delivered
+		batch.Reset();
+		CHECK(batch.Empty());
+		CHECK(!batch.Pop(L));
+	}
+
+	CHECK(lua_gettop(L) == 1);
+	lua_close(L);
+}
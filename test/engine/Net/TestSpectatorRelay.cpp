@@ -0,0 +1,272 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Net/SpectatorRelay.h"
+#include "System/Net/Connection.h"
+#include "System/Net/UDPBatch.h"
+
+#include <catch_amalgamated.hpp>
+
+using namespace netcode;
+
+
+// records what the relay does with it; Update sends what was queued the way
+// UDPConnection does, into the calling thread's UDPSendBatch if there is one
+class TestLink: public CConnection
+{
+public:
+	TestLink(std::shared_ptr<asio::ip::udp::socket> s, asio::ip::udp::endpoint t): socket(s), target(t) {}
+
+	void SendData(std::shared_ptr<const RawPacket> data) override {
+		std::lock_guard<spring::mutex> lock(mutex);
+
+		std::uint32_t seqNum = 0;
+		std::memcpy(&seqNum, data->data, sizeof(seqNum));
+
+		received.push_back(seqNum);
+		outgoing.push_back(seqNum);
+	}
+
+	void Update() override {
+		std::lock_guard<spring::mutex> lock(mutex);
+
+		updateThread = std::this_thread::get_id();
+		numUpdates += 1;
+
+		for (const std::uint32_t seqNum: outgoing) {
+			if (UDPSendBatch* batch = UDPSendBatch::GetCurrent(); batch != nullptr) {
+				batch->Add(socket, target, reinterpret_cast<const std::uint8_t*>(&seqNum), sizeof(seqNum));
+			} else {
+				socket->send_to(asio::buffer(&seqNum, sizeof(seqNum)), target);
+				numUnbatched += 1;
+			}
+		}
+
+		outgoing.clear();
+	}
+
+	void Close(bool flush) override {
+		std::lock_guard<spring::mutex> lock(mutex);
+		closedAfter = received.size();
+	}
+
+	bool HasIncomingData() const override { return false; }
+	std::shared_ptr<const RawPacket> Peek(unsigned ahead) const override { return {}; }
+	std::shared_ptr<const RawPacket> GetData() override { return {}; }
+	void DeleteBufferPacketAt(unsigned index) override {}
+	void Flush(const bool forced) override {}
+	bool CheckTimeout(int seconds, bool initial) const override { return false; }
+	void ReconnectTo(CConnection& conn) override {}
+	bool CanReconnect() const override { return false; }
+	bool NeedsReconnect() override { return false; }
+	std::string Statistics() const override { return {}; }
+	std::string GetFullAddress() const override { return {}; }
+	void Unmute() override {}
+	void SetLossFactor(int factor) override {}
+
+	std::vector<std::uint32_t> GetReceived() {
+		std::lock_guard<spring::mutex> lock(mutex);
+		return received;
+	}
+
+public:
+	std::shared_ptr<asio::ip::udp::socket> socket;
+	asio::ip::udp::endpoint target;
+
+	spring::mutex mutex;
+
+	std::vector<std::uint32_t> received;
+	std::vector<std::uint32_t> outgoing;
+
+	std::thread::id updateThread;
+
+	int numUpdates = 0;
+	int numUnbatched = 0;
+
+	size_t closedAfter = size_t(-1);
+};
+
+
+static asio::io_context ioContext;
+
+static std::shared_ptr<asio::ip::udp::socket> OpenSocket()
+{
+	// port 0 binds to a free port
+	const asio::ip::udp::endpoint endpoint(asio::ip::make_address("127.0.0.1"), 0);
+	const auto socket = std::make_shared<asio::ip::udp::socket>(ioContext, endpoint);
+
+	socket->non_blocking(true);
+	return socket;
+}
+
+static std::shared_ptr<const RawPacket> MakePacket(std::uint32_t seqNum)
+{
+	return (std::make_shared<const RawPacket>(reinterpret_cast<const std::uint8_t*>(&seqNum), sizeof(seqNum)));
+}
+
+template<typename F>
+static bool WaitFor(F&& cond)
+{
+	for (int n = 0; n < 5000 && !cond(); n++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return cond();
+}
+
+static size_t Receive(asio::ip::udp::socket& socket, std::vector<std::uint32_t>& seqNums)
+{
+	UDPReceiveBatch recvBatch;
+	asio::error_code err;
+
+	size_t numReceived = 0;
+	size_t n = 0;
+
+	while ((n = recvBatch.Receive(socket, err)) > 0) {
+		for (size_t i = 0; i < n; i++) {
+			std::uint32_t seqNum = 0;
+			std::memcpy(&seqNum, recvBatch.GetData(i), sizeof(seqNum));
+			seqNums.push_back(seqNum);
+		}
+
+		numReceived += n;
+	}
+
+	return numReceived;
+}
+
+
+TEST_CASE("SpectatorRelay")
+{
+	const std::shared_ptr<asio::ip::udp::socket> sender = OpenSocket();
+	const std::shared_ptr<asio::ip::udp::socket> receiver = OpenSocket();
+
+	REQUIRE(sender != nullptr);
+	REQUIRE(receiver != nullptr);
+
+	const auto a = std::make_shared<TestLink>(sender, receiver->local_endpoint());
+	const auto b = std::make_shared<TestLink>(sender, receiver->local_endpoint());
+
+	CSpectatorRelay relay(1);
+
+	SECTION("order") {
+		std::vector<std::uint32_t> expectedA;
+		std::vector<std::uint32_t> expectedB;
+
+		relay.AddLink(a);
+		relay.AddLink(b);
+
+		CHECK(a->IsRelayed());
+		CHECK(b->IsRelayed());
+
+		std::uint32_t seqNum = 0;
+
+		for (int i = 0; i < 1000; i++, seqNum++) {
+			if ((i % 3) == 0) {
+				relay.SendData(a, MakePacket(seqNum));
+				expectedA.push_back(seqNum);
+			} else {
+				relay.Broadcast(MakePacket(seqNum));
+				expectedA.push_back(seqNum);
+				expectedB.push_back(seqNum);
+			}
+		}
+
+		// returns without waiting for the relay thread
+		CSpectatorRelay::JobNum removed = relay.RemoveLink(a);
+		CSpectatorRelay::JobNum lastJob = removed;
+
+		// sends to a detached link still line up behind the queued jobs
+		for (int i = 0; i < 100; i++, seqNum++) {
+			lastJob = relay.SendData(a, MakePacket(seqNum));
+			expectedA.push_back(seqNum);
+
+			relay.Broadcast(MakePacket(seqNum + 1000000));
+			expectedB.push_back(seqNum + 1000000);
+		}
+
+		const CSpectatorRelay::JobNum closed = relay.CloseLink(a, true);
+
+		REQUIRE(WaitFor([&]() { return relay.IsDone(closed); }));
+		CHECK(relay.IsDone(removed));
+		CHECK(relay.IsDone(lastJob));
+		CHECK(!relay.IsDone(closed + 1));
+
+		CHECK(!a->IsRelayed());
+		CHECK(b->IsRelayed());
+
+		CHECK(a->GetReceived() == expectedA);
+		CHECK(b->GetReceived() == expectedB);
+		CHECK(a->closedAfter == expectedA.size());
+	}
+
+	SECTION("sends from the owning thread") {
+		relay.AddLink(a);
+		relay.AddLink(b);
+
+		std::vector<std::uint32_t> expected;
+
+		for (std::uint32_t seqNum = 0; seqNum < 50; seqNum++) {
+			relay.Broadcast(MakePacket(seqNum));
+			expected.push_back(seqNum);
+			expected.push_back(seqNum);
+		}
+
+		// the relay updates the links, but keeps what they send for us
+		REQUIRE(WaitFor([&]() { return (a->GetReceived().size() == 50 && b->GetReceived().size() == 50); }));
+		REQUIRE(WaitFor([&]() { std::lock_guard<spring::mutex> lock(a->mutex); return a->outgoing.empty(); }));
+		REQUIRE(WaitFor([&]() { std::lock_guard<spring::mutex> lock(b->mutex); return b->outgoing.empty(); }));
+
+		{
+			std::lock_guard<spring::mutex> lockA(a->mutex);
+			std::lock_guard<spring::mutex> lockB(b->mutex);
+
+			CHECK(a->updateThread != std::this_thread::get_id());
+			CHECK(a->numUnbatched == 0);
+			CHECK(b->numUnbatched == 0);
+		}
+
+		std::vector<std::uint32_t> seqNums;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		CHECK(Receive(*receiver, seqNums) == 0);
+
+		relay.FlushSends();
+
+		REQUIRE(WaitFor([&]() { Receive(*receiver, seqNums); return (seqNums.size() >= expected.size()); }));
+
+		// every datagram of both links, interleaved however the relay updated them
+		std::vector<std::uint32_t> sorted = seqNums;
+		std::sort(sorted.begin(), sorted.end());
+		CHECK(sorted == expected);
+	}
+
+	SECTION("stop") {
+		relay.AddLink(a);
+
+		for (std::uint32_t seqNum = 0; seqNum < 100; seqNum++) {
+			relay.Broadcast(MakePacket(seqNum));
+		}
+
+		const CSpectatorRelay::JobNum lastJob = relay.RemoveLink(a);
+
+		relay.Stop();
+
+		CHECK(!relay.IsRunning());
+		CHECK(relay.IsDone(lastJob));
+		CHECK(!a->IsRelayed());
+		CHECK(a->GetReceived().size() == 100);
+
+		// without the thread, jobs run right away
+		relay.AddLink(b);
+		CHECK(relay.IsDone(relay.SendData(b, MakePacket(7))));
+		CHECK(b->GetReceived() == std::vector<std::uint32_t>{7});
+	}
+}
@@ -0,0 +1,167 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Misc/LosInstance.h"
+#include "Sim/Misc/LosMap.h"
+#include "Game/GlobalUnsynced.h"
+#include "Map/ReadMap.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+// CLosMap only reaches these when sending ReadMap events, which the test disables
+CGlobalUnsynced* gu = nullptr;
+CReadMap* readMap = nullptr;
+MapDimensions mapDims;
+
+void CReadMap::UpdateLOS(const SRectangle& hgtMapRect) {}
+
+
+struct TestLosMap: public CLosMap {
+	void Init(const int2 losSize, const std::vector<float>& ctrHeightMap, const std::vector<float>& mipHeightMap) {
+		CLosMap::Init(losSize, int2(mapDims.mapx, mapDims.mapy), ctrHeightMap.data(), mipHeightMap.data(), false);
+	}
+};
+
+static bool SameSquares(const SLosInstance& a, const SLosInstance& b)
+{
+	if (a.squares.size() != b.squares.size())
+		return false;
+
+	for (size_t i = 0; i < a.squares.size(); i++) {
+		if (a.squares[i].start != b.squares[i].start || a.squares[i].length != b.squares[i].length)
+			return false;
+	}
+
+	return true;
+}
+
+
+TEST_CASE("LosMapUpdateRaycast")
+{
+	static constexpr int TEST_RUNS = 2000;
+	static constexpr int LOS2HEIGHT = 2;
+
+	std::mt19937 rng(0x105);
+
+	const auto RandInt = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+	const auto RandFloat = [&](float a, float b) { return std::uniform_real_distribution<float>(a, b)(rng); };
+
+	const int2 losSize = {96, 64};
+
+	mapDims.mapx = losSize.x * LOS2HEIGHT;
+	mapDims.mapy = losSize.y * LOS2HEIGHT;
+	mapDims.mapxm1 = mapDims.mapx - 1;
+	mapDims.mapym1 = mapDims.mapy - 1;
+
+	std::vector<float> ctrHeightMap(mapDims.mapx * mapDims.mapy);
+	std::vector<float> mipHeightMap(losSize.x * losSize.y);
+
+	// keeps both resolutions consistent, like the ReadMap does
+	const auto SetHeight = [&](int x, int y, float h) {
+		mipHeightMap[y * losSize.x + x] = h;
+
+		for (int dy = 0; dy < LOS2HEIGHT; dy++) {
+			for (int dx = 0; dx < LOS2HEIGHT; dx++) {
+				ctrHeightMap[(y * LOS2HEIGHT + dy) * mapDims.mapx + (x * LOS2HEIGHT + dx)] = h;
+			}
+		}
+	};
+
+	// rolling terrain, partly below water level (clamped to 0 by the raycast)
+	const auto ResetTerrain = [&]() {
+		for (int y = 0; y < losSize.y; y++) {
+			for (int x = 0; x < losSize.x; x++) {
+				SetHeight(x, y, 40.0f * std::sin(x * 0.21f) * std::cos(y * 0.17f) + RandFloat(-8.0f, 8.0f));
+			}
+		}
+	};
+
+	// raises, lowers or flattens a random rectangle, mostly within sight of
+	// <instance>; returns it in LOS-map squares
+	const auto ChangeTerrain = [&](const SLosInstance& instance) {
+		const int r = instance.radius + 4;
+		const bool near = (RandInt(0, 3) != 0);
+
+		const int x1 = std::clamp(near? RandInt(instance.basePos.x - r, instance.basePos.x + r): RandInt(0, losSize.x), 0, losSize.x - 1);
+		const int y1 = std::clamp(near? RandInt(instance.basePos.y - r, instance.basePos.y + r): RandInt(0, losSize.y), 0, losSize.y - 1);
+		const SRectangle rect(x1, y1, std::min(x1 + RandInt(1, 12), losSize.x), std::min(y1 + RandInt(1, 12), losSize.y));
+
+		const int mode = RandInt(0, 2);
+		const float delta = RandFloat(-60.0f, 60.0f);
+
+		for (int y = rect.y1; y < rect.y2; y++) {
+			for (int x = rect.x1; x < rect.x2; x++) {
+				const float h = mipHeightMap[y * losSize.x + x];
+
+				switch (mode) {
+					case 0: { SetHeight(x, y, h + delta); } break;
+					case 1: { SetHeight(x, y, h + RandFloat(-30.0f, 30.0f)); } break;
+					case 2: { SetHeight(x, y, delta); } break;
+				}
+			}
+		}
+
+		return rect;
+	};
+
+	TestLosMap losMap;
+	losMap.Init(losSize, ctrHeightMap, mipHeightMap);
+
+	// updates that can not just fall back to a full PrepareRaycast
+	int numIncremental = 0;
+
+	for (int n = 0; n < TEST_RUNS; ++n) {
+		ResetTerrain();
+
+		SLosInstance instance(0);
+
+		instance.radius = RandInt(1, 24);
+		// also near and beyond the map edges, where SafeLosAdd takes over
+		instance.basePos = int2(RandInt(-8, losSize.x + 7), RandInt(-8, losSize.y + 7));
+		instance.baseHeight = RandFloat(-20.0f, 120.0f);
+		instance.allyteam = 0;
+
+		losMap.PrepareRaycast(&instance);
+
+		// several updates in a row, each after one or more terrain changes
+		// whose rectangles are merged the way ILosType::UpdateHeightMapSynced does
+		for (int k = 0, numUpdates = RandInt(1, 4); k < numUpdates; ++k) {
+			instance.dirtyRect = ChangeTerrain(instance);
+
+			for (int m = RandInt(0, 2); m > 0; --m) {
+				const SRectangle rect = ChangeTerrain(instance);
+
+				instance.dirtyRect.x1 = std::min(instance.dirtyRect.x1, rect.x1);
+				instance.dirtyRect.y1 = std::min(instance.dirtyRect.y1, rect.y1);
+				instance.dirtyRect.x2 = std::max(instance.dirtyRect.x2, rect.x2);
+				instance.dirtyRect.y2 = std::max(instance.dirtyRect.y2, rect.y2);
+			}
+
+			const SRectangle sightRect(
+				instance.basePos.x - instance.radius    , instance.basePos.y - instance.radius,
+				instance.basePos.x + instance.radius + 1, instance.basePos.y + instance.radius + 1
+			);
+
+			numIncremental += (instance.squares[0].length != SLosInstance::EMPTY_RLE.length && !instance.dirtyRect.Inside(instance.basePos) && instance.dirtyRect.CheckOverlap(sightRect));
+
+			losMap.UpdateRaycast(&instance);
+			instance.dirtyRect = {};
+
+			SLosInstance reference(1);
+
+			reference.radius = instance.radius;
+			reference.basePos = instance.basePos;
+			reference.baseHeight = instance.baseHeight;
+			reference.allyteam = instance.allyteam;
+
+			losMap.PrepareRaycast(&reference);
+
+			INFO("run " << n << " update " << k << ": radius " << instance.radius << " at (" << instance.basePos.x << ", " << instance.basePos.y << ")");
+			REQUIRE(SameSquares(instance, reference));
+		}
+	}
+
+	CHECK(numIncremental >= (TEST_RUNS / 2));
+}
@@ -0,0 +1,121 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Misc/LosMapSIMD.h"
+#include "System/SpringMath.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+// rays to every square of the upper right quadrant, same stepping as CLosTableHelper::GetRay
+static std::vector<std::vector<int2>> GetRays(int radius)
+{
+	std::vector<std::vector<int2>> rays;
+
+	for (int yf = 0; yf <= radius; ++yf) {
+		for (int xf = 1; xf <= radius; ++xf) {
+			if ((xf * xf + yf * yf) > (radius * radius))
+				continue;
+
+			std::vector<int2>& ray = rays.emplace_back();
+
+			if (xf > yf) {
+				const float m = (float) yf / (float) xf;
+
+				for (int x = 1; x <= xf; x++) {
+					ray.emplace_back(x, Round(m * x));
+				}
+			} else {
+				const float m = (float) xf / (float) yf;
+
+				for (int y = 1; y <= yf; y++) {
+					ray.emplace_back(Round(m * y), y);
+				}
+			}
+		}
+	}
+
+	return rays;
+}
+
+
+TEST_CASE("LosMapSIMDKernels")
+{
+	static constexpr int TEST_RUNS = 300;
+
+	std::mt19937 rng(0x105);
+
+	const auto RandInt = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+
+	const int2 mapSize = {128, 96};
+
+	std::vector<float> heightMap(mapSize.x * mapSize.y);
+	std::vector<float> isqrtTable;
+
+	std::vector<float> raycastAngles;
+	std::vector<char> scalarSquares;
+	std::vector<char> simdSquares;
+
+	INFO("LosMapSIMD::CastRay: " << LosMapSIMD::GetImplName());
+
+	for (int n = 0; n < TEST_RUNS; ++n) {
+		// coarse heights produce plenty of exactly equal angles
+		const int heightStep = RandInt(1, 16);
+
+		for (float& h: heightMap) {
+			h = RandInt(-8, 40) * heightStep * 0.5f;
+		}
+
+		const int radius = RandInt(1, 48);
+		const int2 pos = {RandInt(-radius / 2, mapSize.x + radius / 2), RandInt(-radius / 2, mapSize.y + radius / 2)};
+		const float losHeight = RandInt(0, 400) * 0.25f;
+
+		const bool posInMap = (pos.x >= 0 && pos.y >= 0 && pos.x < mapSize.x && pos.y < mapSize.y);
+		const bool circleInMap = (pos.x >= radius && pos.y >= radius && pos.x < (mapSize.x - radius) && pos.y < (mapSize.y - radius));
+
+		const LosMapSIMD::CastMode mode = circleInMap?
+			LosMapSIMD::CAST_UNBOUNDED:
+			(posInMap? LosMapSIMD::CAST_STOP_AT_EDGE: LosMapSIMD::CAST_SKIP_OUTSIDE);
+
+		isqrtTable.clear();
+
+		for (int i = 0; i <= (radius + 1) * (radius + 1); ++i) {
+			isqrtTable.push_back(math::isqrt(std::max(i, 1)));
+		}
+
+		// same precalculation as CLosMap::SafeLosAdd, on a square instead of a circle
+		raycastAngles.assign(Square(2 * radius + 1), -1e8);
+		scalarSquares.assign(Square(2 * radius + 1), false);
+
+		for (int y = -radius; y <= radius; ++y) {
+			for (int x = -radius; x <= radius; ++x) {
+				const int2 sq = pos + int2(x, y);
+
+				if (sq.x < 0 || sq.y < 0 || sq.x >= mapSize.x || sq.y >= mapSize.y)
+					continue;
+				if (x == 0 && y == 0)
+					continue;
+
+				const size_t oidx = LosMapSIMD::ToAngleMapIdx(int2(x, y), radius);
+				const float dh = std::max(0.0f, heightMap[sq.y * mapSize.x + sq.x]) - losHeight;
+
+				raycastAngles[oidx] = (dh + LosMapSIMD::LOS_BONUS_HEIGHT) * isqrtTable[x * x + y * y];
+				scalarSquares[oidx] = true;
+			}
+		}
+
+		simdSquares = scalarSquares;
+
+		const LosMapSIMD::CastParams scalarParams = {raycastAngles.data(), scalarSquares.data(), isqrtTable.data(), pos, mapSize, radius, mode};
+		const LosMapSIMD::CastParams simdParams = {raycastAngles.data(), simdSquares.data(), isqrtTable.data(), pos, mapSize, radius, mode};
+
+		for (const auto& ray: GetRays(radius)) {
+			LosMapSIMD::CastRayScalar(scalarParams, ray.data(), ray.size());
+			LosMapSIMD::CastRaySSE(simdParams, ray.data(), ray.size());
+		}
+
+		// squares are RLE-encoded straight from this table, so equal tables mean equal RLEs
+		CHECK(scalarSquares == simdSquares);
+	}
+}
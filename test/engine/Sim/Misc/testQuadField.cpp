@@ -1,10 +1,14 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "Sim/Misc/QuadField.h"
+#include "Sim/Misc/QuadFieldSIMD.h"
+#include "System/ContainerUtil.h"
 #include "System/float3.h"
 #include "System/SpringMath.h"
 #include <stdlib.h>
 #include <time.h>
+#include <memory>
+#include <vector>
 
 #include <catch_amalgamated.hpp>
 
@@ -101,3 +105,333 @@ TEST_CASE("QuadField")
 	INFO("Too little quads returned!");
 	CHECK_FALSE(fail);
 }
+
+
+// stand-in for CUnit; large enough that every candidate is its own cache line(s)
+struct FakeUnit {
+	float3 pos;
+	float radius;
+	char padding[2048];
+};
+
+TEST_CASE("QuadFieldPackedQueries")
+{
+	srand( time(nullptr) );
+
+	static constexpr int NUM_UNITS = 4096;
+	static constexpr int NUM_QUERIES = 64;
+
+	std::vector< std::unique_ptr<FakeUnit> > units;
+	std::vector<FakeUnit*> unitPtrs;
+	std::vector<float4> unitPosRads;
+	PackedSpheres packedUnits;
+
+	for (int i = 0; i < NUM_UNITS; ++i) {
+		units.emplace_back(new FakeUnit());
+		units.back()->pos = float3(randf() * 4096.0f, randf() * 256.0f, randf() * 4096.0f);
+		units.back()->radius = 8.0f + randf() * 64.0f;
+
+		unitPtrs.push_back(units.back().get());
+		unitPosRads.emplace_back(units.back()->pos, units.back()->radius);
+	}
+
+	// shuffle the pointers so the AoS walk is not accidentally sequential
+	for (int i = NUM_UNITS - 1; i > 0; --i) {
+		const int j = rand() % (i + 1);
+		std::swap(unitPtrs[i], unitPtrs[j]);
+		std::swap(unitPosRads[i], unitPosRads[j]);
+	}
+	for (const float4& pr: unitPosRads) {
+		packedUnits.push_back(pr, pr.w);
+	}
+
+	std::vector<float4> queries;
+	for (int i = 0; i < NUM_QUERIES; ++i) {
+		queries.emplace_back(float3(randf() * 4096.0f, randf() * 256.0f, randf() * 4096.0f), randf() * 512.0f);
+	}
+
+	const auto QueryPointers = [&](std::vector<int>& hits, bool spherical) {
+		hits.clear();
+
+		for (const float4& q: queries) {
+			for (int i = 0; i < NUM_UNITS; ++i) {
+				const FakeUnit* u = unitPtrs[i];
+
+				const float totRad   = q.w + u->radius;
+				const float posDstSq = spherical? q.SqDistance(u->pos): q.SqDistance2D(u->pos);
+
+				if (posDstSq >= (totRad * totRad))
+					continue;
+
+				hits.push_back(i);
+			}
+		}
+
+		return hits.size();
+	};
+	const auto QueryPacked = [&](std::vector<int>& hits, bool spherical) {
+		hits.clear();
+
+		for (const float4& q: queries) {
+			for (int i = 0; i < NUM_UNITS; ++i) {
+				if (!QuadFieldSIMD::SphereTest(unitPosRads[i], q, q.w, spherical))
+					continue;
+
+				hits.push_back(i);
+			}
+		}
+
+		return hits.size();
+	};
+	const auto QueryMasks = [&](std::vector<int>& hits, bool spherical) {
+		std::vector<uint64_t> masks(QuadFieldSIMD::NumMaskWords(NUM_UNITS));
+
+		hits.clear();
+
+		for (const float4& q: queries) {
+			QuadFieldSIMD::SphereMask(packedUnits, q, q.w, spherical, masks.data());
+
+			for (int i = 0; i < NUM_UNITS; ++i) {
+				if ((masks[i >> 6] & (uint64_t(1) << (i & 63))) == 0)
+					continue;
+
+				hits.push_back(i);
+			}
+		}
+
+		return hits.size();
+	};
+
+	// what the queries would cost if the quads did not keep their packed copy
+	const auto QueryRepacked = [&](std::vector<int>& hits, bool spherical) {
+		PackedSpheres repackedUnits;
+		std::vector<uint64_t> masks(QuadFieldSIMD::NumMaskWords(NUM_UNITS));
+
+		hits.clear();
+
+		for (const float4& q: queries) {
+			repackedUnits.resize(NUM_UNITS);
+
+			for (int i = 0; i < NUM_UNITS; ++i) {
+				repackedUnits.set(i, unitPtrs[i]->pos, unitPtrs[i]->radius);
+			}
+
+			QuadFieldSIMD::SphereMask(repackedUnits, q, q.w, spherical, masks.data());
+
+			for (int i = 0; i < NUM_UNITS; ++i) {
+				if ((masks[i >> 6] & (uint64_t(1) << (i & 63))) == 0)
+					continue;
+
+				hits.push_back(i);
+			}
+		}
+
+		return hits.size();
+	};
+
+	QuadFieldSIMD::Init();
+
+	std::vector<int> ptrHits;
+	std::vector<int> pckHits;
+	std::vector<int> mskHits;
+	std::vector<int> rpkHits;
+
+	for (const bool spherical: {true, false}) {
+		QueryPointers(ptrHits, spherical);
+		QueryPacked(pckHits, spherical);
+		QueryMasks(mskHits, spherical);
+		QueryRepacked(rpkHits, spherical);
+
+		CHECK(ptrHits == pckHits);
+		CHECK(ptrHits == mskHits);
+		CHECK(ptrHits == rpkHits);
+	}
+
+	BENCHMARK("Pointers") { return QueryPointers(ptrHits, true); };
+	BENCHMARK("Packed") { return QueryPacked(pckHits, true); };
+	BENCHMARK(std::string("Packed ") + QuadFieldSIMD::GetImplName()) { return QueryMasks(mskHits, true); };
+	BENCHMARK(std::string("Repacked ") + QuadFieldSIMD::GetImplName()) { return QueryRepacked(rpkHits, true); };
+}
+
+
+TEST_CASE("QuadFieldSIMDKernels")
+{
+	srand( time(nullptr) );
+
+	// every implementation must produce the exact same bits as the scalar
+	// reference, including for elements lying exactly on a boundary and for
+	// sizes that leave a partial SIMD tail
+	static constexpr int NUM_QUERIES = 256;
+
+	const bool haveAVX = QuadFieldSIMD::HaveAVX();
+
+	for (const size_t numElems: {0, 1, 3, 4, 7, 8, 9, 63, 64, 65, 127, 1000}) {
+		PackedSpheres ps;
+
+		for (size_t i = 0; i < numElems; ++i) {
+			// quantize some positions so that boundary hits actually occur
+			const float3 p = (i & 1)?
+				float3(randf() * 1024.0f, randf() * 128.0f, randf() * 1024.0f):
+				float3(int(randf() * 64.0f) * 16.0f, int(randf() * 8.0f) * 16.0f, int(randf() * 64.0f) * 16.0f);
+
+			ps.push_back(p, (i & 1)? (randf() * 64.0f): (int(randf() * 4.0f) * 8.0f));
+		}
+
+		const size_t numWords = QuadFieldSIMD::NumMaskWords(numElems) + 1;
+
+		std::vector<uint64_t> refMasks(numWords, 0);
+		std::vector<uint64_t> sseMasks(numWords, 0);
+		std::vector<uint64_t> avxMasks(numWords, 0);
+
+		for (int n = 0; n < NUM_QUERIES; ++n) {
+			const float3 pos = (n & 1)?
+				float3(randf() * 1024.0f, randf() * 128.0f, randf() * 1024.0f):
+				float3(int(randf() * 64.0f) * 16.0f, int(randf() * 8.0f) * 16.0f, int(randf() * 64.0f) * 16.0f);
+			const float radius = (n & 1)? (randf() * 256.0f): (int(randf() * 16.0f) * 8.0f);
+			const bool spherical = (n & 2);
+
+			QuadFieldSIMD::SphereMaskScalar(ps, pos, radius, spherical, refMasks.data());
+			QuadFieldSIMD::SphereMaskSSE(ps, pos, radius, spherical, sseMasks.data());
+			CHECK(refMasks == sseMasks);
+
+			if (haveAVX) {
+				QuadFieldSIMD::SphereMaskAVX(ps, pos, radius, spherical, avxMasks.data());
+				CHECK(refMasks == avxMasks);
+			}
+
+			for (size_t i = 0; i < numElems; ++i) {
+				const bool bit = (refMasks[i >> 6] >> (i & 63)) & 1;
+				CHECK(bit == QuadFieldSIMD::SphereTest(ps.get(i), pos, radius, spherical));
+			}
+
+			const float3 mins = pos - float3(radius, 0.0f, radius * 0.5f);
+			const float3 maxs = pos + float3(radius * 0.5f, 0.0f, radius);
+
+			QuadFieldSIMD::RectMaskScalar(ps, mins, maxs, refMasks.data());
+			QuadFieldSIMD::RectMaskSSE(ps, mins, maxs, sseMasks.data());
+			CHECK(refMasks == sseMasks);
+
+			if (haveAVX) {
+				QuadFieldSIMD::RectMaskAVX(ps, mins, maxs, avxMasks.data());
+				CHECK(refMasks == avxMasks);
+			}
+
+			for (size_t i = 0; i < numElems; ++i) {
+				const bool bit = (refMasks[i >> 6] >> (i & 63)) & 1;
+				CHECK(bit == QuadFieldSIMD::RectTest(ps.get(i), mins, maxs));
+			}
+		}
+	}
+}
+
+
+TEST_CASE("QuadFieldMoveBatch")
+{
+	srand( time(nullptr) );
+
+	// applying a grouped batch quad by quad has to leave every quad's unit
+	// list exactly as sequential MovedUnit calls would, order included
+	static constexpr int NUM_QUADS = 64;
+	static constexpr int NUM_UNITS = 500;
+	static constexpr int NUM_ROUNDS = 200;
+
+	// a unit covers up to 2x2 neighbouring quads, like GetQuads returns them
+	const auto RandomQuads = []() {
+		std::vector<int> quads;
+
+		const int x = rand() % 8;
+		const int z = rand() % 8;
+		const int w = 1 + (x < 7 && (rand() & 1));
+		const int h = 1 + (z < 7 && (rand() & 1));
+
+		for (int dz = 0; dz < h; ++dz) {
+			for (int dx = 0; dx < w; ++dx) {
+				quads.push_back((z + dz) * 8 + (x + dx));
+			}
+		}
+
+		return quads;
+	};
+
+	std::vector< std::vector<int> > unitQuads(NUM_UNITS);
+	std::vector< std::vector<int> > seqQuads(NUM_QUADS);
+	std::vector< std::vector<int> > batchQuads(NUM_QUADS);
+
+	for (int u = 0; u < NUM_UNITS; ++u) {
+		unitQuads[u] = RandomQuads();
+
+		for (const int qi: unitQuads[u]) {
+			seqQuads[qi].push_back(u);
+		}
+	}
+
+	batchQuads = seqQuads;
+
+	CQuadField::MoveBatch moveBatch;
+
+	for (int round = 0; round < NUM_ROUNDS; ++round) {
+		// moved units in batch order; a unit is never in a batch twice
+		std::vector<int> moved;
+		std::vector< std::vector<int> > newQuads;
+
+		for (int u = 0; u < NUM_UNITS; ++u) {
+			if ((rand() % 4) != 0)
+				continue;
+
+			moved.push_back(u);
+			newQuads.push_back(RandomQuads());
+		}
+
+		for (int i = moved.size() - 1; i > 0; --i) {
+			const int j = rand() % (i + 1);
+			std::swap(moved[i], moved[j]);
+			std::swap(newQuads[i], newQuads[j]);
+		}
+
+		moveBatch.Clear();
+
+		for (size_t i = 0; i < moved.size(); ++i) {
+			const int u = moved[i];
+
+			if (unitQuads[u] == newQuads[i])
+				continue;
+
+			moveBatch.AddMove(i, unitQuads[u], newQuads[i]);
+
+			// what MovedUnit does
+			for (const int qi: unitQuads[u]) {
+				spring::VectorErase(seqQuads[qi], u);
+			}
+			for (const int qi: newQuads[i]) {
+				spring::VectorInsertUnique(seqQuads[qi], u, false);
+			}
+
+			unitQuads[u] = newQuads[i];
+		}
+
+		moveBatch.Group(NUM_QUADS);
+
+		std::vector<int> touched = moveBatch.GetTouchedQuads();
+		std::sort(touched.begin(), touched.end());
+
+		REQUIRE(std::adjacent_find(touched.begin(), touched.end()) == touched.end());
+
+		for (int qi = 0; qi < NUM_QUADS; ++qi) {
+			const bool isTouched = std::binary_search(touched.begin(), touched.end(), qi);
+
+			CHECK(isTouched == !moveBatch.GetQuadOps(qi).empty());
+
+			for (const CQuadField::MoveBatch::Op& op: moveBatch.GetQuadOps(qi)) {
+				REQUIRE(op.quad == qi);
+
+				if (op.insert) {
+					spring::VectorInsertUnique(batchQuads[qi], moved[op.unit], false);
+				} else {
+					REQUIRE(spring::VectorErase(batchQuads[qi], moved[op.unit]));
+				}
+			}
+		}
+
+		REQUIRE(batchQuads == seqQuads);
+	}
+}
@@ -0,0 +1,302 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/QTPFS/AbstractGraph.h"
+#include "Sim/Path/QTPFS/PathThreads.h"
+
+#include <random>
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+using QTPFS::AbstractGraph;
+using QTPFS::AbstractSearchData;
+
+
+// every root node (cluster) is split into 2x2 leaves, which form a grid of
+// cells; links between cells are set by the test and may be one-way
+struct TestNode {
+	struct Link { int nodeId; };
+
+	bool IsLeaf() const { return (childBaseIndex < 0); }
+	bool AllSquaresImpassable() const { return impassable; }
+
+	int GetChildBaseIndex() const { return childBaseIndex; }
+	unsigned int GetIndex() const { return index; }
+
+	int xmin() const { return x1; }
+	int zmin() const { return z1; }
+	int xmax() const { return x2; }
+	int zmax() const { return z2; }
+	unsigned int area() const { return ((x2 - x1) * (z2 - z1)); }
+
+	float GetMoveCost() const { return 1.0f; }
+
+	const std::vector<Link>& GetNeighbours() const { return neighbours; }
+
+	std::vector<Link> neighbours;
+
+	unsigned int index = 0;
+	int childBaseIndex = -1;
+
+	int x1 = 0, z1 = 0;
+	int x2 = 0, z2 = 0;
+
+	bool impassable = false;
+};
+
+struct TestLayer {
+	static constexpr int LEAF_SIZE = 8;
+
+	TestLayer(int xr, int zr): xRootNodes(xr), zRootNodes(zr) {
+		nodes.resize(GetRootNodeCount() * (1 + QTNODE_CHILD_COUNT));
+
+		for (int r = 0; r < GetRootNodeCount(); ++r) {
+			TestNode& root = nodes[r];
+
+			root.index = r;
+			root.childBaseIndex = GetRootNodeCount() + r * QTNODE_CHILD_COUNT;
+		}
+
+		for (int z = 0; z < GetZCells(); ++z) {
+			for (int x = 0; x < GetXCells(); ++x) {
+				TestNode& leaf = nodes[GetCellIndex(x, z)];
+
+				leaf.index = GetCellIndex(x, z);
+				leaf.x1 = x * LEAF_SIZE;
+				leaf.z1 = z * LEAF_SIZE;
+				leaf.x2 = leaf.x1 + LEAF_SIZE;
+				leaf.z2 = leaf.z1 + LEAF_SIZE;
+			}
+		}
+	}
+
+	int GetXRootNodes() const { return xRootNodes; }
+	int GetZRootNodes() const { return zRootNodes; }
+	int GetRootNodeSize() const { return (LEAF_SIZE * 2); }
+	int GetRootNodeCount() const { return (xRootNodes * zRootNodes); }
+	int GetMaxNodesAlloced() const { return nodes.size(); }
+
+	const TestNode* GetPoolNode(unsigned int i) const { return &nodes[i]; }
+
+	int GetXCells() const { return (xRootNodes * 2); }
+	int GetZCells() const { return (zRootNodes * 2); }
+
+	// same child order as NodeLayer::GetNode: right, then down
+	int GetCellIndex(int x, int z) const {
+		const int root = (z / 2) * xRootNodes + (x / 2);
+		const int child = (z % 2) * 2 + (x % 2);
+
+		return (GetRootNodeCount() + root * QTNODE_CHILD_COUNT + child);
+	}
+	int GetCellCluster(int x, int z) const { return ((z / 2) * xRootNodes + (x / 2)); }
+
+	TestNode& GetCell(int x, int z) { return nodes[GetCellIndex(x, z)]; }
+
+	void Link(int x1, int z1, int x2, int z2) {
+		GetCell(x1, z1).neighbours.push_back({GetCellIndex(x2, z2)});
+	}
+	void Unlink(int x1, int z1, int x2, int z2) {
+		auto& ngbs = GetCell(x1, z1).neighbours;
+		const int ngbIdx = GetCellIndex(x2, z2);
+
+		ngbs.erase(std::remove_if(ngbs.begin(), ngbs.end(), [&](const TestNode::Link& l) { return (l.nodeId == ngbIdx); }), ngbs.end());
+	}
+
+	// links every pair of adjacent cells both ways
+	void LinkAll() {
+		for (int z = 0; z < GetZCells(); ++z) {
+			for (int x = 0; x < GetXCells(); ++x) {
+				if (x > 0) { Link(x, z, x - 1, z); Link(x - 1, z, x, z); }
+				if (z > 0) { Link(x, z, x, z - 1); Link(x, z - 1, x, z); }
+			}
+		}
+	}
+
+	std::vector<TestNode> nodes;
+
+	int xRootNodes = 0;
+	int zRootNodes = 0;
+};
+
+
+// what the node-level search can reach, by following links from <src>
+static std::vector<bool> GetReachable(const TestLayer& layer, int src)
+{
+	std::vector<bool> reachable(layer.nodes.size(), false);
+	std::vector<int> open = {src};
+
+	reachable[src] = true;
+
+	while (!open.empty()) {
+		const int cur = open.back();
+		open.pop_back();
+
+		for (const TestNode::Link& link: layer.nodes[cur].neighbours) {
+			if (reachable[link.nodeId])
+				continue;
+
+			reachable[link.nodeId] = true;
+			open.push_back(link.nodeId);
+		}
+	}
+
+	return reachable;
+}
+
+static bool FindCorridor(const AbstractGraph& graph, AbstractSearchData& data, int srcNode, int tgtNode)
+{
+	return (graph.FindCorridor(graph.GetNodeRegion(srcNode), graph.GetNodeRegion(tgtNode), 1.0f, data));
+}
+
+// the coarse graph has to find a corridor exactly when the target can be reached
+static void CheckReachability(const TestLayer& layer, const AbstractGraph& graph, AbstractSearchData& data)
+{
+	for (int sz = 0; sz < layer.GetZCells(); ++sz) {
+		for (int sx = 0; sx < layer.GetXCells(); ++sx) {
+			const int srcNode = layer.GetCellIndex(sx, sz);
+
+			if (layer.nodes[srcNode].impassable) {
+				REQUIRE(graph.GetNodeRegion(srcNode) == -1);
+				continue;
+			}
+
+			const std::vector<bool> reachable = GetReachable(layer, srcNode);
+
+			for (int tz = 0; tz < layer.GetZCells(); ++tz) {
+				for (int tx = 0; tx < layer.GetXCells(); ++tx) {
+					const int tgtNode = layer.GetCellIndex(tx, tz);
+
+					if (layer.nodes[tgtNode].impassable)
+						continue;
+
+					INFO("(" << sx << ", " << sz << ") -> (" << tx << ", " << tz << ")");
+					REQUIRE(FindCorridor(graph, data, srcNode, tgtNode) == reachable[tgtNode]);
+
+					if (!reachable[tgtNode])
+						continue;
+
+					CHECK(data.InCorridor(layer.GetCellCluster(sx, sz)));
+					CHECK(data.InCorridor(layer.GetCellCluster(tx, tz)));
+				}
+			}
+		}
+	}
+}
+
+
+TEST_CASE("AbstractGraph")
+{
+	AbstractGraph graph;
+	AbstractSearchData data;
+
+	SECTION("one-way link between clusters") {
+		TestLayer layer(2, 1);
+
+		layer.LinkAll();
+		// (1, z) is in cluster 0 and (2, z) in cluster 1; only allow 0 -> 1
+		layer.Unlink(2, 0, 1, 0);
+		layer.Unlink(2, 1, 1, 1);
+		layer.Unlink(1, 1, 2, 1);
+
+		graph.Build(layer);
+
+		CHECK(graph.GetNumClusters() == 2);
+		CHECK(graph.GetNumRegions() == 2);
+		CHECK( FindCorridor(graph, data, layer.GetCellIndex(0, 0), layer.GetCellIndex(3, 1)));
+		CHECK(!FindCorridor(graph, data, layer.GetCellIndex(3, 1), layer.GetCellIndex(0, 0)));
+
+		CheckReachability(layer, graph, data);
+	}
+
+	SECTION("one-way links inside a cluster") {
+		TestLayer layer(1, 1);
+
+		// (0, 0) -> (1, 0) -> (1, 1) -> (0, 1) -> (0, 0) is one region
+		layer.Link(0, 0, 1, 0);
+		layer.Link(1, 0, 1, 1);
+		layer.Link(1, 1, 0, 1);
+		layer.Link(0, 1, 0, 0);
+
+		graph.Build(layer);
+
+		CHECK(graph.GetNumRegions() == 1);
+
+		// without the last link each leaf is on its own, and regions only
+		// lead further along the chain
+		layer.Unlink(0, 1, 0, 0);
+		graph.MarkDirty(SRectangle(0, 0, 16, 16));
+		graph.Repair(layer);
+
+		CHECK(graph.GetNumRegions() == 4);
+		CHECK( FindCorridor(graph, data, layer.GetCellIndex(0, 0), layer.GetCellIndex(0, 1)));
+		CHECK(!FindCorridor(graph, data, layer.GetCellIndex(0, 1), layer.GetCellIndex(0, 0)));
+		CHECK(!FindCorridor(graph, data, layer.GetCellIndex(1, 1), layer.GetCellIndex(1, 0)));
+
+		CheckReachability(layer, graph, data);
+	}
+
+	SECTION("random links") {
+		std::mt19937 rng(8);
+
+		const auto RandInt = [&](int a, int b) { return std::uniform_int_distribution<int>(a, b)(rng); };
+
+		TestLayer layer(5, 4);
+
+		// none, one way, the other way or both
+		const auto RandomLinks = [&](int x1, int z1, int x2, int z2) {
+			layer.Unlink(x1, z1, x2, z2);
+			layer.Unlink(x2, z2, x1, z1);
+
+			if (layer.GetCell(x1, z1).impassable || layer.GetCell(x2, z2).impassable)
+				return;
+
+			const int dirs = RandInt(0, 5);
+
+			if (dirs == 1 || dirs >= 3)
+				layer.Link(x1, z1, x2, z2);
+			if (dirs == 2 || dirs >= 3)
+				layer.Link(x2, z2, x1, z1);
+		};
+		const auto RandomCellLinks = [&](int x, int z) {
+			if (x > 0) RandomLinks(x, z, x - 1, z);
+			if (z > 0) RandomLinks(x, z, x, z - 1);
+			if (x < layer.GetXCells() - 1) RandomLinks(x, z, x + 1, z);
+			if (z < layer.GetZCells() - 1) RandomLinks(x, z, x, z + 1);
+		};
+
+		for (int z = 0; z < layer.GetZCells(); ++z) {
+			for (int x = 0; x < layer.GetXCells(); ++x) {
+				layer.GetCell(x, z).impassable = (RandInt(0, 9) == 0);
+			}
+		}
+		for (int z = 0; z < layer.GetZCells(); ++z) {
+			for (int x = 0; x < layer.GetXCells(); ++x) {
+				RandomCellLinks(x, z);
+			}
+		}
+
+		graph.Build(layer);
+		CheckReachability(layer, graph, data);
+
+		// relink a few clusters, which also changes the links their
+		// neighbours have into them, and repair only those
+		for (int n = 0; n < 20; ++n) {
+			for (int k = RandInt(1, 3); k > 0; --k) {
+				const int cx = RandInt(0, layer.GetXRootNodes() - 1);
+				const int cz = RandInt(0, layer.GetZRootNodes() - 1);
+
+				for (int z = cz * 2; z < cz * 2 + 2; ++z) {
+					for (int x = cx * 2; x < cx * 2 + 2; ++x) {
+						RandomCellLinks(x, z);
+					}
+				}
+
+				const int rootSize = layer.GetRootNodeSize();
+				graph.MarkDirty(SRectangle(cx * rootSize, cz * rootSize, (cx + 1) * rootSize, (cz + 1) * rootSize));
+			}
+
+			graph.Repair(layer);
+			CheckReachability(layer, graph, data);
+		}
+	}
+}
@@ -0,0 +1,98 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/QTPFS/NodeHeap.h"
+
+#include <queue>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+// mirrors QTPFS::SearchQueueNode and its ordering
+struct QueueNode {
+	QueueNode(int index, float priority): heapPriority(priority), nodeIndex(index) {}
+
+	float heapPriority;
+	int nodeIndex;
+};
+
+struct QueueNodeCmp {
+	bool operator() (const QueueNode& lhs, const QueueNode& rhs) const {
+		return std::tie(lhs.heapPriority, lhs.nodeIndex) > std::tie(rhs.heapPriority, rhs.nodeIndex);
+	}
+};
+
+template<size_t D>
+static void ComparePopOrder(unsigned int seed)
+{
+	typedef std::priority_queue<QueueNode, std::vector<QueueNode>, QueueNodeCmp> RefQueue;
+	typedef QTPFS::d_ary_heap<QueueNode, QueueNodeCmp, D> TestQueue;
+
+	RefQueue refQueue;
+	TestQueue testQueue;
+
+	std::mt19937 rng(seed);
+	// few distinct priorities and indices, so ties and duplicate entries are common
+	std::uniform_int_distribution<int> priorityDist(0, 63);
+	std::uniform_int_distribution<int> indexDist(0, 255);
+	std::uniform_int_distribution<int> opDist(0, 2);
+
+	for (int i = 0; i < 20000; ++i) {
+		if (opDist(rng) != 0 || refQueue.empty()) {
+			const int idx = indexDist(rng);
+			const float prio = priorityDist(rng) * 0.5f;
+
+			refQueue.emplace(idx, prio);
+			testQueue.emplace(idx, prio);
+		} else {
+			REQUIRE(testQueue.top().heapPriority == refQueue.top().heapPriority);
+			REQUIRE(testQueue.top().nodeIndex == refQueue.top().nodeIndex);
+
+			refQueue.pop();
+			testQueue.pop();
+		}
+
+		REQUIRE(testQueue.size() == refQueue.size());
+	}
+
+	while (!refQueue.empty()) {
+		REQUIRE(testQueue.top().heapPriority == refQueue.top().heapPriority);
+		REQUIRE(testQueue.top().nodeIndex == refQueue.top().nodeIndex);
+
+		refQueue.pop();
+		testQueue.pop();
+	}
+
+	CHECK(testQueue.empty());
+}
+
+TEST_CASE("DAryHeapMatchesPriorityQueue")
+{
+	for (unsigned int seed = 1; seed <= 4; ++seed) {
+		ComparePopOrder<2>(seed);
+		ComparePopOrder<3>(seed);
+		ComparePopOrder<4>(seed);
+		ComparePopOrder<8>(seed);
+	}
+}
+
+TEST_CASE("DAryHeapClearKeepsWorking")
+{
+	QTPFS::d_ary_heap<QueueNode, QueueNodeCmp, 4> queue;
+
+	for (int i = 0; i < 100; ++i)
+		queue.emplace(i, float(100 - i));
+
+	queue.clear();
+	CHECK(queue.empty());
+
+	queue.emplace(7, 2.0f);
+	queue.emplace(3, 1.0f);
+	queue.emplace(5, 1.0f);
+
+	CHECK(queue.top().nodeIndex == 3); queue.pop();
+	CHECK(queue.top().nodeIndex == 5); queue.pop();
+	CHECK(queue.top().nodeIndex == 7); queue.pop();
+	CHECK(queue.empty());
+}
@@ -0,0 +1,338 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/QTPFS/NodeLayerCache.h"
+#include "Sim/Path/QTPFS/NodeLayer.h"
+#include "Sim/Path/QTPFS/Node.h"
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileSystemAbstraction.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+using QTPFS::INode;
+using QTPFS::NodeLayer;
+using QTPFS::NodeLayerCache;
+
+
+// all data directories are the test directory
+static const std::string testDir = (std::filesystem::temp_directory_path() / "testNodeLayerCache").string() + "/";
+
+DataDirsAccess dataDirsAccess;
+
+std::string DataDirsAccess::LocateFile(std::string file, int flags) const { return (testDir + file); }
+
+entt::registry QTPFS::registry;
+unsigned int QTPFS::QTNode::MAX_DEPTH = 8;
+
+// the real ones need the map and movedefs; these only set up what the cache stores
+void QTPFS::NodeLayer::Init(unsigned int layerNum) {
+	layerNumber = layerNum;
+	numLeafNodes = 0;
+
+	nodeIndcs.resize(POOL_TOTAL_SIZE);
+
+	for (unsigned int i = 0; i < POOL_TOTAL_SIZE; i++) {
+		nodeIndcs[i] = POOL_TOTAL_SIZE - 1 - i;
+	}
+}
+
+void QTPFS::QTNode::Init(
+	const QTNode* parent,
+	unsigned int nn,
+	unsigned int x1, unsigned int z1,
+	unsigned int x2, unsigned int z2,
+	unsigned int idx
+) {
+	nodeNumber = nn;
+	childBaseIndex = -1u;
+
+	_xmin = x1;
+	_xmax = x2;
+	_zmin = z1;
+	_zmax = z2;
+
+	moveCostAvg = 1.0f + (idx % 7);
+	uint32_t depth = (parent != nullptr) ? (parent->GetDepth() + 1) : 0;
+	index = (idx & NODE_INDEX_MASK) + ((depth << DEPTH_BIT_OFFSET) & DEPTH_MASK);
+
+	// a different number of neighbours per node, all of them allocated before
+	neighbours.resize(idx % 5);
+
+	for (size_t i = 0; i < neighbours.size(); i++) {
+		neighbours[i].nodeId = (idx * 31 + i) % (idx + 1);
+
+		for (size_t k = 0; k < neighbours[i].netpoints.size(); k++) {
+			neighbours[i].netpoints[k] = float2(x1 + i, z1 + k);
+		}
+	}
+}
+
+bool QTPFS::QTNode::Split(NodeLayer& nl, unsigned int depth, bool forced) {
+	const unsigned int base = nl.AllocPoolNode(this, GetChildID(0, nl.GetRootMask()), xmin(), zmin(), xmid(), zmid());
+
+	nl.AllocPoolNode(this, GetChildID(1, nl.GetRootMask()), xmid(), zmin(), xmax(), zmid());
+	nl.AllocPoolNode(this, GetChildID(2, nl.GetRootMask()), xmin(), zmid(), xmid(), zmax());
+	nl.AllocPoolNode(this, GetChildID(3, nl.GetRootMask()), xmid(), zmid(), xmax(), zmax());
+
+	childBaseIndex = base;
+	neighbours.clear();
+
+	for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
+		nl.IncreaseOpenNodeCounter();
+	}
+
+	nl.DecreaseOpenNodeCounter();
+	nl.SetNumLeafNodes(nl.GetNumLeafNodes() + (4 - 1));
+	return true;
+}
+
+// only merges parents of leaves
+bool QTPFS::QTNode::Merge(NodeLayer& nl) {
+	nl.FreePoolNode(childBaseIndex + 3);
+	nl.FreePoolNode(childBaseIndex + 2);
+	nl.FreePoolNode(childBaseIndex + 1);
+	nl.FreePoolNode(childBaseIndex + 0);
+
+	childBaseIndex = -1u;
+
+	for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
+		nl.DecreaseOpenNodeCounter();
+	}
+
+	nl.IncreaseOpenNodeCounter();
+	nl.SetNumLeafNodes(nl.GetNumLeafNodes() - (4 - 1));
+	return true;
+}
+
+
+static constexpr int ROOT_NODE_SIZE = 256;
+
+// what PathManager::InitNodeLayer sets up before the cache is applied
+static void InitLayer(NodeLayer& nl, unsigned int layerNum, int xRootNodes, int zRootNodes)
+{
+	nl.Init(layerNum);
+	nl.SetRootNodeCountAndDimensions(xRootNodes * zRootNodes, xRootNodes, zRootNodes, ROOT_NODE_SIZE);
+	nl.SetRootMask(0x3);
+
+	for (int z = 0; z < zRootNodes; z++) {
+		for (int x = 0; x < xRootNodes; x++) {
+			nl.AllocPoolNode(nullptr, z * xRootNodes + x, x * ROOT_NODE_SIZE, z * ROOT_NODE_SIZE, (x + 1) * ROOT_NODE_SIZE, (z + 1) * ROOT_NODE_SIZE);
+			nl.IncreaseOpenNodeCounter();
+			nl.SetNumLeafNodes(nl.GetNumLeafNodes() + 1);
+		}
+	}
+}
+
+// splits random leaves, and merges a few back so the free-list has holes
+static void TesselateLayer(NodeLayer& nl, std::mt19937& rng, int numSplits)
+{
+	for (int n = 0; n < numSplits; n++) {
+		INode* node = nl.GetPoolNode(rng() % nl.GetRootNodeCount());
+
+		while (!node->IsLeaf())
+			node = nl.GetPoolNode(node->GetChildBaseIndex() + rng() % QTNODE_CHILD_COUNT);
+
+		if ((node->GetDepth() + 1) >= QTPFS::QTNode::MAX_DEPTH)
+			continue;
+
+		node->Split(nl, node->GetDepth(), true);
+	}
+
+	for (int n = 0; n < numSplits / 4; n++) {
+		const int i = rng() % nl.GetMaxNodesAlloced();
+		INode* node = nl.GetPoolNode(i);
+
+		if (node->NodeDeactivated() || node->IsLeaf())
+			continue;
+
+		const unsigned int childBase = node->GetChildBaseIndex();
+		bool leafChildren = true;
+
+		for (unsigned int k = 0; k < QTNODE_CHILD_COUNT; k++) {
+			leafChildren &= nl.GetPoolNode(childBase + k)->IsLeaf();
+		}
+
+		if (!leafChildren)
+			continue;
+
+		node->Merge(nl);
+	}
+
+	for (int n = 0; n < numSplits / 8; n++) {
+		nl.DecreaseOpenNodeCounter();
+		nl.IncreaseClosedNodeCounter();
+	}
+}
+
+static void CheckSameLayer(NodeLayer& a, NodeLayer& b)
+{
+	REQUIRE(a.GetMaxNodesAlloced() == b.GetMaxNodesAlloced());
+	CHECK(a.GetNumLeafNodes() == b.GetNumLeafNodes());
+	CHECK(a.GetNumOpenNodes() == b.GetNumOpenNodes());
+	CHECK(a.GetNumClosedNodes() == b.GetNumClosedNodes());
+
+	for (int i = 0; i < a.GetMaxNodesAlloced(); i++) {
+		const INode* na = a.GetPoolNode(i);
+		const INode* nb = b.GetPoolNode(i);
+
+		INFO("node " << i);
+		REQUIRE(na->GetNodeNumber() == nb->GetNodeNumber());
+		REQUIRE(na->GetRawIndex() == nb->GetRawIndex());
+		REQUIRE(na->xmin() == nb->xmin());
+		REQUIRE(na->zmin() == nb->zmin());
+		REQUIRE(na->xmax() == nb->xmax());
+		REQUIRE(na->zmax() == nb->zmax());
+		REQUIRE(na->GetMoveCost() == nb->GetMoveCost());
+		REQUIRE(na->GetChildBaseIndex() == nb->GetChildBaseIndex());
+
+		const auto& ngbsa = na->GetNeighbours();
+		const auto& ngbsb = nb->GetNeighbours();
+
+		REQUIRE(ngbsa.size() == ngbsb.size());
+
+		for (size_t k = 0; k < ngbsa.size(); k++) {
+			REQUIRE(ngbsa[k].nodeId == ngbsb[k].nodeId);
+			REQUIRE(std::memcmp(ngbsa[k].netpoints.data(), ngbsb[k].netpoints.data(), sizeof(ngbsa[k].netpoints)) == 0);
+		}
+	}
+
+	// both have to hand out the same indices from here on
+	for (unsigned int n = 0; n < NodeLayer::POOL_TOTAL_SIZE; n++) {
+		const unsigned int ia = a.AllocPoolNode(nullptr, 0, 0, 0, 1, 1);
+		const unsigned int ib = b.AllocPoolNode(nullptr, 0, 0, 0, 1, 1);
+
+		INFO("allocation " << n);
+		REQUIRE(ia == ib);
+
+		if (ia == -1u)
+			break;
+	}
+}
+
+static std::string ReadFile(const std::string& fileName)
+{
+	std::ifstream file(testDir + fileName, std::ios::in | std::ios::binary);
+	return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+static void WriteFile(const std::string& fileName, const std::string& data)
+{
+	std::ofstream file(testDir + fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(data.data(), data.size());
+}
+
+
+TEST_CASE("NodeLayerCache")
+{
+	const std::string fileName = "test.qtpfs.bin";
+
+	std::filesystem::remove_all(testDir);
+	std::filesystem::create_directories(testDir);
+
+	std::mt19937 rng(7);
+
+	std::vector<NodeLayer> layers(2);
+
+	InitLayer(layers[0], 0, 4, 2);
+	InitLayer(layers[1], 1, 4, 2);
+	TesselateLayer(layers[0], rng, 300);
+	TesselateLayer(layers[1], rng, 50);
+
+	NodeLayerCache::Key key;
+	key.heightMapChecksum = 1;
+	key.typeMapChecksum = 2;
+	key.mapx = 4 * ROOT_NODE_SIZE;
+	key.mapy = 2 * ROOT_NODE_SIZE;
+	key.rootSize = ROOT_NODE_SIZE;
+	key.numLayers = layers.size();
+
+	REQUIRE(NodeLayerCache::Write(fileName, key, layers));
+
+	SECTION("round trip") {
+		// written through a temporary file
+		CHECK(FileSystemAbstraction::FileExists(testDir + fileName));
+		CHECK(!FileSystemAbstraction::FileExists(testDir + fileName + ".tmp"));
+
+		NodeLayerCache cache;
+		REQUIRE(cache.Read(fileName, key));
+
+		for (unsigned int layerNum = 0; layerNum < layers.size(); layerNum++) {
+			NodeLayer loaded;
+
+			InitLayer(loaded, layerNum, 4, 2);
+			cache.ApplyLayer(layerNum, loaded);
+
+			INFO("layer " << layerNum);
+			CheckSameLayer(layers[layerNum], loaded);
+		}
+	}
+
+	SECTION("writing again replaces the file") {
+		const std::string saved = ReadFile(fileName);
+
+		TesselateLayer(layers[1], rng, 50);
+		REQUIRE(NodeLayerCache::Write(fileName, key, layers));
+		CHECK(ReadFile(fileName) != saved);
+
+		NodeLayerCache cache;
+		REQUIRE(cache.Read(fileName, key));
+
+		NodeLayer loaded;
+		InitLayer(loaded, 1, 4, 2);
+		cache.ApplyLayer(1, loaded);
+		CheckSameLayer(layers[1], loaded);
+	}
+
+	SECTION("failed writes keep the file") {
+		const std::string saved = ReadFile(fileName);
+
+		// the temporary file can not be created
+		std::filesystem::create_directories(testDir + fileName + ".tmp");
+
+		TesselateLayer(layers[1], rng, 50);
+		CHECK(!NodeLayerCache::Write(fileName, key, layers));
+		CHECK(ReadFile(fileName) == saved);
+	}
+
+	SECTION("stale or damaged files") {
+		const std::string saved = ReadFile(fileName);
+		NodeLayerCache cache;
+
+		CHECK(!cache.Read("missing.bin", key));
+
+		// any other input
+		NodeLayerCache::Key otherKey = key;
+		otherKey.blockMapChecksum = 3;
+		CHECK(!cache.Read(fileName, otherKey));
+
+		// truncated
+		for (const size_t size: {size_t(0), size_t(8), saved.size() / 2, saved.size() - 8}) {
+			INFO("size " << size);
+			WriteFile(fileName, saved.substr(0, size));
+			CHECK(!cache.Read(fileName, key));
+		}
+
+		// single flipped bits anywhere, header or payload
+		for (int n = 0; n < 200; n++) {
+			const size_t offset = (n < 100)? (n % 96): (rng() % saved.size());
+			std::string data = saved;
+
+			data[offset] ^= (1 << (rng() % 8));
+			WriteFile(fileName, data);
+
+			INFO("offset " << offset);
+			CHECK(!cache.Read(fileName, key));
+		}
+
+		WriteFile(fileName, saved);
+		CHECK(cache.Read(fileName, key));
+	}
+
+	std::filesystem::remove_all(testDir);
+}
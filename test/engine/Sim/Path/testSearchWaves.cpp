@@ -0,0 +1,122 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/QTPFS/SearchWaves.h"
+
+#include <random>
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+typedef QTPFS::SearchWaves<int, 3> TestWaves;
+typedef std::vector<std::vector<int>> HeadMap;
+
+static void Sort(TestWaves& waves, const std::vector<int>& searches, const HeadMap& heads)
+{
+	waves.Sort(searches, [&](int search, std::vector<int>& searchHeads) {
+		searchHeads.insert(searchHeads.end(), heads[search].begin(), heads[search].end());
+	});
+}
+
+static int FindWave(const TestWaves& waves, int search)
+{
+	for (size_t i = 0; i < waves.size(); i++) {
+		if (std::find(waves[i].begin(), waves[i].end(), search) != waves[i].end())
+			return int(i);
+	}
+
+	return -1;
+}
+
+
+TEST_CASE("SearchWaves")
+{
+	TestWaves waves;
+
+	SECTION("chains") {
+		// 0 <- 1, 0 <- 2 (full hash chain of 0); 2 <- 3 (partial chain of 2); 4 alone
+		const std::vector<int> searches = {3, 1, 4, 0, 2};
+		const HeadMap heads = {{}, {0}, {0}, {2}, {}};
+
+		Sort(waves, searches, heads);
+
+		CHECK(waves[0] == std::vector<int>{4, 0});
+		CHECK(waves[1] == std::vector<int>{1, 2});
+		CHECK(waves[2] == std::vector<int>{3});
+	}
+
+	SECTION("heads outside the update") {
+		// 5 has a search queued, but not in this update; 1 lists itself
+		const std::vector<int> searches = {0, 1, 2};
+		const HeadMap heads = {{5}, {1}, {5, 0}, {}, {}, {}};
+
+		Sort(waves, searches, heads);
+
+		CHECK(waves[0] == std::vector<int>{0, 1});
+		CHECK(waves[1] == std::vector<int>{2});
+		CHECK(waves[2].empty());
+	}
+
+	SECTION("deep chains and cycles") {
+		// 0 <- 1 <- 2 <- 3 needs four waves; 4 <-> 5 depend on each other
+		const std::vector<int> searches = {0, 1, 2, 3, 4, 5};
+		const HeadMap heads = {{}, {0}, {1}, {2}, {5}, {4}};
+
+		Sort(waves, searches, heads);
+
+		CHECK(waves[0] == std::vector<int>{0});
+		CHECK(waves[1] == std::vector<int>{1});
+		CHECK(waves[2] == std::vector<int>{2, 3, 4, 5});
+	}
+
+	SECTION("random") {
+		std::mt19937 rng(1);
+
+		for (int n = 0; n < 1000; n++) {
+			const int numSearches = 1 + (rng() % 64);
+
+			std::vector<int> searches;
+			HeadMap heads(numSearches + 8);
+
+			for (int i = 0; i < numSearches; i++) {
+				searches.push_back(i);
+
+				for (int j = 0, k = rng() % 3; j < k; j++) {
+					heads[i].push_back(rng() % (numSearches + 8));
+				}
+			}
+
+			std::shuffle(searches.begin(), searches.end(), rng);
+			Sort(waves, searches, heads);
+
+			size_t numSorted = 0;
+
+			for (const auto& wave: waves) {
+				numSorted += wave.size();
+			}
+
+			REQUIRE(numSorted == searches.size());
+
+			for (const int search: searches) {
+				const int wave = FindWave(waves, search);
+
+				// every search after its heads, unless there is no room left
+				for (const int head: heads[search]) {
+					if (head == search || head >= numSearches)
+						continue;
+
+					CHECK((FindWave(waves, head) < wave || wave == int(waves.size() - 1)));
+				}
+			}
+
+			// and within a wave in the given order
+			for (const auto& wave: waves) {
+				for (size_t i = 1; i < wave.size(); i++) {
+					const auto a = std::find(searches.begin(), searches.end(), wave[i - 1]);
+					const auto b = std::find(searches.begin(), searches.end(), wave[i]);
+
+					CHECK(a < b);
+				}
+			}
+		}
+	}
+}
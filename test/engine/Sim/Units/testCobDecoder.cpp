@@ -0,0 +1,434 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Units/Scripts/CobDecoder.h"
+#include "Sim/Units/Scripts/CobInterpreter.h"
+#include "Sim/Units/Scripts/CobOpcodes.h"
+
+#include <array>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+// Runs the interpreters of CCobThread (CCobInterpreter::TickRaw on the bytecode
+// and CCobInterpreter::TickDecoded on the decoded stream) side by side, with
+// the callouts to the unit, the engine and Lua recorded instead of executed.
+// After every tick both threads must be in the same state and have made the
+// same calls; fused sequences and jumps into them included.
+
+class TestThread;
+
+// the fields of CCobFile the interpreters read
+struct TestFile {
+	std::vector<int> code;
+	std::vector<CobOp> ops;
+	std::vector<std::string> scriptNames;
+	std::vector<int> scriptOffsets;
+	std::vector<int> scriptLengths;
+	std::string name = "test.cob";
+};
+
+// stands in for CCobInstance
+struct TestScript {
+	// {opcode, pc, arguments...}
+	using Event = std::array<int, 6>;
+
+	void Record(int type, int a = 0, int b = 0, int c = 0, int d = 0);
+
+	void Move(int piece, int axis, int pos, int speed) { Record(MOVE, piece, axis, pos, speed); }
+	void Turn(int piece, int axis, int dest, int speed) { Record(TURN, piece, axis, dest, speed); }
+	void Spin(int piece, int axis, int speed, int accel) { Record(SPIN, piece, axis, speed, accel); }
+	void StopSpin(int piece, int axis, int decel) { Record(STOP_SPIN, piece, axis, decel); }
+	void MoveNow(int piece, int axis, int pos) { Record(MOVE_NOW, piece, axis, pos); }
+	void TurnNow(int piece, int axis, int dest) { Record(TURN_NOW, piece, axis, dest); }
+	void SetVisibility(int piece, bool visible) { Record(visible? SHOW: HIDE, piece); }
+	void ShowFlare(int piece) { Record(SHOW, piece, 1); }
+	void EmitSfx(int type, int piece) { Record(EMIT_SFX, type, piece); }
+	void Explode(int piece, int flags) { Record(EXPLODE, piece, flags); }
+	void PlayUnitSound(int sound, int volume) { Record(PLAY_SOUND, sound, volume); }
+	void AttachUnit(int piece, int unit) { Record(ATTACH, piece, unit); }
+	void DropUnit(int unit) { Record(DROP, unit); }
+	void Signal(int signal);
+
+	int GetUnitVal(int val, int p1, int p2, int p3, int p4) {
+		Record(GET, val, p1, p2, p3);
+		return (val * 3 + p1 - p4);
+	}
+	void SetUnitVal(int val, int param) { Record(SET, val, param); }
+
+	bool NeedsWait(int type, int piece, int axis) {
+		Record(WAIT_TURN, type, piece, axis);
+		return (((piece + axis) & 1) == 0);
+	}
+
+	TestThread* thread = nullptr;
+
+	std::vector<int> staticVars;
+	std::vector<Event> events;
+};
+
+
+class TestThread: public CCobInterpreter<TestThread, TestFile>
+{
+	friend class CCobInterpreter<TestThread, TestFile>;
+
+public:
+	static constexpr int ANIM_TURN = 0;
+	static constexpr int ANIM_MOVE = 2;
+
+	TestThread(TestScript* script, TestFile* file): cobInst(script) {
+		cobFile = file;
+		script->thread = this;
+	}
+
+	void Start(int functionId, int startPC, const std::vector<int>& stack) {
+		callStack.push_back({functionId, -1, 0});
+		dataStack = stack;
+		pc = startPC;
+		state = Run;
+	}
+
+	// like CCobThread::Tick; false once the thread is dead
+	bool Tick(bool decoded) {
+		state = Run;
+
+		if (decoded) {
+			TickDecoded();
+		} else {
+			TickRaw();
+		}
+
+		return (state != Dead);
+	}
+
+	// like CCobThread::AnimFinished
+	void Wake() {
+		waitPiece = -1;
+		waitAxis = -1;
+	}
+
+	void Kill() { state = Dead; }
+
+	int GetPC() const { return pc; }
+	int GetSignalMask() const { return signalMask; }
+	State GetState() const { return state; }
+
+	bool operator == (const TestThread& t) const {
+		if (pc != t.pc || state != t.state || wakeTime != t.wakeTime)
+			return false;
+		if (paramCount != t.paramCount || retCode != t.retCode || signalMask != t.signalMask)
+			return false;
+		if (waitPiece != t.waitPiece || waitAxis != t.waitAxis)
+			return false;
+		if (!std::equal(std::begin(luaArgs), std::end(luaArgs), std::begin(t.luaArgs)))
+			return false;
+		if (dataStack != t.dataStack || callStack.size() != t.callStack.size())
+			return false;
+
+		for (size_t i = 0; i < callStack.size(); i++) {
+			const CallInfo& a = callStack[i];
+			const CallInfo& b = t.callStack[i];
+
+			if (a.functionId != b.functionId || a.returnAddr != b.returnAddr || a.stackTop != b.stackTop)
+				return false;
+		}
+
+		return true;
+	}
+
+	TestScript* cobInst = nullptr;
+
+protected:
+	int GetCurrTime() const { return 1000; }
+	void Schedule() { cobInst->Record(SLEEP, wakeTime); }
+
+	void StartThread(int functionId, int argCount) {
+		// the new thread takes its arguments off our stack
+		int args[2] = {0, 0};
+
+		for (int i = 0; i < argCount; i++) {
+			args[i & 1] += PopDataStack();
+		}
+
+		cobInst->Record(START, functionId, argCount, args[0], args[1]);
+	}
+
+	void LuaCall(int scriptId, int argCount) {
+		for (int i = 0; i < argCount; i++) {
+			luaArgs[i % NUM_LUA_ARGS] = PopDataStack();
+		}
+
+		retCode = luaArgs[0];
+		cobInst->Record(LUA_CALL, scriptId, argCount);
+	}
+
+	int RandInt(int n) const { return ((n > 1)? (n / 3): 0); }
+	bool InFireScript() const { return (LocalFunctionID() == 1); }
+};
+
+
+void TestScript::Record(int type, int a, int b, int c, int d)
+{
+	events.push_back({type, thread->GetPC(), a, b, c, d});
+}
+
+void TestScript::Signal(int signal)
+{
+	Record(SIGNAL, signal);
+
+	// CCobInstance::Signal kills the threads whose mask matches
+	if ((signal & thread->GetSignalMask()) != 0)
+		thread->Kill();
+}
+
+
+struct TestRun {
+	TestRun(const TestFile& f): file(f), thread(&script, &file) {
+		script.staticVars = {0, 1, -1};
+	}
+
+	// all state but the file, which the raw interpreter patches (CALL)
+	bool operator == (const TestRun& r) const {
+		return (thread == r.thread && script.staticVars == r.script.staticVars && script.events == r.script.events);
+	}
+
+	TestFile file;
+	TestScript script;
+	TestThread thread;
+
+	bool threw = false;
+};
+
+// ticks both runs until they end, comparing them after every tick
+static void RunBoth(TestRun& raw, TestRun& dec, int maxTicks)
+{
+	for (int n = 0; n < maxTicks; n++) {
+		bool rawAlive = false;
+		bool decAlive = false;
+
+		try { rawAlive = raw.thread.Tick(false); } catch (const std::out_of_range&) { raw.threw = true; }
+		try { decAlive = dec.thread.Tick(true); } catch (const std::out_of_range&) { dec.threw = true; }
+
+		REQUIRE(raw.threw == dec.threw);
+
+		// an exception can come half-way through a raw instruction
+		if (raw.threw) {
+			REQUIRE(dec.script.events == raw.script.events);
+			return;
+		}
+
+		REQUIRE(decAlive == rawAlive);
+		REQUIRE(dec == raw);
+
+		if (!rawAlive)
+			return;
+
+		// sleeping or waiting for an animation, pretend it is done
+		raw.thread.Wake();
+		dec.thread.Wake();
+	}
+
+	FAIL("thread did not end");
+}
+
+
+static std::vector<int> GenerateProgram(std::mt19937& rng)
+{
+	std::vector<int> code;
+	std::vector<size_t> jumpOperands;
+
+	const auto Rand = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+	const auto Append = [&](std::initializer_list<int> words) { code.insert(code.end(), words); };
+	const auto AppendJump = [&](int opcode) {
+		code.push_back(opcode);
+		jumpOperands.push_back(code.size());
+		code.push_back(0);
+	};
+
+	static constexpr int SIMPLE_OPS[] = {
+		ADD, SUB, MUL, DIV, MOD, BITWISE_AND, BITWISE_OR, BITWISE_XOR, BITWISE_NOT, RAND, GET_UNIT_VALUE, GET, SET,
+		SET_LESS, SET_LESS_OR_EQUAL, SET_GREATER, SET_GREATER_OR_EQUAL, SET_EQUAL, SET_NOT_EQUAL,
+		LOGICAL_AND, LOGICAL_OR, LOGICAL_XOR, LOGICAL_NOT, POP_STACK, CREATE_LOCAL_VAR,
+		SIGNAL, SET_SIGNAL_MASK, ATTACH, DROP, SLEEP,
+	};
+	static constexpr int PIECE_OPS[] = {
+		SPIN, STOP_SPIN, MOVE_NOW, TURN_NOW, WAIT_TURN, WAIT_MOVE, MOVE, TURN,
+	};
+
+	for (int i = 0, n = Rand(4, 40); i < n; ++i) {
+		switch (Rand(0, 20)) {
+			case  0: { Append({PUSH_CONSTANT, Rand(-2, 3)}); } break;
+			case  1: { Append({PUSH_CONSTANT, Rand(-90, 90), PUSH_CONSTANT, Rand(1, 9), TURN, Rand(0, 3), Rand(0, 2)}); } break;
+			case  2: { Append({PUSH_CONSTANT, Rand(-90, 90), PUSH_CONSTANT, Rand(1, 9), MOVE, Rand(0, 3), Rand(0, 2)}); } break;
+			case  3: { Append({PUSH_CONSTANT, Rand(0, 500), SLEEP}); } break;
+			case  4: { Append({PUSH_CONSTANT, Rand(-1, 1), POP_LOCAL_VAR, Rand(0, 5)}); } break;
+			case  5: { Append({PUSH_CONSTANT, Rand(-1, 1), POP_STATIC, Rand(0, 3)}); } break;
+			case  6: { Append({PUSH_LOCAL_VAR, Rand(0, 5)}); AppendJump(JUMP_NOT_EQUAL); } break;
+			case  7: { Append({PUSH_STATIC, Rand(0, 3)}); AppendJump(JUMP_NOT_EQUAL); } break;
+			case  8: { Append({PUSH_LOCAL_VAR, Rand(0, 5)}); } break;
+			case  9: { Append({POP_LOCAL_VAR, Rand(0, 5)}); } break;
+			case 10: { Append({PUSH_CONSTANT, LUA0 + Rand(0, 9)}); } break;
+			case 11: { Append({SIMPLE_OPS[Rand(0, std::size(SIMPLE_OPS) - 1)]}); } break;
+			case 12: { Append({SIMPLE_OPS[Rand(0, std::size(SIMPLE_OPS) - 1)]}); } break;
+			case 13: { Append({PIECE_OPS[Rand(0, std::size(PIECE_OPS) - 1)], Rand(0, 3), Rand(0, 2)}); } break;
+			case 14: { Append({Rand(0, 1)? SHOW: HIDE, Rand(0, 3)}); } break;
+			case 15: { Append({Rand(0, 1)? EXPLODE: PLAY_SOUND, Rand(0, 3)}); } break;
+			case 16: { Append({EMIT_SFX, Rand(0, 3)}); } break;
+			case 17: { Append({CACHE, Rand(0, 3)}); } break;
+			case 18: { AppendJump(JUMP); } break;
+			case 19: { AppendJump(JUMP_NOT_EQUAL); } break;
+			case 20: { Append({Rand(0, 1)? RETURN: 0x12345678}); } break;
+		}
+	}
+
+	Append({RETURN});
+
+	// forward only, so that every run ends; to any word (also into the
+	// middle of a sequence or past the end)
+	for (const size_t i: jumpOperands) {
+		code[i] = Rand(i + 1, code.size() + 1);
+	}
+
+	// sometimes leave an instruction's operands hanging off the end
+	if (Rand(0, 7) == 0)
+		code.push_back(PUSH_CONSTANT);
+
+	return code;
+}
+
+
+TEST_CASE("CobDecoderMatchesBytecode")
+{
+	std::mt19937 rng(1234);
+
+	// locals 0-5, then enough values that no program pops into the locals
+	std::vector<int> stack = {1, 0, 2, 0, -1, 0};
+	stack.resize(256, 1);
+
+	int numCompared = 0;
+
+	for (int n = 0; n < 1000; ++n) {
+		TestFile file;
+		file.code = GenerateProgram(rng);
+		file.scriptNames = {"Create"};
+		file.scriptOffsets = {0};
+		file.scriptLengths = {int(file.code.size())};
+
+		CobDecoder::Decode(file.code, file.scriptNames, file.scriptOffsets, file.scriptLengths, file.ops);
+
+		REQUIRE(file.ops.size() == file.code.size() + 1);
+
+		// start at every word, like a jump could
+		for (int start = 0; start < int(file.code.size()); ++start) {
+			TestRun raw(file);
+			TestRun dec(file);
+
+			raw.thread.Start(0, start, stack);
+			dec.thread.Start(0, start, stack);
+
+			RunBoth(raw, dec, 1000);
+
+			numCompared += 1;
+		}
+	}
+
+	INFO("compared " << numCompared);
+	CHECK(numCompared > 20000);
+}
+
+
+TEST_CASE("CobDecoderCalls")
+{
+	// 0: lua_Foo (zero-length), 1: Empty (zero-length), 2: Main
+	const std::vector<std::string> scriptNames = {"lua_Foo", "Empty", "Main"};
+	const std::vector<int> scriptOffsets = {0, 0, 0};
+	const std::vector<int> scriptLengths = {0, 0, 16};
+
+	const std::vector<int> code = {
+		CALL, 0, 1,
+		CALL, 1, 0,
+		CALL, 2, 3,
+		START, 1, 0,
+		START, 2, 0,
+		CALL, 7, 0,
+		0x12345678,
+		JUMP, 1000,
+	};
+
+	std::vector<CobOp> ops;
+	CobDecoder::Decode(code, scriptNames, scriptOffsets, scriptLengths, ops);
+
+	CHECK(ops[0].type == CobOp::OP_LUA_CALL);
+	CHECK(ops[3].type == CobOp::OP_NOP);
+	CHECK(ops[6].type == CobOp::OP_REAL_CALL);
+	CHECK(ops[6].args[1] == 3);
+	CHECK(ops[6].args[2] == scriptOffsets[2]);
+	CHECK(ops[6].next == 9);
+	CHECK(ops[9].type == CobOp::OP_NOP);
+	CHECK(ops[12].type == CobOp::OP_START);
+	CHECK(ops[15].type == CobOp::OP_NOP);
+	CHECK(ops[18].type == CobOp::OP_UNKNOWN);
+	CHECK(ops[18].args[0] == 0x12345678);
+	CHECK(ops[19].type == CobOp::OP_JUMP);
+	CHECK(ops[19].args[0] == int(code.size()));
+	CHECK(ops[21].type == CobOp::OP_OUT_OF_RANGE);
+}
+
+
+TEST_CASE("CobInterpreterCalls")
+{
+	TestFile file;
+	file.scriptNames = {"Main", "lua_Foo", "Add", "Empty"};
+	file.scriptOffsets = {0, 0, 26, 0};
+	file.scriptLengths = {26, 0, 8, 0};
+	file.code = {
+		// Main
+		PUSH_CONSTANT, 7,
+		PUSH_CONSTANT, 5,
+		CALL, 2, 2,           // Add(7, 5)
+		PUSH_CONSTANT, 3,
+		CALL, 1, 1,           // lua_Foo(3)
+		CALL, 3, 0,           // Empty(), skipped
+		PUSH_CONSTANT, 9,
+		START, 2, 1,          // start Add(9)
+		PUSH_CONSTANT, 100,
+		SLEEP,
+		PUSH_CONSTANT, 0,
+		RETURN,
+		// Add
+		CREATE_LOCAL_VAR,
+		CREATE_LOCAL_VAR,
+		PUSH_LOCAL_VAR, 0,
+		PUSH_LOCAL_VAR, 1,
+		ADD,
+		RETURN,
+	};
+
+	CobDecoder::Decode(file.code, file.scriptNames, file.scriptOffsets, file.scriptLengths, file.ops);
+
+	TestRun raw(file);
+	TestRun dec(file);
+
+	raw.thread.Start(0, 0, {});
+	dec.thread.Start(0, 0, {});
+
+	RunBoth(raw, dec, 10);
+
+	CHECK(dec.thread.GetState() == TestThread::Dead);
+	CHECK(dec.thread.GetPC() == 26);
+
+	const std::vector<TestScript::Event> events = {
+		{LUA_CALL, 12, 1, 1, 0, 0},
+		{START, 20, 2, 1, 9, 0},
+		{SLEEP, 23, 1100, 0, 0, 0},
+	};
+
+	CHECK(dec.script.events == events);
+
+	// the raw interpreter rewrites CALL in place, the decoded one reads nothing from code
+	CHECK(raw.file.code[4] == REAL_CALL);
+	CHECK(raw.file.code[9] == LUA_CALL);
+	CHECK(dec.file.code[4] == CALL);
+}
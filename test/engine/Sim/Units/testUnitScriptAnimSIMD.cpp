@@ -0,0 +1,103 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Units/Scripts/UnitScriptAnimSIMD.h"
+#include "System/SpringMath.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+using namespace UnitScriptAnimSIMD;
+
+struct AnimState {
+	std::vector<float> cur;
+	std::vector<float> speed;
+	std::vector<float> dest;
+	std::vector<float> accel;
+	std::vector<std::uint8_t> done;
+
+	AnimLanes GetLanes() { return {cur.data(), speed.data(), dest.data(), accel.data(), done.data(), cur.size()}; }
+
+	bool operator == (const AnimState& s) const {
+		// bitwise, NaN's included
+		const auto Same = [](const std::vector<float>& a, const std::vector<float>& b) {
+			return (a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0);
+		};
+		return (Same(cur, s.cur) && Same(speed, s.speed) && Same(dest, s.dest) && Same(accel, s.accel) && done == s.done);
+	}
+};
+
+static AnimState RandomState(std::mt19937& rng, size_t n, bool angles)
+{
+	std::uniform_real_distribution<float> angleDist(0.0f, math::TWOPI * 0.9999f);
+	std::uniform_real_distribution<float> wrapDist(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> speedDist(0.0f, 8.0f);
+	std::uniform_real_distribution<float> posDist(-50.0f, 50.0f);
+	std::uniform_int_distribution<int> caseDist(0, 7);
+
+	AnimState s;
+
+	for (size_t i = 0; i < n; i++) {
+		float cur = angles? angleDist(rng): posDist(rng);
+		float dest = angles? angleDist(rng): posDist(rng);
+		float speed = speedDist(rng);
+		float accel = speedDist(rng) * 0.1f;
+
+		// plenty of lanes that finish, tie or need wrapping
+		switch (caseDist(rng)) {
+			case 0: { dest = cur; } break;
+			case 1: { speed = 0.0f; } break;
+			case 2: { dest = 0.0f; accel = speed; } break;
+			case 3: { dest = angles? std::min(speed, 6.0f): speed; } break;
+			case 4: { cur = angles? wrapDist(rng): cur; } break;
+			case 5: { accel = -accel; } break;
+			case 6: { cur = -0.0f; speed = -0.0f; } break;
+			default: {} break;
+		}
+
+		s.cur.push_back(cur);
+		s.speed.push_back(speed);
+		s.dest.push_back(dest);
+		s.accel.push_back(accel);
+		s.done.push_back(0);
+	}
+
+	return s;
+}
+
+static void CompareKernels(TickAnimsFunc scalar, TickAnimsFunc simd, bool angles, float hugeAngle = 0.0f)
+{
+	std::mt19937 rng(angles);
+
+	for (int round = 0; round < 2000; round++) {
+		// odd sizes test the scalar tail as well
+		AnimState s = RandomState(rng, 1 + (round % 37), angles);
+
+		// angles that can not be wrapped exactly by the SIMD code
+		if (hugeAngle != 0.0f)
+			s.cur[round % s.cur.size()] = hugeAngle;
+
+		AnimState v = s;
+
+		// step a few times so spins accelerate and turns wrap around
+		for (const int tickRate: {30, 15, 60, 30, 30}) {
+			scalar(s.GetLanes(), tickRate);
+			simd(v.GetLanes(), tickRate);
+
+			REQUIRE(s == v);
+		}
+	}
+}
+
+
+TEST_CASE("UnitScriptAnimSIMD")
+{
+	INFO("implementation: " << GetImplName());
+
+	SECTION("turns") { CompareKernels(TickTurnsScalar, TickTurnsSSE, true); }
+	SECTION("spins") { CompareKernels(TickSpinsScalar, TickSpinsSSE, true); }
+	SECTION("spins (scalar fallback)") { CompareKernels(TickSpinsScalar, TickSpinsSSE, true, 2e10f); }
+	SECTION("moves") { CompareKernels(TickMovesScalar, TickMovesSSE, false); }
+}
@@ -0,0 +1,162 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Weapons/WeaponAutoTarget.h"
+
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+
+struct FakeUnit;
+
+// stands in for CWeapon, targets are plain ids (0 = none)
+struct FakeWeapon {
+	FakeUnit* owner = nullptr;
+	FakeWeapon* slavedTo = nullptr;
+	int weaponNum = 0;
+
+	int currentTarget = 0;
+	// what the deferred search will pick, 0 = it finds nothing
+	int searchResult = 0;
+	bool autoTargetPending = false;
+	int numTargetChanges = 0;
+
+	void SetAttackTarget(int target) {
+		if (target == currentTarget)
+			return;
+
+		currentTarget = target;
+		numTargetChanges++;
+	}
+
+	// the target-related part of CWeapon::SlowUpdate
+	void SlowUpdate() {
+		if (slavedTo != nullptr) {
+			SetAttackTarget(slavedTo->currentTarget);
+			return;
+		}
+
+		autoTargetPending = true;
+	}
+
+	int GetCurrentTarget() const { return currentTarget; }
+
+	bool HasPendingAutoTarget() const { return autoTargetPending; }
+	bool CommitAutoTarget() {
+		autoTargetPending = false;
+
+		if (searchResult == 0)
+			return false;
+
+		SetAttackTarget(searchResult);
+		return true;
+	}
+};
+
+struct FakeUnit {
+	std::vector<FakeWeapon*> weapons;
+};
+
+
+// mirrors CUnitHandler::SlowUpdateUnits: all SlowUpdates first, then the commits
+static void SlowUpdateUnits(const std::vector<FakeUnit*>& units)
+{
+	std::vector<FakeWeapon*> autoTargetWeapons;
+
+	for (FakeUnit* unit: units) {
+		for (FakeWeapon* w: unit->weapons) {
+			w->SlowUpdate();
+
+			if (w->HasPendingAutoTarget())
+				autoTargetWeapons.push_back(w);
+		}
+	}
+
+	WeaponAutoTarget::CommitTargets(autoTargetWeapons);
+}
+
+
+TEST_CASE("WeaponAutoTarget")
+{
+	// weapon 0 is a master, 1 is slaved to it, 2 is slaved to 1,
+	// 3 is an independent master and 4 is slaved to that one
+	FakeWeapon weapons[5];
+	FakeUnit unit;
+
+	for (int i = 0; i < 5; i++) {
+		weapons[i].owner = &unit;
+		weapons[i].weaponNum = i;
+		unit.weapons.push_back(&weapons[i]);
+	}
+
+	weapons[1].slavedTo = &weapons[0];
+	weapons[2].slavedTo = &weapons[1];
+	weapons[4].slavedTo = &weapons[3];
+
+	FakeWeapon otherWeapons[2];
+	FakeUnit otherUnit;
+
+	for (int i = 0; i < 2; i++) {
+		otherWeapons[i].owner = &otherUnit;
+		otherWeapons[i].weaponNum = i;
+		otherUnit.weapons.push_back(&otherWeapons[i]);
+	}
+
+	otherWeapons[1].slavedTo = &otherWeapons[0];
+
+	const std::vector<FakeUnit*> units = {&unit, &otherUnit};
+
+	SECTION("slaves pick up the new target in the same slow update") {
+		weapons[0].searchResult = 10;
+		weapons[3].searchResult = 30;
+		otherWeapons[0].searchResult = 40;
+
+		SlowUpdateUnits(units);
+
+		CHECK(weapons[0].currentTarget == 10);
+		CHECK(weapons[1].currentTarget == 10);
+		CHECK(weapons[2].currentTarget == 10);
+		CHECK(weapons[3].currentTarget == 30);
+		CHECK(weapons[4].currentTarget == 30);
+		CHECK(otherWeapons[0].currentTarget == 40);
+		CHECK(otherWeapons[1].currentTarget == 40);
+
+		// and keep following it
+		weapons[0].searchResult = 11;
+
+		SlowUpdateUnits(units);
+
+		CHECK(weapons[0].currentTarget == 11);
+		CHECK(weapons[1].currentTarget == 11);
+		CHECK(weapons[2].currentTarget == 11);
+		CHECK(weapons[4].currentTarget == 30);
+	}
+
+	SECTION("slaves of other masters are left alone") {
+		weapons[0].searchResult = 10;
+		weapons[3].searchResult = 30;
+
+		SlowUpdateUnits(units);
+
+		const int numChanges = weapons[4].numTargetChanges;
+
+		weapons[0].searchResult = 12;
+		weapons[3].searchResult = 0;
+
+		SlowUpdateUnits(units);
+
+		CHECK(weapons[2].currentTarget == 12);
+		CHECK(weapons[4].currentTarget == 30);
+		CHECK(weapons[4].numTargetChanges == numChanges);
+	}
+
+	SECTION("nothing found keeps the cloned target") {
+		weapons[0].currentTarget = 5;
+
+		SlowUpdateUnits(units);
+
+		CHECK(weapons[0].currentTarget == 5);
+		CHECK(weapons[1].currentTarget == 5);
+		CHECK(weapons[2].currentTarget == 5);
+	}
+}
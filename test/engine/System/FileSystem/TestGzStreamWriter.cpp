@@ -0,0 +1,191 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "System/FileSystem/GzStreamWriter.h"
+#include "System/FileSystem/GZFileHandler.h"
+
+#include <catch_amalgamated.hpp>
+
+
+static std::vector<std::uint8_t> ReadGzFile(const std::string& fileName)
+{
+	std::vector<std::uint8_t> data;
+	std::uint8_t buffer[8192];
+
+	gzFile file = gzopen(fileName.c_str(), "rb");
+
+	if (file == nullptr)
+		return data;
+
+	int n = 0;
+
+	while ((n = gzread(file, buffer, sizeof(buffer))) > 0) {
+		data.insert(data.end(), buffer, buffer + n);
+	}
+
+	gzclose(file);
+	return data;
+}
+
+static std::vector<std::uint8_t> ReadRawFile(const std::string& fileName)
+{
+	std::vector<std::uint8_t> data;
+	std::uint8_t buffer[8192];
+
+	FILE* file = std::fopen(fileName.c_str(), "rb");
+
+	if (file == nullptr)
+		return data;
+
+	size_t n = 0;
+
+	while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data.insert(data.end(), buffer, buffer + n);
+	}
+
+	std::fclose(file);
+	return data;
+}
+
+// feeds a compressed buffer through the path files loaded from the VFS take
+struct TestGZFileHandler: public CGZFileHandler {
+	TestGZFileHandler(): CGZFileHandler("", SPRING_VFS_NONE) {}
+
+	bool Uncompress(const std::vector<std::uint8_t>& compressed) {
+		fileBuffer = compressed;
+		fileSize = fileBuffer.size();
+		return UncompressBuffer();
+	}
+};
+
+static std::vector<std::uint8_t> MakeData(size_t size)
+{
+	std::vector<std::uint8_t> data(size);
+	std::uint32_t state = 12345;
+
+	// compressible, but not trivially so
+	for (size_t i = 0; i < size; i++) {
+		state = state * 1664525u + 1013904223u;
+		data[i] = std::uint8_t((state >> 24) & 0x0F) + std::uint8_t(i / 1000);
+	}
+
+	return data;
+}
+
+
+TEST_CASE("GzStreamWriter")
+{
+	const std::string fileName = "testGzStreamWriter.gz";
+	const std::vector<std::uint8_t> data = MakeData(100 * 1000);
+
+	SECTION("blocks are written in order as concatenated members")
+	{
+		CGzStreamWriter writer(fileName, 9, 3, 4096);
+		REQUIRE(writer.IsOpen());
+
+		// odd sizes so writes straddle block boundaries
+		for (size_t pos = 0; pos < data.size(); pos += 777) {
+			writer.Write(&data[pos], std::min(size_t(777), data.size() - pos));
+		}
+
+		CHECK(writer.GetInputSize() == data.size());
+		CHECK(writer.Close());
+		CHECK(ReadGzFile(fileName) == data);
+	}
+
+	SECTION("header is patched in place on close")
+	{
+		const std::string header0 = "header-v0";
+		const std::string header1 = "header-v1";
+
+		std::vector<std::uint8_t> expected(header1.begin(), header1.end());
+		expected.insert(expected.end(), data.begin(), data.end());
+
+		CGzStreamWriter writer(fileName, 5, 2, 4096);
+		REQUIRE(writer.IsOpen());
+
+		writer.SetHeader(header0.data(), header0.size());
+		writer.Write(data.data(), data.size());
+		writer.SetHeader(header1.data(), header1.size());
+
+		CHECK(writer.GetInputSize() == expected.size());
+		CHECK(writer.Close());
+		CHECK(ReadGzFile(fileName) == expected);
+	}
+
+	SECTION("empty file")
+	{
+		CGzStreamWriter writer(fileName, 9);
+		CHECK(writer.Close());
+		CHECK(ReadGzFile(fileName).empty());
+	}
+
+	std::remove(fileName.c_str());
+}
+
+
+TEST_CASE("GZFileHandlerMultiMember")
+{
+	const std::vector<std::uint8_t> data = MakeData(50 * 1000);
+
+	TestGZFileHandler fh;
+
+	SECTION("every member is inflated")
+	{
+		std::vector<std::uint8_t> compressed;
+		std::vector<std::uint8_t> member;
+
+		// uneven members, including an empty one
+		const size_t splits[] = {0, 1, 1, 4000, 20000, data.size()};
+
+		for (size_t i = 1; i < std::size(splits); i++) {
+			REQUIRE(CGzStreamWriter::CompressMember(data.data() + splits[i - 1], splits[i] - splits[i - 1], 6, member));
+			compressed.insert(compressed.end(), member.begin(), member.end());
+		}
+
+		CHECK(fh.Uncompress(compressed));
+		CHECK(fh.FileSize() == int(data.size()));
+		CHECK(fh.GetBuffer() == data);
+	}
+
+	SECTION("files written by CGzStreamWriter")
+	{
+		const std::string fileName = "testGZFileHandler.gz";
+		const std::string header = "header";
+
+		std::vector<std::uint8_t> expected(header.begin(), header.end());
+		expected.insert(expected.end(), data.begin(), data.end());
+
+		CGzStreamWriter writer(fileName, 9, 2, 4096);
+		REQUIRE(writer.IsOpen());
+
+		writer.SetHeader(header.data(), header.size());
+		writer.Write(data.data(), data.size());
+		REQUIRE(writer.Close());
+
+		CHECK(fh.Uncompress(ReadRawFile(fileName)));
+		CHECK(fh.GetBuffer() == expected);
+
+		std::remove(fileName.c_str());
+	}
+
+	SECTION("truncated last member")
+	{
+		std::vector<std::uint8_t> compressed;
+		std::vector<std::uint8_t> member;
+
+		REQUIRE(CGzStreamWriter::CompressMember(data.data(), 1000, 6, member));
+		compressed.insert(compressed.end(), member.begin(), member.end());
+		REQUIRE(CGzStreamWriter::CompressMember(data.data() + 1000, data.size() - 1000, 6, member));
+		compressed.insert(compressed.end(), member.begin(), member.begin() + member.size() / 2);
+
+		CHECK(!fh.Uncompress(compressed));
+		CHECK(!fh.FileExists());
+	}
+}
@@ -2,6 +2,8 @@
 
 #include "System/creg/creg_cond.h"
 #include "System/creg/Serializer.h"
+#include "System/LoadSave/SaveDelta.h"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -36,6 +38,7 @@ struct TestObj {
 		enumVar = A;
 		for(int a=0;a<5;a++) sarray[a] = 0;
 		children[0] = children[1] = 0;
+		embedded.value = 0;
 		embeddedPtr = &embedded;
 	}
 	virtual ~TestObj() {
@@ -76,7 +79,7 @@ CR_REG_METADATA(TestObj, (
 ));
 
 
-static void savetest(std::ostream* os)
+static void savetest(std::ostream* os, bool parallel = false)
 {
 	// root obj
 	TestObj* o = new TestObj;
@@ -102,7 +105,7 @@ static void savetest(std::ostream* os)
 
 	// save
 	creg::COutputStreamSerializer ss;
-	ss.SavePackage(os, o, o->GetClass());
+	ss.SavePackage(os, o, o->GetClass(), parallel);
 
 	delete(o);
 }
@@ -171,3 +174,101 @@ TEST_CASE("CregLoadSave")
 
 	delete root;
 }
+
+
+TEST_CASE("CregLoadSaveParallel")
+{
+	std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+	std::stringstream ps(std::ios::in | std::ios::out | std::ios::binary);
+	savetest(&ss, false);
+	savetest(&ps, true);
+
+	INFO("parallel package matches serial package");
+	CHECK(ss.str() == ps.str());
+
+	TestObj* root = (TestObj*)loadtest(&ps);
+
+	CHECK(dynamic_cast<TestObj*>(root));
+	CHECK(test_creg_members(root));
+	CHECK(test_creg_pointers(root));
+
+	delete root;
+}
+
+
+TEST_CASE("CregLoadSaveDelta")
+{
+	constexpr int NUM_OBJECTS = 500;
+
+	// a chain of objects, each with enough data to get a piece of its own
+	TestObj* root = new TestObj;
+	TestObj* tail = root;
+
+	for (int i = 0; i < NUM_OBJECTS; i++) {
+		tail->intvar = i;
+		tail->darray.assign(256, i);
+		tail = (tail->children[0] = new TestObj);
+	}
+
+	const auto SaveChain = [&](std::string& data, std::vector<std::uint64_t>& offsets) {
+		std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+		creg::COutputStreamSerializer os;
+		os.SetObjectOffsets(&offsets);
+		os.SavePackage(&ss, root, root->GetClass());
+		data = ss.str();
+	};
+
+	std::string baseData;
+	std::string nextData;
+	std::vector<std::uint64_t> baseOffsets;
+	std::vector<std::uint64_t> nextOffsets;
+
+	SaveChain(baseData, baseOffsets);
+	CHECK(baseOffsets.size() >= NUM_OBJECTS);
+	CHECK(std::is_sorted(baseOffsets.begin(), baseOffsets.end()));
+
+	CSaveDelta delta;
+	delta.SetBase("base.ssf", baseData, baseOffsets);
+
+	// change a single object in the middle of the chain
+	tail = root;
+	for (int i = 0; i < NUM_OBJECTS / 2; i++) {
+		tail = tail->children[0];
+	}
+	tail->darray[0] = -1;
+
+	SaveChain(nextData, nextOffsets);
+
+	std::string deltaData;
+	const size_t numLiteralBytes = delta.Create(nextData, nextOffsets, deltaData);
+
+	INFO("only the changed object is stored");
+	CHECK(numLiteralBytes > 0);
+	CHECK(numLiteralBytes < nextData.size() / 50);
+	CHECK(deltaData.size() < nextData.size() / 20);
+
+	CSaveDelta::Header header;
+	CHECK(CSaveDelta::IsDelta(deltaData));
+	CHECK(CSaveDelta::ReadHeader(deltaData, header));
+	CHECK(header.baseName == "base.ssf");
+
+	std::string appliedData;
+	CHECK(CSaveDelta::Apply(deltaData, baseData, appliedData));
+	CHECK(appliedData == nextData);
+
+	INFO("the delta is rejected against any other base");
+	CHECK(!CSaveDelta::Apply(deltaData, nextData, appliedData));
+
+	std::stringstream ss(appliedData, std::ios::in | std::ios::binary);
+	TestObj* loaded = (TestObj*)loadtest(&ss);
+
+	tail = loaded;
+	for (int i = 0; i < NUM_OBJECTS / 2; i++) {
+		tail = tail->children[0];
+	}
+	CHECK(tail->intvar == NUM_OBJECTS / 2);
+	CHECK(tail->darray[0] == -1);
+
+	delete loaded;
+	delete root;
+}
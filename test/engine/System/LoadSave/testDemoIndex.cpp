@@ -0,0 +1,211 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "System/LoadSave/DemoIndex.h"
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileSystemAbstraction.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <catch_amalgamated.hpp>
+
+
+// all data directories are the test directory
+static const std::string testDir = (std::filesystem::temp_directory_path() / "testDemoIndex").string() + "/";
+
+DataDirsAccess dataDirsAccess;
+
+std::string DataDirsAccess::LocateFile(std::string file, int flags) const { return (testDir + file); }
+
+
+static DemoFileHeader GetDemoHeader(std::uint8_t gameID, int demoStreamSize)
+{
+	DemoFileHeader header;
+
+	memset(&header, 0, sizeof(header));
+	memset(header.gameID, gameID, sizeof(header.gameID));
+
+	header.demoStreamSize = demoStreamSize;
+	return header;
+}
+
+// indexes frames 30, 60 and 90 of a demo, but only snapshots 30 and 90
+static void AddEntries(CDemoIndex& index)
+{
+	for (int frameNum = 1; frameNum <= 100; frameNum++) {
+		index.AddFramePos(frameNum, frameNum * 10, frameNum / 30.0f);
+	}
+
+	index.AddSnapshot(30);
+	index.AddSnapshot(90);
+}
+
+static void CheckEntry(const CDemoIndex& index, int frameNum, int expFrameNum)
+{
+	CDemoIndex::Entry entry;
+
+	INFO("frame " << frameNum);
+	REQUIRE(index.FindEntry(frameNum, entry));
+	CHECK(entry.frameNum == expFrameNum);
+	CHECK(entry.chunkPos == expFrameNum * 10);
+	CHECK(entry.modGameTime == expFrameNum / 30.0f);
+}
+
+static void WriteFile(const std::string& fileName, const std::string& data)
+{
+	std::ofstream file(testDir + fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(data.data(), data.size());
+}
+
+static std::string ReadFile(const std::string& fileName)
+{
+	std::ifstream file(testDir + fileName, std::ios::in | std::ios::binary);
+	return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+
+TEST_CASE("DemoIndex")
+{
+	const std::string demoName = "test.sdfz";
+	const std::string indexName = CDemoIndex::GetIndexFileName(demoName);
+
+	std::filesystem::remove_all(testDir);
+	std::filesystem::create_directories(testDir);
+
+	CDemoIndex index(demoName, GetDemoHeader(1, 5000), 30);
+
+	SECTION("snapshots") {
+		CHECK(!index.Load());
+
+		for (int frameNum = 1; frameNum <= 100; frameNum++) {
+			index.AddFramePos(frameNum, frameNum * 10, frameNum / 30.0f);
+		}
+
+		// only multiples of the interval
+		CHECK( index.WantSnapshot(30));
+		CHECK( index.WantSnapshot(60));
+		CHECK(!index.WantSnapshot(45));
+		CHECK(!index.WantSnapshot(120));
+
+		// not visible until the snapshot was written
+		CDemoIndex::Entry entry;
+		CHECK(!index.GetEntry(30, entry));
+		CHECK(index.GetNumEntries() == 0);
+
+		index.AddSnapshot(30);
+		CHECK(index.GetEntry(30, entry));
+		CHECK(!index.WantSnapshot(30));
+
+		// 60 was skipped and is dropped with it
+		index.AddSnapshot(90);
+		CHECK(!index.GetEntry(60, entry));
+		CHECK(!index.WantSnapshot(60));
+		CHECK(index.GetNumEntries() == 2);
+
+		// already indexed frames are not recorded again
+		index.AddFramePos(30, 1, 1.0f);
+		CHECK(!index.WantSnapshot(30));
+
+		// and without an interval nothing is
+		CDemoIndex disabled(demoName, GetDemoHeader(1, 5000), 0);
+		disabled.AddFramePos(30, 300, 1.0f);
+		CHECK(!disabled.WantSnapshot(30));
+	}
+
+	SECTION("FindEntry") {
+		CDemoIndex::Entry entry;
+		CHECK(!index.FindEntry(100, entry));
+
+		AddEntries(index);
+
+		CHECK(!index.FindEntry(0, entry));
+		CHECK(!index.FindEntry(29, entry));
+		CheckEntry(index, 30, 30);
+		CheckEntry(index, 60, 30);
+		CheckEntry(index, 89, 30);
+		CheckEntry(index, 90, 90);
+		CheckEntry(index, 100000, 90);
+	}
+
+	SECTION("round trip") {
+		AddEntries(index);
+
+		// AddSnapshot saves, and does so through a temporary file
+		CHECK(FileSystemAbstraction::FileExists(testDir + indexName));
+		CHECK(!FileSystemAbstraction::FileExists(testDir + indexName + ".tmp"));
+
+		CDemoIndex loaded(demoName, GetDemoHeader(1, 5000), 30);
+
+		REQUIRE(loaded.Load());
+		CHECK(loaded.GetNumEntries() == 2);
+		CheckEntry(loaded, 30, 30);
+		CheckEntry(loaded, 95, 90);
+
+		// saving again replaces the index instead of appending to it
+		REQUIRE(loaded.Save());
+		REQUIRE(loaded.Load());
+		CHECK(loaded.GetNumEntries() == 2);
+	}
+
+	SECTION("failed saves keep the index") {
+		AddEntries(index);
+
+		const std::string saved = ReadFile(indexName);
+
+		// the temporary file can not be created
+		std::filesystem::create_directories(testDir + indexName + ".tmp");
+
+		CDemoIndex other(demoName, GetDemoHeader(1, 5000), 30);
+		other.AddFramePos(60, 600, 2.0f);
+		other.AddSnapshot(60);
+
+		CHECK(!other.Save());
+		CHECK(ReadFile(indexName) == saved);
+	}
+
+	SECTION("invalid files") {
+		AddEntries(index);
+
+		const std::string saved = ReadFile(indexName);
+
+		// a different demo
+		CHECK(!CDemoIndex(demoName, GetDemoHeader(2, 5000), 30).Load());
+		CHECK(!CDemoIndex(demoName, GetDemoHeader(1, 4000), 30).Load());
+
+		// truncated
+		for (const size_t size: {size_t(0), size_t(10), saved.size() - 1}) {
+			INFO("size " << size);
+			WriteFile(indexName, saved.substr(0, size));
+			CHECK(!CDemoIndex(demoName, GetDemoHeader(1, 5000), 30).Load());
+		}
+
+		const size_t headerSize = saved.size() - 2 * sizeof(CDemoIndex::Entry);
+		const auto CheckCorrupt = [&](size_t offset, std::int32_t value) {
+			std::string data = saved;
+			memcpy(&data[offset], &value, sizeof(value));
+			WriteFile(indexName, data);
+
+			INFO("offset " << offset << " value " << value);
+			CHECK(!CDemoIndex(demoName, GetDemoHeader(1, 5000), 30).Load());
+		};
+
+		// bad magic, version and counts
+		CheckCorrupt(0, 0);
+		CheckCorrupt(16, 1234);
+		CheckCorrupt(headerSize - 4, -1);
+		CheckCorrupt(headerSize - 4, 0x7fffffff);
+		// entries with impossible frames and chunk positions, or duplicates
+		CheckCorrupt(headerSize + 0, 0);
+		CheckCorrupt(headerSize + 0, 90);
+		CheckCorrupt(headerSize + 4, -10);
+		CheckCorrupt(headerSize + 4, 5001);
+
+		// an intact index still loads
+		WriteFile(indexName, saved);
+		CHECK(CDemoIndex(demoName, GetDemoHeader(1, 5000), 30).Load());
+	}
+
+	std::filesystem::remove_all(testDir);
+}
@@ -0,0 +1,192 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "System/Net/PacketPool.h"
+#include "System/Net/RawPacket.h"
+
+#include <cstring>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+using namespace netcode;
+
+
+// the pool is global and keeps its blocks between sections, so
+// everything is checked relative to the state a section starts with
+TEST_CASE("PacketPool")
+{
+	SECTION("acquire and release") {
+		void* a = PacketPool::Alloc(100);
+		void* b = PacketPool::Alloc(100);
+
+		REQUIRE(a != nullptr);
+		REQUIRE(b != nullptr);
+		CHECK(a != b);
+
+		// the whole block is usable
+		std::memset(a, 0xAA, 100);
+		std::memset(b, 0xBB, 100);
+
+		const uint32_t numFree = PacketPool::GetNumFreeBlocks(100);
+
+		PacketPool::Free(a, 100);
+		CHECK(PacketPool::GetNumFreeBlocks(100) == numFree + 1);
+		PacketPool::Free(b, 100);
+		CHECK(PacketPool::GetNumFreeBlocks(100) == numFree + 2);
+
+		// nothing to do
+		PacketPool::Free(nullptr, 100);
+		CHECK(PacketPool::GetNumFreeBlocks(100) == numFree + 2);
+	}
+
+	SECTION("reuse") {
+		void* a = PacketPool::Alloc(200);
+		void* b = PacketPool::Alloc(200);
+
+		// most recently freed first
+		PacketPool::Free(a, 200);
+		PacketPool::Free(b, 200);
+
+		const uint32_t numFree = PacketPool::GetNumFreeBlocks(200);
+
+		CHECK(PacketPool::Alloc(200) == b);
+		CHECK(PacketPool::Alloc(200) == a);
+		CHECK(PacketPool::GetNumFreeBlocks(200) == numFree - 2);
+
+		PacketPool::Free(a, 200);
+		PacketPool::Free(b, 200);
+	}
+
+	SECTION("size classes") {
+		for (uint32_t blockSize = PacketPool::MIN_BLOCK_SIZE; blockSize <= PacketPool::MAX_BLOCK_SIZE; blockSize <<= 1) {
+			const uint32_t minSize = (blockSize == PacketPool::MIN_BLOCK_SIZE)? 1: (blockSize / 2 + 1);
+
+			INFO("block size " << blockSize);
+
+			// a block freed with the largest size of a class serves the smallest
+			void* block = PacketPool::Alloc(blockSize);
+			std::memset(block, 0xCC, blockSize);
+			PacketPool::Free(block, blockSize);
+
+			CHECK(PacketPool::GetNumFreeBlocks(minSize) == PacketPool::GetNumFreeBlocks(blockSize));
+			CHECK(PacketPool::Alloc(minSize) == block);
+
+			// and neither neighbouring class
+			const uint32_t numFreeBelow = PacketPool::GetNumFreeBlocks(minSize - 1);
+			const uint32_t numFreeAbove = PacketPool::GetNumFreeBlocks(blockSize + 1);
+
+			PacketPool::Free(block, minSize);
+
+			if (blockSize > PacketPool::MIN_BLOCK_SIZE)
+				CHECK(PacketPool::GetNumFreeBlocks(minSize - 1) == numFreeBelow);
+			if (blockSize < PacketPool::MAX_BLOCK_SIZE)
+				CHECK(PacketPool::GetNumFreeBlocks(blockSize + 1) == numFreeAbove);
+		}
+
+		// no class covers larger sizes, these go to the heap
+		void* large = PacketPool::Alloc(PacketPool::MAX_BLOCK_SIZE + 1);
+		std::memset(large, 0xDD, PacketPool::MAX_BLOCK_SIZE + 1);
+		PacketPool::Free(large, PacketPool::MAX_BLOCK_SIZE + 1);
+
+		CHECK(PacketPool::GetNumFreeBlocks(PacketPool::MAX_BLOCK_SIZE + 1) == 0);
+	}
+
+	SECTION("free-list limit") {
+		std::vector<void*> blocks(PacketPool::MAX_FREE_BLOCKS + 10);
+
+		for (void*& block: blocks) {
+			block = PacketPool::Alloc(64);
+		}
+		for (void* block: blocks) {
+			PacketPool::Free(block, 64);
+		}
+
+		CHECK(PacketPool::GetNumFreeBlocks(64) == PacketPool::MAX_FREE_BLOCKS);
+	}
+
+	SECTION("packets") {
+		const uint32_t length = 300;
+
+		const auto SendPacket = [&]() {
+			std::shared_ptr<const RawPacket> packet = SharePacket(new RawPacket(length, 1));
+
+			CHECK(packet->length == length);
+			CHECK(packet->data[0] == 1);
+			return std::make_pair(PacketPool::GetNumFreeBlocks(sizeof(RawPacket)), PacketPool::GetNumFreeBlocks(length));
+		};
+
+		// the first one may have to go to the heap
+		SendPacket();
+
+		const uint32_t numFreeObjects = PacketPool::GetNumFreeBlocks(sizeof(RawPacket));
+		const uint32_t numFreeData = PacketPool::GetNumFreeBlocks(length);
+
+		// object, control-block and data are taken from the pool and returned to it
+		const auto [numFreeObjectsSent, numFreeDataSent] = SendPacket();
+
+		CHECK(numFreeObjectsSent < numFreeObjects);
+		CHECK(numFreeDataSent == numFreeData - 1);
+		CHECK(PacketPool::GetNumFreeBlocks(sizeof(RawPacket)) == numFreeObjects);
+		CHECK(PacketPool::GetNumFreeBlocks(length) == numFreeData);
+	}
+
+	SECTION("threads") {
+		constexpr int NUM_THREADS = 4;
+		constexpr int NUM_ROUNDS = 20000;
+
+		// blocks are allocated on one thread and freed on another
+		std::vector<void*> handoff[NUM_THREADS];
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < NUM_THREADS; t++) {
+			handoff[t].resize(NUM_ROUNDS);
+		}
+		for (int t = 0; t < NUM_THREADS; t++) {
+			threads.emplace_back([&, t]() {
+				for (int n = 0; n < NUM_ROUNDS; n++) {
+					void* block = PacketPool::Alloc(1000);
+					std::memset(block, t, 1000);
+					PacketPool::Free(block, 1000);
+
+					handoff[t][n] = PacketPool::Alloc(1000);
+				}
+			});
+		}
+		for (std::thread& thread: threads) {
+			thread.join();
+		}
+
+		threads.clear();
+
+		for (int t = 0; t < NUM_THREADS; t++) {
+			threads.emplace_back([&, t]() {
+				for (void* block: handoff[(t + 1) % NUM_THREADS]) {
+					PacketPool::Free(block, 1000);
+				}
+			});
+		}
+		for (std::thread& thread: threads) {
+			thread.join();
+		}
+
+		// every block is on the free-list at most once
+		const uint32_t numFree = PacketPool::GetNumFreeBlocks(1000);
+		std::set<void*> blocks;
+
+		CHECK(numFree == PacketPool::MAX_FREE_BLOCKS);
+
+		for (uint32_t n = 0; n < numFree; n++) {
+			blocks.insert(PacketPool::Alloc(1000));
+		}
+
+		CHECK(blocks.size() == numFree);
+		CHECK(PacketPool::GetNumFreeBlocks(1000) == 0);
+
+		for (void* block: blocks) {
+			PacketPool::Free(block, 1000);
+		}
+	}
+}
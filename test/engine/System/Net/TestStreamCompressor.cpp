@@ -0,0 +1,113 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "System/Net/StreamCompressor.h"
+
+#include <catch_amalgamated.hpp>
+
+using namespace netcode;
+
+static constexpr size_t MAX_PIECE_SIZE = 8192;
+
+
+// game-like data: short messages that mostly repeat with small changes
+static std::vector<std::uint8_t> MakePiece(std::mt19937& rng, size_t size)
+{
+	std::vector<std::uint8_t> piece(size);
+
+	for (size_t i = 0; i < size; i++) {
+		piece[i] = ((i % 16) < 12)? std::uint8_t(i % 16): std::uint8_t(rng());
+	}
+
+	return piece;
+}
+
+
+TEST_CASE("StreamCompressor")
+{
+	std::mt19937 rng(1);
+
+	SECTION("round trip") {
+		StreamCompressor compressor(9);
+		StreamDecompressor decompressor;
+
+		REQUIRE(compressor.IsValid());
+		REQUIRE(decompressor.IsValid());
+
+		std::vector<std::uint8_t> packed;
+		std::vector<std::uint8_t> unpacked;
+
+		size_t rawBytes = 0;
+		size_t packedBytes = 0;
+
+		// every piece has to decode on its own, given all earlier ones
+		for (int n = 0; n < 500; n++) {
+			const std::vector<std::uint8_t> piece = MakePiece(rng, 1 + (rng() % MAX_PIECE_SIZE));
+
+			// the level may change between pieces
+			if ((n % 100) == 50)
+				compressor.SetLevel(1 + (n % 9));
+
+			packed.clear();
+			unpacked.clear();
+
+			REQUIRE(compressor.Compress(piece.data(), piece.size() / 2, packed));
+			REQUIRE(compressor.Compress(piece.data() + piece.size() / 2, piece.size() - piece.size() / 2, packed));
+			REQUIRE(compressor.Flush(packed));
+
+			REQUIRE(decompressor.Decompress(packed.data(), packed.size(), unpacked, MAX_PIECE_SIZE));
+			REQUIRE(unpacked == piece);
+
+			rawBytes += piece.size();
+			packedBytes += packed.size();
+		}
+
+		CHECK(packedBytes < rawBytes);
+	}
+
+	SECTION("size cap") {
+		StreamCompressor compressor(9);
+		StreamDecompressor decompressor;
+
+		std::vector<std::uint8_t> packed;
+		std::vector<std::uint8_t> unpacked;
+
+		// exactly at the cap is fine
+		const std::vector<std::uint8_t> piece(MAX_PIECE_SIZE, 0);
+
+		REQUIRE(compressor.Compress(piece.data(), piece.size(), packed));
+		REQUIRE(compressor.Flush(packed));
+		REQUIRE(decompressor.Decompress(packed.data(), packed.size(), unpacked, MAX_PIECE_SIZE));
+		REQUIRE(unpacked.size() == MAX_PIECE_SIZE);
+
+		// a few hundred bytes of zeros inflate to megabytes, which must be refused
+		const std::vector<std::uint8_t> bomb(1 << 22, 0);
+
+		packed.clear();
+		unpacked.clear();
+
+		REQUIRE(compressor.Compress(bomb.data(), bomb.size(), packed));
+		REQUIRE(compressor.Flush(packed));
+		REQUIRE(packed.size() < MAX_PIECE_SIZE);
+
+		CHECK_FALSE(decompressor.Decompress(packed.data(), packed.size(), unpacked, MAX_PIECE_SIZE));
+		CHECK(unpacked.size() <= (MAX_PIECE_SIZE + 1));
+	}
+
+	SECTION("garbage") {
+		StreamDecompressor decompressor;
+
+		std::vector<std::uint8_t> garbage(256);
+		std::vector<std::uint8_t> unpacked;
+
+		// 0xff bytes start a reserved deflate block type
+		for (std::uint8_t& b: garbage) {
+			b = 0xff;
+		}
+
+		CHECK_FALSE(decompressor.Decompress(garbage.data(), garbage.size(), unpacked, MAX_PIECE_SIZE));
+	}
+}
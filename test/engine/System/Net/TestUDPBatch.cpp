@@ -0,0 +1,153 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "System/Net/UDPBatch.h"
+#include "System/Net/UDPListener.h"
+#include "System/Log/ILog.h"
+
+#include <catch_amalgamated.hpp>
+
+namespace streflop {
+	template<typename T> inline void streflop_init() {
+		// Do nothing by default, or for unknown types
+	}
+}
+
+using namespace netcode;
+
+static constexpr size_t NUM_DATAGRAMS = 20000;
+static constexpr size_t DATAGRAM_SIZE = 200;
+
+
+static std::shared_ptr<asio::ip::udp::socket> OpenSocket()
+{
+	std::shared_ptr<asio::ip::udp::socket> socket;
+
+	// port 0 binds to a free port
+	if (!UDPListener::TryBindSocket(0, socket, "127.0.0.1").empty())
+		return nullptr;
+
+	socket->non_blocking(true);
+	return socket;
+}
+
+static void FillDatagram(std::uint8_t* data, std::uint32_t seqNum)
+{
+	memset(data, seqNum & 0xFF, DATAGRAM_SIZE);
+	memcpy(data, &seqNum, sizeof(seqNum));
+}
+
+/// sends NUM_DATAGRAMS in bursts of <burstSize> and drains the receiver after each burst
+static double RunLoopback(bool batched, size_t burstSize, size_t& numReceived, size_t& numCorrupt)
+{
+	const std::shared_ptr<asio::ip::udp::socket> sender = OpenSocket();
+	const std::shared_ptr<asio::ip::udp::socket> receiver = OpenSocket();
+
+	REQUIRE(sender != nullptr);
+	REQUIRE(receiver != nullptr);
+
+	const asio::ip::udp::endpoint target = receiver->local_endpoint();
+
+	UDPReceiveBatch recvBatch;
+	std::uint8_t data[DATAGRAM_SIZE];
+	std::uint32_t nextSeqNum = 0;
+
+	numReceived = 0;
+	numCorrupt = 0;
+
+	const auto DrainReceiver = [&]() {
+		asio::error_code err;
+		size_t n = 0;
+
+		while ((n = recvBatch.Receive(*receiver, err)) > 0) {
+			for (size_t i = 0; i < n; i++) {
+				std::uint32_t seqNum = 0;
+
+				if (recvBatch.GetSize(i) != DATAGRAM_SIZE) {
+					numCorrupt += 1;
+					continue;
+				}
+
+				memcpy(&seqNum, recvBatch.GetData(i), sizeof(seqNum));
+				FillDatagram(data, seqNum);
+
+				// loopback neither drops (we never overrun the receive buffer) nor reorders
+				numCorrupt += (seqNum != nextSeqNum++);
+				numCorrupt += (memcmp(data, recvBatch.GetData(i), DATAGRAM_SIZE) != 0);
+				numCorrupt += (recvBatch.GetEndpoint(i) != sender->local_endpoint());
+				numReceived += 1;
+			}
+		}
+
+		CHECK(!err);
+	};
+
+	const auto t0 = std::chrono::steady_clock::now();
+
+	for (size_t sent = 0; sent < NUM_DATAGRAMS; ) {
+		if (batched) {
+			UDPSendBatch sendBatch;
+
+			for (size_t i = 0; i < burstSize; i++, sent++) {
+				FillDatagram(data, sent);
+				sendBatch.Add(sender, target, data, DATAGRAM_SIZE);
+			}
+
+			CHECK(sendBatch.GetNumQueued() == burstSize);
+		} else {
+			for (size_t i = 0; i < burstSize; i++, sent++) {
+				FillDatagram(data, sent);
+				sender->send_to(asio::buffer(data, DATAGRAM_SIZE), target);
+			}
+		}
+
+		DrainReceiver();
+	}
+
+	const auto t1 = std::chrono::steady_clock::now();
+
+	return (std::chrono::duration<double>(t1 - t0).count());
+}
+
+
+TEST_CASE("UDPBatch")
+{
+	size_t numReceived = 0;
+	size_t numCorrupt = 0;
+
+	SECTION("current batch is scoped per thread")
+	{
+		CHECK(UDPSendBatch::GetCurrent() == nullptr);
+		{
+			UDPSendBatch outer;
+			CHECK(UDPSendBatch::GetCurrent() == &outer);
+			{
+				UDPSendBatch inner;
+				CHECK(UDPSendBatch::GetCurrent() == &inner);
+			}
+			CHECK(UDPSendBatch::GetCurrent() == &outer);
+		}
+		CHECK(UDPSendBatch::GetCurrent() == nullptr);
+	}
+
+	SECTION("loopback throughput")
+	{
+		const double singleTime = RunLoopback(false, 32, numReceived, numCorrupt);
+
+		CHECK(numReceived == NUM_DATAGRAMS);
+		CHECK(numCorrupt == 0);
+
+		// bursts larger than MAX_BATCH_SIZE take more than one sendmmsg
+		const double batchTime = RunLoopback(true, 100, numReceived, numCorrupt);
+
+		CHECK(numReceived == NUM_DATAGRAMS);
+		CHECK(numCorrupt == 0);
+
+		LOG("[%s] %u datagrams: %.1fms one by one, %.1fms batched", __func__, unsigned(NUM_DATAGRAMS), singleTime * 1000.0, batchTime * 1000.0);
+	}
+}
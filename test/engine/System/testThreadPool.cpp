@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "System/Threading/ThreadPool.h"
+#include "System/Threading/TaskGraph.h"
 #include "System/Log/ILog.h"
 #include "System/Threading/SpringThreading.h"
 #include "System/Misc/SpringTime.h"
@@ -144,6 +145,34 @@ TEST_CASE("test_nested_for_mt")
 	});
 }
 
+TEST_CASE("test_concurrent_for_mt_section")
+{
+	LOG("[%s::test_concurrent_for_mt_section]", __func__);
+
+	CTaskGraph graph("MTSection");
+	std::atomic<int> outside = {0};
+
+	// loops of independent stages overlap, neither may end the other's section
+	const auto Loop = [&]() {
+		for (int n = 0; n < 20; n++) {
+			for_mt(0, 1000, [&](const int i) {
+				if (ThreadPool::inMultiThreadedSection <= 0)
+					outside.fetch_add(1);
+			});
+		}
+	};
+
+	graph.AddStage("a", CTaskGraph::RES_NONE, 1 << 0, false, Loop);
+	graph.AddStage("b", CTaskGraph::RES_NONE, 1 << 1, false, Loop);
+
+	for (int i = 0; i < 20; i++) {
+		graph.Run();
+	}
+
+	CHECK(outside == 0);
+	CHECK(ThreadPool::inMultiThreadedSection == 0);
+}
+
 TEST_CASE("test_nested_parallel")
 {
 	#if 0
@@ -169,6 +198,41 @@ TEST_CASE("test_throw_for_mt")
 	}*/
 }
 
+TEST_CASE("test_imbalanced_for_mt_chunk")
+{
+	LOG("[%s::test_imbalanced_for_mt_chunk]", __func__);
+
+	std::vector<std::atomic<int>> hits(NUM_RUNS);
+
+	// heavy elements are clustered at the front, every index must still be hit once
+	for (const int minChunkSize: {1, 7, 64}) {
+		for (auto& h: hits)
+			h = 0;
+
+		for_mt_chunk(0, NUM_RUNS, [&](const int i) {
+			const spring_time end = spring_now() + spring_time::fromMicroSecs(10 * (i < (NUM_RUNS / 16)));
+			while (spring_now() < end) {}
+
+			hits[i] += 1;
+		}, minChunkSize, 256);
+
+		for (int i = 0; i < NUM_RUNS; i++) {
+			CHECK(hits[i] == 1);
+		}
+	}
+
+	std::atomic<int> cnt(0);
+
+	for_mt_chunk(0, 64, [&](const int y) {
+		for_mt_chunk(0, 64, [&](const int x) {
+			++cnt;
+		});
+	});
+
+	CHECK(cnt == 64 * 64);
+}
+
+
 TEST_CASE("test_null_for_mt")
 {
 	for_mt(0, -100, [&](const int i) {
@@ -203,6 +267,49 @@ TEST_CASE("test_sse_for_mt")
 
 
 
+TEST_CASE("test_task_graph")
+{
+	LOG("[%s::test_task_graph]", __func__);
+
+	enum { RES_A = 1 << 0, RES_B = 1 << 1, RES_C = 1 << 2 };
+
+	std::vector<int> order;
+	std::atomic<int> a = {0};
+	std::atomic<int> b = {0};
+	int c = 0;
+
+	CTaskGraph graph("TaskGraph");
+
+	// independent of each other, both may run on workers
+	graph.AddStage("a", CTaskGraph::RES_NONE, RES_A, false, [&]() { a = 1; });
+	graph.AddStage("b", CTaskGraph::RES_NONE, RES_B, false, [&]() { b = 2; });
+	// must see both
+	graph.AddStage("c", RES_A | RES_B, RES_C, true, [&]() { c = a + b; order.push_back(0); });
+	// writers of the same resource keep their order
+	graph.AddStage("d", CTaskGraph::RES_NONE, RES_C, false, [&]() { order.push_back(1); });
+	graph.AddStage("e", CTaskGraph::RES_ALL, CTaskGraph::RES_ALL, true, [&]() { order.push_back(2); });
+
+	CHECK(graph.GetDependencies(0).empty());
+	CHECK(graph.GetDependencies(1).empty());
+	CHECK(graph.GetDependencies(2) == std::vector<size_t>{0, 1});
+	CHECK(graph.GetDependencies(3) == std::vector<size_t>{2});
+	CHECK(graph.GetDependencies(4) == std::vector<size_t>{0, 1, 2, 3});
+
+	for (int i = 0; i < 100; i++) {
+		a = 0;
+		b = 0;
+		c = 0;
+		order.clear();
+
+		graph.Run();
+
+		CHECK(c == 3);
+		CHECK(order == std::vector<int>{0, 1, 2});
+		CHECK(graph.GetCriticalPathTime() >= spring_notime);
+	}
+}
+
+
 
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -245,6 +352,75 @@ static void for_vs_for_mt_kernel(const int numRuns, const spring_time kernelLoad
 	LOG("\t\tmt runtime: %.0f%%", (t_formt.toMilliSecsf() / t_for.toMilliSecsf()) * 100.0f);
 }
 
+// how long after the first thread ran out of work the last one finished,
+// for a loop whose first <numHeavy> elements cost <heavyLoad> and the
+// rest nothing; a static split (the old for_mt_chunk) hands all of the
+// heavy ones to the first thread
+static void imbalanced_for_mt_kernel(const int numElems, const int numHeavy, const spring_time heavyLoad)
+{
+	LOG("\t[%s] %d elements, first %d take %.3fms each:", __func__, numElems, numHeavy, heavyLoad.toMilliSecsf());
+
+	std::array<spring_time, ThreadPool::MAX_THREADS> doneTimes;
+
+	const auto Kernel = [&](const int i) {
+		if (i < numHeavy) {
+			const spring_time finish = spring_now() + heavyLoad;
+			while (spring_now() < finish) {}
+		}
+
+		doneTimes[ThreadPool::GetThreadNum()] = spring_now();
+	};
+	const auto TailTime = [&]() {
+		spring_time minTime = spring_now();
+		spring_time maxTime = spring_notime;
+
+		for (int i = 0; i < ThreadPool::GetNumThreads(); i++) {
+			// thread did not take part
+			if (doneTimes[i] <= spring_notime)
+				continue;
+
+			minTime = std::min(minTime, doneTimes[i]);
+			maxTime = std::max(maxTime, doneTimes[i]);
+		}
+
+		return (maxTime - minTime);
+	};
+
+	const int numThreads = ThreadPool::GetNumThreads();
+	const int chunkSize = (numElems + numThreads - 1) / numThreads;
+
+	{
+		doneTimes.fill(spring_notime);
+
+		const spring_time start = spring_now();
+
+		for_mt(0, numThreads, [&](const int j) {
+			for (int i = j * chunkSize, e = std::min(i + chunkSize, numElems); i < e; ++i) {
+				Kernel(i);
+			}
+		});
+
+		LOG("\t\tstatic split   took %.4fms (tail %.4fms)", (spring_now() - start).toMilliSecsf(), TailTime().toMilliSecsf());
+	}
+	{
+		doneTimes.fill(spring_notime);
+
+		const spring_time start = spring_now();
+
+		for_mt_chunk(0, numElems, Kernel);
+
+		LOG("\t\twork-stealing took %.4fms (tail %.4fms)", (spring_now() - start).toMilliSecsf(), TailTime().toMilliSecsf());
+	}
+}
+
+TEST_CASE("test_imbalanced_for_mt_tail")
+{
+	imbalanced_for_mt_kernel(10000, 10000 / ThreadPool::GetNumThreads(), spring_time::fromMicroSecs(5));
+	imbalanced_for_mt_kernel(10000, 200, spring_time::fromMicroSecs(50));
+	imbalanced_for_mt_kernel(1000, 10, spring_time::fromMicroSecs(1000));
+}
+
+
 TEST_CASE("test_for_vs_for_mt")
 {
 	for_vs_for_mt_kernel(100,  spring_time::fromMicroSecs(10));
@@ -0,0 +1,112 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "System/TimingWheel.h"
+
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include <catch_amalgamated.hpp>
+
+typedef CTimingWheel::Entry Entry;
+typedef std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> RefQueue;
+
+
+// the wheel has to hand out entries exactly like the heap it replaces, also
+// when entries are inserted from the callback (like re-sleeping COB threads);
+// ties are broken by key, which is not the ID order (like COB thread slots)
+static void CompareWithHeap(unsigned int seed, int startTime, int maxDelta, int maxDelay)
+{
+	std::mt19937 rng(seed);
+
+	const auto Rand = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+	const auto RandDelay = [&]() {
+		switch (Rand(0, 5)) {
+			case 0: return Rand(-50, 0);
+			case 1: return Rand(0, 300);
+			case 2: return Rand(0, 20000);
+			case 3: return Rand(0, maxDelay);
+			default: break;
+		}
+
+		return Rand(0, 64);
+	};
+
+	CTimingWheel wheel;
+	RefQueue heap;
+
+	wheel.Clear(startTime);
+
+	int time = startTime;
+	int nextKey = 0;
+	int wheelKey = 0;
+	int heapKey = 0;
+
+	// unique, but in no particular order
+	const auto KeyToID = [](int key) { return int((unsigned(key) * 2654435761u) & 0x7fffffff); };
+
+	std::vector<Entry> wheelOrder;
+	std::vector<Entry> heapOrder;
+	std::vector<Entry> entries;
+
+	for (int step = 0; step < 20000; ++step) {
+		for (int i = 0, n = Rand(0, 8); i < n; ++i) {
+			const Entry e = {time + RandDelay(), nextKey, KeyToID(nextKey)};
+
+			nextKey += 1;
+			wheel.Insert(e.time, e.key, e.id);
+			heap.push(e);
+		}
+
+		time += Rand(1, maxDelta);
+
+		wheelOrder.clear();
+		heapOrder.clear();
+
+		wheelKey = nextKey;
+		heapKey = nextKey;
+
+		// a third of the woken entries goes back to sleep, deterministically
+		// per entry so both sides re-insert the same ones (with new keys)
+		wheel.Advance(time, [&](int t, int id) {
+			wheelOrder.push_back({t, 0, id});
+
+			if ((id % 3) == 0 && t > (time - maxDelta))
+				wheel.Insert(time + ((id % 101) - 50), wheelKey++, (id / 3) * 2 + 1);
+		});
+
+		while (!heap.empty() && heap.top().time < time) {
+			const Entry e = heap.top();
+
+			heap.pop();
+			heapOrder.push_back({e.time, 0, e.id});
+
+			if ((e.id % 3) == 0 && e.time > (time - maxDelta))
+				heap.push({time + ((e.id % 101) - 50), heapKey++, (e.id / 3) * 2 + 1});
+		}
+
+		nextKey = wheelKey;
+
+		REQUIRE(wheelOrder == heapOrder);
+		REQUIRE(wheel.GetSize() == int(heap.size()));
+	}
+
+	wheel.GetEntries(entries);
+	heapOrder.clear();
+
+	while (!heap.empty()) {
+		heapOrder.push_back(heap.top());
+		heap.pop();
+	}
+
+	REQUIRE(entries == heapOrder);
+}
+
+
+TEST_CASE("TimingWheel")
+{
+	SECTION("frame steps") { CompareWithHeap(1, 0, 33, 1 << 21); }
+	SECTION("long steps") { CompareWithHeap(2, 0, 5000, 1 << 28); }
+	SECTION("negative times") { CompareWithHeap(3, -100000, 100, 1 << 16); }
+}
@@ -0,0 +1,168 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "lib/lua/include/LuaInclude.h"
+#include "lib/lua/src/lobject.h"
+
+#include <random>
+#include <string>
+
+#include <catch_amalgamated.hpp>
+
+
+static const Table* GetTable(lua_State* L, int idx) { return static_cast<const Table*>(lua_topointer(L, idx)); }
+
+static void CheckTableSize(lua_State* L, int idx, int expArr, int expRec)
+{
+	int narr = -1;
+	int nrec = -1;
+
+	lua_tablesize(L, idx, &narr, &nrec);
+
+	CHECK(narr == expArr);
+	CHECK(nrec == expRec);
+}
+
+// copies the table on top of L into one created with lua_tablesize's sizes,
+// which has to hold all elements without growing; leaves the copy on top
+static void CopyTable(lua_State* L)
+{
+	int narr = 0;
+	int nrec = 0;
+
+	lua_tablesize(L, -1, &narr, &nrec);
+	lua_createtable(L, narr, nrec);
+
+	const Table* t = GetTable(L, -1);
+	const Node* node = t->node;
+	const int sizearray = t->sizearray;
+	const int sizenode = sizenode(t);
+
+	for (lua_pushnil(L); lua_next(L, -3) != 0; ) {
+		lua_pushvalue(L, -2);
+		lua_insert(L, -2);
+		lua_rawset(L, -4);
+	}
+
+	CHECK(t->node == node);
+	CHECK(t->sizearray == sizearray);
+	CHECK(sizenode(t) == sizenode);
+
+	lua_remove(L, -2);
+}
+
+
+TEST_CASE("LuaApi")
+{
+	lua_State* L = luaL_newstate();
+
+	SECTION("lua_tohstring") {
+		const std::string str = "SendToUnsynced";
+
+		lua_pushlstring(L, str.data(), str.size());
+		lua_pushnumber(L, 42);
+
+		size_t len = 0;
+		lua_Hash hash = 0;
+
+		const char* s = lua_tohstring(L, -2, &len, &hash);
+
+		REQUIRE(s != nullptr);
+		CHECK(std::string(s, len) == str);
+		CHECK(hash == lua_calchash(str.data(), str.size()));
+
+		// pushing it with that hash has to yield the same interned string
+		lua_pushhstring(L, hash, s, len);
+		CHECK(lua_rawequal(L, -1, -3));
+		CHECK(lua_tostring(L, -1) == s);
+		lua_pop(L, 1);
+
+		// numbers are not converted, unlike lua_tolstring does
+		CHECK(lua_tohstring(L, -1, &len, &hash) == nullptr);
+		CHECK(lua_type(L, -1) == LUA_TNUMBER);
+	}
+
+	SECTION("lua_tablesize") {
+		// empty
+		lua_newtable(L);
+		CheckTableSize(L, -1, 0, 0);
+		lua_pop(L, 1);
+
+		// array and hash part; like rehash would, rounds the array part
+		// up to a power of two as long as it is more than half full
+		luaL_dostring(L, "return {1, 2, 3, 4, 5, x = 1, y = 2}");
+		CheckTableSize(L, -1, 8, 2);
+		lua_pop(L, 1);
+
+		// allocated much larger than the elements it still holds
+		lua_createtable(L, 1024, 256);
+		for (int i = 1; i <= 1024; i++) {
+			lua_pushnumber(L, i);
+			lua_rawseti(L, -2, i);
+		}
+		for (int i = 0; i < 200; i++) {
+			lua_pushnumber(L, i);
+			lua_setfield(L, -2, ("key" + std::to_string(i)).c_str());
+		}
+		for (int i = 4; i <= 1024; i++) {
+			lua_pushnil(L);
+			lua_rawseti(L, -2, i);
+		}
+		for (int i = 1; i < 200; i++) {
+			lua_pushnil(L);
+			lua_setfield(L, -2, ("key" + std::to_string(i)).c_str());
+		}
+		CheckTableSize(L, -1, 4, 1);
+		lua_pop(L, 1);
+
+		// integer keys too sparse for an array part
+		luaL_dostring(L, "return {[1] = 1, [100] = 2, [10000] = 3}");
+		CheckTableSize(L, -1, 1, 2);
+		lua_pop(L, 1);
+
+		// integer keys in the hash part that would fill the array part
+		luaL_dostring(L, "local t = {} for i = 8, 1, -1 do t[i] = i end return t");
+		CheckTableSize(L, -1, 8, 0);
+		lua_pop(L, 1);
+	}
+
+	SECTION("lua_tablesize fits copies") {
+		std::mt19937 rng(20);
+
+		for (int n = 0; n < 500; n++) {
+			lua_createtable(L, rng() % 64, rng() % 64);
+
+			for (int k = rng() % 200; k > 0; k--) {
+				switch (rng() % 4) {
+					case 0: { lua_pushnumber(L, 1 + rng() % 128); } break;
+					case 1: { lua_pushnumber(L, 1 + rng() % 100000); } break;
+					case 2: { lua_pushstring(L, std::to_string(rng() % 100).c_str()); } break;
+					case 3: { lua_pushnumber(L, (rng() % 1000) * 0.5); } break;
+				}
+
+				// sometimes erase, so the table holds fewer elements than it has room for
+				if ((rng() % 4) == 0) {
+					lua_pushnil(L);
+				} else {
+					lua_pushboolean(L, true);
+				}
+
+				lua_rawset(L, -3);
+			}
+
+			int narr = 0;
+			int nrec = 0;
+
+			lua_tablesize(L, -1, &narr, &nrec);
+
+			CopyTable(L);
+
+			// the copy already has the size it needs
+			INFO("table " << n);
+			CheckTableSize(L, -1, narr, nrec);
+			CHECK(GetTable(L, -1)->sizearray == narr);
+			lua_pop(L, 1);
+		}
+	}
+
+	lua_close(L);
+}
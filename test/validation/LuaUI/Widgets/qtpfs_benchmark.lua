@@ -0,0 +1,90 @@
+function widget:GetInfo()
+return {
+	name    = "QTPFS-Benchmark",
+	desc    = "Replays fixed path requests and reports nodes expanded + wall time",
+	author  = "Recoil",
+	date    = "2026",
+	license = "GNU GPL, v2 or later",
+	layer   = 0,
+	enabled = false,
+}
+end
+
+-- Run with test/validation/qtpfs_benchmark.sh, which starts one game with
+-- qtAbstractGraphMinDist = 0 (abstract graph off) and one with it enabled,
+-- then prints the result lines of both runs next to each other.
+-- Can also be enabled by hand, the result then is for whatever value the
+-- game's modrules set.
+
+local moveDefName = "tank3" -- any movedef of the game being tested
+local repetitions = 5
+
+-- start and goal as fractions of the map size, mostly corner-to-corner and
+-- edge-to-edge so that the searches are long enough to matter
+local requests = {
+	{ 0.05, 0.05, 0.95, 0.95 },
+	{ 0.95, 0.05, 0.05, 0.95 },
+	{ 0.05, 0.50, 0.95, 0.50 },
+	{ 0.50, 0.05, 0.50, 0.95 },
+	{ 0.10, 0.90, 0.90, 0.15 },
+	{ 0.25, 0.25, 0.75, 0.75 },
+	{ 0.20, 0.60, 0.80, 0.40 },
+	{ 0.60, 0.10, 0.30, 0.85 },
+}
+
+local modOptions = Spring.GetModOptions()
+local minDistLabel = modOptions.qtabstractgraphmindist or "game default"
+local quitWhenDone = (modOptions.qtpfsbenchmark == "1")
+
+local function ToWorld(fx, fz)
+	local x = fx * Game.mapSizeX
+	local z = fz * Game.mapSizeZ
+	return x, Spring.GetGroundHeight(x, z), z
+end
+
+local function RunBenchmark()
+	local totalNodes = 0
+	local totalWallTime = 0
+	local numFound = 0
+
+	for rep = 1, repetitions do
+		for i = 1, #requests do
+			local r = requests[i]
+			local sx, sy, sz = ToWorld(r[1], r[2])
+			local ex, ey, ez = ToWorld(r[3], r[4])
+
+			-- unsynced requests are searched right away, so this covers the whole search
+			local timer = Spring.GetTimer()
+			local path = Spring.RequestPath(moveDefName, sx, sy, sz, ex, ey, ez)
+			local wallTime = Spring.DiffTimers(Spring.GetTimer(), timer, true)
+
+			if path then
+				local nodes = path:GetSearchStats()
+				if nodes then
+					numFound = numFound + 1
+					totalNodes = totalNodes + nodes
+					totalWallTime = totalWallTime + wallTime
+					if rep == 1 then
+						Spring.Echo(string.format("QTPFS benchmark request %i: nodes=%i wall-time=%.3fms", i, nodes, wallTime))
+					end
+				end
+			end
+			path = nil
+		end
+	end
+
+	Spring.Echo(string.format("QTPFS benchmark result: qtAbstractGraphMinDist=%s paths=%i/%i nodes=%i wall-time=%.3fms",
+		minDistLabel, numFound, repetitions * #requests, totalNodes, totalWallTime))
+end
+
+function widget:GameFrame(n)
+	-- give the pathfinder time to finish its initial updates
+	if n == 30 then
+		RunBenchmark()
+		widgetHandler:RemoveWidget(self)
+
+		if quitWhenDone then
+			Spring.SendCommands("quitforce")
+		end
+	end
+end
@@ -0,0 +1,85 @@
+#!/bin/sh
+
+# Runs the QTPFS-Benchmark widget once with the abstract graph disabled and
+# once with it enabled, and prints the results of both runs.
+#
+# The value is handed to the game as the qtabstractgraphmindist modoption,
+# so the game's gamedata/modrules.lua has to forward it, e.g.:
+#   system.qtAbstractGraphMinDist = tonumber(Spring.GetModOptions().qtabstractgraphmindist)
+# and select QTPFS (system.pathFinderSystem = 1).
+
+set -e # abort on error
+
+if [ $# -lt 3 ]; then
+	echo "Usage: $0 /path/to/spring-headless Game Map [qtAbstractGraphMinDist]"
+	exit 1
+fi
+
+SPRING="$1"
+GAME="$2"
+MAP="$3"
+MINDIST="${4:-1024}"
+
+WIDGET=test/validation/LuaUI/Widgets/qtpfs_benchmark.lua
+
+if [ ! -x "$SPRING" ]; then
+	echo "Parameter 1 $SPRING isn't executable!"
+	exit 1
+fi
+
+if [ ! -f $WIDGET ]; then
+	echo "$WIDGET doesn't exist, please run from the source-root directory"
+	exit 1
+fi
+
+# games and maps are still looked up in the usual data-dir
+export SPRING_DATADIR="${SPRING_DATADIR:-$HOME/.config/spring}"
+
+for VALUE in 0 $MINDIST; do
+	WRITEDIR=$(mktemp -d)
+
+	mkdir -p $WRITEDIR/LuaUI/Widgets
+	sed 's/enabled = false/enabled = true/' $WIDGET > $WRITEDIR/LuaUI/Widgets/qtpfs_benchmark.lua
+
+	cat > $WRITEDIR/script.txt <<EOD
+[GAME]
+{
+	IsHost=1;
+	MyPlayerName=Benchmark;
+	Mapname=$MAP;
+	GameType=$GAME;
+	StartPosType=0;
+	[modoptions]
+	{
+		qtabstractgraphmindist=$VALUE;
+		qtpfsbenchmark=1;
+	}
+	[PLAYER0]
+	{
+		Name=Benchmark;
+		Spectator=1;
+		Team=0;
+	}
+	[TEAM0]
+	{
+		TeamLeader=0;
+		AllyTeam=0;
+	}
+	[ALLYTEAM0]
+	{
+		NumAllies=0;
+	}
+}
+EOD
+
+	echo "Running with qtAbstractGraphMinDist=$VALUE"
+	set +e
+	"$SPRING" --nocolor --write-dir $WRITEDIR $WRITEDIR/script.txt > /dev/null 2>&1
+	set -e
+
+	if grep "QTPFS benchmark" $WRITEDIR/infolog.txt; then
+		rm -rf $WRITEDIR
+	else
+		echo "no results, see $WRITEDIR/infolog.txt"
+	fi
+done
@@ -4,9 +4,9 @@ set -e
 
 TESTRUNS=4
 
-CMD[0]="./spring_pic --benchmark 20 --benchmarkstart 0"
-CMD[1]="./spring_nonpic --benchmark 20 --benchmarkstart 0"
-CMD[2]="./spring_mt --benchmark 20 --benchmarkstart 0"
+# creating the demo uses the first command, the benchmark runs write a
+# per-frame timing report (frame,wall,<timers...>) for every run
+CMD[0]="./spring-headless"
 
 #CMD1=$CMD2
 
@@ -27,7 +27,6 @@ if ! [ -s "$DEMOFILE" ]; then
 	DEMOFILE=`cat infolog.txt | grep "Writing demo: " | cut -c27-`
 	echo demo file: $DEMOFILE
 	cp -v "$DEMOFILE" "$PREFIX/benchmark.sdf"
-	mv benchmark.data "$PREFIX/data-0-cmd1.data"
 fi
 
 
@@ -36,8 +35,7 @@ for (( i=1; i <= TESTRUNS; i++ )); do
 	echo Round $i/$TESTRUNS
 	for (( k=0; k < $CMDCOUNT; k++ )); do
 		echo Running CMD $(($k+1))/$CMDCOUNT
-		${CMD[$k]} "$DEMOFILE" >/dev/null 2>&1
-		mv benchmark.data "$PREFIX/data-${i}-cmd${k}.data"
+		${CMD[$k]} --benchmark-report "$PREFIX/data-${i}-cmd${k}.csv" "$DEMOFILE" >/dev/null 2>&1
 	done
 done
 